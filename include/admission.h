@@ -0,0 +1,38 @@
+#ifndef ADMISSION_H
+#define ADMISSION_H
+
+#include "distributed_lxc.h"
+#include "config.h"
+
+#define ADMISSION_SLOTS MAX_CONTAINERS      // Deploys waiting over all nodes
+
+// Sends a placed deploy to its node, returns 0 or -1 once the operation failed
+typedef int (*admission_dispatcher_t)(int op_id, const char* node_id, const lxc_config_t* config);
+
+// One node's backlog for status output
+typedef struct {
+    char node_id[MAX_NAME_LEN];
+    int queued;
+    double tokens;
+    unsigned long dispatched;
+} admission_node_info_t;
+
+// Admission counters for status output
+typedef struct {
+    int queued;                 // Deploys waiting over all nodes
+    double tokens;              // Cluster bucket
+    double oldest_wait;         // Seconds the longest waiting deploy has waited
+    unsigned long admitted;
+    unsigned long delayed;      // Admitted after waiting in the queue
+    unsigned long expired;      // Failed after waiting max_wait
+} admission_status_t;
+
+// Admission functions
+int init_admission(admission_dispatcher_t dispatcher);
+void admission_configure(const daemon_config_t* config);
+int admission_submit(int op_id, const char* node_id, const lxc_config_t* config);
+void admission_status(admission_status_t* status);
+int admission_list(admission_node_info_t* nodes, int max_nodes);
+void show_admission(void);
+
+#endif // ADMISSION_H
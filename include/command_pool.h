@@ -0,0 +1,34 @@
+#ifndef COMMAND_POOL_H
+#define COMMAND_POOL_H
+
+#include "distributed_lxc.h"
+
+#define COMMAND_POOL_MAX_THREADS 64
+#define COMMAND_VERB_LEN 16
+
+// Runs one command, returns an operation id, 0 when there is none, or -1
+typedef int (*command_executor_t)(const char* verb, const char* argument);
+
+// Commands started together by command_start_batch
+typedef struct command_batch command_batch_t;
+
+// Pool counters for status output
+typedef struct {
+    int threads;
+    int queued;                 // Submitted but not finished
+    unsigned long submitted;
+    unsigned long completed;
+    unsigned long failed;
+} command_pool_status_t;
+
+// Command pool functions
+int init_command_pool(int threads, command_executor_t executor);
+int command_submit(const char* verb, const char* argument);
+command_batch_t* command_start_batch(const char* verb, char** arguments, int count,
+                                     void (*notify)(void));
+int command_batch_results(command_batch_t* batch, int* results);
+void command_release_batch(command_batch_t* batch);
+void command_pool_status(command_pool_status_t* status);
+void show_command_pool(void);
+
+#endif // COMMAND_POOL_H
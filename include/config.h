@@ -0,0 +1,112 @@
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include "distributed_lxc.h"
+
+#define DEFAULT_COORDINATOR_CONFIG "/etc/distributed-lxc/coordinator.conf"
+#define DEFAULT_WORKER_CONFIG "/etc/distributed-lxc/worker.conf"
+#define DEFAULT_NODE_MAX_CONTAINERS 50
+#define DEFAULT_MIGRATION_DIR "/var/tmp"
+#define DEFAULT_EXECUTOR_THREADS 8
+#define DEFAULT_RUNTIME "lxd"
+#define MAX_TENANT_QUOTAS 64
+
+// Limits for one tenant from the [tenants] section, 0 meaning unlimited
+typedef struct {
+    char name[MAX_NAME_LEN];
+    int cpu;                      // CPUs requested by the tenant's containers
+    int memory;                   // MB
+    int containers;
+    double weight;                // Fair share weight, 1 by default
+} tenant_quota_t;
+
+// Immutable configuration snapshot shared by the coordinator and worker.
+// Each binary fills the fields of the sections present in its own file and
+// keeps the defaults for the rest.
+typedef struct {
+    unsigned long generation;     // Increments on every successful load
+
+    // [coordinator]
+    int port;
+    int max_nodes;
+    int max_containers;           // Cluster-wide container limit
+    int heartbeat_timeout;        // Seconds without heartbeat before a node is skipped
+    char state_dir[MAX_PATH_LEN]; // Snapshot and log directory, empty to keep state in memory only
+    int snapshot_interval;        // Log records between snapshots
+    char control_socket[MAX_PATH_LEN]; // Unix control socket path, empty to disable
+    int control_port;             // Loopback TCP control port, 0 to disable
+    int metrics_port;             // HTTP port serving /metrics, 0 to disable
+    int command_threads;          // Threads running deploy/start/stop/delete, 0 for one per CPU
+
+    // [resources]
+    double cpu_weight;
+    double memory_weight;
+    double disk_weight;
+    double load_weight;
+
+    // [scheduler]
+    char policy[32];
+    int headroom_percent;
+    int sample_size;
+    double locality_bonus;
+    int preemption;               // Evict lower-priority containers when nothing fits
+
+    // [rebalancer]
+    int rebalance_interval;       // Seconds between passes, 0 for on-request only
+    int rebalance_threshold;      // Load spread in percentage points that triggers moves
+    int rebalance_max_moves;      // Moves started per pass
+    int rebalance_cooldown;       // Seconds before a moved container may move again
+
+    // [admission], deploy dispatch rates; a rate of 0 is unlimited
+    double admission_rate;        // Deploys per second over the cluster
+    int admission_burst;
+    double admission_node_rate;   // Deploys per second to one node
+    int admission_node_burst;
+    int admission_max_wait;       // Seconds a deploy may wait before it fails
+
+    // [tenants], one "name = cpu=N memory=MB containers=N weight=W" line each
+    tenant_quota_t tenant_quotas[MAX_TENANT_QUOTAS];
+    int tenant_quota_count;
+
+    // [worker]
+    char coordinator_ip[INET_ADDRSTRLEN];
+    int coordinator_port;
+    int node_max_containers;      // [worker] max_containers, reported to the coordinator
+    char labels[MAX_NAME_LEN];
+    char coordinators[MAX_COMMAND_LEN]; // Other coordinators to try, "ip:port,..."
+    int node_metrics_port;        // [worker] metrics_port
+    char migration_dir[MAX_PATH_LEN]; // Where containers are staged while migrating
+    int executor_threads;         // [worker] executor_threads, container commands run at once
+    char runtime[32];             // [worker] runtime, "lxd" or "fake"
+
+    // [fake_runtime], the in-memory runtime used for tests and benchmarks
+    int fake_create_ms;           // Latency of each call, in milliseconds
+    int fake_start_ms;
+    int fake_stop_ms;
+    int fake_destroy_ms;
+    int fake_jitter_percent;      // Latencies vary by up to this much either way
+    double fake_failure_rate;     // Share of create/start/stop/destroy calls that fail, 0 to 1
+    unsigned int fake_seed;       // Same seed, same latencies and failures
+    int fake_cpus;                // Capacity the node reports
+    int fake_memory;              // MB
+
+    // [heartbeat]
+    int heartbeat_interval;
+
+    // [cluster]
+    int cluster_node_id;          // This coordinator's id, 0 to run standalone
+    char cluster_peers[MAX_COMMAND_LEN]; // "id=ip:raft_port:client_port,...", including this one
+    int election_timeout_ms;
+} daemon_config_t;
+
+// Called after a new snapshot has been published
+typedef void (*config_reload_handler_t)(const daemon_config_t* config);
+
+// Configuration functions
+void config_set_defaults(daemon_config_t* config);
+int config_load(const char* path, daemon_config_t* config);
+int init_config(const char* path, config_reload_handler_t handler);
+int config_reload(void);
+const daemon_config_t* config_current(void);
+
+#endif // CONFIG_H
@@ -0,0 +1,42 @@
+#ifndef CONTROL_H
+#define CONTROL_H
+
+#include "distributed_lxc.h"
+
+#define CONTROL_MAX_CLIENTS 64
+#define CONTROL_MAX_REQUEST 65536       // Largest request body accepted
+#define CONTROL_MAX_REPLY (1024 * 1024) // Reply bodies are cut off beyond this
+#define CONTROL_MAX_BACKLOG (4 * 1024 * 1024) // Unsent reply bytes before a client's reads pause
+#define CONTROL_TICK_MS 100             // How often deferred requests are retried
+
+// Outcome of handling one request
+typedef enum {
+    CONTROL_DONE,       // Reply is complete
+    CONTROL_PENDING     // Not ready yet, call again with the same request on a later tick
+} control_status_t;
+
+// Reply text under construction
+typedef struct {
+    char* data;
+    size_t length;
+    size_t capacity;
+    int truncated;
+} control_reply_t;
+
+// Handles one request; elapsed_ms counts time since it was first tried.
+// context starts NULL and keeps what the handler stores there across
+// CONTROL_PENDING retries; the handler clears it before CONTROL_DONE.
+typedef control_status_t (*control_handler_t)(const char* request, int elapsed_ms,
+                                              void** context, control_reply_t* reply);
+
+// Frees the context of a deferred request whose client went away
+typedef void (*control_release_t)(void* context);
+
+// Control socket functions
+int init_control(const char* socket_path, int port, control_handler_t handler,
+                 control_release_t release);
+void control_reply(control_reply_t* reply, const char* format, ...);
+void control_wake(void);
+void close_control(void);
+
+#endif // CONTROL_H
@@ -15,14 +15,27 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 
+#ifndef MAX_NODES
 #define MAX_NODES 256
+#endif
+#ifndef MAX_CONTAINERS
 #define MAX_CONTAINERS 1024
+#endif
 #define MAX_NAME_LEN 256
 #define MAX_PATH_LEN 1024
 #define MAX_COMMAND_LEN 2048
 #define MAX_LOG_LEN 4096
 #define BUFFER_SIZE 8192
 #define DEFAULT_PORT 8888
+#define IMAGE_DIGEST_BYTES 64   // Bloom filter of locally cached images (512 bits)
+#define DEFAULT_IMAGE "ubuntu:20.04"
+#define DEFAULT_TENANT "default"
+
+// Priority classes accepted by the spec's priority key
+#define PRIORITY_LOW -100
+#define PRIORITY_NORMAL 0
+#define PRIORITY_HIGH 100
+#define PRIORITY_CRITICAL 1000
 
 // Message types for node communication
 typedef enum {
@@ -35,7 +48,13 @@ typedef enum {
     MSG_CONTAINER_STATUS,
     MSG_NODE_STATUS,
     MSG_ERROR,
-    MSG_ACK
+    MSG_ACK,
+    MSG_REDIRECT,       // Registration refused, data holds "ip port" of the leader or is empty
+    MSG_INVENTORY_SYNC, // Coordinator asks for part of a worker's inventory hash tree
+    MSG_INVENTORY_REPLY, // Worker's hashes or containers for an inventory sync step
+    MSG_MIGRATE_EXPORT, // Source worker stops and stages a container for migration
+    MSG_MIGRATE_READY,  // Staged export is listening for the target worker
+    MSG_MIGRATE_IMPORT  // Target worker pulls the export from the source
 } message_type_t;
 
 // Container states
@@ -63,6 +82,9 @@ typedef struct {
     double disk_usage;
     int container_count;
     int max_containers;
+    int cpu_capacity;       // Online CPUs
+    int memory_capacity;    // Physical memory in MB
+    unsigned char image_digest[IMAGE_DIGEST_BYTES];  // Images already cached on the node
 } resource_info_t;
 
 // LXC Container configuration
@@ -76,6 +98,12 @@ typedef struct {
     int cpu_limit;
     int memory_limit;
     int privileged;
+    char group[MAX_NAME_LEN];          // Replica group, defaults to the container name
+    char affinity[MAX_NAME_LEN];       // Labels the node must carry, "k=v,k=v"
+    char anti_affinity[MAX_NAME_LEN];  // Labels the node must not carry
+    char spread_key[MAX_NAME_LEN];     // Node label key to spread the group across
+    int priority;                      // Higher priorities may preempt lower ones
+    char tenant[MAX_NAME_LEN];         // Owner charged for the container's requests
 } lxc_config_t;
 
 // Container instance
@@ -83,7 +111,8 @@ typedef struct {
     char id[MAX_NAME_LEN];
     char name[MAX_NAME_LEN];
     char node_id[MAX_NAME_LEN];
-    container_state_t state;
+    container_state_t state;           // Last observed state
+    container_state_t desired_state;   // RUNNING or STOPPED, what the reconciler converges to
     lxc_config_t config;
     time_t created_at;
     time_t started_at;
@@ -97,11 +126,18 @@ typedef struct {
     char ip_address[INET_ADDRSTRLEN];
     int port;
     node_state_t state;
+    char labels[MAX_NAME_LEN];   // Topology labels reported at registration, "k=v,k=v"
     resource_info_t resources;
     time_t last_heartbeat;
     int socket_fd;
     container_t containers[MAX_CONTAINERS];
     int container_count;
+    int cpu_requested;      // Sum of cpu_limit of containers placed here
+    int memory_requested;   // Sum of memory_limit (MB) of containers placed here
+    double reserved_cpu;    // Estimated CPU% of placements not yet seen in a heartbeat
+    double reserved_memory; // Estimated memory% of placements not yet seen in a heartbeat
+    int pending_placements; // Reservations still outstanding
+    int settled_placements; // Acknowledged reservations waiting for the next heartbeat
 } node_t;
 
 // Message structure for network communication
@@ -109,10 +145,20 @@ typedef struct {
     message_type_t type;
     char sender_id[MAX_NAME_LEN];
     char recipient_id[MAX_NAME_LEN];
+    int operation_id;    // Coordinator operation this message belongs to, 0 if none
     int data_length;
-    char data[BUFFER_SIZE - sizeof(message_type_t) - 2*MAX_NAME_LEN - sizeof(int)];
+    char data[BUFFER_SIZE - sizeof(message_type_t) - 2*MAX_NAME_LEN - 2*sizeof(int)];
 } message_t;
 
+// Handler for coordinator-bound messages not processed by the network layer
+typedef void (*message_handler_t)(const message_t* msg);
+
+// Told when a worker's connection closes
+typedef void (*disconnect_handler_t)(const char* node_id);
+
+// Decides whether a worker may register here; fills redirect and returns -1 to refuse
+typedef int (*registration_guard_t)(char* redirect, size_t size);
+
 // Function prototypes
 int init_coordinator(int port);
 int init_worker_node(const char* coordinator_ip, int coordinator_port);
@@ -123,8 +169,15 @@ int stop_container(const char* container_id);
 int delete_container(const char* container_id);
 container_state_t get_container_status(const char* container_id);
 node_t* find_best_node(const lxc_config_t* config);
+node_t* find_best_node_excluding(const lxc_config_t* config, const char* node_id);
+int migrate_container(const char* container_id, const char* node_id, int checkpoint);
 int send_message(int socket_fd, const message_t* msg);
 int receive_message(int socket_fd, message_t* msg);
+void create_message(message_t* msg, message_type_t type, const char* sender_id,
+                   const char* recipient_id, const void* data, int data_len);
+void set_message_handler(message_handler_t handler);
+void set_disconnect_handler(disconnect_handler_t handler);
+void set_registration_guard(registration_guard_t guard);
 void cleanup_resources(void);
 
 #endif // DISTRIBUTED_LXC_H
\ No newline at end of file
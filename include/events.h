@@ -0,0 +1,66 @@
+#ifndef EVENTS_H
+#define EVENTS_H
+
+#include "distributed_lxc.h"
+
+#define EVENT_MAX_SUBSCRIBERS 64
+#define EVENT_DEFAULT_SLOTS 256             // Events a subscriber buffers before the oldest are dropped
+#define EVENT_MAX_SLOTS 4096
+#define EVENT_SUBSCRIBER_TIMEOUT 300        // Seconds a subscriber may go unread before it is dropped
+#define EVENT_WATCH_TIMEOUT 30              // Seconds a watch waits for events by default
+#define EVENT_READ_BATCH 512                // Events returned by one watch
+
+// What an event is about
+typedef enum {
+    EVENT_CONTAINER = 1,
+    EVENT_NODE = 2
+} event_kind_t;
+
+// One change in the cluster, numbered in publication order
+typedef struct {
+    unsigned long seq;
+    time_t time;
+    event_kind_t kind;
+    char action[16];               // added, state, moved, removed; up, down
+    char id[MAX_NAME_LEN];         // Container or node id
+    char name[MAX_NAME_LEN];       // Container name, the node id for nodes
+    char node_id[MAX_NAME_LEN];
+    char state[16];
+    char desired[16];              // Desired container state, "-" for nodes
+} event_t;
+
+// Which events a subscriber receives; empty fields match anything
+typedef struct {
+    int kinds;                     // Mask of event_kind_t, 0 for all
+    char node_id[MAX_NAME_LEN];
+    char name[MAX_NAME_LEN];
+} event_filter_t;
+
+// One subscriber for status output
+typedef struct {
+    int id;
+    event_filter_t filter;
+    int slots;
+    int buffered;
+    unsigned long delivered;       // Highest sequence number handed out
+    unsigned long dropped;         // Events lost because the buffer was full
+    time_t last_read;
+} event_subscriber_info_t;
+
+// Called after events are published, e.g. to wake waiting readers
+typedef void (*event_notify_t)(void);
+
+// Event functions
+int init_events(event_notify_t notify);
+void events_publish(event_kind_t kind, const char* action, const char* id, const char* name,
+                    const char* node_id, const char* state, const char* desired);
+int events_parse_filter(char** tokens, int count, event_filter_t* filter, int* slots);
+int events_subscribe(const event_filter_t* filter, int slots, unsigned long* seq);
+int events_unsubscribe(int subscriber_id);
+int events_read(int subscriber_id, int has_cursor, unsigned long cursor, event_t* events,
+                int max_events, unsigned long* lost);
+unsigned long events_sequence(void);
+int events_list(event_subscriber_info_t* subscribers, int max_subscribers);
+void show_events(void);
+
+#endif // EVENTS_H
@@ -0,0 +1,26 @@
+#ifndef EXECUTOR_H
+#define EXECUTOR_H
+
+#include "distributed_lxc.h"
+
+#define EXECUTOR_MAX_THREADS 64
+#define EXECUTOR_KEY_BUCKETS 256            // Must be a power of two
+
+// Runs one job; owns arg
+typedef void (*executor_job_t)(void* arg);
+
+// Executor counters for status output
+typedef struct {
+    int threads;
+    int queued;                 // Submitted and not started
+    int running;
+    int keys;                   // Keys with queued or running jobs
+    unsigned long completed;
+} executor_status_t;
+
+// Executor functions
+int init_executor(int threads);
+int executor_submit(const char* key, executor_job_t job, void* arg);
+void executor_status(executor_status_t* status);
+
+#endif // EXECUTOR_H
@@ -0,0 +1,65 @@
+#ifndef INVENTORY_H
+#define INVENTORY_H
+
+#include "distributed_lxc.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#define INVENTORY_FANOUT 16
+#define INVENTORY_LEAVES (INVENTORY_FANOUT * INVENTORY_FANOUT)
+
+// Two-level hash tree over a node's containers. Each container hashes
+// (name, state) into one of 256 leaves picked by its name; leaves, branches
+// and root hold the sum of the item hashes below them, so a change updates
+// three words instead of rehashing the tree.
+typedef struct {
+    uint64_t root;
+    uint64_t branches[INVENTORY_FANOUT];
+    uint64_t leaves[INVENTORY_LEAVES];
+    int count;
+} inventory_tree_t;
+
+// Steps of a sync, the coordinator drills down where the hashes differ
+typedef enum {
+    INVENTORY_ROOT = 1,     // Ask for the root and branch hashes
+    INVENTORY_BRANCHES,     // Ask for the leaf hashes of some branches
+    INVENTORY_ITEMS         // Ask for the containers in some leaves
+} inventory_step_t;
+
+// MSG_INVENTORY_SYNC payload, coordinator to worker
+typedef struct {
+    uint16_t step;
+    uint16_t count;                      // Entries used in indices
+    uint16_t indices[INVENTORY_LEAVES];  // Branch (BRANCHES) or leaf (ITEMS) numbers
+} inventory_request_t;
+
+// MSG_INVENTORY_REPLY header, worker to coordinator. ROOT replies carry the
+// branch hashes; BRANCHES replies are followed by count inventory_branch_t;
+// ITEMS replies by count leaf numbers (uint16_t) and then item_count items
+// encoded as leaf (uint16_t), state (uint8_t), name length (uint8_t), name.
+typedef struct {
+    uint16_t step;
+    uint16_t count;
+    uint16_t item_count;
+    uint16_t last;                       // No more replies follow for this request
+    uint64_t root;
+    uint64_t branches[INVENTORY_FANOUT];
+} inventory_reply_t;
+
+typedef struct {
+    uint16_t branch;
+    uint16_t reserved[3];
+    uint64_t leaves[INVENTORY_FANOUT];
+} inventory_branch_t;
+
+// Inventory functions
+void inventory_reset(inventory_tree_t* tree);
+int inventory_leaf_of(const char* name);
+void inventory_add(inventory_tree_t* tree, const char* name, container_state_t state);
+void inventory_remove(inventory_tree_t* tree, const char* name, container_state_t state);
+int inventory_append_item(char* buffer, size_t* length, size_t capacity,
+                          const char* name, container_state_t state);
+size_t inventory_read_item(const char* data, size_t size, int* leaf,
+                           char* name, container_state_t* state);
+
+#endif // INVENTORY_H
@@ -3,15 +3,46 @@
 
 #include "distributed_lxc.h"
 
+// A container runtime. The lxc_* functions below run through the selected
+// backend: the LXD command line by default, or an in-memory fake.
+typedef struct {
+    const char* name;
+    int (*create)(const lxc_config_t* config);
+    int (*start)(const char* name);
+    int (*stop)(const char* name);
+    int (*destroy)(const char* name);
+    int (*exists)(const char* name);
+    container_state_t (*state)(const char* name);       // CONTAINER_ERROR when unknown
+    int (*list)(char (*names)[MAX_NAME_LEN], container_state_t* states, int max_containers);
+    int (*resources)(resource_info_t* resources);
+    int (*export_container)(const char* name, const char* path, int stateful);
+    int (*import_container)(const char* path);
+} runtime_backend_t;
+
+extern const runtime_backend_t lxd_runtime;
+extern const runtime_backend_t fake_runtime;
+
+// Runtime selection
+int lxc_set_runtime(const char* name);
+const char* lxc_runtime_name(void);
+
 // LXC management functions
 int lxc_create_container(const lxc_config_t* config);
 int lxc_start_container(const char* name);
 int lxc_stop_container(const char* name);
 int lxc_destroy_container(const char* name);
+int lxc_export_container(const char* name, const char* path, int stateful);
+int lxc_import_container(const char* path);
 container_state_t lxc_get_container_state(const char* name);
+int lxc_list_container_states(char (*names)[MAX_NAME_LEN], container_state_t* states,
+                              int max_containers);
 int lxc_container_exists(const char* name);
 int generate_lxc_config_file(const lxc_config_t* config, const char* output_path);
 int get_system_resources(resource_info_t* resources);
 int monitor_container(const char* name, char* log_buffer, size_t buffer_size);
 
+// Image cache digest functions
+void image_digest_add(unsigned char* digest, const char* image);
+int image_digest_contains(const unsigned char* digest, const char* image);
+
 #endif // LXC_MANAGER_H
\ No newline at end of file
@@ -0,0 +1,42 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include "distributed_lxc.h"
+#include <stdint.h>
+
+#define METRICS_MAX_SLOTS 1024      // Counter words per shard; a histogram takes METRICS_HISTOGRAM_SLOTS
+#define METRICS_MAX_SERIES 256
+#define METRICS_SHARDS 32           // Threads beyond this share shards
+#define METRICS_BUCKETS 13          // Latency buckets including +Inf
+#define METRICS_HISTOGRAM_SLOTS (METRICS_BUCKETS + 2)  // Buckets, sum in microseconds, count
+#define METRICS_MAX_BODY (1024 * 1024)
+
+// Scrape output under construction
+typedef struct {
+    char* data;
+    size_t length;
+    size_t capacity;
+} metrics_buffer_t;
+
+// Appends gauges computed at scrape time, e.g. node counts by state
+typedef void (*metrics_collector_t)(metrics_buffer_t* out);
+
+// Metric registration, done once at startup or lazily; returns an id or -1
+int metrics_counter(const char* name, const char* labels, const char* help);
+int metrics_histogram(const char* name, const char* labels, const char* help);
+int metrics_lock_histogram(const char* lock);
+
+// Hot path: touches only the calling thread's shard
+void metrics_add(int id, uint64_t value);
+void metrics_observe(int id, double seconds);
+void metrics_lock(pthread_mutex_t* mutex, int histogram);
+double metrics_elapsed(const struct timespec* start);
+
+// Scrape output helpers for collectors
+void metrics_printf(metrics_buffer_t* out, const char* format, ...);
+void metrics_gauge_header(metrics_buffer_t* out, const char* name, const char* help);
+
+// HTTP listener serving GET /metrics, port 0 disables it
+int init_metrics(int port, metrics_collector_t collector);
+
+#endif // METRICS_H
@@ -0,0 +1,46 @@
+#ifndef MIGRATION_H
+#define MIGRATION_H
+
+#include "distributed_lxc.h"
+#include <sys/types.h>
+
+#define MIGRATION_ACCEPT_TIMEOUT 60         // Seconds the source waits for the target to connect
+#define MIGRATION_IO_TIMEOUT 30             // Seconds a stalled transfer is allowed to idle
+#define MIGRATION_TIMEOUT 600               // Seconds the coordinator allows a whole migration
+#define MIGRATION_TOKEN_LEN 33              // 32 hex digits and a terminator
+
+// Coordinator -> source worker: stop and export a container
+typedef struct {
+    char name[MAX_NAME_LEN];
+    int checkpoint;                 // Keep the running state (stateful stop) instead of a cold stop
+    char token[MIGRATION_TOKEN_LEN]; // The target must present this before it is served
+} migration_export_t;
+
+// Source worker -> coordinator: export staged and listening for the target
+typedef struct {
+    char name[MAX_NAME_LEN];
+    int port;
+    long long size;                 // Bytes the target will receive
+    char token[MIGRATION_TOKEN_LEN]; // Echoed from the export request for the target
+} migration_offer_t;
+
+// Coordinator -> target worker: fetch the export from the source and import it
+typedef struct {
+    lxc_config_t config;
+    char source_ip[INET_ADDRSTRLEN];
+    int source_port;
+    long long size;
+    int start;                      // Start the container once imported
+    char token[MIGRATION_TOKEN_LEN]; // Sent to the source to prove the coordinator picked us
+} migration_import_t;
+
+// Worker-to-worker transfer, bypassing the coordinator
+int migration_token(char* token);
+int migration_listen(int* port);
+int migration_send_file(int listen_fd, const char* token, const char* path);
+int migration_receive_file(const char* ip, int port, const char* token, const char* path,
+                           long long size);
+void migration_path(const char* dir, const char* name, int op_id, const char* suffix,
+                    char* path, size_t size);
+
+#endif // MIGRATION_H
@@ -0,0 +1,60 @@
+#ifndef OPERATIONS_H
+#define OPERATIONS_H
+
+#include "distributed_lxc.h"
+
+#define MAX_OPERATIONS 4096            // Slot table size, must be a power of two
+#define DEFAULT_OPERATION_TIMEOUT 120  // Seconds before an unanswered operation times out
+
+// Operation kinds tracked by the coordinator
+typedef enum {
+    OP_DEPLOY,
+    OP_START,
+    OP_STOP,
+    OP_DELETE,
+    OP_MIGRATE
+} operation_type_t;
+
+// Operation lifecycle: PENDING -> RUNNING -> SUCCEEDED | FAILED | TIMED_OUT
+typedef enum {
+    OP_PENDING,
+    OP_RUNNING,
+    OP_SUCCEEDED,
+    OP_FAILED,
+    OP_TIMED_OUT
+} operation_state_t;
+
+// Tracked operation
+typedef struct {
+    int id;
+    operation_type_t type;
+    operation_state_t state;
+    char container_id[MAX_NAME_LEN];
+    char node_id[MAX_NAME_LEN];
+    time_t created_at;
+    time_t deadline;
+    time_t completed_at;
+    char result[MAX_NAME_LEN];
+} operation_t;
+
+// Called once for every operation that reaches a terminal state
+typedef void (*operation_handler_t)(const operation_t* op);
+
+// Operation engine functions
+int init_operations(void);
+void set_operation_handler(operation_handler_t handler);
+int operation_create(operation_type_t type, const char* container_id,
+                     const char* node_id, int timeout_seconds);
+int operation_mark_running(int id);
+int operation_restart_timer(int id, int timeout_seconds);
+int operation_complete(int id, operation_state_t state, const char* result);
+int operation_get(int id, operation_t* op);
+operation_state_t operation_wait(int id, int timeout_seconds);
+int operation_wait_all(const int* ids, int count, int timeout_seconds);
+int operation_list_active(int* ids, int max_ids);
+int operation_is_terminal(operation_state_t state);
+const char* operation_type_name(operation_type_t type);
+const char* operation_state_name(operation_state_t state);
+void list_operations(void);
+
+#endif // OPERATIONS_H
@@ -0,0 +1,41 @@
+#ifndef PREEMPTION_H
+#define PREEMPTION_H
+
+#include "distributed_lxc.h"
+
+#define PREEMPTION_QUEUE_SLOTS 1024         // Evicted containers waiting for a node
+#define PREEMPTION_BASE_BACKOFF 5           // Seconds before the first retry, doubled per attempt
+#define PREEMPTION_MAX_BACKOFF 120
+
+// Places a requeued container, returns the deploy operation id, 0 when it was
+// queued for placement elsewhere, or -1
+typedef int (*preemption_deployer_t)(const lxc_config_t* config, container_state_t desired_state);
+
+// One evicted container waiting to be placed again
+typedef struct {
+    char container_id[MAX_NAME_LEN];   // Id it had before eviction
+    lxc_config_t config;
+    container_state_t desired_state;
+    char evicted_by[MAX_NAME_LEN];     // Container that took its place
+    time_t queued_at;
+    time_t next_attempt;
+    int attempts;
+} requeue_entry_t;
+
+// Requeue counters for status output
+typedef struct {
+    int waiting;               // Evicted containers not placed yet
+    int evicting;              // Victims whose delete is in flight
+    unsigned long requeued;
+    unsigned long placed;      // Requeued containers placed again
+} preemption_status_t;
+
+// Preemption functions
+int init_preemption(preemption_deployer_t deployer);
+int preemption_evict(const char* container_id, const lxc_config_t* config,
+                     container_state_t desired_state, const char* evicted_by);
+void preemption_evicted(const char* container_id, int succeeded);
+void preemption_status(preemption_status_t* status);
+void show_preemption(void);
+
+#endif // PREEMPTION_H
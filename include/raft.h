@@ -0,0 +1,53 @@
+#ifndef RAFT_H
+#define RAFT_H
+
+#include "distributed_lxc.h"
+#include "wal.h"
+
+#define MAX_RAFT_PEERS 7                  // Cluster members, including this one
+#define DEFAULT_ELECTION_TIMEOUT_MS 1000  // Randomized between 1x and 2x
+#define RAFT_MAX_BATCH 256                // Entries per AppendEntries request
+#define RAFT_MAX_BATCH_BYTES (1024 * 1024)
+#define RAFT_MAX_INFLIGHT 4               // Pipelined AppendEntries per follower
+#define RAFT_COMMIT_TIMEOUT_MS 5000       // How long a change may wait for a quorum
+
+// Coordinator cluster member
+typedef struct {
+    int id;
+    char ip_address[INET_ADDRSTRLEN];
+    int raft_port;      // Replication traffic between coordinators
+    int client_port;    // Port workers connect to
+} raft_peer_t;
+
+typedef enum {
+    RAFT_FOLLOWER,
+    RAFT_CANDIDATE,
+    RAFT_LEADER
+} raft_role_t;
+
+// Applies a committed entry to the state machine
+typedef void (*raft_apply_handler_t)(const wal_entry_t* entry);
+
+// Clears the state machine before it is rebuilt from a snapshot
+typedef void (*raft_reset_handler_t)(void);
+
+// Told when this coordinator gains (1) or loses (0) leadership
+typedef void (*raft_role_handler_t)(int leader);
+
+// Replication functions
+int raft_parse_peers(const char* spec, raft_peer_t* peers, int max_peers);
+int init_raft(const char* state_dir, int self_id, const raft_peer_t* peers, int peer_count,
+              int election_timeout_ms, raft_apply_handler_t apply,
+              raft_reset_handler_t reset, raft_role_handler_t role);
+void raft_load_entry(const wal_entry_t* entry);
+int raft_start(void);
+int raft_enabled(void);
+int raft_is_leader(void);
+int raft_leader_address(char* ip_address, int* port);
+unsigned long raft_propose(wal_record_type_t type, const void* data, size_t length);
+int raft_wait_commit(unsigned long index, int timeout_ms);
+int raft_snapshot_point(unsigned long* index, unsigned long* term);
+void raft_compact(unsigned long index, unsigned long term);
+void show_raft(void);
+
+#endif // RAFT_H
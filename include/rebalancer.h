@@ -0,0 +1,47 @@
+#ifndef REBALANCER_H
+#define REBALANCER_H
+
+#include "distributed_lxc.h"
+
+#define DEFAULT_REBALANCE_INTERVAL 0        // Seconds between passes, 0 runs them on request only
+#define DEFAULT_REBALANCE_THRESHOLD 20      // Load spread (percentage points) worth acting on
+#define DEFAULT_REBALANCE_MAX_MOVES 2       // Moves started per pass
+#define DEFAULT_REBALANCE_COOLDOWN 3600     // Seconds a moved container stays put
+#define REBALANCE_RECENT_MOVES 256          // Moved containers remembered for the cooldown
+#define REBALANCE_STEP_TIMEOUT 600          // Seconds one move step may take
+#define REBALANCE_MAX_MOVES 64              // Upper bound for max_moves
+#define REBALANCE_RECHECK 60                // Seconds between checks for a changed interval
+
+// One container as the registry sees it
+typedef struct {
+    char id[MAX_NAME_LEN];
+    char name[MAX_NAME_LEN];
+    char node_id[MAX_NAME_LEN];
+    container_state_t state;
+    container_state_t desired_state;
+    lxc_config_t config;
+} rebalance_container_t;
+
+// Fills containers with the registry, returns how many
+typedef int (*rebalance_lister_t)(rebalance_container_t* containers, int max_containers);
+
+// State of the last pass for status output
+typedef struct {
+    int running;               // A pass is under way
+    double imbalance;          // Load spread between the busiest and idlest node
+    char busiest[MAX_NAME_LEN];
+    char idlest[MAX_NAME_LEN];
+    unsigned long passes;
+    unsigned long moves;       // Moves started
+    unsigned long failed;      // Moves that did not complete
+    time_t last_pass;
+    char last_result[MAX_NAME_LEN];
+} rebalance_status_t;
+
+// Rebalancer functions
+int init_rebalancer(rebalance_lister_t lister);
+void rebalancer_trigger(void);
+void rebalancer_status(rebalance_status_t* status);
+void show_rebalancer(void);
+
+#endif // REBALANCER_H
@@ -0,0 +1,29 @@
+#ifndef RECONCILER_H
+#define RECONCILER_H
+
+#include "distributed_lxc.h"
+
+#define RECONCILE_SLOTS MAX_CONTAINERS      // One dirty entry per container
+#define RECONCILE_BUCKETS (MAX_CONTAINERS * 2)  // Must be a power of two
+#define RECONCILE_BASE_BACKOFF 2            // Seconds before the first retry, doubled per attempt
+#define RECONCILE_MAX_BACKOFF 60
+#ifndef RECONCILE_MAX_ATTEMPTS
+#define RECONCILE_MAX_ATTEMPTS 8            // Corrections tried before giving up until the next change
+#endif
+
+// Outcome of reconciling one container
+typedef enum {
+    RECONCILE_CONVERGED,    // Observed matches desired, or nothing to do
+    RECONCILE_CORRECTING,   // Corrective operation issued; its completion marks the container again
+    RECONCILE_RETRY         // Could not act now, try again after a backoff
+} reconcile_result_t;
+
+// Compares desired and observed state of one container and issues a correction
+typedef reconcile_result_t (*reconcile_handler_t)(const char* container_id);
+
+// Reconciler functions
+int init_reconciler(reconcile_handler_t handler);
+void reconciler_mark_dirty(const char* container_id);
+void show_reconciler(void);
+
+#endif // RECONCILER_H
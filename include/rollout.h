@@ -0,0 +1,70 @@
+#ifndef ROLLOUT_H
+#define ROLLOUT_H
+
+#include "distributed_lxc.h"
+
+#define MAX_ROLLOUTS 16                 // Rollouts remembered at once, finished ones are reused
+#define ROLLOUT_MAX_PARALLEL 64         // Replacements in flight per rollout
+#define ROLLOUT_TICK_MS 500             // Progress check interval between operation completions
+#define DEFAULT_MAX_UNAVAILABLE 1
+#define DEFAULT_MAX_SURGE 1
+
+// What a rollout does when a replacement fails
+typedef enum {
+    ROLLOUT_ON_FAILURE_PAUSE,       // Stop issuing replacements until resumed
+    ROLLOUT_ON_FAILURE_ROLLBACK     // Roll the group back to its previous spec
+} rollout_failure_policy_t;
+
+// Rollout lifecycle
+typedef enum {
+    ROLLOUT_RUNNING,
+    ROLLOUT_PAUSED,
+    ROLLOUT_ROLLING_BACK,
+    ROLLOUT_SUCCEEDED,
+    ROLLOUT_ROLLED_BACK,
+    ROLLOUT_ABORTED
+} rollout_state_t;
+
+// One container of a replica group as the registry sees it
+typedef struct {
+    char id[MAX_NAME_LEN];
+    char name[MAX_NAME_LEN];
+    char node_id[MAX_NAME_LEN];
+    container_state_t state;
+    container_state_t desired_state;
+    lxc_config_t config;
+} rollout_member_t;
+
+// Fills members with the containers of a group, returns how many
+typedef int (*rollout_lister_t)(const char* group, rollout_member_t* members, int max_members);
+
+// Rollout summary for status output
+typedef struct {
+    char group[MAX_NAME_LEN];
+    char image[MAX_NAME_LEN];
+    rollout_state_t state;
+    rollout_failure_policy_t on_failure;
+    int max_unavailable;
+    int max_surge;
+    int total;             // Containers in the group at the last check
+    int updated;           // Of those, running the target spec
+    int in_flight;         // Replacements under way
+    int failed;            // Replacements that failed
+    time_t started_at;
+    char reason[MAX_NAME_LEN];
+} rollout_info_t;
+
+// Rollout functions
+int init_rollout(rollout_lister_t lister);
+int rollout_start(const char* group, const lxc_config_t* target, int max_unavailable,
+                  int max_surge, rollout_failure_policy_t on_failure);
+int rollout_pause(const char* group);
+int rollout_resume(const char* group);
+int rollout_rollback(const char* group);
+int rollout_abort(const char* group);
+int rollout_list(rollout_info_t* infos, int max_infos);
+void rollout_notify(void);
+const char* rollout_state_name(rollout_state_t state);
+void show_rollouts(void);
+
+#endif // ROLLOUT_H
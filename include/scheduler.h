@@ -0,0 +1,50 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include "distributed_lxc.h"
+
+#define MAX_RESERVATIONS 4096          // Must be a power of two
+#define RESERVATION_DEFAULT_PERCENT 5  // Usage assumed for requests without a limit
+#define DEFAULT_SAMPLE_SIZE 2          // Nodes sampled per placement by the p2c policy
+#define DEFAULT_LOCALITY_BONUS 10.0    // Score bonus for nodes that cache the image
+#define DEFAULT_HEARTBEAT_TIMEOUT 30   // Seconds before a silent node is skipped
+#define PREEMPTION_MAX_VICTIMS 32      // Containers evicted for one placement
+
+// Placement policies
+typedef enum {
+    SCHED_SPREAD,      // Weighted score over instantaneous usage (default)
+    SCHED_BEST_FIT,    // Tightest node that still fits the request
+    SCHED_WORST_FIT,   // Roomiest node that fits the request
+    SCHED_P2C          // Best spread score among d randomly sampled nodes
+} scheduler_policy_t;
+
+// Containers to evict from one node so a request fits there
+typedef struct {
+    char node_id[MAX_NAME_LEN];
+    int count;
+    int max_priority;                  // Highest priority among the victims
+    long priority_sum;
+    char victims[PREEMPTION_MAX_VICTIMS][MAX_NAME_LEN];
+} preemption_plan_t;
+
+// Scheduler functions
+void scheduler_set_policy(scheduler_policy_t policy);
+scheduler_policy_t scheduler_get_policy(void);
+int scheduler_parse_policy(const char* name, scheduler_policy_t* policy);
+const char* scheduler_policy_name(scheduler_policy_t policy);
+void scheduler_set_headroom(int percent);
+void scheduler_set_sample_size(int sample_size);
+void scheduler_set_locality_bonus(double bonus);
+void scheduler_set_weights(double cpu, double memory, double disk, double load);
+void scheduler_set_heartbeat_timeout(int seconds);
+int scheduler_node_fits(const node_t* node, const lxc_config_t* config);
+int scheduler_could_place(const lxc_config_t* config);
+void scheduler_commit(node_t* node, const lxc_config_t* config);
+void scheduler_release(node_t* node, const lxc_config_t* config);
+void scheduler_reserve(node_t* node, const lxc_config_t* config, int operation_id);
+void scheduler_settle_reservation(int operation_id, int succeeded);
+void scheduler_heartbeat(const char* node_id);
+int scheduler_plan_preemption(const lxc_config_t* config, preemption_plan_t* plan);
+void show_scheduler(void);
+
+#endif // SCHEDULER_H
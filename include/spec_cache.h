@@ -0,0 +1,25 @@
+#ifndef SPEC_CACHE_H
+#define SPEC_CACHE_H
+
+#include "distributed_lxc.h"
+#include <stdint.h>
+
+#define SPEC_CACHE_ENTRIES 256              // Parsed specs kept, least recently used goes first
+#define SPEC_CACHE_MAX_FILE (1024 * 1024)   // Larger specs are parsed every time
+
+// Cache counters for status output
+typedef struct {
+    int entries;
+    unsigned long hits;          // Unchanged file, no read
+    unsigned long revalidated;   // File touched or recently written, same content
+    unsigned long parsed;        // New or changed content
+} spec_cache_status_t;
+
+// Spec cache functions
+int init_spec_cache(void);
+int spec_cache_load(const char* path, lxc_config_t* config);
+void spec_cache_clear(void);
+void spec_cache_status(spec_cache_status_t* status);
+void show_spec_cache(void);
+
+#endif // SPEC_CACHE_H
@@ -0,0 +1,44 @@
+#ifndef TENANTS_H
+#define TENANTS_H
+
+#include "distributed_lxc.h"
+#include "config.h"
+
+#define MAX_TENANTS 256                     // Distinct tenants tracked
+#define TENANT_SLOTS (2 * MAX_TENANTS)      // Hash table slots for tenant names
+#define TENANT_QUEUE_SLOTS 4096             // Pending deployments over all tenants
+#define TENANT_RETRY_INTERVAL 5             // Seconds between placement attempts while blocked
+#define TENANT_PENDING_TIMEOUT 3600         // Seconds a deployment may stay pending
+
+#define TENANT_NO_ROOM -2                   // Placer result: no node has room for it yet
+
+// Places a container, returns the deploy operation id, TENANT_NO_ROOM when it
+// could run once capacity frees up, or -1 when it cannot be placed at all
+typedef int (*tenant_placer_t)(const lxc_config_t* config, container_state_t desired_state);
+
+// One tenant's usage and limits for status output
+typedef struct {
+    char name[MAX_NAME_LEN];
+    int cpu_used;
+    int memory_used;
+    int containers;
+    int cpu_quota;              // 0 when unlimited
+    int memory_quota;
+    int container_quota;
+    double weight;
+    double dominant_share;      // Largest share of any cluster resource, divided by weight
+    int pending;
+    unsigned long admitted;
+} tenant_info_t;
+
+// Tenant functions
+int init_tenants(tenant_placer_t placer);
+void tenants_configure(const daemon_config_t* config);
+int tenant_submit(const lxc_config_t* config, container_state_t desired_state);
+void tenant_charge(const lxc_config_t* config);
+void tenant_release(const lxc_config_t* config);
+void tenants_reset(void);
+int tenants_list(tenant_info_t* tenants, int max_tenants);
+void show_tenants(void);
+
+#endif // TENANTS_H
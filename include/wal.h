@@ -0,0 +1,86 @@
+#ifndef WAL_H
+#define WAL_H
+
+#include "distributed_lxc.h"
+#include <stdint.h>
+
+#define WAL_SNAPSHOT_FILE "snapshot.dat"
+#define WAL_DEFAULT_SNAPSHOT_INTERVAL 10000   // Log records between automatic snapshots
+
+// Coordinator state mutations recorded in the log
+typedef enum {
+    WAL_NODE_PUT = 1,        // wal_node_t, insert or replace a node
+    WAL_CONTAINER_PUT,       // container_t, insert or replace a container
+    WAL_CONTAINER_DELETE,    // Container id string
+    WAL_NOOP,                // Empty entry a new replication leader commits its term with
+    WAL_CONTAINER_MOVE       // wal_container_move_t, a container migrated to another node
+} wal_record_type_t;
+
+// On-disk record header, followed by the payload padded to 8 bytes
+typedef struct {
+    uint32_t length;         // Payload bytes
+    uint32_t type;
+    uint64_t lsn;            // Log sequence number, strictly increasing
+    uint32_t crc;            // CRC32 over length, type, lsn, term and payload
+    uint32_t term;           // Replication term, 0 for a standalone coordinator
+} wal_record_header_t;
+
+// Decoded record
+typedef struct {
+    unsigned long lsn;
+    unsigned long term;
+    wal_record_type_t type;
+    const void* data;
+    size_t length;
+} wal_entry_t;
+
+// Persistent part of a node
+typedef struct {
+    char id[MAX_NAME_LEN];
+    char hostname[MAX_NAME_LEN];
+    char ip_address[INET_ADDRSTRLEN];
+    int port;
+    char labels[MAX_NAME_LEN];
+} wal_node_t;
+
+// A migrated container: the record under old_id is replaced by container
+typedef struct {
+    char old_id[MAX_NAME_LEN];
+    container_t container;
+} wal_container_move_t;
+
+// Receives one recovered record
+typedef void (*wal_replay_handler_t)(const wal_entry_t* entry);
+
+// Writes a snapshot with wal_snapshot_begin/add/commit
+typedef void (*wal_checkpoint_handler_t)(void);
+
+// Told the highest lsn on disk after each group commit
+typedef void (*wal_durable_handler_t)(unsigned long lsn);
+
+typedef struct wal_snapshot wal_snapshot_t;
+
+// Write-ahead log functions
+int wal_open(const char* dir, int snapshot_interval, wal_replay_handler_t restore,
+             wal_replay_handler_t replay, wal_checkpoint_handler_t checkpoint);
+void wal_close(void);
+int wal_enabled(void);
+void wal_set_durable_handler(wal_durable_handler_t handler);
+unsigned long wal_append(wal_record_type_t type, const void* data, size_t length);
+int wal_append_entry(const wal_entry_t* entry);
+int wal_truncate(unsigned long lsn);
+unsigned long wal_last_lsn(void);
+int wal_sync(unsigned long lsn);
+void wal_snapshot_position(unsigned long* lsn, unsigned long* term);
+wal_snapshot_t* wal_snapshot_begin(unsigned long lsn, unsigned long term);
+int wal_snapshot_add(wal_snapshot_t* snapshot, wal_record_type_t type,
+                     const void* data, size_t length);
+int wal_snapshot_commit(wal_snapshot_t* snapshot);
+int wal_restore_snapshot(wal_replay_handler_t restore);
+int wal_read_snapshot(char** data, size_t* length);
+int wal_install_snapshot(const char* data, size_t length, wal_replay_handler_t restore);
+int wal_encode_entry(char** buffer, size_t* length, size_t* capacity, const wal_entry_t* entry);
+size_t wal_decode_entry(const char* data, size_t size, wal_entry_t* entry);
+void show_wal(void);
+
+#endif // WAL_H
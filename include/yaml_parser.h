@@ -13,6 +13,9 @@ typedef struct yaml_node {
 
 // Function prototypes for YAML parsing
 int parse_yaml_file(const char* filename, yaml_node_t** root);
+int parse_yaml_buffer(const char* data, size_t length, yaml_node_t** root);
+int parse_lxc_yaml_buffer(const char* data, size_t length, const char* source,
+                          lxc_config_t* config);
 int extract_lxc_config(yaml_node_t* root, lxc_config_t* config);
 void free_yaml_tree(yaml_node_t* root);
 char* get_yaml_value(yaml_node_t* root, const char* key);
@@ -0,0 +1,419 @@
+#include "../include/admission.h"
+#include "../include/operations.h"
+#include "../include/metrics.h"
+
+// Token bucket refilled at rate tokens per second up to burst; rate 0 is unlimited
+typedef struct {
+    double tokens;
+    double rate;
+    double burst;
+    struct timespec updated;
+} token_bucket_t;
+
+#define OVERFLOW_NODE "*"          // Shared queue for nodes that find the table full
+
+// A placed deploy waiting for its node's turn
+typedef struct {
+    int op_id;
+    int next;                       // Next entry for the same node, -1 at the end
+    char node_id[MAX_NAME_LEN];     // Where it goes, which the queue's node names unless shared
+    lxc_config_t config;
+    struct timespec queued_at;
+} admission_entry_t;
+
+// Deploys waiting for one node, oldest first
+typedef struct {
+    char node_id[MAX_NAME_LEN];
+    int head;
+    int tail;
+    int count;
+    token_bucket_t bucket;
+    unsigned long dispatched;
+} admission_node_t;
+
+// Queue, buckets and counters (protected by admission_mutex)
+static admission_entry_t entries[ADMISSION_SLOTS];
+static int free_head = -1;
+static admission_node_t admission_nodes[MAX_NODES + 1];   // One more for OVERFLOW_NODE
+static int admission_node_count = 0;
+static int next_node = 0;           // Where the next dispatch round starts
+static int queued_total = 0;
+static token_bucket_t cluster_bucket = { 100.0, 50.0, 100.0, { 0, 0 } };
+static double node_rate = 5.0;
+static double node_burst = 10.0;
+static int max_wait = 600;
+static unsigned long admitted_total = 0;
+static unsigned long delayed_total = 0;
+static unsigned long expired_total = 0;
+static admission_dispatcher_t admission_dispatcher = NULL;
+static pthread_mutex_t admission_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t admission_cond;
+static int wait_histogram = -1;
+static int expired_counter = -1;
+
+// Seconds between two monotonic timestamps
+static double seconds_between(const struct timespec* since, const struct timespec* now) {
+    return (now->tv_sec - since->tv_sec) + (now->tv_nsec - since->tv_nsec) / 1e9;
+}
+
+// Add the tokens earned since the last refill
+static void bucket_refill(token_bucket_t* bucket, const struct timespec* now) {
+    if (bucket->rate > 0.0) {
+        bucket->tokens += seconds_between(&bucket->updated, now) * bucket->rate;
+    }
+    if (bucket->rate <= 0.0 || bucket->tokens > bucket->burst) {
+        bucket->tokens = bucket->burst;
+    }
+    bucket->updated = *now;
+}
+
+// Whether a bucket has a token to spend
+static int bucket_ready(const token_bucket_t* bucket) {
+    return bucket->rate <= 0.0 || bucket->tokens >= 1.0;
+}
+
+// Seconds until a bucket has a token
+static double bucket_delay(const token_bucket_t* bucket) {
+    if (bucket_ready(bucket)) return 0.0;
+    return (1.0 - bucket->tokens) / bucket->rate;
+}
+
+// Spend one token
+static void bucket_take(token_bucket_t* bucket) {
+    if (bucket->rate > 0.0) bucket->tokens -= 1.0;
+}
+
+// Apply a new rate and burst, keeping the tokens already earned
+static void bucket_set(token_bucket_t* bucket, double rate, double burst) {
+    bucket->rate = rate;
+    bucket->burst = burst;
+    if (bucket->tokens > burst) bucket->tokens = burst;
+}
+
+// Drop one node that has nothing queued and a full bucket; a fresh entry for
+// it would be the same, so nothing is lost. Node ids change on every worker
+// restart, so without this the table fills with gone nodes. Returns 1 if a
+// slot was freed (caller holds admission_mutex).
+static int evict_idle_node_locked(const struct timespec* now) {
+    for (int i = 0; i < admission_node_count; i++) {
+        admission_node_t* node = &admission_nodes[i];
+        if (node->count > 0) continue;
+
+        bucket_refill(&node->bucket, now);
+        if (node->bucket.rate > 0.0 && node->bucket.tokens < node->bucket.burst) continue;
+
+        admission_nodes[i] = admission_nodes[--admission_node_count];
+        return 1;
+    }
+    return 0;
+}
+
+// Find a node's queue, adding it with a full bucket. When the table is full
+// of busy nodes the deploy shares the OVERFLOW_NODE queue, which is still
+// paced by the cluster bucket (caller holds admission_mutex).
+static admission_node_t* find_node_locked(const char* node_id, const struct timespec* now) {
+    for (int i = 0; i < admission_node_count; i++) {
+        if (strcmp(admission_nodes[i].node_id, node_id) == 0) {
+            return &admission_nodes[i];
+        }
+    }
+
+    // Only OVERFLOW_NODE may take the last slot, so it always finds room
+    int limit = strcmp(node_id, OVERFLOW_NODE) == 0 ? MAX_NODES + 1 : MAX_NODES;
+    while (admission_node_count >= limit) {
+        if (!evict_idle_node_locked(now)) {
+            return find_node_locked(OVERFLOW_NODE, now);
+        }
+    }
+
+    admission_node_t* node = &admission_nodes[admission_node_count++];
+    memset(node, 0, sizeof(*node));
+    strncpy(node->node_id, node_id, MAX_NAME_LEN - 1);
+    node->head = -1;
+    node->tail = -1;
+    node->bucket.rate = node_rate;
+    node->bucket.burst = node_burst;
+    node->bucket.tokens = node_burst;
+    node->bucket.updated = *now;
+    return node;
+}
+
+// Unlink a node's oldest entry and return its slot to the free list; the
+// entry stays readable until the next allocation (caller holds admission_mutex)
+static admission_entry_t* pop_locked(admission_node_t* node) {
+    int index = node->head;
+    admission_entry_t* entry = &entries[index];
+
+    node->head = entry->next;
+    if (node->head < 0) node->tail = -1;
+    node->count--;
+    queued_total--;
+
+    entry->next = free_head;
+    free_head = index;
+    return entry;
+}
+
+// Paces queued deploys: each round takes one deploy from the next node that
+// has a token, so one busy node does not hold up the others
+static void* admission_thread(void* arg) {
+    static lxc_config_t config;
+    (void)arg;
+
+    pthread_mutex_lock(&admission_mutex);
+    while (1) {
+        struct timespec now;
+        double delay = 1.0;
+        int progressed = 0;
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        bucket_refill(&cluster_bucket, &now);
+
+        for (int k = 0; k < admission_node_count && !progressed; k++) {
+            int index = (next_node + k) % admission_node_count;
+            admission_node_t* node = &admission_nodes[index];
+            if (node->count == 0) continue;
+
+            admission_entry_t* head = &entries[node->head];
+            double waited = seconds_between(&head->queued_at, &now);
+            int op_id = head->op_id;
+
+            // Waited too long: fail it so the container is dropped from the registry
+            if (waited >= max_wait) {
+                pop_locked(node);
+                expired_total++;
+                pthread_mutex_unlock(&admission_mutex);
+                metrics_add(expired_counter, 1);
+                printf("Error: Deploy operation %d waited %.0fs for admission to node %s\n",
+                       op_id, waited, node->node_id);
+                operation_complete(op_id, OP_FAILED, "admission wait exceeded");
+                pthread_mutex_lock(&admission_mutex);
+                progressed = 1;
+                break;
+            }
+
+            if (!bucket_ready(&cluster_bucket)) {
+                delay = bucket_delay(&cluster_bucket);
+                break;
+            }
+            bucket_refill(&node->bucket, &now);
+            if (!bucket_ready(&node->bucket)) {
+                double node_delay = bucket_delay(&node->bucket);
+                if (node_delay < delay) delay = node_delay;
+                continue;
+            }
+
+            // Copy the deploy out before the slot can be reused
+            char node_id[MAX_NAME_LEN];
+            config = head->config;
+            strcpy(node_id, head->node_id);
+            pop_locked(node);
+            bucket_take(&cluster_bucket);
+            bucket_take(&node->bucket);
+            node->dispatched++;
+            admitted_total++;
+            delayed_total++;
+            next_node = index + 1;
+            pthread_mutex_unlock(&admission_mutex);
+
+            metrics_observe(wait_histogram, waited);
+            operation_restart_timer(op_id, DEFAULT_OPERATION_TIMEOUT);
+            admission_dispatcher(op_id, node_id, &config);
+
+            pthread_mutex_lock(&admission_mutex);
+            progressed = 1;
+        }
+        if (progressed) continue;
+
+        if (queued_total == 0) {
+            pthread_cond_wait(&admission_cond, &admission_mutex);
+        } else {
+            struct timespec deadline = now;
+            long nanoseconds = (long)(delay * 1e9) + 1000000;
+            deadline.tv_sec += nanoseconds / 1000000000L;
+            deadline.tv_nsec += nanoseconds % 1000000000L;
+            if (deadline.tv_nsec >= 1000000000L) {
+                deadline.tv_sec++;
+                deadline.tv_nsec -= 1000000000L;
+            }
+            pthread_cond_timedwait(&admission_cond, &admission_mutex, &deadline);
+        }
+    }
+
+    return NULL;
+}
+
+// Start the admission thread
+int init_admission(admission_dispatcher_t dispatcher) {
+    pthread_condattr_t attributes;
+    pthread_t tid;
+
+    if (!dispatcher) return -1;
+    admission_dispatcher = dispatcher;
+
+    pthread_condattr_init(&attributes);
+    pthread_condattr_setclock(&attributes, CLOCK_MONOTONIC);
+    pthread_cond_init(&admission_cond, &attributes);
+    pthread_condattr_destroy(&attributes);
+
+    pthread_mutex_lock(&admission_mutex);
+    for (int i = ADMISSION_SLOTS - 1; i >= 0; i--) {
+        entries[i].next = free_head;
+        free_head = i;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &cluster_bucket.updated);
+    pthread_mutex_unlock(&admission_mutex);
+
+    wait_histogram = metrics_histogram("lxc_admission_wait_seconds", NULL,
+                                       "Time deploys waited for admission");
+    expired_counter = metrics_counter("lxc_admission_expired_total", NULL,
+                                      "Deploys failed after waiting too long for admission");
+
+    if (pthread_create(&tid, NULL, admission_thread, NULL) != 0) {
+        printf("Error: Failed to start admission thread\n");
+        return -1;
+    }
+
+    pthread_detach(tid);
+    return 0;
+}
+
+// Take the [admission] rates; tokens already earned carry over
+void admission_configure(const daemon_config_t* config) {
+    pthread_mutex_lock(&admission_mutex);
+    bucket_set(&cluster_bucket, config->admission_rate, config->admission_burst);
+    node_rate = config->admission_node_rate;
+    node_burst = config->admission_node_burst;
+    for (int i = 0; i < admission_node_count; i++) {
+        bucket_set(&admission_nodes[i].bucket, node_rate, node_burst);
+    }
+    max_wait = config->admission_max_wait;
+    if (admission_dispatcher) {
+        pthread_cond_signal(&admission_cond);
+    }
+    pthread_mutex_unlock(&admission_mutex);
+}
+
+// Send a placed deploy now if the cluster and its node have tokens and nothing
+// is waiting for that node, or queue it. Returns 0, or -1 once the operation
+// has failed.
+int admission_submit(int op_id, const char* node_id, const lxc_config_t* config) {
+    struct timespec now;
+
+    if (!node_id || !config) return -1;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    pthread_mutex_lock(&admission_mutex);
+    admission_node_t* node = find_node_locked(node_id, &now);
+
+    bucket_refill(&cluster_bucket, &now);
+    bucket_refill(&node->bucket, &now);
+    if (node->count == 0 && bucket_ready(&cluster_bucket) && bucket_ready(&node->bucket)) {
+        bucket_take(&cluster_bucket);
+        bucket_take(&node->bucket);
+        node->dispatched++;
+        admitted_total++;
+        pthread_mutex_unlock(&admission_mutex);
+
+        metrics_observe(wait_histogram, 0.0);
+        return admission_dispatcher(op_id, node_id, config);
+    }
+
+    if (free_head < 0) {
+        pthread_mutex_unlock(&admission_mutex);
+        printf("Error: Admission queue full, deploy operation %d refused\n", op_id);
+        operation_complete(op_id, OP_FAILED, "admission queue full");
+        return -1;
+    }
+
+    int index = free_head;
+    admission_entry_t* entry = &entries[index];
+    free_head = entry->next;
+    entry->op_id = op_id;
+    entry->next = -1;
+    strncpy(entry->node_id, node_id, MAX_NAME_LEN - 1);
+    entry->node_id[MAX_NAME_LEN - 1] = '\0';
+    entry->config = *config;
+    entry->queued_at = now;
+
+    if (node->tail >= 0) {
+        entries[node->tail].next = index;
+    } else {
+        node->head = index;
+    }
+    node->tail = index;
+    node->count++;
+    queued_total++;
+
+    // The operation must outlive its wait here; it gets a fresh timeout when sent
+    operation_restart_timer(op_id, max_wait + DEFAULT_OPERATION_TIMEOUT);
+    pthread_cond_signal(&admission_cond);
+    pthread_mutex_unlock(&admission_mutex);
+    return 0;
+}
+
+// Copy the admission counters
+void admission_status(admission_status_t* status) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    pthread_mutex_lock(&admission_mutex);
+    bucket_refill(&cluster_bucket, &now);
+    status->queued = queued_total;
+    status->tokens = cluster_bucket.tokens;
+    status->oldest_wait = 0.0;
+    for (int i = 0; i < admission_node_count; i++) {
+        if (admission_nodes[i].count == 0) continue;
+        double waited = seconds_between(&entries[admission_nodes[i].head].queued_at, &now);
+        if (waited > status->oldest_wait) status->oldest_wait = waited;
+    }
+    status->admitted = admitted_total;
+    status->delayed = delayed_total;
+    status->expired = expired_total;
+    pthread_mutex_unlock(&admission_mutex);
+}
+
+// Copy each node's backlog
+int admission_list(admission_node_info_t* infos, int max_nodes) {
+    struct timespec now;
+    int count = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    pthread_mutex_lock(&admission_mutex);
+    for (int i = 0; i < admission_node_count && count < max_nodes; i++) {
+        admission_node_t* node = &admission_nodes[i];
+        bucket_refill(&node->bucket, &now);
+
+        admission_node_info_t* info = &infos[count++];
+        strcpy(info->node_id, node->node_id);
+        info->queued = node->count;
+        info->tokens = node->bucket.tokens;
+        info->dispatched = node->dispatched;
+    }
+    pthread_mutex_unlock(&admission_mutex);
+    return count;
+}
+
+// Print the rate limits, counters and per-node backlog
+void show_admission(void) {
+    static admission_node_info_t infos[MAX_NODES];
+    admission_status_t status;
+    const daemon_config_t* config = config_current();
+
+    admission_status(&status);
+    int count = admission_list(infos, MAX_NODES);
+
+    printf("\n=== Admission ===\n");
+    printf("Cluster: %.1f/s burst %d  Node: %.1f/s burst %d  Max wait: %ds\n",
+           config->admission_rate, config->admission_burst, config->admission_node_rate,
+           config->admission_node_burst, config->admission_max_wait);
+    printf("Queued: %d  Oldest: %.1fs  Admitted: %lu  Delayed: %lu  Expired: %lu  Tokens: %.1f\n",
+           status.queued, status.oldest_wait, status.admitted, status.delayed, status.expired,
+           status.tokens);
+    printf("%-20s %-8s %-8s %-10s\n", "Node", "Queued", "Tokens", "Dispatched");
+    printf("-------------------------------------------------------------------------------\n");
+    for (int i = 0; i < count; i++) {
+        printf("%-20s %-8d %-8.1f %-10lu\n", infos[i].node_id, infos[i].queued, infos[i].tokens,
+               infos[i].dispatched);
+    }
+}
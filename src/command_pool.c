@@ -0,0 +1,315 @@
+#include "../include/command_pool.h"
+#include <semaphore.h>
+#include <stdint.h>
+#include <sched.h>
+
+// Commands started together whose results are collected together. The
+// batch is freed by whichever of its caller and its last command is done last.
+struct command_batch {
+    pthread_mutex_t mutex;
+    int count;
+    int remaining;                  // Commands not finished yet
+    int released;                   // Caller no longer wants the results
+    void (*notify)(void);           // Called once the last command finishes
+    int results[];
+};
+
+// One submitted command, linked into its thread's queue
+typedef struct command_task {
+    struct command_task* next;
+    int job_id;
+    char verb[COMMAND_VERB_LEN];
+    char argument[MAX_PATH_LEN];
+    command_batch_t* batch;         // NULL when the result is only printed
+    int index;                      // Slot in the batch's results
+} command_task_t;
+
+// Intrusive multi-producer single-consumer queue owned by one pool thread.
+// Producers never lock: each swaps itself in as the new head and then links
+// the previous head to itself. Only the owning thread moves the tail.
+typedef struct {
+    command_task_t* head;
+    command_task_t* tail;
+    command_task_t stub;
+    sem_t ready;                    // One post per pushed task
+    int queued;                     // Submitted and not finished
+} command_queue_t;
+
+static command_queue_t queues[COMMAND_POOL_MAX_THREADS];
+static int queue_count = 0;
+static command_executor_t command_executor = NULL;
+static int next_job_id = 0;
+static unsigned int next_queue = 0;    // Round robin for commands without a key
+static unsigned long submitted_total = 0;
+static unsigned long completed_total = 0;
+static unsigned long failed_total = 0;
+
+// Append a task; safe from any number of threads at once
+static void queue_push(command_queue_t* queue, command_task_t* task) {
+    __atomic_store_n(&task->next, NULL, __ATOMIC_RELAXED);
+    command_task_t* previous = __atomic_exchange_n(&queue->head, task, __ATOMIC_ACQ_REL);
+    __atomic_store_n(&previous->next, task, __ATOMIC_RELEASE);
+}
+
+// Take the oldest task, NULL if the queue is empty or a producer is between
+// its two steps (owning thread only)
+static command_task_t* queue_pop(command_queue_t* queue) {
+    command_task_t* tail = queue->tail;
+    command_task_t* next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+
+    if (tail == &queue->stub) {
+        if (!next) return NULL;
+        queue->tail = next;
+        tail = next;
+        next = __atomic_load_n(&next->next, __ATOMIC_ACQUIRE);
+    }
+    if (next) {
+        queue->tail = next;
+        return tail;
+    }
+    if (tail != __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE)) return NULL;
+
+    // tail is the last task; put the stub behind it so it can be handed out
+    queue_push(queue, &queue->stub);
+    next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+    if (next) {
+        queue->tail = next;
+        return tail;
+    }
+    return NULL;
+}
+
+// Report a finished command to its batch or on the console
+static void finish_task(command_task_t* task, int result) {
+    if (result < 0) {
+        __atomic_fetch_add(&failed_total, 1, __ATOMIC_RELAXED);
+    }
+    __atomic_fetch_add(&completed_total, 1, __ATOMIC_RELAXED);
+
+    if (task->batch) {
+        command_batch_t* batch = task->batch;
+        void (*notify)(void) = batch->notify;
+
+        pthread_mutex_lock(&batch->mutex);
+        batch->results[task->index] = result;
+        int finished = --batch->remaining == 0;
+        int unwanted = finished && batch->released;
+        pthread_mutex_unlock(&batch->mutex);
+
+        if (unwanted) {
+            pthread_mutex_destroy(&batch->mutex);
+            free(batch);
+        } else if (finished && notify) {
+            notify();
+        }
+    } else if (result < 0) {
+        printf("Job %d failed: %s %s\n", task->job_id, task->verb, task->argument);
+    } else if (result > 0) {
+        printf("Job %d done: %s %s (operation %d)\n", task->job_id, task->verb, task->argument,
+               result);
+    } else {
+        printf("Job %d done: %s %s\n", task->job_id, task->verb, task->argument);
+    }
+    free(task);
+}
+
+// Runs the commands of one queue in submission order
+static void* command_thread(void* arg) {
+    command_queue_t* queue = arg;
+
+    while (1) {
+        command_task_t* task;
+
+        while (sem_wait(&queue->ready) != 0) {
+            // Interrupted by a signal, wait again
+        }
+        // The post follows a finished push, but an earlier push may still be
+        // linking itself in front of it
+        while (!(task = queue_pop(queue))) {
+            sched_yield();
+        }
+
+        int result = command_executor(task->verb, task->argument);
+        __atomic_fetch_sub(&queue->queued, 1, __ATOMIC_RELAXED);
+        finish_task(task, result);
+    }
+
+    return NULL;
+}
+
+// Start the pool; threads 0 means one per online CPU
+int init_command_pool(int threads, command_executor_t executor) {
+    if (!executor) return -1;
+    if (threads <= 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cpus > 0 ? (int)cpus : 1;
+    }
+    if (threads > COMMAND_POOL_MAX_THREADS) threads = COMMAND_POOL_MAX_THREADS;
+    command_executor = executor;
+
+    for (int i = 0; i < threads; i++) {
+        command_queue_t* queue = &queues[i];
+        pthread_t tid;
+
+        queue->head = &queue->stub;
+        queue->tail = &queue->stub;
+        queue->stub.next = NULL;
+        if (sem_init(&queue->ready, 0, 0) != 0 ||
+            pthread_create(&tid, NULL, command_thread, queue) != 0) {
+            printf("Error: Failed to start command thread %d\n", i);
+            return -1;
+        }
+        pthread_detach(tid);
+        queue_count++;
+    }
+
+    printf("Command pool started with %d threads\n", queue_count);
+    return 0;
+}
+
+// 64-bit FNV-1a over a command argument
+static uint64_t hash_argument(const char* argument) {
+    uint64_t hash = 14695981039346656037ULL;
+    while (*argument) {
+        hash ^= (unsigned char)*argument++;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// Queue one command. Commands on the same container share a thread and run
+// in submission order; deploys are spread over all threads.
+static int submit_task(const char* verb, const char* argument, command_batch_t* batch, int index) {
+    command_task_t* task = calloc(1, sizeof(command_task_t));
+    if (!task) {
+        printf("Error: No memory to queue %s %s\n", verb, argument);
+        return -1;
+    }
+
+    int job_id = __atomic_add_fetch(&next_job_id, 1, __ATOMIC_RELAXED);
+    task->job_id = job_id;
+    strncpy(task->verb, verb, COMMAND_VERB_LEN - 1);
+    strncpy(task->argument, argument, MAX_PATH_LEN - 1);
+    task->batch = batch;
+    task->index = index;
+
+    unsigned int slot = strcmp(verb, "deploy") == 0
+                        ? __atomic_fetch_add(&next_queue, 1, __ATOMIC_RELAXED)
+                        : (unsigned int)hash_argument(argument);
+    command_queue_t* queue = &queues[slot % queue_count];
+
+    __atomic_fetch_add(&queue->queued, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&submitted_total, 1, __ATOMIC_RELAXED);
+    queue_push(queue, task);
+    sem_post(&queue->ready);
+    return job_id;     // The task may already be finished and freed
+}
+
+// Run a command in the background; its result is printed when it finishes.
+// Returns the job id, or -1
+int command_submit(const char* verb, const char* argument) {
+    if (!verb || !argument) return -1;
+    if (queue_count == 0) {
+        printf("Error: Command pool is not running\n");
+        return -1;
+    }
+    return submit_task(verb, argument, NULL, 0);
+}
+
+// Start a batch of commands across the pool without waiting for them; notify,
+// if given, is called from a pool thread once the last one finishes. Returns
+// NULL when out of memory
+command_batch_t* command_start_batch(const char* verb, char** arguments, int count,
+                                     void (*notify)(void)) {
+    if (!command_executor || count < 1) return NULL;
+
+    command_batch_t* batch = calloc(1, sizeof(command_batch_t) + count * sizeof(int));
+    if (!batch) {
+        printf("Error: No memory to queue a batch of %d commands\n", count);
+        return NULL;
+    }
+    pthread_mutex_init(&batch->mutex, NULL);
+    batch->count = count;
+
+    if (queue_count == 0) {
+        for (int i = 0; i < count; i++) {
+            batch->results[i] = command_executor(verb, arguments[i]);
+        }
+        return batch;
+    }
+
+    // Hold the count up until every command is queued so none can finish the batch early
+    batch->remaining = count + 1;
+    batch->notify = notify;
+    for (int i = 0; i < count; i++) {
+        if (submit_task(verb, arguments[i], batch, i) < 0) {
+            pthread_mutex_lock(&batch->mutex);
+            batch->results[i] = -1;
+            batch->remaining--;
+            pthread_mutex_unlock(&batch->mutex);
+        }
+    }
+
+    pthread_mutex_lock(&batch->mutex);
+    int finished = --batch->remaining == 0;
+    pthread_mutex_unlock(&batch->mutex);
+    if (finished && notify) {
+        notify();
+    }
+    return batch;
+}
+
+// Copy a batch's results in argument order once every command has finished;
+// returns 1 when they were copied, 0 while commands are still running
+int command_batch_results(command_batch_t* batch, int* results) {
+    pthread_mutex_lock(&batch->mutex);
+    int finished = batch->remaining == 0;
+    if (finished) {
+        memcpy(results, batch->results, batch->count * sizeof(int));
+    }
+    pthread_mutex_unlock(&batch->mutex);
+    return finished;
+}
+
+// Give up a batch; it is freed now or when its last command finishes
+void command_release_batch(command_batch_t* batch) {
+    if (!batch) return;
+
+    pthread_mutex_lock(&batch->mutex);
+    int finished = batch->remaining == 0;
+    batch->released = 1;
+    pthread_mutex_unlock(&batch->mutex);
+
+    if (finished) {
+        pthread_mutex_destroy(&batch->mutex);
+        free(batch);
+    }
+}
+
+// Copy the pool counters
+void command_pool_status(command_pool_status_t* status) {
+    status->threads = queue_count;
+    status->queued = 0;
+    for (int i = 0; i < queue_count; i++) {
+        status->queued += __atomic_load_n(&queues[i].queued, __ATOMIC_RELAXED);
+    }
+    status->submitted = __atomic_load_n(&submitted_total, __ATOMIC_RELAXED);
+    status->completed = __atomic_load_n(&completed_total, __ATOMIC_RELAXED);
+    status->failed = __atomic_load_n(&failed_total, __ATOMIC_RELAXED);
+}
+
+// Print the pool counters and each thread's backlog
+void show_command_pool(void) {
+    command_pool_status_t status;
+    command_pool_status(&status);
+
+    printf("\n=== Command Pool ===\n");
+    printf("Threads: %d  Queued: %d  Submitted: %lu  Completed: %lu  Failed: %lu\n",
+           status.threads, status.queued, status.submitted, status.completed, status.failed);
+    for (int i = 0; i < queue_count; i++) {
+        int queued = __atomic_load_n(&queues[i].queued, __ATOMIC_RELAXED);
+        if (queued > 0) {
+            printf("  Thread %d: %d queued\n", i, queued);
+        }
+    }
+}
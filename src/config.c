@@ -0,0 +1,445 @@
+#include "../include/config.h"
+#include <ctype.h>
+
+#define RETIRED_SNAPSHOTS 8         // Replaced snapshots waiting out their grace period
+#define RETIRE_GRACE 60             // Seconds a replaced snapshot stays readable
+
+// Published snapshot. Readers load the pointer atomically and never see a
+// partially written config. A pointer from config_current() is used within
+// one call and not kept across long waits, so a replaced snapshot is freed
+// once it has been retired for RETIRE_GRACE seconds. At most
+// RETIRED_SNAPSHOTS are retired at once; a reload beyond that is refused,
+// which bounds the memory held to that many daemon_config_t.
+static daemon_config_t* current_config = NULL;
+static daemon_config_t default_config;
+static pthread_once_t default_config_once = PTHREAD_ONCE_INIT;
+static daemon_config_t* retired_configs[RETIRED_SNAPSHOTS];   // Protected by reload_mutex
+static time_t retired_at[RETIRED_SNAPSHOTS];
+static pthread_mutex_t reload_mutex = PTHREAD_MUTEX_INITIALIZER;
+static char config_path[MAX_PATH_LEN];
+static config_reload_handler_t reload_handler = NULL;
+
+// Fill in built-in defaults matching the shipped config files
+void config_set_defaults(daemon_config_t* config) {
+    if (!config) return;
+
+    memset(config, 0, sizeof(daemon_config_t));
+
+    config->port = DEFAULT_PORT;
+    config->max_nodes = MAX_NODES;
+    config->max_containers = MAX_CONTAINERS;
+    config->heartbeat_timeout = 30;
+    config->snapshot_interval = 10000;
+
+    config->cpu_weight = 0.3;
+    config->memory_weight = 0.3;
+    config->disk_weight = 0.2;
+    config->load_weight = 0.2;
+
+    strcpy(config->policy, "spread");
+    config->headroom_percent = 10;
+    config->sample_size = 2;
+    config->locality_bonus = 10.0;
+    config->preemption = 1;
+
+    config->rebalance_interval = 0;
+    config->rebalance_threshold = 20;
+    config->rebalance_max_moves = 2;
+    config->rebalance_cooldown = 3600;
+
+    config->admission_rate = 50.0;
+    config->admission_burst = 100;
+    config->admission_node_rate = 5.0;
+    config->admission_node_burst = 10;
+    config->admission_max_wait = 600;
+
+    strcpy(config->coordinator_ip, "127.0.0.1");
+    config->coordinator_port = DEFAULT_PORT;
+    config->node_max_containers = DEFAULT_NODE_MAX_CONTAINERS;
+    strcpy(config->migration_dir, DEFAULT_MIGRATION_DIR);
+    config->executor_threads = DEFAULT_EXECUTOR_THREADS;
+    strcpy(config->runtime, DEFAULT_RUNTIME);
+    config->fake_create_ms = 50;
+    config->fake_start_ms = 20;
+    config->fake_stop_ms = 20;
+    config->fake_destroy_ms = 20;
+    config->fake_jitter_percent = 0;
+    config->fake_failure_rate = 0.0;
+    config->fake_seed = 1;
+    config->fake_cpus = 64;
+    config->fake_memory = 262144;
+
+    config->heartbeat_interval = 10;
+
+    config->election_timeout_ms = 1000;
+}
+
+// Strip leading and trailing whitespace in place
+static char* trim(char* str) {
+    while (isspace((unsigned char)*str)) str++;
+
+    char* end = str + strlen(str);
+    while (end > str && isspace((unsigned char)end[-1])) end--;
+    *end = '\0';
+
+    return str;
+}
+
+// Clamp an integer setting into a sane range
+static int clamp_int(int value, int min, int max) {
+    if (value < min) return min;
+    if (value > max) return max;
+    return value;
+}
+
+// Parse a tenant's "cpu=N memory=MB containers=N weight=W" limits
+static void apply_tenant_quota(daemon_config_t* config, const char* name, const char* value) {
+    char terms[MAX_NAME_LEN];
+    char* saveptr = NULL;
+    tenant_quota_t* quota = NULL;
+
+    for (int i = 0; i < config->tenant_quota_count; i++) {
+        if (strcmp(config->tenant_quotas[i].name, name) == 0) {
+            quota = &config->tenant_quotas[i];
+        }
+    }
+    if (!quota) {
+        if (config->tenant_quota_count >= MAX_TENANT_QUOTAS) {
+            printf("Warning: Ignoring tenant %s, at most %d tenants can have limits\n",
+                   name, MAX_TENANT_QUOTAS);
+            return;
+        }
+        quota = &config->tenant_quotas[config->tenant_quota_count++];
+    }
+
+    memset(quota, 0, sizeof(*quota));
+    strncpy(quota->name, name, MAX_NAME_LEN - 1);
+    quota->weight = 1.0;
+
+    strncpy(terms, value, MAX_NAME_LEN - 1);
+    terms[MAX_NAME_LEN - 1] = '\0';
+    for (char* term = strtok_r(terms, " ,", &saveptr); term; term = strtok_r(NULL, " ,", &saveptr)) {
+        char* equals = strchr(term, '=');
+        if (!equals) continue;
+        *equals = '\0';
+
+        if (strcmp(term, "cpu") == 0) {
+            quota->cpu = clamp_int(atoi(equals + 1), 0, 1000000);
+        } else if (strcmp(term, "memory") == 0) {
+            quota->memory = clamp_int(atoi(equals + 1), 0, 1000000000);
+        } else if (strcmp(term, "containers") == 0) {
+            quota->containers = clamp_int(atoi(equals + 1), 0, MAX_CONTAINERS);
+        } else if (strcmp(term, "weight") == 0) {
+            quota->weight = atof(equals + 1);
+            if (quota->weight <= 0.0) quota->weight = 1.0;
+        }
+    }
+}
+
+// Apply one key = value pair; unknown keys are ignored
+static void apply_setting(daemon_config_t* config, const char* section,
+                          const char* key, const char* value) {
+    if (strcmp(section, "coordinator") == 0) {
+        if (strcmp(key, "port") == 0) {
+            config->port = clamp_int(atoi(value), 1, 65535);
+        } else if (strcmp(key, "max_nodes") == 0) {
+            config->max_nodes = clamp_int(atoi(value), 1, MAX_NODES);
+        } else if (strcmp(key, "max_containers") == 0) {
+            config->max_containers = clamp_int(atoi(value), 1, MAX_CONTAINERS);
+        } else if (strcmp(key, "heartbeat_timeout") == 0) {
+            config->heartbeat_timeout = clamp_int(atoi(value), 1, 86400);
+        } else if (strcmp(key, "state_dir") == 0) {
+            strncpy(config->state_dir, value, MAX_PATH_LEN - 1);
+        } else if (strcmp(key, "snapshot_interval") == 0) {
+            config->snapshot_interval = clamp_int(atoi(value), 1, 100000000);
+        } else if (strcmp(key, "control_socket") == 0) {
+            strncpy(config->control_socket, value, MAX_PATH_LEN - 1);
+        } else if (strcmp(key, "control_port") == 0) {
+            config->control_port = clamp_int(atoi(value), 0, 65535);
+        } else if (strcmp(key, "metrics_port") == 0) {
+            config->metrics_port = clamp_int(atoi(value), 0, 65535);
+        } else if (strcmp(key, "command_threads") == 0) {
+            config->command_threads = clamp_int(atoi(value), 0, 64);
+        }
+    } else if (strcmp(section, "resources") == 0) {
+        if (strcmp(key, "cpu_weight") == 0) {
+            config->cpu_weight = atof(value);
+        } else if (strcmp(key, "memory_weight") == 0) {
+            config->memory_weight = atof(value);
+        } else if (strcmp(key, "disk_weight") == 0) {
+            config->disk_weight = atof(value);
+        } else if (strcmp(key, "load_weight") == 0) {
+            config->load_weight = atof(value);
+        }
+    } else if (strcmp(section, "scheduler") == 0) {
+        if (strcmp(key, "policy") == 0) {
+            strncpy(config->policy, value, sizeof(config->policy) - 1);
+        } else if (strcmp(key, "headroom") == 0) {
+            config->headroom_percent = clamp_int(atoi(value), 0, 90);
+        } else if (strcmp(key, "sample_size") == 0) {
+            config->sample_size = clamp_int(atoi(value), 1, MAX_NODES);
+        } else if (strcmp(key, "locality_bonus") == 0) {
+            config->locality_bonus = atof(value);
+        } else if (strcmp(key, "preemption") == 0) {
+            config->preemption = clamp_int(atoi(value), 0, 1);
+        }
+    } else if (strcmp(section, "rebalancer") == 0) {
+        if (strcmp(key, "interval") == 0) {
+            config->rebalance_interval = clamp_int(atoi(value), 0, 86400);
+        } else if (strcmp(key, "threshold") == 0) {
+            config->rebalance_threshold = clamp_int(atoi(value), 1, 100);
+        } else if (strcmp(key, "max_moves") == 0) {
+            config->rebalance_max_moves = clamp_int(atoi(value), 1, 64);
+        } else if (strcmp(key, "cooldown") == 0) {
+            config->rebalance_cooldown = clamp_int(atoi(value), 0, 7 * 86400);
+        }
+    } else if (strcmp(section, "admission") == 0) {
+        if (strcmp(key, "rate") == 0) {
+            config->admission_rate = atof(value) > 0.0 ? atof(value) : 0.0;
+        } else if (strcmp(key, "burst") == 0) {
+            config->admission_burst = clamp_int(atoi(value), 1, 100000);
+        } else if (strcmp(key, "node_rate") == 0) {
+            config->admission_node_rate = atof(value) > 0.0 ? atof(value) : 0.0;
+        } else if (strcmp(key, "node_burst") == 0) {
+            config->admission_node_burst = clamp_int(atoi(value), 1, 100000);
+        } else if (strcmp(key, "max_wait") == 0) {
+            config->admission_max_wait = clamp_int(atoi(value), 1, 86400);
+        }
+    } else if (strcmp(section, "tenants") == 0) {
+        apply_tenant_quota(config, key, value);
+    } else if (strcmp(section, "worker") == 0) {
+        if (strcmp(key, "coordinator_ip") == 0) {
+            strncpy(config->coordinator_ip, value, INET_ADDRSTRLEN - 1);
+        } else if (strcmp(key, "coordinator_port") == 0) {
+            config->coordinator_port = clamp_int(atoi(value), 1, 65535);
+        } else if (strcmp(key, "max_containers") == 0) {
+            config->node_max_containers = clamp_int(atoi(value), 1, MAX_CONTAINERS);
+        } else if (strcmp(key, "labels") == 0) {
+            strncpy(config->labels, value, MAX_NAME_LEN - 1);
+        } else if (strcmp(key, "coordinators") == 0) {
+            strncpy(config->coordinators, value, MAX_COMMAND_LEN - 1);
+        } else if (strcmp(key, "metrics_port") == 0) {
+            config->node_metrics_port = clamp_int(atoi(value), 0, 65535);
+        } else if (strcmp(key, "migration_dir") == 0) {
+            strncpy(config->migration_dir, value, MAX_PATH_LEN - 1);
+        } else if (strcmp(key, "executor_threads") == 0) {
+            config->executor_threads = clamp_int(atoi(value), 1, 64);
+        } else if (strcmp(key, "runtime") == 0) {
+            strncpy(config->runtime, value, sizeof(config->runtime) - 1);
+        }
+    } else if (strcmp(section, "fake_runtime") == 0) {
+        if (strcmp(key, "create_ms") == 0) {
+            config->fake_create_ms = clamp_int(atoi(value), 0, 600000);
+        } else if (strcmp(key, "start_ms") == 0) {
+            config->fake_start_ms = clamp_int(atoi(value), 0, 600000);
+        } else if (strcmp(key, "stop_ms") == 0) {
+            config->fake_stop_ms = clamp_int(atoi(value), 0, 600000);
+        } else if (strcmp(key, "destroy_ms") == 0) {
+            config->fake_destroy_ms = clamp_int(atoi(value), 0, 600000);
+        } else if (strcmp(key, "jitter_percent") == 0) {
+            config->fake_jitter_percent = clamp_int(atoi(value), 0, 100);
+        } else if (strcmp(key, "failure_rate") == 0) {
+            double rate = atof(value);
+            config->fake_failure_rate = rate < 0.0 ? 0.0 : (rate > 1.0 ? 1.0 : rate);
+        } else if (strcmp(key, "seed") == 0) {
+            config->fake_seed = (unsigned int)strtoul(value, NULL, 10);
+        } else if (strcmp(key, "cpus") == 0) {
+            config->fake_cpus = clamp_int(atoi(value), 1, 65536);
+        } else if (strcmp(key, "memory") == 0) {
+            config->fake_memory = clamp_int(atoi(value), 1, 1 << 30);
+        }
+    } else if (strcmp(section, "heartbeat") == 0) {
+        if (strcmp(key, "interval") == 0) {
+            config->heartbeat_interval = clamp_int(atoi(value), 1, 3600);
+        } else if (strcmp(key, "timeout") == 0) {
+            config->heartbeat_timeout = clamp_int(atoi(value), 1, 86400);
+        }
+    } else if (strcmp(section, "cluster") == 0) {
+        if (strcmp(key, "node_id") == 0) {
+            config->cluster_node_id = clamp_int(atoi(value), 0, 65535);
+        } else if (strcmp(key, "peers") == 0) {
+            strncpy(config->cluster_peers, value, MAX_COMMAND_LEN - 1);
+        } else if (strcmp(key, "election_timeout_ms") == 0) {
+            config->election_timeout_ms = clamp_int(atoi(value), 50, 60000);
+        }
+    }
+}
+
+// Parse an INI style config file on top of the defaults
+int config_load(const char* path, daemon_config_t* config) {
+    if (!path || !config) return -1;
+
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        printf("Error: Cannot open config file %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    config_set_defaults(config);
+
+    char line[MAX_COMMAND_LEN];
+    char section[MAX_NAME_LEN] = "";
+    int line_number = 0;
+
+    while (fgets(line, sizeof(line), file)) {
+        line_number++;
+        char* text = trim(line);
+
+        if (*text == '\0' || *text == '#' || *text == ';') {
+            continue;
+        }
+
+        if (*text == '[') {
+            char* close = strchr(text, ']');
+            if (!close) {
+                printf("Warning: %s:%d: malformed section header\n", path, line_number);
+                continue;
+            }
+            *close = '\0';
+            strncpy(section, trim(text + 1), MAX_NAME_LEN - 1);
+            continue;
+        }
+
+        char* equals = strchr(text, '=');
+        if (!equals) {
+            printf("Warning: %s:%d: expected key = value\n", path, line_number);
+            continue;
+        }
+
+        *equals = '\0';
+        apply_setting(config, section, trim(text), trim(equals + 1));
+    }
+
+    fclose(file);
+    return 0;
+}
+
+// Built-in defaults used until a file is loaded
+static void init_default_config(void) {
+    config_set_defaults(&default_config);
+}
+
+// Current configuration snapshot, never NULL
+const daemon_config_t* config_current(void) {
+    daemon_config_t* config = __atomic_load_n(&current_config, __ATOMIC_ACQUIRE);
+    if (config) return config;
+
+    pthread_once(&default_config_once, init_default_config);
+    return &default_config;
+}
+
+// Publish a new snapshot and retire the previous one, freeing snapshots whose
+// grace period is over. Returns -1, publishing nothing, when every retired
+// slot is still in its grace period (caller holds reload_mutex).
+static int publish_config(daemon_config_t* config) {
+    time_t now = time(NULL);
+    int slot = -1;
+
+    for (int i = 0; i < RETIRED_SNAPSHOTS; i++) {
+        if (retired_configs[i] && now - retired_at[i] >= RETIRE_GRACE) {
+            free(retired_configs[i]);
+            retired_configs[i] = NULL;
+        }
+        if (!retired_configs[i] && slot < 0) {
+            slot = i;
+        }
+    }
+    if (slot < 0) {
+        printf("Error: %d reloads within %ds, wait before reloading again\n",
+               RETIRED_SNAPSHOTS, RETIRE_GRACE);
+        return -1;
+    }
+
+    const daemon_config_t* previous = config_current();
+    config->generation = previous->generation + 1;
+
+    daemon_config_t* old = __atomic_exchange_n(&current_config, config, __ATOMIC_ACQ_REL);
+    if (old) {
+        retired_configs[slot] = old;
+        retired_at[slot] = now;
+    }
+    return 0;
+}
+
+// Re-read the config file and swap in the new snapshot; the old one stays
+// active if the file cannot be read
+int config_reload(void) {
+    pthread_mutex_lock(&reload_mutex);
+
+    if (strlen(config_path) == 0) {
+        pthread_mutex_unlock(&reload_mutex);
+        return -1;
+    }
+
+    daemon_config_t* config = malloc(sizeof(daemon_config_t));
+    if (!config || config_load(config_path, config) != 0) {
+        free(config);
+        pthread_mutex_unlock(&reload_mutex);
+        printf("Error: Keeping previous configuration\n");
+        return -1;
+    }
+
+    if (publish_config(config) != 0) {
+        free(config);
+        pthread_mutex_unlock(&reload_mutex);
+        printf("Error: Keeping previous configuration\n");
+        return -1;
+    }
+    config_reload_handler_t handler = reload_handler;
+
+    pthread_mutex_unlock(&reload_mutex);
+
+    printf("Configuration loaded from %s (generation %lu)\n", config_path, config->generation);
+    if (handler) {
+        handler(config);
+    }
+    return 0;
+}
+
+// Wait for SIGHUP and reload the config file
+static void* config_reload_thread(void* arg) {
+    sigset_t* signals = (sigset_t*)arg;
+    int sig;
+
+    while (1) {
+        if (sigwait(signals, &sig) == 0 && sig == SIGHUP) {
+            printf("Received SIGHUP, reloading configuration\n");
+            config_reload();
+        }
+    }
+
+    return NULL;
+}
+
+// Load the initial config and start SIGHUP reloading. Must run before other
+// threads are created so they inherit the blocked SIGHUP mask.
+int init_config(const char* path, config_reload_handler_t handler) {
+    static sigset_t signals;
+    pthread_t reload_tid;
+
+    reload_handler = handler;
+
+    if (path) {
+        strncpy(config_path, path, MAX_PATH_LEN - 1);
+        if (config_reload() != 0) {
+            return -1;
+        }
+    } else if (handler) {
+        handler(config_current());
+    }
+
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGHUP);
+    if (pthread_sigmask(SIG_BLOCK, &signals, NULL) != 0) {
+        printf("Error: Failed to block SIGHUP\n");
+        return -1;
+    }
+
+    if (pthread_create(&reload_tid, NULL, config_reload_thread, &signals) != 0) {
+        printf("Error: Failed to start config reload thread\n");
+        return -1;
+    }
+
+    pthread_detach(reload_tid);
+    return 0;
+}
@@ -0,0 +1,477 @@
+#include "../include/control.h"
+#include <poll.h>
+#include <stdarg.h>
+#include <fcntl.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+
+// One connected control client. Requests are handled in arrival order and
+// replies queued in the same order, so a client may pipeline as many requests
+// as it likes; a deferred request holds back the ones behind it.
+typedef struct {
+    int fd;
+    char* in;                       // Received bytes not yet handled
+    size_t in_length;
+    char* out;                      // Reply frames not yet sent
+    size_t out_length;
+    size_t out_sent;
+    size_t out_capacity;
+    int pending;                    // Head request was deferred by the handler
+    void* context;                  // Handler state kept for the deferred request
+    int closing;                    // Peer finished sending; drop once replies are out
+    struct timespec pending_since;
+} control_client_t;
+
+static control_client_t clients[CONTROL_MAX_CLIENTS];
+static int client_count = 0;
+static int unix_fd = -1;
+static int tcp_fd = -1;
+static int wake_fds[2] = { -1, -1 };            // Self-pipe that makes deferred requests retry now
+static char unix_path[MAX_PATH_LEN] = "";
+static control_handler_t control_handler = NULL;
+static control_release_t control_release = NULL;
+static control_reply_t scratch;                  // Reply being built, control thread only
+static char request_buffer[CONTROL_MAX_REQUEST + 1];
+static volatile int control_running = 0;
+
+// Append formatted text to a reply, growing it up to CONTROL_MAX_REPLY
+void control_reply(control_reply_t* reply, const char* format, ...) {
+    va_list args;
+
+    if (reply->capacity == 0) {
+        reply->data = malloc(4096);
+        if (!reply->data) {
+            reply->truncated = 1;
+            return;
+        }
+        reply->capacity = 4096;
+        reply->length = 0;
+    }
+
+    while (!reply->truncated) {
+        size_t room = reply->capacity - reply->length;
+
+        va_start(args, format);
+        int written = vsnprintf(reply->data + reply->length, room, format, args);
+        va_end(args);
+
+        if (written < 0) return;
+        if ((size_t)written < room) {
+            reply->length += written;
+            return;
+        }
+
+        size_t needed = reply->length + written + 1;
+        if (needed > CONTROL_MAX_REPLY) {
+            reply->data[reply->length] = '\0';
+            reply->truncated = 1;
+            return;
+        }
+
+        size_t capacity = reply->capacity * 2;
+        while (capacity < needed) capacity *= 2;
+        if (capacity > CONTROL_MAX_REPLY) capacity = CONTROL_MAX_REPLY;
+
+        char* grown = realloc(reply->data, capacity);
+        if (!grown) {
+            reply->data[reply->length] = '\0';
+            reply->truncated = 1;
+            return;
+        }
+        reply->data = grown;
+        reply->capacity = capacity;
+    }
+}
+
+// Milliseconds between two monotonic timestamps
+static int elapsed_ms(const struct timespec* since, const struct timespec* now) {
+    return (int)((now->tv_sec - since->tv_sec) * 1000 + (now->tv_nsec - since->tv_nsec) / 1000000);
+}
+
+// Make a socket non-blocking
+static int set_nonblocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags < 0) return -1;
+    return fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+// Queue one length-prefixed reply frame for a client
+static int queue_reply(control_client_t* client, const char* data, size_t length) {
+    size_t needed = client->out_length + sizeof(uint32_t) + length;
+
+    if (needed > client->out_capacity) {
+        size_t capacity = client->out_capacity ? client->out_capacity : 4096;
+        while (capacity < needed) capacity *= 2;
+
+        char* grown = realloc(client->out, capacity);
+        if (!grown) return -1;
+        client->out = grown;
+        client->out_capacity = capacity;
+    }
+
+    uint32_t prefix = htonl((uint32_t)length);
+    memcpy(client->out + client->out_length, &prefix, sizeof(prefix));
+    memcpy(client->out + client->out_length + sizeof(prefix), data, length);
+    client->out_length = needed;
+    return 0;
+}
+
+// Send as much queued reply data as the socket takes, -1 if the client is gone
+static int flush_client(control_client_t* client) {
+    while (client->out_sent < client->out_length) {
+        ssize_t sent = send(client->fd, client->out + client->out_sent,
+                            client->out_length - client->out_sent, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        client->out_sent += sent;
+    }
+
+    if (client->out_sent == client->out_length) {
+        client->out_sent = 0;
+        client->out_length = 0;
+    }
+    return 0;
+}
+
+// Handle every complete request a client has sent, -1 if it must be dropped
+static int process_client(control_client_t* client) {
+    while (client->in_length >= sizeof(uint32_t) &&
+           client->out_length - client->out_sent < CONTROL_MAX_BACKLOG) {
+        uint32_t prefix;
+        memcpy(&prefix, client->in, sizeof(prefix));
+        size_t length = ntohl(prefix);
+
+        if (length > CONTROL_MAX_REQUEST) {
+            const char* error = "error request too large\n";
+            queue_reply(client, error, strlen(error));
+            flush_client(client);
+            return -1;
+        }
+        if (client->in_length < sizeof(uint32_t) + length) break;
+
+        memcpy(request_buffer, client->in + sizeof(uint32_t), length);
+        request_buffer[length] = '\0';
+
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        int elapsed = client->pending ? elapsed_ms(&client->pending_since, &now) : 0;
+
+        scratch.length = 0;
+        scratch.truncated = 0;
+
+        if (control_handler(request_buffer, elapsed, &client->context, &scratch) == CONTROL_PENDING) {
+            if (!client->pending) {
+                client->pending = 1;
+                client->pending_since = now;
+            }
+            break;
+        }
+        client->pending = 0;
+
+        // Mark a reply that hit CONTROL_MAX_REPLY with a final "truncated" line
+        const char* marker = "truncated\n";
+        if (scratch.truncated && scratch.capacity > strlen(marker)) {
+            size_t keep = scratch.capacity - strlen(marker) - 1;
+            if (scratch.length < keep) keep = scratch.length;
+            memcpy(scratch.data + keep, marker, strlen(marker) + 1);
+            scratch.length = keep + strlen(marker);
+        }
+        if (queue_reply(client, scratch.data, scratch.length) != 0) return -1;
+
+        size_t consumed = sizeof(uint32_t) + length;
+        memmove(client->in, client->in + consumed, client->in_length - consumed);
+        client->in_length -= consumed;
+    }
+
+    return 0;
+}
+
+// Read what a client sent, -1 on error
+static int read_client(control_client_t* client) {
+    size_t capacity = sizeof(uint32_t) + CONTROL_MAX_REQUEST;
+
+    while (client->in_length < capacity) {
+        ssize_t received = recv(client->fd, client->in + client->in_length,
+                                capacity - client->in_length, 0);
+        if (received == 0) {
+            client->closing = 1;
+            break;
+        }
+        if (received < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        client->in_length += received;
+    }
+    return 0;
+}
+
+// Take a new connection from a listener
+static void accept_client(int listen_fd) {
+    int fd = accept(listen_fd, NULL, NULL);
+    if (fd < 0) return;
+
+    if (client_count >= CONTROL_MAX_CLIENTS || set_nonblocking(fd) != 0) {
+        close(fd);
+        return;
+    }
+
+    control_client_t* client = &clients[client_count];
+    memset(client, 0, sizeof(control_client_t));
+    client->in = malloc(sizeof(uint32_t) + CONTROL_MAX_REQUEST);
+    if (!client->in) {
+        close(fd);
+        return;
+    }
+    client->fd = fd;
+    client_count++;
+}
+
+// Release a client slot
+static void drop_client(control_client_t* client) {
+    if (client->context && control_release) {
+        control_release(client->context);
+    }
+    client->context = NULL;
+    close(client->fd);
+    free(client->in);
+    free(client->out);
+    client->fd = -1;
+    client->in = NULL;
+    client->out = NULL;
+}
+
+// Event loop: one thread multiplexes the listeners and every client
+static void* control_thread(void* arg) {
+    struct pollfd fds[CONTROL_MAX_CLIENTS + 3];
+    (void)arg;
+
+    while (control_running) {
+        int count = 0;
+        int deferred = 0;
+
+        if (wake_fds[0] >= 0) {
+            fds[count].fd = wake_fds[0];
+            fds[count++].events = POLLIN;
+        }
+        int first_listener = count;
+        if (unix_fd >= 0) {
+            fds[count].fd = unix_fd;
+            fds[count++].events = POLLIN;
+        }
+        if (tcp_fd >= 0) {
+            fds[count].fd = tcp_fd;
+            fds[count++].events = POLLIN;
+        }
+        int first_client = count;
+
+        for (int i = 0; i < client_count; i++) {
+            control_client_t* client = &clients[i];
+            short events = 0;
+
+            // Stop reading from a client that is waiting on a deferred request,
+            // has a full buffer or does not collect its replies
+            if (!client->pending && !client->closing && client->in_length < sizeof(uint32_t) + CONTROL_MAX_REQUEST &&
+                client->out_length - client->out_sent < CONTROL_MAX_BACKLOG) {
+                events |= POLLIN;
+            }
+            if (client->out_length > client->out_sent) {
+                events |= POLLOUT;
+            }
+            deferred |= client->pending;
+
+            fds[count].fd = client->fd;
+            fds[count].events = events;
+            fds[count++].revents = 0;
+        }
+
+        int ready = poll(fds, count, deferred ? CONTROL_TICK_MS : 1000);
+        if (ready < 0) {
+            if (errno == EINTR) continue;
+            printf("Error: Control socket poll failed: %s\n", strerror(errno));
+            break;
+        }
+
+        if (first_listener > 0 && (fds[0].revents & POLLIN)) {
+            char drain[64];
+            while (read(wake_fds[0], drain, sizeof(drain)) > 0) continue;
+        }
+
+        for (int i = first_listener; i < first_client; i++) {
+            if (fds[i].revents & POLLIN) {
+                accept_client(fds[i].fd);
+            }
+        }
+
+        // Clients accepted above are not in fds yet and are served next round
+        for (int i = 0; i < count - first_client; i++) {
+            control_client_t* client = &clients[i];
+            short revents = fds[first_client + i].revents;
+            int failed = 0;
+
+            if ((revents & (POLLIN | POLLHUP | POLLERR)) && !client->closing) {
+                failed = read_client(client) != 0;
+            } else if (revents & (POLLHUP | POLLERR)) {
+                // Gone in both directions: nothing more can be answered, and
+                // poll would keep reporting it while a request is deferred
+                failed = 1;
+            }
+            if (!failed) {
+                failed = process_client(client) != 0;
+            }
+            if (!failed && client->out_length > client->out_sent) {
+                failed = flush_client(client) != 0;
+            }
+
+            // A client that hung up is done once every complete request it sent
+            // is answered; a partial request left behind is discarded
+            if (client->closing && !client->pending && client->out_length == 0) {
+                failed = 1;
+            }
+
+            if (failed) {
+                drop_client(client);
+            }
+        }
+
+        // Compact the client table
+        int kept = 0;
+        for (int i = 0; i < client_count; i++) {
+            if (clients[i].fd >= 0) {
+                if (kept != i) clients[kept] = clients[i];
+                kept++;
+            }
+        }
+        client_count = kept;
+    }
+
+    return NULL;
+}
+
+// Open a Unix socket only the owner can connect to
+static int open_unix_listener(const char* path) {
+    struct sockaddr_un address;
+
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        printf("Error: Control socket path %s is too long\n", path);
+        return -1;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, path);
+    unlink(path);
+
+    if (bind(fd, (struct sockaddr*)&address, sizeof(address)) < 0 ||
+        chmod(path, 0600) < 0 || listen(fd, 16) < 0 || set_nonblocking(fd) != 0) {
+        printf("Error: Failed to open control socket %s: %s\n", path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+// Open a TCP listener on the loopback interface
+static int open_tcp_listener(int port) {
+    struct sockaddr_in address;
+    int reuse = 1;
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(port);
+
+    if (bind(fd, (struct sockaddr*)&address, sizeof(address)) < 0 ||
+        listen(fd, 16) < 0 || set_nonblocking(fd) != 0) {
+        printf("Error: Failed to open control port %d: %s\n", port, strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+// Open the control listeners and start the event loop; either may be disabled
+// with an empty path or port 0
+int init_control(const char* socket_path, int port, control_handler_t handler,
+                 control_release_t release) {
+    pthread_t tid;
+
+    if (!handler) return -1;
+    if ((!socket_path || !*socket_path) && port <= 0) return 0;
+
+    control_handler = handler;
+    control_release = release;
+
+    if (socket_path && *socket_path) {
+        unix_fd = open_unix_listener(socket_path);
+        if (unix_fd < 0) return -1;
+        strncpy(unix_path, socket_path, MAX_PATH_LEN - 1);
+    }
+
+    if (port > 0) {
+        tcp_fd = open_tcp_listener(port);
+        if (tcp_fd < 0) {
+            close_control();
+            return -1;
+        }
+    }
+
+    // Without the wake-up pipe deferred requests are still retried every tick
+    if (pipe(wake_fds) != 0 || set_nonblocking(wake_fds[0]) != 0 || set_nonblocking(wake_fds[1]) != 0) {
+        printf("Warning: Control wake-up pipe unavailable: %s\n", strerror(errno));
+        if (wake_fds[0] >= 0) close(wake_fds[0]);
+        if (wake_fds[1] >= 0) close(wake_fds[1]);
+        wake_fds[0] = wake_fds[1] = -1;
+    }
+
+    control_running = 1;
+    if (pthread_create(&tid, NULL, control_thread, NULL) != 0) {
+        printf("Error: Failed to start control thread\n");
+        control_running = 0;
+        close_control();
+        return -1;
+    }
+    pthread_detach(tid);
+
+    if (unix_fd >= 0) printf("Control socket listening on %s\n", unix_path);
+    if (tcp_fd >= 0) printf("Control port listening on 127.0.0.1:%d\n", port);
+    return 0;
+}
+
+// Retry deferred requests now instead of at the next tick; callable from any thread
+void control_wake(void) {
+    char byte = 1;
+    if (wake_fds[1] >= 0) {
+        // A full pipe already has a wake-up pending, so a failed write is fine
+        ssize_t written = write(wake_fds[1], &byte, 1);
+        (void)written;
+    }
+}
+
+// Stop accepting control connections and remove the socket file
+void close_control(void) {
+    control_running = 0;
+
+    if (unix_fd >= 0) {
+        close(unix_fd);
+        unix_fd = -1;
+        unlink(unix_path);
+    }
+    if (tcp_fd >= 0) {
+        close(tcp_fd);
+        tcp_fd = -1;
+    }
+}
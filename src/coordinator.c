@@ -1,77 +1,927 @@
 #include "../include/distributed_lxc.h"
 #include "../include/yaml_parser.h"
 #include "../include/lxc_manager.h"
+#include "../include/operations.h"
+#include "../include/scheduler.h"
+#include "../include/config.h"
+#include "../include/wal.h"
+#include "../include/raft.h"
+#include "../include/reconciler.h"
+#include "../include/inventory.h"
+#include "../include/control.h"
+#include "../include/metrics.h"
+#include "../include/rollout.h"
+#include "../include/migration.h"
+#include "../include/rebalancer.h"
+#include "../include/preemption.h"
+#include "../include/tenants.h"
+#include "../include/events.h"
+#include "../include/spec_cache.h"
+#include "../include/command_pool.h"
+#include "../include/admission.h"
 
 // External declarations from network.c
 extern node_t* find_node_by_id(const char* node_id);
-extern int register_node(const char* node_id, const char* hostname, const char* ip_address, int port);
+extern int register_node(const char* node_id, const char* hostname, const char* ip_address, int port,
+                         const char* labels);
+extern int restore_node(const char* node_id, const char* hostname, const char* ip_address, int port,
+                        const char* labels);
+extern void cleanup_network_resources(void);
+extern void disconnect_nodes(void);
+extern void reset_nodes(void);
+extern node_t nodes[];
+extern int node_count;
+extern pthread_mutex_t nodes_mutex;
+extern void lock_nodes(void);
 
 // Global coordinator state
 static container_t deployed_containers[MAX_CONTAINERS];
 static int deployed_container_count = 0;
 static pthread_mutex_t containers_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int containers_lock_wait = -1;
 
-// Find best node for container deployment based on resources
-node_t* find_best_node(const lxc_config_t* config) {
-    if (!config) return NULL;
+// Take containers_mutex, recording how long it took
+static void lock_containers(void) {
+    metrics_lock(&containers_mutex, containers_lock_wait);
+}
+
+// Find a deployed container by id (caller holds containers_mutex)
+static container_t* find_container_locked(const char* container_id) {
+    for (int i = 0; i < deployed_container_count; i++) {
+        if (strcmp(deployed_containers[i].id, container_id) == 0) {
+            return &deployed_containers[i];
+        }
+    }
+    return NULL;
+}
+
+// Human readable container state
+static const char* container_state_name(container_state_t state) {
+    switch (state) {
+        case CONTAINER_STOPPED:  return "STOPPED";
+        case CONTAINER_STARTING: return "STARTING";
+        case CONTAINER_RUNNING:  return "RUNNING";
+        case CONTAINER_STOPPING: return "STOPPING";
+        case CONTAINER_ERROR:    return "ERROR";
+        default:                 return "UNKNOWN";
+    }
+}
+
+// Short name of a node state
+static const char* node_state_name(node_state_t state) {
+    switch (state) {
+        case NODE_DISCONNECTED: return "DISC";
+        case NODE_CONNECTING:   return "CONN";
+        case NODE_CONNECTED:    return "UP";
+        case NODE_BUSY:         return "BUSY";
+        case NODE_ERROR:        return "ERROR";
+        default:                return "UNK";
+    }
+}
+
+// Tell event subscribers about a container change (caller holds containers_mutex)
+static void publish_container_event(const container_t* container, const char* action) {
+    events_publish(EVENT_CONTAINER, action, container->id, container->name, container->node_id,
+                   container_state_name(container->state),
+                   container_state_name(container->desired_state));
+}
+
+// Record a state change in the local log or, in a cluster, propose it to the
+// other coordinators. Returns the position to wait for, 0 if nothing was logged.
+static unsigned long log_state_change(wal_record_type_t type, const void* data, size_t length) {
+    if (raft_enabled()) {
+        return raft_propose(type, data, length);
+    }
+    return wal_append(type, data, length);
+}
+
+// Wait until a logged change is durable, on a quorum of coordinators in a cluster
+static int sync_state_change(unsigned long position) {
+    if (raft_enabled()) {
+        return raft_wait_commit(position, RAFT_COMMIT_TIMEOUT_MS);
+    }
+    return wal_sync(position);
+}
+
+// Only the leader changes cluster state; tell the user where to go otherwise
+static int accept_state_change(void) {
+    if (!raft_enabled() || raft_is_leader()) return 1;
+    
+    char leader_ip[INET_ADDRSTRLEN];
+    int leader_port;
+    if (raft_leader_address(leader_ip, &leader_port) == 0) {
+        printf("Error: Not the leader, send changes to the coordinator at %s:%d\n",
+               leader_ip, leader_port);
+    } else {
+        printf("Error: Not the leader and no leader is elected yet\n");
+    }
+    return 0;
+}
+
+// Record a container's current state in the log (caller holds containers_mutex)
+static unsigned long log_container_locked(const container_t* container) {
+    return log_state_change(WAL_CONTAINER_PUT, container, sizeof(container_t));
+}
+
+// Set container state in the registry and in its node's copy, returns the log
+// sequence number of the change (caller holds containers_mutex)
+static unsigned long set_container_state_locked(container_t* container, container_state_t state) {
+    container->state = state;
+    publish_container_event(container, "state");
+    
+    node_t* node = find_node_by_id(container->node_id);
+    if (node) {
+        lock_nodes();
+        for (int i = 0; i < node->container_count; i++) {
+            if (strcmp(node->containers[i].id, container->id) == 0) {
+                node->containers[i].state = state;
+                break;
+            }
+        }
+        pthread_mutex_unlock(&nodes_mutex);
+    }
+    
+    return log_container_locked(container);
+}
+
+// Add a container to a node's list, taking nodes_mutex after containers_mutex
+// (caller holds containers_mutex)
+static void append_node_container_locked(node_t* node, const container_t* container) {
+    lock_nodes();
+    if (node->container_count < MAX_CONTAINERS) {
+        node->containers[node->container_count++] = *container;
+    }
+    pthread_mutex_unlock(&nodes_mutex);
+}
+
+// Drop a container from a node's list (caller holds containers_mutex)
+static void remove_node_container_locked(node_t* node, const char* container_id) {
+    lock_nodes();
+    for (int i = 0; i < node->container_count; i++) {
+        if (strcmp(node->containers[i].id, container_id) == 0) {
+            // Shift remaining containers
+            for (int j = i; j < node->container_count - 1; j++) {
+                node->containers[j] = node->containers[j + 1];
+            }
+            node->container_count--;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&nodes_mutex);
+}
+
+// Remove a container from the registry and its node (caller holds containers_mutex)
+static void remove_container_locked(const char* container_id) {
+    int container_index = -1;
+    for (int i = 0; i < deployed_container_count; i++) {
+        if (strcmp(deployed_containers[i].id, container_id) == 0) {
+            container_index = i;
+            break;
+        }
+    }
+    
+    if (container_index == -1) return;
+    publish_container_event(&deployed_containers[container_index], "removed");
     
-    node_t* best_node = NULL;
-    double best_score = -1.0;
-    time_t current_time = time(NULL);
+    node_t* node = find_node_by_id(deployed_containers[container_index].node_id);
+    if (node) {
+        remove_node_container_locked(node, container_id);
+        scheduler_release(node, &deployed_containers[container_index].config);
+    }
+    tenant_release(&deployed_containers[container_index].config);
     
-    extern node_t nodes[];
-    extern int node_count;
-    extern pthread_mutex_t nodes_mutex;
+    // Remove from deployed containers list
+    for (int i = container_index; i < deployed_container_count - 1; i++) {
+        deployed_containers[i] = deployed_containers[i + 1];
+    }
+    deployed_container_count--;
+    
+    log_state_change(WAL_CONTAINER_DELETE, container_id, strlen(container_id) + 1);
+}
+
+// Re-home a migrated container: it leaves its old node's list and allocation
+// and takes its new id on the target (caller holds containers_mutex)
+static void apply_container_move_locked(const wal_container_move_t* move) {
+    container_t* container = find_container_locked(move->old_id);
+    if (!container) return;
+    
+    node_t* source = find_node_by_id(container->node_id);
+    if (source) {
+        remove_node_container_locked(source, move->old_id);
+        scheduler_release(source, &container->config);
+    }
+    
+    *container = move->container;
+    
+    node_t* target = find_node_by_id(container->node_id);
+    if (target) {
+        append_node_container_locked(target, container);
+        scheduler_commit(target, &container->config);
+    }
+    publish_container_event(container, "moved");
+}
+
+// Move a container the target worker imported and log it; worker_state is the
+// target's ACK text. Returns the log position (caller holds containers_mutex)
+static unsigned long move_container_locked(container_t* container, const char* node_id,
+                                           const char* worker_state) {
+    wal_container_move_t move;
+    memset(&move, 0, sizeof(move));
+    strcpy(move.old_id, container->id);
+    move.container = *container;
+    snprintf(move.container.id, sizeof(move.container.id), "%.127s_%.127s",
+             node_id, container->name);
+    strcpy(move.container.node_id, node_id);
+    move.container.state = (strcmp(worker_state, "running") == 0) ? CONTAINER_RUNNING
+                                                                  : CONTAINER_STOPPED;
+    if (move.container.state == CONTAINER_RUNNING) {
+        move.container.started_at = time(NULL);
+    }
+    
+    apply_container_move_locked(&move);
+    reconciler_mark_dirty(move.container.id);
+    
+    printf("Container %s migrated to node %s as %s\n", move.old_id, node_id, move.container.id);
+    return log_state_change(WAL_CONTAINER_MOVE, &move, sizeof(move));
+}
+
+// Insert or replace a container recovered from the state log
+static void restore_container(container_t* restored) {
+    // Heap pointers from the previous process are meaningless here
+    restored->config.environment_vars = NULL;
+    restored->config.mount_points = NULL;
+    restored->config.network_config = NULL;
     
-    pthread_mutex_lock(&nodes_mutex);
+    lock_containers();
     
+    node_t* node = find_node_by_id(restored->node_id);
+    container_t* container = find_container_locked(restored->id);
+    
+    if (container) {
+        *container = *restored;
+        if (node) {
+            lock_nodes();
+            for (int i = 0; i < node->container_count; i++) {
+                if (strcmp(node->containers[i].id, restored->id) == 0) {
+                    node->containers[i] = *restored;
+                    break;
+                }
+            }
+            pthread_mutex_unlock(&nodes_mutex);
+        }
+    } else if (deployed_container_count < MAX_CONTAINERS) {
+        deployed_containers[deployed_container_count++] = *restored;
+        tenant_charge(&restored->config);
+        if (node) {
+            append_node_container_locked(node, restored);
+            scheduler_commit(node, &restored->config);
+        }
+    } else {
+        printf("Warning: Dropping recovered container %s, registry is full\n", restored->id);
+        pthread_mutex_unlock(&containers_mutex);
+        return;
+    }
+    publish_container_event(restored, container ? "state" : "added");
+    
+    pthread_mutex_unlock(&containers_mutex);
+}
+
+// Apply one record from the snapshot or log during recovery, or a committed
+// entry from the cluster leader
+static void replay_state_record(const wal_entry_t* entry) {
+    const void* data = entry->data;
+    size_t length = entry->length;
+    
+    switch (entry->type) {
+        case WAL_NODE_PUT:
+            if (length == sizeof(wal_node_t)) {
+                wal_node_t node;
+                memcpy(&node, data, sizeof(node));
+                restore_node(node.id, node.hostname, node.ip_address, node.port, node.labels);
+            }
+            break;
+            
+        case WAL_CONTAINER_PUT:
+            if (length == sizeof(container_t)) {
+                container_t container;
+                memcpy(&container, data, sizeof(container));
+                restore_container(&container);
+            }
+            break;
+            
+        case WAL_CONTAINER_DELETE:
+            if (length > 0 && ((const char*)data)[length - 1] == '\0') {
+                lock_containers();
+                remove_container_locked((const char*)data);
+                pthread_mutex_unlock(&containers_mutex);
+            }
+            break;
+            
+        case WAL_CONTAINER_MOVE:
+            if (length == sizeof(wal_container_move_t)) {
+                wal_container_move_t move;
+                memcpy(&move, data, sizeof(move));
+                move.container.config.environment_vars = NULL;
+                move.container.config.mount_points = NULL;
+                move.container.config.network_config = NULL;
+                
+                lock_containers();
+                apply_container_move_locked(&move);
+                pthread_mutex_unlock(&containers_mutex);
+            }
+            break;
+            
+        case WAL_NOOP:
+            break;
+            
+        default:
+            printf("Warning: Skipping unknown state record type %d\n", entry->type);
+            break;
+    }
+}
+
+// Operations in flight when the coordinator stopped are lost, so containers
+// left mid-transition have an unknown state
+static void settle_recovered_containers(void) {
+    int unsettled = 0;
+    
+    lock_containers();
+    for (int i = 0; i < deployed_container_count; i++) {
+        container_t* container = &deployed_containers[i];
+        if (container->state == CONTAINER_STARTING || container->state == CONTAINER_STOPPING) {
+            set_container_state_locked(container, CONTAINER_ERROR);
+            unsettled++;
+        }
+        
+        // Nothing has been compared against the workers since recovery
+        reconciler_mark_dirty(container->id);
+    }
+    int total = deployed_container_count;
+    pthread_mutex_unlock(&containers_mutex);
+    
+    printf("Recovered %d container(s), %d marked ERROR after interrupted operations\n",
+           total, unsettled);
+}
+
+// Drop all registry state before it is rebuilt from a snapshot
+static void reset_state(void) {
+    lock_containers();
+    deployed_container_count = 0;
+    reset_nodes();
+    tenants_reset();
+    pthread_mutex_unlock(&containers_mutex);
+}
+
+// Write a snapshot of the node and container registries
+static void checkpoint_state(void) {
+    unsigned long lsn = 0;
+    unsigned long term = 0;
+    
+    lock_containers();
+    
+    // The snapshot must cover exactly the entries the registries reflect
+    if (raft_enabled()) {
+        if (raft_snapshot_point(&lsn, &term) != 0) {
+            pthread_mutex_unlock(&containers_mutex);
+            return;
+        }
+    } else {
+        lsn = wal_last_lsn();
+    }
+    
+    wal_snapshot_t* snapshot = wal_snapshot_begin(lsn, term);
+    if (!snapshot) {
+        pthread_mutex_unlock(&containers_mutex);
+        return;
+    }
+    
+    lock_nodes();
     for (int i = 0; i < node_count; i++) {
-        node_t* node = &nodes[i];
+        wal_node_t record;
+        memset(&record, 0, sizeof(record));
+        strcpy(record.id, nodes[i].id);
+        strcpy(record.hostname, nodes[i].hostname);
+        strcpy(record.ip_address, nodes[i].ip_address);
+        record.port = nodes[i].port;
+        strcpy(record.labels, nodes[i].labels);
+        wal_snapshot_add(snapshot, WAL_NODE_PUT, &record, sizeof(record));
+    }
+    pthread_mutex_unlock(&nodes_mutex);
+    
+    for (int i = 0; i < deployed_container_count; i++) {
+        wal_snapshot_add(snapshot, WAL_CONTAINER_PUT, &deployed_containers[i], sizeof(container_t));
+    }
+    
+    pthread_mutex_unlock(&containers_mutex);
+    
+    if (wal_snapshot_commit(snapshot) == 0 && raft_enabled()) {
+        raft_compact(lsn, term);
+    }
+}
+
+// Record a node's registration in the log
+static void log_node(const char* node_id) {
+    wal_node_t record;
+    int found = 0;
+    
+    memset(&record, 0, sizeof(record));
+    
+    lock_nodes();
+    for (int i = 0; i < node_count; i++) {
+        if (strcmp(nodes[i].id, node_id) == 0) {
+            strcpy(record.id, nodes[i].id);
+            strcpy(record.hostname, nodes[i].hostname);
+            strcpy(record.ip_address, nodes[i].ip_address);
+            record.port = nodes[i].port;
+            strcpy(record.labels, nodes[i].labels);
+            found = 1;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&nodes_mutex);
+    
+    if (found) {
+        log_state_change(WAL_NODE_PUT, &record, sizeof(record));
+    }
+}
+
+// Reconcile the container registry with the outcome of a finished operation
+static void apply_operation_result(const operation_t* op) {
+    int succeeded = (op->state == OP_SUCCEEDED);
+    unsigned long move_lsn = 0;
+    char source_id[MAX_NAME_LEN];
+    char name[MAX_NAME_LEN];
+    
+    if (op->type == OP_DEPLOY || op->type == OP_MIGRATE) {
+        scheduler_settle_reservation(op->id, succeeded);
+    }
+    
+    // A coordinator that lost leadership leaves the registry to the new leader
+    if (raft_enabled() && !raft_is_leader()) {
+        return;
+    }
+    
+    lock_containers();
+    
+    container_t* container = find_container_locked(op->container_id);
+    if (!container) {
+        pthread_mutex_unlock(&containers_mutex);
+        return;
+    }
+    
+    switch (op->type) {
+        case OP_DEPLOY:
+            if (succeeded) {
+                // Workers create containers in the stopped state
+                set_container_state_locked(container, CONTAINER_STOPPED);
+            } else if (op->state == OP_FAILED) {
+                // The worker never created it, so drop it and free its request
+                remove_container_locked(op->container_id);
+            } else {
+                // Timed out: the worker may still be creating it
+                set_container_state_locked(container, CONTAINER_ERROR);
+            }
+            break;
+        case OP_START:
+            if (succeeded) {
+                container->started_at = time(NULL);
+            }
+            set_container_state_locked(container, succeeded ? CONTAINER_RUNNING : CONTAINER_ERROR);
+            break;
+        case OP_STOP:
+            set_container_state_locked(container, succeeded ? CONTAINER_STOPPED : CONTAINER_ERROR);
+            break;
+        case OP_DELETE:
+            if (succeeded) {
+                remove_container_locked(op->container_id);
+            } else {
+                set_container_state_locked(container, CONTAINER_ERROR);
+            }
+            break;
+        case OP_MIGRATE:
+            if (succeeded) {
+                strcpy(source_id, container->node_id);
+                strcpy(name, container->name);
+                move_lsn = move_container_locked(container, op->node_id, op->result);
+            } else {
+                // The source still holds a stopped copy, the reconciler restores it
+                set_container_state_locked(container, CONTAINER_ERROR);
+            }
+            break;
+    }
+    
+    pthread_mutex_unlock(&containers_mutex);
+    
+    // The source's copy goes only once the move is durable
+    if (move_lsn > 0 && sync_state_change(move_lsn) == 0) {
+        node_t* source = find_node_by_id(source_id);
+        if (source && source->state == NODE_CONNECTED) {
+            message_t msg;
+            create_message(&msg, MSG_DELETE_CONTAINER, "coordinator", source->id,
+                           name, strlen(name));
+            send_message(source->socket_fd, &msg);
+        }
+    }
+    
+    if (op->type == OP_DELETE) {
+        preemption_evicted(op->container_id, succeeded);
+    }
+    reconciler_mark_dirty(op->container_id);
+    rollout_notify();
+    
+    if (!succeeded) {
+        printf("Operation %d (%s %s) %s: %s\n", op->id, operation_type_name(op->type),
+               op->container_id, operation_state_name(op->state), op->result);
+    }
+}
+
+// Mark every container placed on a node for reconciliation
+static void mark_node_containers_dirty(const char* node_id) {
+    lock_containers();
+    for (int i = 0; i < deployed_container_count; i++) {
+        if (strcmp(deployed_containers[i].node_id, node_id) == 0) {
+            reconciler_mark_dirty(deployed_containers[i].id);
+        }
+    }
+    pthread_mutex_unlock(&containers_mutex);
+}
+
+// Take a state a worker observed into the registry, returns 1 if it changed
+// (caller holds containers_mutex)
+static int observe_container_state_locked(container_t* container, container_state_t observed) {
+    // An operation in flight owns the state until it completes
+    if (container->state == CONTAINER_STARTING || container->state == CONTAINER_STOPPING ||
+        container->state == observed) {
+        return 0;
+    }
+    
+    set_container_state_locked(container, observed);
+    return 1;
+}
+
+// Record a state change a worker observed outside of any command
+static void apply_container_report(const container_t* report) {
+    char container_id[MAX_NAME_LEN];
+    
+    lock_containers();
+    
+    container_t* container = find_container_locked(report->id);
+    if (!container || (raft_enabled() && !raft_is_leader())) {
+        pthread_mutex_unlock(&containers_mutex);
+        return;
+    }
+    
+    strcpy(container_id, container->id);
+    int changed = observe_container_state_locked(container, report->state);
+    
+    pthread_mutex_unlock(&containers_mutex);
+    
+    if (changed) {
+        reconciler_mark_dirty(container_id);
+    }
+}
+
+// Hash the registry's view of a node's containers (caller holds containers_mutex)
+static void build_node_inventory_locked(const char* node_id, inventory_tree_t* tree) {
+    inventory_reset(tree);
+    for (int i = 0; i < deployed_container_count; i++) {
+        if (strcmp(deployed_containers[i].node_id, node_id) == 0) {
+            inventory_add(tree, deployed_containers[i].name, deployed_containers[i].state);
+        }
+    }
+}
+
+// Send one inventory sync step to a node
+static void request_inventory(const char* node_id, inventory_step_t step,
+                              const uint16_t* indices, int count) {
+    inventory_request_t request;
+    message_t msg;
+    
+    memset(&request, 0, sizeof(request));
+    request.step = (uint16_t)step;
+    request.count = (uint16_t)count;
+    if (count > 0) {
+        memcpy(request.indices, indices, count * sizeof(uint16_t));
+    }
+    
+    node_t* node = find_node_by_id(node_id);
+    if (!node || node->socket_fd < 0) return;
+    
+    create_message(&msg, MSG_INVENTORY_SYNC, "coordinator", node_id, &request,
+                   (int)(offsetof(inventory_request_t, indices) + count * sizeof(uint16_t)));
+    send_message(node->socket_fd, &msg);
+}
+
+// Compare the containers a worker reported for some leaves with the registry
+// and queue the ones that changed; returns the number of differences (caller
+// holds containers_mutex)
+static int compare_inventory_items_locked(const char* node_id, const char* data, size_t size,
+                                          const inventory_reply_t* reply) {
+    static unsigned char seen[MAX_CONTAINERS];
+    unsigned char wanted[INVENTORY_LEAVES] = {0};
+    int differences = 0;
+    
+    if (size < reply->count * sizeof(uint16_t)) return 0;
+    for (int i = 0; i < reply->count; i++) {
+        uint16_t leaf;
+        memcpy(&leaf, data + i * sizeof(uint16_t), sizeof(leaf));
+        if (leaf < INVENTORY_LEAVES) wanted[leaf] = 1;
+    }
+    data += reply->count * sizeof(uint16_t);
+    size -= reply->count * sizeof(uint16_t);
+    
+    memset(seen, 0, deployed_container_count);
+    
+    for (int i = 0; i < reply->item_count; i++) {
+        char name[MAX_NAME_LEN];
+        container_state_t state;
+        int leaf;
         
-        // Skip disconnected or unresponsive nodes
-        if (node->state != NODE_CONNECTED || 
-            (current_time - node->last_heartbeat) > 30) {
-            continue;
+        size_t used = inventory_read_item(data, size, &leaf, name, &state);
+        if (used == 0) break;
+        data += used;
+        size -= used;
+        
+        int index = -1;
+        for (int j = 0; j < deployed_container_count; j++) {
+            if (strcmp(deployed_containers[j].node_id, node_id) == 0 &&
+                strcmp(deployed_containers[j].name, name) == 0) {
+                index = j;
+                break;
+            }
         }
         
-        // Check if node has capacity
-        if (node->container_count >= node->resources.max_containers) {
+        if (index < 0) {
+            printf("Warning: Node %s runs container %s that is not in the registry\n", node_id, name);
+            differences++;
             continue;
         }
         
-        // Calculate node score based on available resources
-        double cpu_available = 100.0 - node->resources.cpu_usage;
-        double memory_available = 100.0 - node->resources.memory_usage;
-        double disk_available = 100.0 - node->resources.disk_usage;
-        double container_load = (double)node->container_count / node->resources.max_containers;
-        
-        // Weighted scoring (CPU: 30%, Memory: 30%, Disk: 20%, Load: 20%)
-        double score = (cpu_available * 0.3 + 
-                       memory_available * 0.3 + 
-                       disk_available * 0.2 + 
-                       (1.0 - container_load) * 100.0 * 0.2);
+        seen[index] = 1;
+        container_t* container = &deployed_containers[index];
+        if (container->state != state) {
+            differences++;
+            if (observe_container_state_locked(container, state)) {
+                reconciler_mark_dirty(container->id);
+            }
+        }
+    }
+    
+    // Registered containers the worker did not list in a leaf it covered are gone
+    for (int i = 0; i < deployed_container_count; i++) {
+        container_t* container = &deployed_containers[i];
+        if (seen[i] || strcmp(container->node_id, node_id) != 0 ||
+            !wanted[inventory_leaf_of(container->name)]) {
+            continue;
+        }
         
-        if (score > best_score) {
-            best_score = score;
-            best_node = node;
+        differences++;
+        if (observe_container_state_locked(container, CONTAINER_ERROR)) {
+            printf("Warning: Container %s is missing from node %s\n", container->id, node_id);
+            reconciler_mark_dirty(container->id);
         }
     }
     
-    pthread_mutex_unlock(&nodes_mutex);
-    
-    if (best_node) {
-        printf("Selected node %s (score: %.2f) for container %s\n", 
-               best_node->id, best_score, config->name);
-    } else {
-        printf("No suitable node found for container %s\n", config->name);
+    return differences;
+}
+
+// Drill one level further into the parts of a worker's inventory that differ
+// from the registry: root -> branches -> leaves -> containers
+static void handle_inventory_reply(const message_t* msg) {
+    inventory_tree_t tree;
+    inventory_reply_t reply;
+    uint16_t indices[INVENTORY_LEAVES];
+    int count = 0;
+    int differences = 0;
+    int settled = 0;
+    
+    if (msg->data_length < (int)sizeof(inventory_reply_t)) return;
+    if (raft_enabled() && !raft_is_leader()) return;
+    memcpy(&reply, msg->data, sizeof(reply));
+    
+    const char* body = msg->data + sizeof(inventory_reply_t);
+    size_t body_size = msg->data_length - sizeof(inventory_reply_t);
+    
+    lock_containers();
+    
+    build_node_inventory_locked(msg->sender_id, &tree);
+    
+    switch (reply.step) {
+        case INVENTORY_ROOT:
+            if (reply.root == tree.root) {
+                printf("Inventory of node %s matches the registry (%d containers)\n",
+                       msg->sender_id, reply.count);
+                settled = 1;
+                break;
+            }
+            for (int i = 0; i < INVENTORY_FANOUT; i++) {
+                if (reply.branches[i] != tree.branches[i]) {
+                    indices[count++] = (uint16_t)i;
+                }
+            }
+            break;
+            
+        case INVENTORY_BRANCHES: {
+            // Each branch may appear once, so at most INVENTORY_LEAVES leaves differ
+            int seen[INVENTORY_FANOUT] = {0};
+            int malformed = 0;
+            
+            for (int i = 0; i < reply.count && (i + 1) * sizeof(inventory_branch_t) <= body_size; i++) {
+                inventory_branch_t branch;
+                memcpy(&branch, body + i * sizeof(inventory_branch_t), sizeof(branch));
+                if (branch.branch >= INVENTORY_FANOUT || seen[branch.branch]) {
+                    malformed = 1;
+                    break;
+                }
+                seen[branch.branch] = 1;
+                
+                for (int j = 0; j < INVENTORY_FANOUT && count < INVENTORY_LEAVES; j++) {
+                    int leaf = branch.branch * INVENTORY_FANOUT + j;
+                    if (branch.leaves[j] != tree.leaves[leaf]) {
+                        indices[count++] = (uint16_t)leaf;
+                    }
+                }
+            }
+            
+            if (malformed) {
+                printf("Error: Node %s sent an invalid inventory branch list\n", msg->sender_id);
+                pthread_mutex_unlock(&containers_mutex);
+                return;
+            }
+            break;
+        }
+            
+        case INVENTORY_ITEMS:
+            differences = compare_inventory_items_locked(msg->sender_id, body, body_size, &reply);
+            if (differences > 0) {
+                printf("Inventory sync with node %s: %d container(s) differed\n",
+                       msg->sender_id, differences);
+            }
+            settled = reply.last;
+            break;
+            
+        default:
+            break;
+    }
+    
+    pthread_mutex_unlock(&containers_mutex);
+    
+    if (count > 0) {
+        request_inventory(msg->sender_id, reply.step + 1, indices, count);
+    } else if (reply.step != INVENTORY_ITEMS) {
+        settled = 1;
+    }
+    
+    if (settled) {
+        mark_node_containers_dirty(msg->sender_id);
+    }
+}
+
+// The source worker staged a migration export: point the target at it. The
+// rootfs then flows worker to worker without passing through here.
+static void handle_migration_offer(const message_t* msg) {
+    operation_t op;
+    migration_import_t request;
+    
+    if (msg->data_length < (int)sizeof(migration_offer_t) ||
+        operation_get(msg->operation_id, &op) != 0 ||
+        op.type != OP_MIGRATE || operation_is_terminal(op.state)) {
+        return;
+    }
+    
+    const migration_offer_t* offer = (const migration_offer_t*)msg->data;
+    memset(&request, 0, sizeof(request));
+    
+    lock_containers();
+    container_t* container = find_container_locked(op.container_id);
+    if (!container || strcmp(container->node_id, msg->sender_id) != 0) {
+        pthread_mutex_unlock(&containers_mutex);
+        operation_complete(op.id, OP_FAILED, "container changed during migration");
+        return;
+    }
+    request.config = container->config;
+    request.start = (container->desired_state == CONTAINER_RUNNING);
+    pthread_mutex_unlock(&containers_mutex);
+    
+    node_t* source = find_node_by_id(msg->sender_id);
+    node_t* target = find_node_by_id(op.node_id);
+    if (!source || !target || target->state != NODE_CONNECTED) {
+        operation_complete(op.id, OP_FAILED, "target node unavailable");
+        return;
+    }
+    
+    strcpy(request.source_ip, source->ip_address);
+    request.source_port = offer->port;
+    request.size = offer->size;
+    memcpy(request.token, offer->token, sizeof(request.token));
+    request.token[MIGRATION_TOKEN_LEN - 1] = '\0';
+    
+    message_t import;
+    create_message(&import, MSG_MIGRATE_IMPORT, "coordinator", target->id,
+                   &request, sizeof(request));
+    import.operation_id = op.id;
+    if (send_message(target->socket_fd, &import) != 0) {
+        operation_complete(op.id, OP_FAILED, "send failed");
+        return;
+    }
+    
+    printf("Migration %d: %s (%lld bytes) moving from %s to %s\n", op.id, op.container_id,
+           offer->size, source->id, target->id);
+}
+
+// Tell event subscribers a worker's connection closed
+static void handle_worker_disconnect(const char* node_id) {
+    events_publish(EVENT_NODE, "down", node_id, NULL, node_id,
+                   node_state_name(NODE_DISCONNECTED), NULL);
+}
+
+// Handle registrations, heartbeats and worker ACK/ERROR replies
+static void handle_worker_message(const message_t* msg) {
+    switch (msg->type) {
+        case MSG_REGISTER_NODE:
+            log_node(msg->sender_id);
+            events_publish(EVENT_NODE, "up", msg->sender_id, NULL, msg->sender_id,
+                           node_state_name(NODE_CONNECTED), NULL);
+            
+            // Agree on what the worker runs, exchanging only the parts that
+            // differ; its containers are reconciled once that settles
+            if (!raft_enabled() || raft_is_leader()) {
+                request_inventory(msg->sender_id, INVENTORY_ROOT, NULL, 0);
+            }
+            break;
+            
+        case MSG_INVENTORY_REPLY:
+            handle_inventory_reply(msg);
+            break;
+            
+        case MSG_MIGRATE_READY:
+            handle_migration_offer(msg);
+            break;
+            
+        case MSG_CONTAINER_STATUS:
+            if (msg->data_length >= (int)sizeof(container_t)) {
+                apply_container_report((const container_t*)msg->data);
+            }
+            break;
+            
+        case MSG_NODE_HEARTBEAT:
+            scheduler_heartbeat(msg->sender_id);
+            break;
+            
+        case MSG_ACK:
+        case MSG_ERROR:
+            if (msg->operation_id > 0) {
+                operation_complete(msg->operation_id,
+                                   (msg->type == MSG_ACK) ? OP_SUCCEEDED : OP_FAILED, msg->data);
+            }
+            break;
+            
+        default:
+            break;
+    }
+}
+
+// Send a command for an operation and move it to RUNNING, failing it if the send fails
+static int dispatch_operation(int op_id, node_t* node, message_type_t type,
+                              const void* data, int data_len) {
+    message_t msg;
+    create_message(&msg, type, "coordinator", node->id, data, data_len);
+    msg.operation_id = op_id;
+    
+    if (send_message(node->socket_fd, &msg) != 0) {
+        printf("Error: Failed to send operation %d to node %s\n", op_id, node->id);
+        operation_complete(op_id, OP_FAILED, "send failed");
+        return -1;
+    }
+    
+    operation_mark_running(op_id);
+    return 0;
+}
+
+// Send a deploy the admission queue let through; the node may have gone away
+// while it waited
+static int dispatch_deploy(int op_id, const char* node_id, const lxc_config_t* config) {
+    node_t* node = find_node_by_id(node_id);
+    if (!node || node->state != NODE_CONNECTED) {
+        printf("Error: Node %s is not connected\n", node_id);
+        operation_complete(op_id, OP_FAILED, "node not connected");
+        return -1;
+    }
+    
+    if (dispatch_operation(op_id, node, MSG_DEPLOY_CONTAINER, config, sizeof(lxc_config_t)) != 0) {
+        return -1;
     }
     
-    return best_node;
+    printf("Deploying container %s to node %s (operation %d)\n", config->name, node_id, op_id);
+    return 0;
 }
 
-// Deploy container to a specific node
-int deploy_container(const char* node_id, const lxc_config_t* config) {
+// Deploy container to a specific node with the state the reconciler should
+// bring it to once created, returns the operation id or -1
+static int deploy_container_as(const char* node_id, const lxc_config_t* config,
+                               container_state_t desired_state) {
     if (!node_id || !config) return -1;
+    if (!accept_state_change()) return -1;
     
     node_t* node = find_node_by_id(node_id);
     if (!node) {
@@ -84,72 +934,173 @@ int deploy_container(const char* node_id, const lxc_config_t* config) {
         return -1;
     }
     
-    // Create deployment message
-    message_t msg;
-    create_message(&msg, MSG_DEPLOY_CONTAINER, "coordinator", node_id, 
-                   config, sizeof(lxc_config_t));
+    char container_id[MAX_NAME_LEN];
+    snprintf(container_id, sizeof(container_id), "%.127s_%.127s", node_id, config->name);
     
-    if (send_message(node->socket_fd, &msg) != 0) {
-        printf("Error: Failed to send deployment message to node %s\n", node_id);
+    // Register the container before sending so a fast reply finds it
+    lock_containers();
+    
+    if (find_container_locked(container_id)) {
+        pthread_mutex_unlock(&containers_mutex);
+        printf("Error: Container %s already exists\n", container_id);
         return -1;
     }
     
-    // Add container to deployed list
-    pthread_mutex_lock(&containers_mutex);
+    if (deployed_container_count >= config_current()->max_containers) {
+        pthread_mutex_unlock(&containers_mutex);
+        printf("Error: Maximum container limit reached\n");
+        return -1;
+    }
     
-    if (deployed_container_count < MAX_CONTAINERS) {
-        container_t* container = &deployed_containers[deployed_container_count];
-        
-        snprintf(container->id, sizeof(container->id), "%s_%s", 
-                node_id, config->name);
-        strcpy(container->name, config->name);
-        strcpy(container->node_id, node_id);
-        container->state = CONTAINER_STARTING;
-        container->config = *config;
-        container->created_at = time(NULL);
-        
-        deployed_container_count++;
-        
-        // Add to node's container list
-        if (node->container_count < MAX_CONTAINERS) {
-            node->containers[node->container_count] = *container;
-            node->container_count++;
-        }
+    int op_id = operation_create(OP_DEPLOY, container_id, node_id, 0);
+    if (op_id < 0) {
+        pthread_mutex_unlock(&containers_mutex);
+        return -1;
     }
     
+    container_t* container = &deployed_containers[deployed_container_count];
+    memset(container, 0, sizeof(container_t));
+    strcpy(container->id, container_id);
+    strcpy(container->name, config->name);
+    strcpy(container->node_id, node_id);
+    container->state = CONTAINER_STARTING;
+    container->desired_state = desired_state;
+    container->config = *config;
+    container->created_at = time(NULL);
+    
+    deployed_container_count++;
+    
+    // Add to node's container list
+    append_node_container_locked(node, container);
+    scheduler_commit(node, config);
+    scheduler_reserve(node, config, op_id);
+    tenant_charge(config);
+    publish_container_event(container, "added");
+    unsigned long lsn = log_container_locked(container);
+    
     pthread_mutex_unlock(&containers_mutex);
     
-    printf("Container %s deployed to node %s\n", config->name, node_id);
-    return 0;
+    // The container must be on disk before the worker is told to create it
+    if (sync_state_change(lsn) != 0) {
+        operation_complete(op_id, OP_FAILED, "state log write failed");
+        return -1;
+    }
+    
+    // Sent now or once the admission rate limits allow
+    if (admission_submit(op_id, node_id, config) != 0) {
+        return -1;
+    }
+    return op_id;
 }
 
-// Deploy container using automatic node selection
-int deploy_container_auto(const lxc_config_t* config) {
+// Deploy container to a specific node, returns the operation id or -1
+int deploy_container(const char* node_id, const lxc_config_t* config) {
+    return deploy_container_as(node_id, config, CONTAINER_STOPPED);
+}
+
+// Evict the cheapest set of lower-priority containers from one node and
+// deploy the container in their place once every delete has succeeded; each
+// victim is requeued once its delete succeeds. Returns the operation id or -1.
+static int preempt_and_deploy(const lxc_config_t* config, container_state_t desired_state) {
+    preemption_plan_t plan;
+    
+    lock_containers();
+    if (scheduler_plan_preemption(config, &plan) != 0) {
+        pthread_mutex_unlock(&containers_mutex);
+        return -1;
+    }
+    for (int i = 0; i < plan.count; i++) {
+        container_t* victim = find_container_locked(plan.victims[i]);
+        preemption_evict(victim->id, &victim->config, victim->desired_state, config->name);
+    }
+    pthread_mutex_unlock(&containers_mutex);
+    
+    if (plan.count > 0) {
+        printf("Preempting %d container(s) on node %s for %s (priority %d)\n", plan.count,
+               plan.node_id, config->name, config->priority);
+    }
+    
+    int delete_ops[PREEMPTION_MAX_VICTIMS];
+    int waiting = 0;
+    int failed = 0;
+    for (int i = 0; i < plan.count; i++) {
+        int op_id = delete_container(plan.victims[i]);
+        if (op_id == 0) {
+            preemption_evicted(plan.victims[i], 1);   // Its node is gone, nothing to wait for
+        } else if (op_id < 0) {
+            preemption_evicted(plan.victims[i], 0);
+            failed++;
+        } else {
+            delete_ops[waiting++] = op_id;
+        }
+    }
+    
+    // Deploy only into room that is really free. Victims deleted before a
+    // failure are requeued as they finish, so they go back to the room they left.
+    operation_wait_all(delete_ops, waiting, DEFAULT_OPERATION_TIMEOUT);
+    for (int i = 0; i < waiting; i++) {
+        operation_t op;
+        if (operation_get(delete_ops[i], &op) != 0 || op.state != OP_SUCCEEDED) {
+            failed++;
+        }
+    }
+    
+    if (failed > 0) {
+        printf("Error: %d of %d evictions on %s for %s failed, not deploying\n", failed,
+               plan.count, plan.node_id, config->name);
+        return -1;
+    }
+    
+    return deploy_container_as(plan.node_id, config, desired_state);
+}
+
+// Place a container with the scheduler, preempting lower-priority containers
+// when nothing fits. Returns the operation id, TENANT_NO_ROOM when it should
+// wait for capacity, or -1.
+static int place_container(const lxc_config_t* config, container_state_t desired_state) {
     if (!config) return -1;
+    if (!accept_state_change()) return -1;
     
     node_t* best_node = find_best_node(config);
-    if (!best_node) {
-        printf("Error: No suitable node available for deployment\n");
+    if (best_node) {
+        return deploy_container_as(best_node->id, config, desired_state);
+    }
+    
+    if (config_current()->preemption) {
+        int op_id = preempt_and_deploy(config, desired_state);
+        if (op_id > 0) return op_id;
+    }
+    
+    // Waiting only helps when some node could take it once it has room
+    if (!scheduler_could_place(config)) {
+        printf("Error: No node can ever fit container %s (cpu %d, memory %d MB, affinity %s)\n",
+               config->name, config->cpu_limit, config->memory_limit,
+               config->affinity[0] ? config->affinity : "-");
         return -1;
     }
+    printf("No node has room for container %s yet\n", config->name);
+    return TENANT_NO_ROOM;
+}
+
+// Deploy container using automatic node selection once its tenant's turn
+// comes. Returns the operation id, 0 when queued, or -1.
+int deploy_container_auto(const lxc_config_t* config) {
+    if (!config) return -1;
+    if (!accept_state_change()) return -1;
     
-    return deploy_container(best_node->id, config);
+    return tenant_submit(config, CONTAINER_STOPPED);
 }
 
-// Start a deployed container
-int start_container(const char* container_id) {
+// Submit a start/stop/delete operation for a deployed container
+static int submit_container_operation(const char* container_id, operation_type_t type,
+                                      message_type_t msg_type, container_state_t transient_state,
+                                      container_state_t desired_state) {
     if (!container_id) return -1;
+    if (!accept_state_change()) return -1;
     
-    pthread_mutex_lock(&containers_mutex);
-    
-    container_t* container = NULL;
-    for (int i = 0; i < deployed_container_count; i++) {
-        if (strcmp(deployed_containers[i].id, container_id) == 0) {
-            container = &deployed_containers[i];
-            break;
-        }
-    }
+    lock_containers();
     
+    container_t* container = find_container_locked(container_id);
     if (!container) {
         pthread_mutex_unlock(&containers_mutex);
         printf("Error: Container %s not found\n", container_id);
@@ -158,215 +1109,806 @@ int start_container(const char* container_id) {
     
     node_t* node = find_node_by_id(container->node_id);
     if (!node) {
+        if (type == OP_DELETE) {
+            // Nothing to tell a node that is gone, just forget the container
+            remove_container_locked(container_id);
+            pthread_mutex_unlock(&containers_mutex);
+            printf("Container %s deleted\n", container_id);
+            return 0;
+        }
         pthread_mutex_unlock(&containers_mutex);
         printf("Error: Node %s not found for container %s\n", 
                container->node_id, container_id);
         return -1;
     }
     
-    // Send start message to node
-    message_t msg;
-    create_message(&msg, MSG_START_CONTAINER, "coordinator", node->id, 
-                   container->name, strlen(container->name));
-    
-    if (send_message(node->socket_fd, &msg) != 0) {
+    int op_id = operation_create(type, container_id, node->id, 0);
+    if (op_id < 0) {
         pthread_mutex_unlock(&containers_mutex);
-        printf("Error: Failed to send start message to node %s\n", node->id);
         return -1;
     }
     
-    container->state = CONTAINER_STARTING;
-    container->started_at = time(NULL);
+    char name[MAX_NAME_LEN];
+    strcpy(name, container->name);
+    container->desired_state = desired_state;
+    unsigned long lsn = set_container_state_locked(container, transient_state);
     
     pthread_mutex_unlock(&containers_mutex);
     
-    printf("Start command sent for container %s\n", container_id);
-    return 0;
+    if (sync_state_change(lsn) != 0) {
+        operation_complete(op_id, OP_FAILED, "state log write failed");
+        return -1;
+    }
+    
+    if (dispatch_operation(op_id, node, msg_type, name, strlen(name)) != 0) {
+        return -1;
+    }
+    
+    printf("%s command sent for container %s (operation %d)\n",
+           operation_type_name(type), container_id, op_id);
+    return op_id;
+}
+
+// Start a deployed container, returns the operation id or -1
+int start_container(const char* container_id) {
+    return submit_container_operation(container_id, OP_START, MSG_START_CONTAINER,
+                                      CONTAINER_STARTING, CONTAINER_RUNNING);
 }
 
-// Stop a running container
+// Stop a running container, returns the operation id or -1
 int stop_container(const char* container_id) {
+    return submit_container_operation(container_id, OP_STOP, MSG_STOP_CONTAINER,
+                                      CONTAINER_STOPPING, CONTAINER_STOPPED);
+}
+
+// Delete a container, returns the operation id (0 if removed locally) or -1
+int delete_container(const char* container_id) {
+    return submit_container_operation(container_id, OP_DELETE, MSG_DELETE_CONTAINER,
+                                      CONTAINER_STOPPING, CONTAINER_STOPPED);
+}
+
+// Move a container to another node, chosen by the scheduler when node_id is
+// NULL. Returns the operation id or -1.
+int migrate_container(const char* container_id, const char* node_id, int checkpoint) {
     if (!container_id) return -1;
+    if (!accept_state_change()) return -1;
     
-    pthread_mutex_lock(&containers_mutex);
-    
-    container_t* container = NULL;
-    for (int i = 0; i < deployed_container_count; i++) {
-        if (strcmp(deployed_containers[i].id, container_id) == 0) {
-            container = &deployed_containers[i];
-            break;
-        }
-    }
+    lock_containers();
     
+    container_t* container = find_container_locked(container_id);
     if (!container) {
         pthread_mutex_unlock(&containers_mutex);
         printf("Error: Container %s not found\n", container_id);
         return -1;
     }
     
-    node_t* node = find_node_by_id(container->node_id);
-    if (!node) {
+    if (container->state != CONTAINER_RUNNING && container->state != CONTAINER_STOPPED) {
         pthread_mutex_unlock(&containers_mutex);
-        printf("Error: Node %s not found for container %s\n", 
-               container->node_id, container_id);
+        printf("Error: Container %s is busy, migrate it once it is running or stopped\n",
+               container_id);
         return -1;
     }
     
-    // Send stop message to node
-    message_t msg;
-    create_message(&msg, MSG_STOP_CONTAINER, "coordinator", node->id, 
-                   container->name, strlen(container->name));
+    node_t* source = find_node_by_id(container->node_id);
+    if (!source || source->state != NODE_CONNECTED) {
+        pthread_mutex_unlock(&containers_mutex);
+        printf("Error: Node %s of container %s is not connected\n", container->node_id,
+               container_id);
+        return -1;
+    }
     
-    if (send_message(node->socket_fd, &msg) != 0) {
+    node_t* target = node_id ? find_node_by_id(node_id)
+                             : find_best_node_excluding(&container->config, source->id);
+    if (!target || target == source || target->state != NODE_CONNECTED) {
         pthread_mutex_unlock(&containers_mutex);
-        printf("Error: Failed to send stop message to node %s\n", node->id);
+        printf("Error: No connected target node other than %s for container %s\n",
+               source->id, container_id);
+        return -1;
+    }
+    
+    char moved_id[MAX_NAME_LEN];
+    snprintf(moved_id, sizeof(moved_id), "%.127s_%.127s", target->id, container->name);
+    if (find_container_locked(moved_id)) {
+        pthread_mutex_unlock(&containers_mutex);
+        printf("Error: Container %s already exists\n", moved_id);
+        return -1;
+    }
+    
+    // One-time token the target presents to the source before it is served
+    migration_export_t request;
+    memset(&request, 0, sizeof(request));
+    if (migration_token(request.token) != 0) {
+        pthread_mutex_unlock(&containers_mutex);
+        return -1;
+    }
+    
+    int op_id = operation_create(OP_MIGRATE, container_id, target->id, MIGRATION_TIMEOUT);
+    if (op_id < 0) {
+        pthread_mutex_unlock(&containers_mutex);
+        return -1;
+    }
+    scheduler_reserve(target, &container->config, op_id);
+    
+    strcpy(request.name, container->name);
+    request.checkpoint = checkpoint;
+    
+    // STOPPING holds off the reconciler and worker reports until the move settles
+    unsigned long lsn = set_container_state_locked(container, CONTAINER_STOPPING);
+    
+    pthread_mutex_unlock(&containers_mutex);
+    
+    if (sync_state_change(lsn) != 0) {
+        operation_complete(op_id, OP_FAILED, "state log write failed");
+        return -1;
+    }
+    
+    if (dispatch_operation(op_id, source, MSG_MIGRATE_EXPORT, &request, sizeof(request)) != 0) {
         return -1;
     }
     
-    container->state = CONTAINER_STOPPING;
+    printf("Migrating container %s from %s to %s (operation %d)\n", container_id, source->id,
+           target->id, op_id);
+    return op_id;
+}
+
+// Drive one container from its observed state toward its desired state
+static reconcile_result_t reconcile_container(const char* container_id) {
+    // Only the leader issues commands; a new leader marks every container again
+    if (raft_enabled() && !raft_is_leader()) {
+        return RECONCILE_CONVERGED;
+    }
+    
+    lock_containers();
+    
+    container_t* container = find_container_locked(container_id);
+    if (!container) {
+        pthread_mutex_unlock(&containers_mutex);
+        return RECONCILE_CONVERGED;
+    }
+    
+    container_state_t state = container->state;
+    container_state_t desired = container->desired_state;
+    node_t* node = find_node_by_id(container->node_id);
+    int connected = (node && node->state == NODE_CONNECTED);
+    
+    pthread_mutex_unlock(&containers_mutex);
+    
+    // An operation in flight marks the container again when it completes,
+    // and a node marks its containers again when its worker re-registers
+    if (state == desired || state == CONTAINER_STARTING || state == CONTAINER_STOPPING ||
+        !connected) {
+        return RECONCILE_CONVERGED;
+    }
+    
+    printf("Reconciler: container %s is %s, want %s\n", container_id,
+           container_state_name(state), container_state_name(desired));
+    
+    int op_id = (desired == CONTAINER_RUNNING) ? start_container(container_id)
+                                               : stop_container(container_id);
+    return (op_id > 0) ? RECONCILE_CORRECTING : RECONCILE_RETRY;
+}
+
+// Get container status
+container_state_t get_container_status(const char* container_id) {
+    if (!container_id) return CONTAINER_ERROR;
+    
+    lock_containers();
+    
+    for (int i = 0; i < deployed_container_count; i++) {
+        if (strcmp(deployed_containers[i].id, container_id) == 0) {
+            container_state_t state = deployed_containers[i].state;
+            pthread_mutex_unlock(&containers_mutex);
+            return state;
+        }
+    }
+    
+    pthread_mutex_unlock(&containers_mutex);
+    return CONTAINER_ERROR;
+}
+
+// List all containers
+void list_containers(void) {
+    lock_containers();
+    
+    printf("\n=== Deployed Containers ===\n");
+    printf("%-20s %-20s %-15s %-10s %-10s\n", "ID", "Name", "Node", "State", "Desired");
+    printf("-----------------------------------------------------------------------\n");
+    
+    for (int i = 0; i < deployed_container_count; i++) {
+        container_t* container = &deployed_containers[i];
+        
+        printf("%-20s %-20s %-15s %-10s %-10s\n", 
+               container->id, container->name, container->node_id,
+               container_state_name(container->state),
+               container_state_name(container->desired_state));
+    }
+    
+    pthread_mutex_unlock(&containers_mutex);
+}
+
+// List all nodes
+void list_nodes(void) {
+    lock_nodes();
+    
+    printf("\n=== Connected Nodes ===\n");
+    printf("%-15s %-20s %-15s %-10s %-10s %-10s %s\n", 
+           "ID", "Hostname", "IP", "State", "CPU%", "Mem%", "Labels");
+    printf("------------------------------------------------------------------------\n");
+    
+    for (int i = 0; i < node_count; i++) {
+        node_t* node = &nodes[i];
+        
+        printf("%-15s %-20s %-15s %-10s %-10.1f %-10.1f %s\n", 
+               node->id, node->hostname, node->ip_address, node_state_name(node->state),
+               node->resources.cpu_usage, node->resources.memory_usage, node->labels);
+    }
+    
+    pthread_mutex_unlock(&nodes_mutex);
+}
+
+// Handle the arguments of the scheduler command
+static void configure_scheduler(const char* args) {
+    char setting[MAX_NAME_LEN] = {0};
+    char value[MAX_NAME_LEN] = {0};
+    
+    if (sscanf(args, "%255s %255s", setting, value) < 2) {
+        show_scheduler();
+        return;
+    }
+    
+    if (strcmp(setting, "policy") == 0) {
+        scheduler_policy_t policy;
+        if (scheduler_parse_policy(value, &policy) != 0) {
+            printf("Error: Unknown scheduler policy %s\n", value);
+            return;
+        }
+        scheduler_set_policy(policy);
+        printf("Scheduler policy set to %s\n", scheduler_policy_name(policy));
+    } else if (strcmp(setting, "headroom") == 0) {
+        scheduler_set_headroom(atoi(value));
+        printf("Scheduler headroom set to %s%%\n", value);
+    } else if (strcmp(setting, "sample") == 0) {
+        scheduler_set_sample_size(atoi(value));
+        printf("Scheduler sample size set to %s\n", value);
+    } else if (strcmp(setting, "locality") == 0) {
+        scheduler_set_locality_bonus(atof(value));
+        printf("Scheduler locality bonus set to %s\n", value);
+    } else {
+        printf("Error: Unknown scheduler setting %s\n", setting);
+    }
+}
+
+// Wait for one operation or for every in-flight operation
+static void wait_operations(const char* target, int timeout) {
+    static int ids[MAX_OPERATIONS];
+    int count;
+    
+    if (strcmp(target, "all") == 0) {
+        count = operation_list_active(ids, MAX_OPERATIONS);
+    } else {
+        ids[0] = atoi(target);
+        count = 1;
+    }
+    
+    int finished = operation_wait_all(ids, count, timeout);
+    printf("%d of %d operation(s) finished\n", finished, count);
     
+    if (count == 1) {
+        operation_t op;
+        if (operation_get(ids[0], &op) == 0) {
+            printf("Operation %d: %s %s\n", op.id, operation_state_name(op.state), op.result);
+        }
+    }
+}
+
+// Copy the containers of a replica group for the rollout engine
+static int list_group_members(const char* group, rollout_member_t* members, int max_members) {
+    int count = 0;
+    
+    lock_containers();
+    for (int i = 0; i < deployed_container_count && count < max_members; i++) {
+        container_t* container = &deployed_containers[i];
+        const char* container_group = container->config.group[0] ? container->config.group
+                                                                  : container->config.name;
+        if (strcmp(container_group, group) != 0) continue;
+        
+        rollout_member_t* member = &members[count++];
+        strcpy(member->id, container->id);
+        strcpy(member->name, container->name);
+        strcpy(member->node_id, container->node_id);
+        member->state = container->state;
+        member->desired_state = container->desired_state;
+        member->config = container->config;
+    }
     pthread_mutex_unlock(&containers_mutex);
     
-    printf("Stop command sent for container %s\n", container_id);
+    return count;
+}
+
+// Rebalancer's view of the registry
+static int list_all_containers(rebalance_container_t* containers, int max_containers) {
+    int count = 0;
+    
+    lock_containers();
+    for (int i = 0; i < deployed_container_count && count < max_containers; i++) {
+        container_t* container = &deployed_containers[i];
+        rebalance_container_t* entry = &containers[count++];
+        strcpy(entry->id, container->id);
+        strcpy(entry->name, container->name);
+        strcpy(entry->node_id, container->node_id);
+        entry->state = container->state;
+        entry->desired_state = container->desired_state;
+        entry->config = container->config;
+    }
+    pthread_mutex_unlock(&containers_mutex);
+    
+    return count;
+}
+
+// Handle "rollout start <group> <yaml> [max_unavailable] [max_surge] [pause|rollback]"
+// and "rollout pause|resume|rollback|abort <group>", returns 0 or -1
+static int rollout_command(char** arguments, int argument_count) {
+    if (argument_count < 2) {
+        printf("Usage: rollout start <group> <yaml_file> [max_unavailable] [max_surge] [pause|rollback]\n");
+        printf("       rollout pause|resume|rollback|abort <group>\n");
+        return -1;
+    }
+    
+    const char* action = arguments[0];
+    const char* group = arguments[1];
+    
+    if (strcmp(action, "start") == 0) {
+        int max_unavailable = DEFAULT_MAX_UNAVAILABLE;
+        int max_surge = DEFAULT_MAX_SURGE;
+        rollout_failure_policy_t on_failure = ROLLOUT_ON_FAILURE_PAUSE;
+        lxc_config_t config;
+        
+        if (argument_count < 3) {
+            printf("Error: rollout start needs a group and a YAML file\n");
+            return -1;
+        }
+        if (argument_count > 3) max_unavailable = atoi(arguments[3]);
+        if (argument_count > 4) max_surge = atoi(arguments[4]);
+        if (argument_count > 5) {
+            if (strcmp(arguments[5], "rollback") == 0) {
+                on_failure = ROLLOUT_ON_FAILURE_ROLLBACK;
+            } else if (strcmp(arguments[5], "pause") != 0) {
+                printf("Error: Unknown failure policy %s\n", arguments[5]);
+                return -1;
+            }
+        }
+        if (spec_cache_load(arguments[2], &config) != 0) {
+            printf("Error: Failed to parse YAML file %s\n", arguments[2]);
+            return -1;
+        }
+        return rollout_start(group, &config, max_unavailable, max_surge, on_failure);
+    }
+    if (strcmp(action, "pause") == 0) return rollout_pause(group);
+    if (strcmp(action, "resume") == 0) return rollout_resume(group);
+    if (strcmp(action, "rollback") == 0) return rollout_rollback(group);
+    if (strcmp(action, "abort") == 0) return rollout_abort(group);
+    
+    printf("Error: Unknown rollout action %s\n", action);
+    return -1;
+}
+
+// Run one deploy, start, stop, delete, reconcile or snapshot from the console or control
+// socket, returns the operation id, 0 when there is none, or -1
+static int control_item(const char* verb, const char* argument) {
+    if (strcmp(verb, "deploy") == 0) {
+        lxc_config_t config;
+        if (spec_cache_load(argument, &config) != 0) {
+            printf("Error: Failed to parse YAML file %s\n", argument);
+            return -1;
+        }
+        return deploy_container_auto(&config);
+    }
+    if (strcmp(verb, "start") == 0) return start_container(argument);
+    if (strcmp(verb, "stop") == 0) return stop_container(argument);
+    if (strcmp(verb, "delete") == 0) return delete_container(argument);
+    if (strcmp(verb, "snapshot") == 0) {
+        checkpoint_state();
+        return 0;
+    }
+    
+    reconciler_mark_dirty(argument);
+    return 0;
+}
+
+// Describe one operation on a control reply line
+static void control_operation(control_reply_t* reply, int id) {
+    operation_t op;
+    if (operation_get(id, &op) == 0) {
+        control_reply(reply, "%d %s %s %s %s %s\n", op.id, operation_type_name(op.type),
+                      op.container_id, op.node_id, operation_state_name(op.state), op.result);
+    } else {
+        control_reply(reply, "%d error not found\n", id);
+    }
+}
+
+// Whether this coordinator may change state; otherwise replies with where the
+// leader is
+static int control_leader(control_reply_t* reply) {
+    char leader_ip[INET_ADDRSTRLEN];
+    int leader_port;
+    
+    if (!raft_enabled() || raft_is_leader()) {
+        return 1;
+    }
+    if (raft_leader_address(leader_ip, &leader_port) == 0) {
+        control_reply(reply, "error not leader %s %d\n", leader_ip, leader_port);
+    } else {
+        control_reply(reply, "error no leader\n");
+    }
     return 0;
 }
 
-// Delete a container
-int delete_container(const char* container_id) {
-    if (!container_id) return -1;
+// Drop a deferred control request whose client went away
+static void release_control_request(void* context) {
+    command_release_batch(context);
+}
+
+// Handle one control socket request. Commands follow the interactive ones;
+// the first reply line is "ok" or "error <reason>" and data lines follow.
+// deploy, start, stop, delete, reconcile and op take any number of arguments
+// and answer one line per argument, so a whole batch costs one round trip.
+static control_status_t handle_control_request(const char* request, int elapsed_ms,
+                                               void** context, control_reply_t* reply) {
+    static char line[CONTROL_MAX_REQUEST + 1];
+    static control_reply_t items;
+    static char* arguments[CONTROL_MAX_REQUEST / 2];
+    static int results[CONTROL_MAX_REQUEST / 2];
+    int argument_count = 0;
+    char* save = NULL;
     
-    pthread_mutex_lock(&containers_mutex);
+    strcpy(line, request);
+    char* verb = strtok_r(line, " \t\r\n", &save);
+    if (!verb) {
+        control_reply(reply, "error empty request\n");
+        return CONTROL_DONE;
+    }
+    for (char* token = strtok_r(NULL, " \t\r\n", &save); token;
+         token = strtok_r(NULL, " \t\r\n", &save)) {
+        arguments[argument_count++] = token;
+    }
     
-    container_t* container = NULL;
-    int container_index = -1;
-    for (int i = 0; i < deployed_container_count; i++) {
-        if (strcmp(deployed_containers[i].id, container_id) == 0) {
-            container = &deployed_containers[i];
-            container_index = i;
-            break;
+    if (strcmp(verb, "deploy") == 0 || strcmp(verb, "start") == 0 ||
+        strcmp(verb, "stop") == 0 || strcmp(verb, "delete") == 0 ||
+        strcmp(verb, "reconcile") == 0) {
+        if (argument_count == 0) {
+            control_reply(reply, "error %s needs arguments\n", verb);
+            return CONTROL_DONE;
+        }
+        
+        // Items run in parallel on the command pool while the event loop keeps
+        // serving other clients; the last one to finish wakes it to reply
+        if (!*context) {
+            if (!control_leader(reply)) {
+                return CONTROL_DONE;
+            }
+            *context = command_start_batch(verb, arguments, argument_count, control_wake);
+            if (!*context) {
+                control_reply(reply, "error out of memory\n");
+                return CONTROL_DONE;
+            }
+        }
+        if (!command_batch_results(*context, results)) {
+            return CONTROL_PENDING;
+        }
+        command_release_batch(*context);
+        *context = NULL;
+        
+        // Replies keep argument order
+        int failed = 0;
+        items.length = 0;
+        items.truncated = 0;
+        for (int i = 0; i < argument_count; i++) {
+            int result = results[i];
+            if (result < 0) {
+                failed++;
+                control_reply(&items, "%s error\n", arguments[i]);
+            } else {
+                control_reply(&items, "%s ok %d\n", arguments[i], result);
+            }
+        }
+        
+        if (failed > 0) {
+            control_reply(reply, "error %d of %d failed\n", failed, argument_count);
+        } else {
+            control_reply(reply, "ok %d\n", argument_count);
         }
+        control_reply(reply, "%s", items.data);
+        return CONTROL_DONE;
     }
     
-    if (!container) {
-        pthread_mutex_unlock(&containers_mutex);
-        printf("Error: Container %s not found\n", container_id);
-        return -1;
+    if (strcmp(verb, "op") == 0) {
+        control_reply(reply, "ok\n");
+        for (int i = 0; i < argument_count; i++) {
+            control_operation(reply, atoi(arguments[i]));
+        }
+        return CONTROL_DONE;
     }
     
-    node_t* node = find_node_by_id(container->node_id);
-    if (node) {
-        // Send delete message to node
-        message_t msg;
-        create_message(&msg, MSG_DELETE_CONTAINER, "coordinator", node->id, 
-                       container->name, strlen(container->name));
+    if (strcmp(verb, "wait") == 0) {
+        // Answered once the operations finish; the event loop keeps serving
+        // other clients meanwhile
+        static int ids[MAX_OPERATIONS];
+        int timeout = DEFAULT_OPERATION_TIMEOUT;
+        int count;
         
-        if (send_message(node->socket_fd, &msg) != 0) {
-            printf("Warning: Failed to send delete message to node %s\n", node->id);
+        if (argument_count == 0) {
+            control_reply(reply, "error wait needs an operation id or all\n");
+            return CONTROL_DONE;
+        }
+        if (argument_count > 1) {
+            timeout = atoi(arguments[1]);
         }
         
-        // Remove from node's container list
-        for (int i = 0; i < node->container_count; i++) {
-            if (strcmp(node->containers[i].id, container_id) == 0) {
-                // Shift remaining containers
-                for (int j = i; j < node->container_count - 1; j++) {
-                    node->containers[j] = node->containers[j + 1];
-                }
-                node->container_count--;
-                break;
+        if (strcmp(arguments[0], "all") == 0) {
+            count = operation_list_active(ids, MAX_OPERATIONS);
+            if (count == 0) {
+                control_reply(reply, "ok\n");
+                return CONTROL_DONE;
+            }
+        } else {
+            ids[0] = atoi(arguments[0]);
+            count = 1;
+            
+            operation_t op;
+            if (operation_get(ids[0], &op) != 0) {
+                control_reply(reply, "error operation %d not found\n", ids[0]);
+                return CONTROL_DONE;
+            }
+            if (operation_is_terminal(op.state)) {
+                control_reply(reply, "ok\n");
+                control_operation(reply, ids[0]);
+                return CONTROL_DONE;
             }
         }
+        
+        if (elapsed_ms < timeout * 1000) {
+            return CONTROL_PENDING;
+        }
+        
+        control_reply(reply, "error timed out\n");
+        for (int i = 0; i < count; i++) {
+            control_operation(reply, ids[i]);
+        }
+        return CONTROL_DONE;
     }
     
-    // Remove from deployed containers list
-    for (int i = container_index; i < deployed_container_count - 1; i++) {
-        deployed_containers[i] = deployed_containers[i + 1];
+    if (strcmp(verb, "containers") == 0) {
+        control_reply(reply, "ok\n");
+        lock_containers();
+        for (int i = 0; i < deployed_container_count; i++) {
+            container_t* container = &deployed_containers[i];
+            control_reply(reply, "%s %s %s %s %s\n", container->id, container->name,
+                          container->node_id, container_state_name(container->state),
+                          container_state_name(container->desired_state));
+        }
+        pthread_mutex_unlock(&containers_mutex);
+        return CONTROL_DONE;
     }
-    deployed_container_count--;
     
-    pthread_mutex_unlock(&containers_mutex);
+    if (strcmp(verb, "nodes") == 0) {
+        control_reply(reply, "ok\n");
+        lock_nodes();
+        for (int i = 0; i < node_count; i++) {
+            node_t* node = &nodes[i];
+            control_reply(reply, "%s %s %s %d %s %d %.1f %.1f %s\n", node->id, node->hostname,
+                          node->ip_address, node->port, node_state_name(node->state),
+                          node->container_count, node->resources.cpu_usage,
+                          node->resources.memory_usage, node->labels[0] ? node->labels : "-");
+        }
+        pthread_mutex_unlock(&nodes_mutex);
+        return CONTROL_DONE;
+    }
     
-    printf("Container %s deleted\n", container_id);
-    return 0;
-}
-
-// Get container status
-container_state_t get_container_status(const char* container_id) {
-    if (!container_id) return CONTAINER_ERROR;
+    if (strcmp(verb, "migrate") == 0) {
+        // migrate <container_id> [node_id|auto] [checkpoint]
+        if (argument_count == 0) {
+            control_reply(reply, "error migrate needs a container id\n");
+            return CONTROL_DONE;
+        }
+        if (!control_leader(reply)) {
+            return CONTROL_DONE;
+        }
+        
+        const char* target = (argument_count > 1 && strcmp(arguments[1], "auto") != 0)
+                             ? arguments[1] : NULL;
+        int checkpoint = (argument_count > 2 && strcmp(arguments[2], "checkpoint") == 0);
+        int op_id = migrate_container(arguments[0], target, checkpoint);
+        if (op_id < 0) {
+            control_reply(reply, "error migrate %s failed\n", arguments[0]);
+        } else {
+            control_reply(reply, "ok %d\n", op_id);
+        }
+        return CONTROL_DONE;
+    }
     
-    pthread_mutex_lock(&containers_mutex);
+    if (strcmp(verb, "rollout") == 0) {
+        if (!control_leader(reply)) {
+            return CONTROL_DONE;
+        }
+        if (rollout_command(arguments, argument_count) != 0) {
+            control_reply(reply, "error rollout %s failed\n", argument_count > 0 ? arguments[0] : "");
+        } else {
+            control_reply(reply, "ok\n");
+        }
+        return CONTROL_DONE;
+    }
     
-    for (int i = 0; i < deployed_container_count; i++) {
-        if (strcmp(deployed_containers[i].id, container_id) == 0) {
-            container_state_t state = deployed_containers[i].state;
-            pthread_mutex_unlock(&containers_mutex);
-            return state;
+    if (strcmp(verb, "rollouts") == 0) {
+        static rollout_info_t infos[MAX_ROLLOUTS];
+        int count = rollout_list(infos, MAX_ROLLOUTS);
+        
+        control_reply(reply, "ok\n");
+        for (int i = 0; i < count; i++) {
+            rollout_info_t* info = &infos[i];
+            control_reply(reply, "%s %s %s %d %d %d %d %d %d %s\n", info->group,
+                          rollout_state_name(info->state), info->image, info->updated,
+                          info->total, info->in_flight, info->failed, info->max_unavailable,
+                          info->max_surge, info->reason[0] ? info->reason : "-");
         }
+        return CONTROL_DONE;
     }
     
-    pthread_mutex_unlock(&containers_mutex);
-    return CONTAINER_ERROR;
-}
-
-// List all containers
-void list_containers(void) {
-    pthread_mutex_lock(&containers_mutex);
+    if (strcmp(verb, "rebalance") == 0) {
+        if (!control_leader(reply)) {
+            return CONTROL_DONE;
+        }
+        rebalancer_trigger();
+        control_reply(reply, "ok\n");
+        return CONTROL_DONE;
+    }
     
-    printf("\n=== Deployed Containers ===\n");
-    printf("%-20s %-20s %-15s %-10s\n", "ID", "Name", "Node", "State");
-    printf("------------------------------------------------------------\n");
+    if (strcmp(verb, "rebalancer") == 0) {
+        rebalance_status_t status;
+        rebalancer_status(&status);
+        control_reply(reply, "ok\n");
+        control_reply(reply, "%.1f %s %s %lu %lu %lu %s %s\n", status.imbalance, status.busiest,
+                      status.idlest, status.passes, status.moves, status.failed,
+                      status.running ? "running" : "idle", status.last_result);
+        return CONTROL_DONE;
+    }
     
-    for (int i = 0; i < deployed_container_count; i++) {
-        container_t* container = &deployed_containers[i];
-        const char* state_str;
-        
-        switch (container->state) {
-            case CONTAINER_STOPPED:  state_str = "STOPPED"; break;
-            case CONTAINER_STARTING: state_str = "STARTING"; break;
-            case CONTAINER_RUNNING:  state_str = "RUNNING"; break;
-            case CONTAINER_STOPPING: state_str = "STOPPING"; break;
-            case CONTAINER_ERROR:    state_str = "ERROR"; break;
-            default:                 state_str = "UNKNOWN"; break;
+    if (strcmp(verb, "tenants") == 0) {
+        static tenant_info_t tenants[MAX_TENANTS];
+        int count = tenants_list(tenants, MAX_TENANTS);
+        control_reply(reply, "ok %d\n", count);
+        for (int i = 0; i < count; i++) {
+            control_reply(reply, "%s %.4f %d %d %d %d %d %d %.2f %d %lu\n", tenants[i].name,
+                          tenants[i].dominant_share, tenants[i].cpu_used, tenants[i].cpu_quota,
+                          tenants[i].memory_used, tenants[i].memory_quota, tenants[i].containers,
+                          tenants[i].container_quota, tenants[i].weight, tenants[i].pending,
+                          tenants[i].admitted);
         }
-        
-        printf("%-20s %-20s %-15s %-10s\n", 
-               container->id, container->name, container->node_id, state_str);
+        return CONTROL_DONE;
     }
     
-    pthread_mutex_unlock(&containers_mutex);
-}
-
-// List all nodes
-void list_nodes(void) {
-    extern node_t nodes[];
-    extern int node_count;
-    extern pthread_mutex_t nodes_mutex;
+    if (strcmp(verb, "admission") == 0) {
+        admission_status_t status;
+        admission_status(&status);
+        control_reply(reply, "ok\n");
+        control_reply(reply, "%d %.1f %.1f %lu %lu %lu\n", status.queued, status.tokens,
+                      status.oldest_wait, status.admitted, status.delayed, status.expired);
+        return CONTROL_DONE;
+    }
     
-    pthread_mutex_lock(&nodes_mutex);
+    if (strcmp(verb, "preemption") == 0) {
+        preemption_status_t status;
+        preemption_status(&status);
+        control_reply(reply, "ok\n");
+        control_reply(reply, "%d %d %lu %lu\n", status.waiting, status.evicting, status.requeued,
+                      status.placed);
+        return CONTROL_DONE;
+    }
     
-    printf("\n=== Connected Nodes ===\n");
-    printf("%-15s %-20s %-15s %-10s %-10s %-10s\n", 
-           "ID", "Hostname", "IP", "State", "CPU%", "Mem%");
-    printf("------------------------------------------------------------------------\n");
+    if (strcmp(verb, "subscribe") == 0) {
+        // subscribe [container|node] [node=<id>] [name=<name>] [slots=<n>]
+        event_filter_t filter;
+        unsigned long seq;
+        int slots;
+        
+        if (events_parse_filter(arguments, argument_count, &filter, &slots) != 0) {
+            control_reply(reply, "error bad event filter\n");
+            return CONTROL_DONE;
+        }
+        int subscriber_id = events_subscribe(&filter, slots, &seq);
+        if (subscriber_id < 0) {
+            control_reply(reply, "error too many subscribers\n");
+        } else {
+            control_reply(reply, "ok %d %lu\n", subscriber_id, seq);
+        }
+        return CONTROL_DONE;
+    }
     
-    for (int i = 0; i < node_count; i++) {
-        node_t* node = &nodes[i];
-        const char* state_str;
+    if (strcmp(verb, "watch") == 0) {
+        // watch <subscriber> [cursor|-] [timeout]: answered as soon as events
+        // are buffered, or empty once the timeout passes
+        static event_t events[EVENT_READ_BATCH];
+        unsigned long lost = 0;
+        int timeout = EVENT_WATCH_TIMEOUT;
         
-        switch (node->state) {
-            case NODE_DISCONNECTED: state_str = "DISC"; break;
-            case NODE_CONNECTING:   state_str = "CONN"; break;
-            case NODE_CONNECTED:    state_str = "UP"; break;
-            case NODE_BUSY:         state_str = "BUSY"; break;
-            case NODE_ERROR:        state_str = "ERROR"; break;
-            default:                state_str = "UNK"; break;
+        if (argument_count == 0) {
+            control_reply(reply, "error watch needs a subscriber id\n");
+            return CONTROL_DONE;
+        }
+        int has_cursor = argument_count > 1 && strcmp(arguments[1], "-") != 0;
+        unsigned long cursor = has_cursor ? strtoul(arguments[1], NULL, 10) : 0;
+        if (argument_count > 2) {
+            timeout = atoi(arguments[2]);
+        }
+        
+        int count = events_read(atoi(arguments[0]), has_cursor, cursor, events,
+                                EVENT_READ_BATCH, &lost);
+        if (count < 0) {
+            control_reply(reply, "error subscriber %s not found\n", arguments[0]);
+            return CONTROL_DONE;
+        }
+        if (count == 0 && lost == 0 && elapsed_ms < timeout * 1000) {
+            return CONTROL_PENDING;
         }
         
-        printf("%-15s %-20s %-15s %-10s %-10.1f %-10.1f\n", 
-               node->id, node->hostname, node->ip_address, state_str,
-               node->resources.cpu_usage, node->resources.memory_usage);
+        control_reply(reply, "ok %d %lu\n", count, lost);
+        for (int i = 0; i < count; i++) {
+            event_t* event = &events[i];
+            control_reply(reply, "%lu %ld %s %s %s %s %s %s %s\n", event->seq, (long)event->time,
+                          event->kind == EVENT_NODE ? "node" : "container", event->action,
+                          event->id, event->name, event->node_id, event->state, event->desired);
+        }
+        return CONTROL_DONE;
     }
     
-    pthread_mutex_unlock(&nodes_mutex);
+    if (strcmp(verb, "unsubscribe") == 0) {
+        if (argument_count == 0 || events_unsubscribe(atoi(arguments[0])) != 0) {
+            control_reply(reply, "error subscriber %s not found\n",
+                          argument_count > 0 ? arguments[0] : "");
+        } else {
+            control_reply(reply, "ok\n");
+        }
+        return CONTROL_DONE;
+    }
+    
+    if (strcmp(verb, "snapshot") == 0) {
+        // Writing and syncing the snapshot runs on the command pool, like a batch
+        if (!*context) {
+            static char* no_argument[] = { "-" };
+            if (!wal_enabled()) {
+                control_reply(reply, "error state log is disabled\n");
+                return CONTROL_DONE;
+            }
+            *context = command_start_batch(verb, no_argument, 1, control_wake);
+            if (!*context) {
+                control_reply(reply, "error out of memory\n");
+                return CONTROL_DONE;
+            }
+        }
+        if (!command_batch_results(*context, results)) {
+            return CONTROL_PENDING;
+        }
+        command_release_batch(*context);
+        *context = NULL;
+        control_reply(reply, "ok\n");
+        return CONTROL_DONE;
+    }
+    
+    if (strcmp(verb, "ping") == 0) {
+        control_reply(reply, "ok\n");
+        return CONTROL_DONE;
+    }
+    
+    control_reply(reply, "error unknown command %s\n", verb);
+    return CONTROL_DONE;
+}
+
+// Hand a console command to the command pool; its result is printed when it
+// finishes, so the prompt is back at once
+static void submit_command(const char* verb, const char* argument) {
+    int job_id = command_submit(verb, argument);
+    if (job_id > 0) {
+        printf("Job %d queued: %s %s\n", job_id, verb, argument);
+    }
 }
 
 // Interactive coordinator command interface
@@ -381,8 +1923,31 @@ void coordinator_command_loop(void) {
     printf("  start <container_id> - Start container\n");
     printf("  stop <container_id>  - Stop container\n");
     printf("  delete <container_id> - Delete container\n");
+    printf("  migrate <container_id> [node_id|auto] [checkpoint]\n");
+    printf("                      - Move a container to another node\n");
     printf("  list containers      - List all containers\n");
     printf("  list nodes          - List all nodes\n");
+    printf("  scheduler [policy <spread|best-fit|worst-fit|p2c> | headroom <pct> |\n");
+    printf("             sample <d> | locality <bonus>]\n");
+    printf("                      - Show or tune placement\n");
+    printf("  ops                 - List in-flight operations\n");
+    printf("  op <id>             - Show operation status\n");
+    printf("  wait <id|all> [sec] - Wait for operations to finish\n");
+    printf("  wal                 - Show state log status\n");
+    printf("  snapshot            - Write a state snapshot now\n");
+    printf("  raft                - Show cluster replication status\n");
+    printf("  reconcile [id]      - Show the reconciler, or queue a container for it\n");
+    printf("  rollout start <group> <yaml_file> [max_unavailable] [max_surge] [pause|rollback]\n");
+    printf("  rollout pause|resume|rollback|abort <group>\n");
+    printf("                      - Replace a group's containers with a new spec\n");
+    printf("  rollouts            - List rollouts\n");
+    printf("  rebalance           - Even out node load now\n");
+    printf("  rebalancer          - Show node loads and the last rebalance\n");
+    printf("  preemption          - Show containers evicted for higher priorities\n");
+    printf("  tenants             - Show tenant usage, quotas and pending deployments\n");
+    printf("  events              - Show event stream subscribers\n");
+    printf("  specs [clear]       - Show or empty the parsed spec cache\n");
+    printf("  jobs                - Show queued deploy/start/stop/delete commands\n");
     printf("  quit                - Exit coordinator\n\n");
     
     while (1) {
@@ -390,6 +1955,16 @@ void coordinator_command_loop(void) {
         fflush(stdout);
         
         if (!fgets(command, sizeof(command), stdin)) {
+            // Without a terminal keep serving workers and control clients
+            // until a signal stops the coordinator
+            const daemon_config_t* config = config_current();
+            if (config->control_socket[0] || config->control_port > 0) {
+                printf("\nStandard input closed, serving the control socket only\n");
+                fflush(stdout);
+                while (1) {
+                    pause();
+                }
+            }
             break;
         }
         
@@ -398,25 +1973,26 @@ void coordinator_command_loop(void) {
         
         if (strncmp(command, "deploy ", 7) == 0) {
             sscanf(command + 7, "%s", yaml_file);
-            
-            lxc_config_t config;
-            if (parse_lxc_yaml(yaml_file, &config) == 0) {
-                deploy_container_auto(&config);
-            } else {
-                printf("Error: Failed to parse YAML file %s\n", yaml_file);
-            }
+            submit_command("deploy", yaml_file);
             
         } else if (strncmp(command, "start ", 6) == 0) {
             sscanf(command + 6, "%s", container_id);
-            start_container(container_id);
+            submit_command("start", container_id);
             
         } else if (strncmp(command, "stop ", 5) == 0) {
             sscanf(command + 5, "%s", container_id);
-            stop_container(container_id);
+            submit_command("stop", container_id);
             
         } else if (strncmp(command, "delete ", 7) == 0) {
             sscanf(command + 7, "%s", container_id);
-            delete_container(container_id);
+            submit_command("delete", container_id);
+            
+        } else if (strncmp(command, "migrate ", 8) == 0) {
+            char target[MAX_NAME_LEN] = "auto";
+            char mode[32] = "";
+            sscanf(command + 8, "%255s %255s %31s", container_id, target, mode);
+            migrate_container(container_id, strcmp(target, "auto") == 0 ? NULL : target,
+                              strcmp(mode, "checkpoint") == 0);
             
         } else if (strcmp(command, "list containers") == 0) {
             list_containers();
@@ -424,6 +2000,91 @@ void coordinator_command_loop(void) {
         } else if (strcmp(command, "list nodes") == 0) {
             list_nodes();
             
+        } else if (strncmp(command, "scheduler", 9) == 0) {
+            configure_scheduler(command + 9);
+            
+        } else if (strcmp(command, "ops") == 0) {
+            list_operations();
+            
+        } else if (strncmp(command, "op ", 3) == 0) {
+            operation_t op;
+            if (operation_get(atoi(command + 3), &op) == 0) {
+                printf("Operation %d: %s %s on %s - %s %s\n", op.id,
+                       operation_type_name(op.type), op.container_id, op.node_id,
+                       operation_state_name(op.state), op.result);
+            } else {
+                printf("Error: Operation %s not found\n", command + 3);
+            }
+            
+        } else if (strncmp(command, "wait ", 5) == 0) {
+            char target[MAX_NAME_LEN];
+            int timeout = DEFAULT_OPERATION_TIMEOUT;
+            sscanf(command + 5, "%255s %d", target, &timeout);
+            wait_operations(target, timeout);
+            
+        } else if (strcmp(command, "wal") == 0) {
+            show_wal();
+            
+        } else if (strcmp(command, "snapshot") == 0) {
+            if (wal_enabled()) {
+                checkpoint_state();
+            } else {
+                printf("Error: State log is disabled\n");
+            }
+            
+        } else if (strcmp(command, "raft") == 0) {
+            show_raft();
+            
+        } else if (strcmp(command, "reconcile") == 0) {
+            show_reconciler();
+            
+        } else if (strncmp(command, "reconcile ", 10) == 0) {
+            sscanf(command + 10, "%s", container_id);
+            reconciler_mark_dirty(container_id);
+            
+        } else if (strncmp(command, "rollout ", 8) == 0) {
+            char* arguments[8];
+            int argument_count = 0;
+            char* save = NULL;
+            for (char* token = strtok_r(command + 8, " \t", &save); token && argument_count < 8;
+                 token = strtok_r(NULL, " \t", &save)) {
+                arguments[argument_count++] = token;
+            }
+            rollout_command(arguments, argument_count);
+            
+        } else if (strcmp(command, "rollouts") == 0) {
+            show_rollouts();
+            
+        } else if (strcmp(command, "rebalance") == 0) {
+            if (accept_state_change()) {
+                rebalancer_trigger();
+            }
+            
+        } else if (strcmp(command, "rebalancer") == 0) {
+            show_rebalancer();
+            
+        } else if (strcmp(command, "preemption") == 0) {
+            show_preemption();
+            
+        } else if (strcmp(command, "tenants") == 0) {
+            show_tenants();
+            
+        } else if (strcmp(command, "admission") == 0) {
+            show_admission();
+            
+        } else if (strcmp(command, "events") == 0) {
+            show_events();
+            
+        } else if (strcmp(command, "jobs") == 0) {
+            show_command_pool();
+            
+        } else if (strcmp(command, "specs") == 0) {
+            show_spec_cache();
+            
+        } else if (strcmp(command, "specs clear") == 0) {
+            spec_cache_clear();
+            printf("Spec cache cleared\n");
+            
         } else if (strcmp(command, "quit") == 0) {
             break;
             
@@ -433,14 +2094,234 @@ void coordinator_command_loop(void) {
     }
 }
 
+// Gauges computed at scrape time: nodes and containers by state, per-node
+// resources and heartbeat age, operations in flight and replication role
+static void collect_coordinator_metrics(metrics_buffer_t* out) {
+    static int active_ids[MAX_OPERATIONS];
+    static tenant_info_t tenants[MAX_TENANTS];
+    static event_subscriber_info_t subscribers[EVENT_MAX_SUBSCRIBERS];
+    int container_states[CONTAINER_ERROR + 1] = {0};
+    int node_states[NODE_ERROR + 1] = {0};
+    preemption_status_t preemption;
+    static admission_node_info_t admission_nodes[MAX_NODES];
+    command_pool_status_t commands;
+    admission_status_t admission;
+    time_t now = time(NULL);
+    
+    lock_containers();
+    for (int i = 0; i < deployed_container_count; i++) {
+        container_states[deployed_containers[i].state]++;
+    }
+    pthread_mutex_unlock(&containers_mutex);
+    
+    metrics_gauge_header(out, "lxc_containers", "Containers in the registry by state");
+    for (int state = CONTAINER_STOPPED; state <= CONTAINER_ERROR; state++) {
+        metrics_printf(out, "lxc_containers{state=\"%s\"} %d\n",
+                       container_state_name(state), container_states[state]);
+    }
+    
+    lock_nodes();
+    for (int i = 0; i < node_count; i++) {
+        node_states[nodes[i].state]++;
+    }
+    
+    metrics_gauge_header(out, "lxc_nodes", "Registered nodes by state");
+    for (int state = NODE_DISCONNECTED; state <= NODE_ERROR; state++) {
+        metrics_printf(out, "lxc_nodes{state=\"%s\"} %d\n", node_state_name(state), node_states[state]);
+    }
+    
+    metrics_gauge_header(out, "lxc_node_cpu_usage_percent", "CPU usage last reported by a node");
+    for (int i = 0; i < node_count; i++) {
+        metrics_printf(out, "lxc_node_cpu_usage_percent{node=\"%s\"} %.2f\n",
+                       nodes[i].id, nodes[i].resources.cpu_usage);
+    }
+    metrics_gauge_header(out, "lxc_node_memory_usage_percent", "Memory usage last reported by a node");
+    for (int i = 0; i < node_count; i++) {
+        metrics_printf(out, "lxc_node_memory_usage_percent{node=\"%s\"} %.2f\n",
+                       nodes[i].id, nodes[i].resources.memory_usage);
+    }
+    metrics_gauge_header(out, "lxc_node_disk_usage_percent", "Disk usage last reported by a node");
+    for (int i = 0; i < node_count; i++) {
+        metrics_printf(out, "lxc_node_disk_usage_percent{node=\"%s\"} %.2f\n",
+                       nodes[i].id, nodes[i].resources.disk_usage);
+    }
+    metrics_gauge_header(out, "lxc_node_containers", "Containers placed on a node");
+    for (int i = 0; i < node_count; i++) {
+        metrics_printf(out, "lxc_node_containers{node=\"%s\"} %d\n", nodes[i].id, nodes[i].container_count);
+    }
+    metrics_gauge_header(out, "lxc_node_heartbeat_age_seconds", "Seconds since a node's last heartbeat");
+    for (int i = 0; i < node_count; i++) {
+        metrics_printf(out, "lxc_node_heartbeat_age_seconds{node=\"%s\"} %ld\n",
+                       nodes[i].id, (long)(now - nodes[i].last_heartbeat));
+    }
+    pthread_mutex_unlock(&nodes_mutex);
+    
+    metrics_gauge_header(out, "lxc_operations_in_flight", "Operations not yet finished");
+    metrics_printf(out, "lxc_operations_in_flight %d\n", operation_list_active(active_ids, MAX_OPERATIONS));
+    
+    preemption_status(&preemption);
+    metrics_gauge_header(out, "lxc_requeued_containers", "Evicted containers waiting to be placed again");
+    metrics_printf(out, "lxc_requeued_containers %d\n", preemption.waiting);
+    
+    int tenant_count = tenants_list(tenants, MAX_TENANTS);
+    metrics_gauge_header(out, "lxc_tenant_dominant_share", "Largest cluster resource share held by a tenant, over its weight");
+    for (int i = 0; i < tenant_count; i++) {
+        metrics_printf(out, "lxc_tenant_dominant_share{tenant=\"%s\"} %.4f\n",
+                       tenants[i].name, tenants[i].dominant_share);
+    }
+    metrics_gauge_header(out, "lxc_tenant_pending", "Deployments waiting in a tenant's queue");
+    for (int i = 0; i < tenant_count; i++) {
+        metrics_printf(out, "lxc_tenant_pending{tenant=\"%s\"} %d\n", tenants[i].name,
+                       tenants[i].pending);
+    }
+    
+    command_pool_status(&commands);
+    metrics_gauge_header(out, "lxc_commands_queued", "Commands waiting for or running on the command pool");
+    metrics_printf(out, "lxc_commands_queued %d\n", commands.queued);
+    
+    admission_status(&admission);
+    int admission_node_count = admission_list(admission_nodes, MAX_NODES);
+    metrics_gauge_header(out, "lxc_admission_queued", "Placed deploys waiting for admission");
+    metrics_printf(out, "lxc_admission_queued %d\n", admission.queued);
+    metrics_gauge_header(out, "lxc_admission_node_queued", "Placed deploys waiting for admission to a node");
+    for (int i = 0; i < admission_node_count; i++) {
+        metrics_printf(out, "lxc_admission_node_queued{node=\"%s\"} %d\n",
+                       admission_nodes[i].node_id, admission_nodes[i].queued);
+    }
+    metrics_gauge_header(out, "lxc_admission_oldest_wait_seconds", "Seconds the longest waiting deploy has waited");
+    metrics_printf(out, "lxc_admission_oldest_wait_seconds %.3f\n", admission.oldest_wait);
+    
+    metrics_gauge_header(out, "lxc_event_subscribers", "Registered event stream subscribers");
+    metrics_printf(out, "lxc_event_subscribers %d\n", events_list(subscribers, EVENT_MAX_SUBSCRIBERS));
+    
+    if (raft_enabled()) {
+        metrics_gauge_header(out, "lxc_raft_leader", "1 if this coordinator leads the cluster");
+        metrics_printf(out, "lxc_raft_leader %d\n", raft_is_leader() ? 1 : 0);
+    }
+}
+
+// Release coordinator resources
+void cleanup_resources(void) {
+    close_control();
+    wal_close();
+    cleanup_network_resources();
+}
+
+// Signal handler for cleanup
+static void coordinator_shutdown(int sig) {
+    (void)sig;
+    printf("\nShutting down coordinator...\n");
+    cleanup_resources();
+    exit(0);
+}
+
+// Push reloadable settings into the scheduler
+static void apply_coordinator_config(const daemon_config_t* config) {
+    scheduler_policy_t policy;
+    
+    if (scheduler_parse_policy(config->policy, &policy) == 0) {
+        scheduler_set_policy(policy);
+    } else {
+        printf("Warning: Unknown scheduler policy %s, keeping %s\n",
+               config->policy, scheduler_policy_name(scheduler_get_policy()));
+    }
+    
+    scheduler_set_headroom(config->headroom_percent);
+    scheduler_set_sample_size(config->sample_size);
+    scheduler_set_locality_bonus(config->locality_bonus);
+    scheduler_set_weights(config->cpu_weight, config->memory_weight,
+                          config->disk_weight, config->load_weight);
+    scheduler_set_heartbeat_timeout(config->heartbeat_timeout);
+    tenants_configure(config);
+    admission_configure(config);
+}
+
+// Workers may only register with the leader; others get its address
+static int check_registration(char* redirect, size_t size) {
+    if (!raft_enabled() || raft_is_leader()) return 0;
+    
+    char leader_ip[INET_ADDRSTRLEN];
+    int leader_port;
+    if (raft_leader_address(leader_ip, &leader_port) == 0) {
+        snprintf(redirect, size, "%s %d", leader_ip, leader_port);
+    } else {
+        redirect[0] = '\0';
+    }
+    return -1;
+}
+
+// Take over worker traffic after winning an election, or hand it off after losing it
+static void handle_leadership_change(int leader) {
+    if (leader) {
+        printf("This coordinator is now the cluster leader\n");
+        settle_recovered_containers();
+    } else {
+        printf("This coordinator is no longer the cluster leader\n");
+        disconnect_nodes();
+    }
+}
+
+// Start replication for a [cluster] configuration, before the state log is
+// opened so recovered entries reach the replicated log
+static int start_cluster(const daemon_config_t* config) {
+    raft_peer_t peers[MAX_RAFT_PEERS];
+    
+    if (strlen(config->state_dir) == 0) {
+        printf("Error: Cluster mode requires state_dir\n");
+        return -1;
+    }
+    
+    int peer_count = raft_parse_peers(config->cluster_peers, peers, MAX_RAFT_PEERS);
+    if (peer_count <= 0) {
+        printf("Error: No cluster peers configured\n");
+        return -1;
+    }
+    
+    return init_raft(config->state_dir, config->cluster_node_id, peers, peer_count,
+                     config->election_timeout_ms, replay_state_record, reset_state,
+                     handle_leadership_change);
+}
+
+// Run the coordinator server loop
+static void* coordinator_server_thread(void* arg) {
+    int port = *(int*)arg;
+    free(arg);
+    init_coordinator(port);
+    return NULL;
+}
+
 // Main coordinator function
 int main(int argc, char* argv[]) {
-    int port = DEFAULT_PORT;
+    const char* config_path = NULL;
+    int opt;
+    
+    while ((opt = getopt(argc, argv, "c:")) != -1) {
+        switch (opt) {
+            case 'c':
+                config_path = optarg;
+                break;
+            default:
+                printf("Usage: %s [-c config_file] [port]\n", argv[0]);
+                return 1;
+        }
+    }
+    
+    // Fall back to the installed config file when present
+    if (!config_path && access(DEFAULT_COORDINATOR_CONFIG, R_OK) == 0) {
+        config_path = DEFAULT_COORDINATOR_CONFIG;
+    }
+    
+    // Load settings before any thread starts so SIGHUP stays blocked in all of them
+    if (init_config(config_path, apply_coordinator_config) != 0) {
+        return 1;
+    }
     
-    if (argc > 1) {
-        port = atoi(argv[1]);
+    int port = config_current()->port;
+    
+    if (optind < argc) {
+        port = atoi(argv[optind]);
         if (port <= 0 || port > 65535) {
-            printf("Error: Invalid port number %s\n", argv[1]);
+            printf("Error: Invalid port number %s\n", argv[optind]);
             return 1;
         }
     }
@@ -448,8 +2329,62 @@ int main(int argc, char* argv[]) {
     printf("Starting Distributed LXC Coordinator on port %d\n", port);
     
     // Set up signal handling for cleanup
-    signal(SIGINT, cleanup_resources);
-    signal(SIGTERM, cleanup_resources);
+    signal(SIGINT, coordinator_shutdown);
+    signal(SIGTERM, coordinator_shutdown);
+    
+    containers_lock_wait = metrics_lock_histogram("containers");
+    
+    // Track operations and reconcile them with worker replies
+    if (init_operations() != 0) {
+        return 1;
+    }
+    set_operation_handler(apply_operation_result);
+    if (init_reconciler(reconcile_container) != 0) {
+        return 1;
+    }
+    if (init_rollout(list_group_members) != 0) {
+        return 1;
+    }
+    
+    if (init_rebalancer(list_all_containers) != 0) {
+        return 1;
+    }
+    
+    if (init_tenants(place_container) != 0) {
+        return 1;
+    }
+    
+    if (init_preemption(tenant_submit) != 0) {
+        return 1;
+    }
+    
+    if (init_events(control_wake) != 0 || init_spec_cache() != 0 ||
+        init_command_pool(config_current()->command_threads, control_item) != 0 ||
+        init_admission(dispatch_deploy) != 0) {
+        return 1;
+    }
+    set_message_handler(handle_worker_message);
+    set_disconnect_handler(handle_worker_disconnect);
+    set_registration_guard(check_registration);
+    
+    // Recover cluster state before workers can connect. In a cluster the log
+    // tail is replayed by the replication layer once it is known to be
+    // committed, and containers are settled by whoever becomes leader.
+    const daemon_config_t* config = config_current();
+    if (config->cluster_node_id > 0) {
+        if (start_cluster(config) != 0 ||
+            wal_open(config->state_dir, config->snapshot_interval,
+                     replay_state_record, raft_load_entry, checkpoint_state) != 0 ||
+            raft_start() != 0) {
+            return 1;
+        }
+    } else if (strlen(config->state_dir) > 0) {
+        if (wal_open(config->state_dir, config->snapshot_interval,
+                     replay_state_record, replay_state_record, checkpoint_state) != 0) {
+            return 1;
+        }
+        settle_recovered_containers();
+    }
     
     // Start coordinator in background thread
     pthread_t coordinator_thread;
@@ -457,7 +2392,7 @@ int main(int argc, char* argv[]) {
     *port_ptr = port;
     
     if (pthread_create(&coordinator_thread, NULL, 
-                      (void*(*)(void*))init_coordinator, port_ptr) != 0) {
+                      coordinator_server_thread, port_ptr) != 0) {
         printf("Error: Failed to start coordinator thread\n");
         return 1;
     }
@@ -465,6 +2400,14 @@ int main(int argc, char* argv[]) {
     // Give the server time to start
     sleep(1);
     
+    if (init_control(config->control_socket, config->control_port, handle_control_request,
+                     release_control_request) != 0) {
+        return 1;
+    }
+    if (init_metrics(config->metrics_port, collect_coordinator_metrics) != 0) {
+        return 1;
+    }
+    
     // Start interactive command loop
     coordinator_command_loop();
     
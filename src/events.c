@@ -0,0 +1,306 @@
+#include "../include/events.h"
+#include "../include/metrics.h"
+
+// One registered reader; events it has not acknowledged wait in a ring
+typedef struct {
+    int id;                        // 0 when the slot is free
+    event_filter_t filter;
+    event_t* ring;
+    int slots;
+    int head;                      // Oldest buffered event
+    int count;
+    unsigned long delivered;
+    unsigned long dropped;
+    unsigned long unacked_lost;    // Dropped events the reader has not read past yet
+    unsigned long lost_through;    // Sequence number of the newest of those
+    time_t last_read;
+} subscriber_t;
+
+// Subscribers and the sequence counter (protected by events_mutex)
+static subscriber_t subscribers[EVENT_MAX_SUBSCRIBERS];
+static unsigned long event_sequence = 0;
+static int next_subscriber_id = 1;
+static event_notify_t event_notify = NULL;
+static pthread_mutex_t events_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int published_counter = -1;
+static int dropped_counter = -1;
+
+// Register the event counters and the wake-up callback
+int init_events(event_notify_t notify) {
+    event_notify = notify;
+    published_counter = metrics_counter("lxc_events_published_total", NULL,
+                                        "Container and node events published");
+    dropped_counter = metrics_counter("lxc_events_dropped_total", NULL,
+                                      "Events dropped from a full subscriber buffer");
+    return 0;
+}
+
+// Release a subscriber's slot (caller holds events_mutex)
+static void free_subscriber_locked(subscriber_t* subscriber) {
+    free(subscriber->ring);
+    memset(subscriber, 0, sizeof(*subscriber));
+}
+
+// Drop subscribers nobody has read from for a while (caller holds events_mutex)
+static void expire_subscribers_locked(time_t now) {
+    for (int i = 0; i < EVENT_MAX_SUBSCRIBERS; i++) {
+        subscriber_t* subscriber = &subscribers[i];
+        if (subscriber->id && now - subscriber->last_read > EVENT_SUBSCRIBER_TIMEOUT) {
+            printf("Event subscriber %d expired after %ds without a read\n", subscriber->id,
+                   EVENT_SUBSCRIBER_TIMEOUT);
+            free_subscriber_locked(subscriber);
+        }
+    }
+}
+
+// Find an active subscriber (caller holds events_mutex)
+static subscriber_t* find_subscriber_locked(int subscriber_id) {
+    if (subscriber_id <= 0) return NULL;
+    for (int i = 0; i < EVENT_MAX_SUBSCRIBERS; i++) {
+        if (subscribers[i].id == subscriber_id) {
+            return &subscribers[i];
+        }
+    }
+    return NULL;
+}
+
+// Whether a filter lets an event through
+static int filter_matches(const event_filter_t* filter, const event_t* event) {
+    if (filter->kinds && !(filter->kinds & event->kind)) return 0;
+    if (filter->node_id[0] && strcmp(filter->node_id, event->node_id) != 0) return 0;
+    if (filter->name[0] && strcmp(filter->name, event->name) != 0 &&
+        strcmp(filter->name, event->id) != 0) {
+        return 0;
+    }
+    return 1;
+}
+
+// Number a change and buffer it for every subscriber whose filter matches.
+// Safe to call with registry locks held; events_mutex is taken last.
+void events_publish(event_kind_t kind, const char* action, const char* id, const char* name,
+                    const char* node_id, const char* state, const char* desired) {
+    event_t event;
+    int matched = 0;
+    unsigned long dropped = 0;
+
+    memset(&event, 0, sizeof(event));
+    event.time = time(NULL);
+    event.kind = kind;
+    strncpy(event.action, action, sizeof(event.action) - 1);
+    strncpy(event.id, id ? id : "-", MAX_NAME_LEN - 1);
+    strncpy(event.name, name ? name : event.id, MAX_NAME_LEN - 1);
+    strncpy(event.node_id, node_id && *node_id ? node_id : "-", MAX_NAME_LEN - 1);
+    strncpy(event.state, state ? state : "-", sizeof(event.state) - 1);
+    strncpy(event.desired, desired ? desired : "-", sizeof(event.desired) - 1);
+
+    pthread_mutex_lock(&events_mutex);
+    expire_subscribers_locked(event.time);
+    event.seq = ++event_sequence;
+
+    for (int i = 0; i < EVENT_MAX_SUBSCRIBERS; i++) {
+        subscriber_t* subscriber = &subscribers[i];
+        if (!subscriber->id || !filter_matches(&subscriber->filter, &event)) continue;
+
+        // A full buffer loses its oldest event; the reader learns of the gap
+        if (subscriber->count == subscriber->slots) {
+            subscriber->lost_through = subscriber->ring[subscriber->head].seq;
+            subscriber->head = (subscriber->head + 1) % subscriber->slots;
+            subscriber->count--;
+            subscriber->dropped++;
+            subscriber->unacked_lost++;
+            dropped++;
+        }
+        subscriber->ring[(subscriber->head + subscriber->count) % subscriber->slots] = event;
+        subscriber->count++;
+        matched = 1;
+    }
+    pthread_mutex_unlock(&events_mutex);
+
+    metrics_add(published_counter, 1);
+    if (dropped > 0) metrics_add(dropped_counter, dropped);
+    if (matched && event_notify) {
+        event_notify();
+    }
+}
+
+// Fill a filter from words like "container", "node", "node=<id>", "name=<name>"
+// and "slots=<n>"; -1 on a word it does not know
+int events_parse_filter(char** tokens, int count, event_filter_t* filter, int* slots) {
+    memset(filter, 0, sizeof(*filter));
+    *slots = EVENT_DEFAULT_SLOTS;
+
+    for (int i = 0; i < count; i++) {
+        const char* token = tokens[i];
+        if (strcmp(token, "container") == 0 || strcmp(token, "containers") == 0) {
+            filter->kinds |= EVENT_CONTAINER;
+        } else if (strcmp(token, "node") == 0 || strcmp(token, "nodes") == 0) {
+            filter->kinds |= EVENT_NODE;
+        } else if (strncmp(token, "node=", 5) == 0) {
+            strncpy(filter->node_id, token + 5, MAX_NAME_LEN - 1);
+        } else if (strncmp(token, "name=", 5) == 0) {
+            strncpy(filter->name, token + 5, MAX_NAME_LEN - 1);
+        } else if (strncmp(token, "slots=", 6) == 0) {
+            *slots = atoi(token + 6);
+            if (*slots < 1 || *slots > EVENT_MAX_SLOTS) {
+                printf("Error: Event buffer must hold 1 to %d events\n", EVENT_MAX_SLOTS);
+                return -1;
+            }
+        } else {
+            printf("Error: Unknown event filter %s\n", token);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+// Register a subscriber; it receives events published from now on. Returns
+// its id and the current sequence number, or -1 when every slot is taken.
+int events_subscribe(const event_filter_t* filter, int slots, unsigned long* seq) {
+    time_t now = time(NULL);
+
+    event_t* ring = malloc(sizeof(event_t) * slots);
+    if (!ring) {
+        printf("Error: No memory for a %d event subscriber buffer\n", slots);
+        return -1;
+    }
+
+    pthread_mutex_lock(&events_mutex);
+    expire_subscribers_locked(now);
+
+    for (int i = 0; i < EVENT_MAX_SUBSCRIBERS; i++) {
+        subscriber_t* subscriber = &subscribers[i];
+        if (subscriber->id) continue;
+
+        subscriber->id = next_subscriber_id++;
+        subscriber->filter = *filter;
+        subscriber->ring = ring;
+        subscriber->slots = slots;
+        subscriber->delivered = event_sequence;
+        subscriber->last_read = now;
+        if (seq) *seq = event_sequence;
+
+        int id = subscriber->id;
+        pthread_mutex_unlock(&events_mutex);
+        return id;
+    }
+    pthread_mutex_unlock(&events_mutex);
+
+    free(ring);
+    printf("Error: Too many event subscribers\n");
+    return -1;
+}
+
+// Remove a subscriber and its buffer
+int events_unsubscribe(int subscriber_id) {
+    pthread_mutex_lock(&events_mutex);
+    subscriber_t* subscriber = find_subscriber_locked(subscriber_id);
+    if (!subscriber) {
+        pthread_mutex_unlock(&events_mutex);
+        return -1;
+    }
+    free_subscriber_locked(subscriber);
+    pthread_mutex_unlock(&events_mutex);
+    return 0;
+}
+
+// Acknowledge every event up to cursor, or up to what the last read handed out
+// when there is no cursor, then copy the oldest unacknowledged events. Events
+// stay buffered until acknowledged, so a reader that lost a reply resumes by
+// reading again from its last cursor. lost counts events dropped after the
+// cursor. Returns the number copied, or -1 for an unknown subscriber.
+int events_read(int subscriber_id, int has_cursor, unsigned long cursor, event_t* events,
+                int max_events, unsigned long* lost) {
+    pthread_mutex_lock(&events_mutex);
+    subscriber_t* subscriber = find_subscriber_locked(subscriber_id);
+    if (!subscriber) {
+        pthread_mutex_unlock(&events_mutex);
+        return -1;
+    }
+
+    unsigned long acknowledged = has_cursor ? cursor : subscriber->delivered;
+    while (subscriber->count > 0 && subscriber->ring[subscriber->head].seq <= acknowledged) {
+        subscriber->head = (subscriber->head + 1) % subscriber->slots;
+        subscriber->count--;
+    }
+    if (subscriber->unacked_lost > 0 && acknowledged >= subscriber->lost_through) {
+        subscriber->unacked_lost = 0;
+    }
+
+    int copied = 0;
+    while (copied < max_events && copied < subscriber->count) {
+        events[copied] = subscriber->ring[(subscriber->head + copied) % subscriber->slots];
+        copied++;
+    }
+    if (copied > 0) {
+        subscriber->delivered = events[copied - 1].seq;
+    } else if (acknowledged > subscriber->delivered) {
+        subscriber->delivered = acknowledged;
+    }
+
+    if (lost) *lost = subscriber->unacked_lost;
+    subscriber->last_read = time(NULL);
+    pthread_mutex_unlock(&events_mutex);
+    return copied;
+}
+
+// Sequence number of the newest event
+unsigned long events_sequence(void) {
+    pthread_mutex_lock(&events_mutex);
+    unsigned long seq = event_sequence;
+    pthread_mutex_unlock(&events_mutex);
+    return seq;
+}
+
+// Copy the subscriber table for status output
+int events_list(event_subscriber_info_t* infos, int max_subscribers) {
+    int count = 0;
+
+    pthread_mutex_lock(&events_mutex);
+    for (int i = 0; i < EVENT_MAX_SUBSCRIBERS && count < max_subscribers; i++) {
+        subscriber_t* subscriber = &subscribers[i];
+        if (!subscriber->id) continue;
+
+        event_subscriber_info_t* info = &infos[count++];
+        info->id = subscriber->id;
+        info->filter = subscriber->filter;
+        info->slots = subscriber->slots;
+        info->buffered = subscriber->count;
+        info->delivered = subscriber->delivered;
+        info->dropped = subscriber->dropped;
+        info->last_read = subscriber->last_read;
+    }
+    pthread_mutex_unlock(&events_mutex);
+    return count;
+}
+
+// Print the sequence counter and every subscriber
+void show_events(void) {
+    static event_subscriber_info_t infos[EVENT_MAX_SUBSCRIBERS];
+    int count = events_list(infos, EVENT_MAX_SUBSCRIBERS);
+    time_t now = time(NULL);
+
+    printf("\n=== Events ===\n");
+    printf("Sequence: %lu  Subscribers: %d\n", events_sequence(), count);
+    printf("%-6s %-30s %-10s %-10s %-8s %-6s\n", "Id", "Filter", "Buffered", "Delivered",
+           "Dropped", "Idle");
+    printf("-------------------------------------------------------------------------------\n");
+    for (int i = 0; i < count; i++) {
+        const event_filter_t* filter = &infos[i].filter;
+        char text[64];
+        char buffered[32];
+
+        int length = snprintf(text, sizeof(text), "%s",
+                              filter->kinds == EVENT_CONTAINER ? "container " :
+                              filter->kinds == EVENT_NODE ? "node " : "");
+        if (filter->node_id[0]) {
+            length += snprintf(text + length, sizeof(text) - length, "node=%.20s ", filter->node_id);
+        }
+        if (filter->name[0]) {
+            snprintf(text + length, sizeof(text) - length, "name=%.20s", filter->name);
+        }
+        snprintf(buffered, sizeof(buffered), "%d/%d", infos[i].buffered, infos[i].slots);
+        printf("%-6d %-30s %-10s %-10lu %-8lu %lds\n", infos[i].id, text[0] ? text : "all",
+               buffered, infos[i].delivered, infos[i].dropped, (long)(now - infos[i].last_read));
+    }
+}
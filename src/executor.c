@@ -0,0 +1,198 @@
+#include "../include/executor.h"
+#include <stdint.h>
+
+// One submitted job
+typedef struct executor_task {
+    struct executor_task* next;
+    executor_job_t job;
+    void* arg;
+} executor_task_t;
+
+// Jobs for one key, run one at a time in submission order. A key exists
+// while it has jobs queued or running, and sits on the ready list while it
+// has jobs queued and none running.
+typedef struct executor_key {
+    struct executor_key* next;          // Hash bucket chain
+    struct executor_key* ready_next;
+    char name[MAX_NAME_LEN];
+    uint64_t hash;
+    executor_task_t* head;
+    executor_task_t* tail;
+    int running;
+} executor_key_t;
+
+// Keys, ready list and counters (protected by executor_mutex)
+static executor_key_t* key_buckets[EXECUTOR_KEY_BUCKETS];
+static executor_key_t* ready_head = NULL;
+static executor_key_t* ready_tail = NULL;
+static int thread_count = 0;
+static int queued_total = 0;
+static int running_total = 0;
+static int key_count = 0;
+static unsigned long completed_total = 0;
+static pthread_mutex_t executor_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t executor_ready = PTHREAD_COND_INITIALIZER;
+
+// 64-bit FNV-1a over a key
+static uint64_t hash_key(const char* key) {
+    uint64_t hash = 14695981039346656037ULL;
+    while (*key) {
+        hash ^= (unsigned char)*key++;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// Find a key, adding it if it has nothing pending (caller holds executor_mutex)
+static executor_key_t* find_key_locked(const char* name) {
+    uint64_t hash = hash_key(name);
+    executor_key_t** bucket = &key_buckets[hash & (EXECUTOR_KEY_BUCKETS - 1)];
+
+    for (executor_key_t* key = *bucket; key; key = key->next) {
+        if (key->hash == hash && strcmp(key->name, name) == 0) {
+            return key;
+        }
+    }
+
+    executor_key_t* key = calloc(1, sizeof(executor_key_t));
+    if (!key) return NULL;
+    strncpy(key->name, name, MAX_NAME_LEN - 1);
+    key->hash = hash;
+    key->next = *bucket;
+    *bucket = key;
+    key_count++;
+    return key;
+}
+
+// Forget a key with nothing queued or running (caller holds executor_mutex)
+static void drop_key_locked(executor_key_t* key) {
+    executor_key_t** link = &key_buckets[key->hash & (EXECUTOR_KEY_BUCKETS - 1)];
+    while (*link != key) {
+        link = &(*link)->next;
+    }
+    *link = key->next;
+    key_count--;
+    free(key);
+}
+
+// Queue a key whose next job may run (caller holds executor_mutex)
+static void make_ready_locked(executor_key_t* key) {
+    key->ready_next = NULL;
+    if (ready_tail) {
+        ready_tail->ready_next = key;
+    } else {
+        ready_head = key;
+    }
+    ready_tail = key;
+    pthread_cond_signal(&executor_ready);
+}
+
+// Runs the next job of whichever key has been ready longest; a key with
+// more work goes to the back so busy keys take turns
+static void* executor_thread(void* arg) {
+    (void)arg;
+
+    pthread_mutex_lock(&executor_mutex);
+    while (1) {
+        while (!ready_head) {
+            pthread_cond_wait(&executor_ready, &executor_mutex);
+        }
+
+        executor_key_t* key = ready_head;
+        ready_head = key->ready_next;
+        if (!ready_head) ready_tail = NULL;
+
+        executor_task_t* task = key->head;
+        key->head = task->next;
+        if (!key->head) key->tail = NULL;
+        key->running = 1;
+        queued_total--;
+        running_total++;
+        pthread_mutex_unlock(&executor_mutex);
+
+        task->job(task->arg);
+        free(task);
+
+        pthread_mutex_lock(&executor_mutex);
+        key->running = 0;
+        running_total--;
+        completed_total++;
+        if (key->head) {
+            make_ready_locked(key);
+        } else {
+            drop_key_locked(key);
+        }
+    }
+
+    return NULL;
+}
+
+// Start the executor threads
+int init_executor(int threads) {
+    if (threads < 1) threads = 1;
+    if (threads > EXECUTOR_MAX_THREADS) threads = EXECUTOR_MAX_THREADS;
+
+    for (int i = 0; i < threads; i++) {
+        pthread_t tid;
+        if (pthread_create(&tid, NULL, executor_thread, NULL) != 0) {
+            printf("Error: Failed to start executor thread %d\n", i);
+            return -1;
+        }
+        pthread_detach(tid);
+        pthread_mutex_lock(&executor_mutex);
+        thread_count++;
+        pthread_mutex_unlock(&executor_mutex);
+    }
+
+    printf("Executor started with %d threads\n", threads);
+    return 0;
+}
+
+// Queue a job behind any others with the same key; jobs with different keys
+// run in parallel. The job owns arg once this returns 0.
+int executor_submit(const char* key_name, executor_job_t job, void* arg) {
+    if (!key_name || !job) return -1;
+
+    executor_task_t* task = calloc(1, sizeof(executor_task_t));
+    if (!task) {
+        printf("Error: No memory to queue a command for %s\n", key_name);
+        return -1;
+    }
+    task->job = job;
+    task->arg = arg;
+
+    pthread_mutex_lock(&executor_mutex);
+    executor_key_t* key = find_key_locked(key_name);
+    if (!key) {
+        pthread_mutex_unlock(&executor_mutex);
+        free(task);
+        printf("Error: No memory to queue a command for %s\n", key_name);
+        return -1;
+    }
+
+    int idle = !key->head && !key->running;
+    if (key->tail) {
+        key->tail->next = task;
+    } else {
+        key->head = task;
+    }
+    key->tail = task;
+    queued_total++;
+
+    if (idle) {
+        make_ready_locked(key);
+    }
+    pthread_mutex_unlock(&executor_mutex);
+    return 0;
+}
+
+// Copy the executor counters
+void executor_status(executor_status_t* status) {
+    pthread_mutex_lock(&executor_mutex);
+    status->threads = thread_count;
+    status->queued = queued_total;
+    status->running = running_total;
+    status->keys = key_count;
+    status->completed = completed_total;
+    pthread_mutex_unlock(&executor_mutex);
+}
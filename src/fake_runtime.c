@@ -0,0 +1,402 @@
+#include "../include/lxc_manager.h"
+#include "../include/config.h"
+#include <stdint.h>
+
+#define FAKE_BUCKETS 4096               // Must be a power of two
+#define FAKE_MAX_IMAGES 64
+
+// Calls that take time and may fail
+enum { FAKE_CREATE, FAKE_START, FAKE_STOP, FAKE_DESTROY };
+
+// A container the fake runtime holds. Entries stay after a destroy so a
+// name's call count, and with it its draws, carry on if it is created again.
+typedef struct fake_container {
+    struct fake_container* next;        // Hash bucket chain
+    char name[MAX_NAME_LEN];
+    uint64_t hash;
+    int exists;
+    container_state_t state;
+    int cpu;                            // Requests, counted while running
+    int memory;
+    unsigned long calls;                // Draws made for this name
+} fake_container_t;
+
+// Containers, images and usage (protected by fake_mutex)
+static fake_container_t* fake_buckets[FAKE_BUCKETS];
+static int fake_count = 0;
+static int fake_cpu_used = 0;
+static int fake_memory_used = 0;
+static char fake_images[FAKE_MAX_IMAGES][MAX_NAME_LEN];
+static int fake_image_count = 0;
+static pthread_mutex_t fake_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// 64-bit FNV-1a over a name
+static uint64_t hash_name(const char* name) {
+    uint64_t hash = 14695981039346656037ULL;
+    while (*name) {
+        hash ^= (unsigned char)*name++;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// splitmix64 finalizer, spreads a counter into well mixed bits
+static uint64_t mix(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+// Find a container by name, adding an entry if asked (caller holds fake_mutex)
+static fake_container_t* find_locked(const char* name, int create) {
+    uint64_t hash = hash_name(name);
+    fake_container_t** bucket = &fake_buckets[hash & (FAKE_BUCKETS - 1)];
+
+    for (fake_container_t* container = *bucket; container; container = container->next) {
+        if (container->hash == hash && strcmp(container->name, name) == 0) {
+            return container;
+        }
+    }
+    if (!create) return NULL;
+
+    fake_container_t* container = calloc(1, sizeof(fake_container_t));
+    if (!container) return NULL;
+    strncpy(container->name, name, MAX_NAME_LEN - 1);
+    container->hash = hash;
+    container->state = CONTAINER_STOPPED;
+    container->next = *bucket;
+    *bucket = container;
+    return container;
+}
+
+// Latency and outcome of the next call on a container. The draw depends only
+// on the seed, the name and how many calls the name has had, so a run repeats
+// exactly whatever order the executor threads take. Returns 1 if it fails.
+static int draw_locked(fake_container_t* container, int call, int* latency_ms) {
+    const daemon_config_t* config = config_current();
+    static const int call_salt[] = { 0x11, 0x23, 0x35, 0x47 };
+    int base = 0;
+
+    switch (call) {
+        case FAKE_CREATE: base = config->fake_create_ms; break;
+        case FAKE_START: base = config->fake_start_ms; break;
+        case FAKE_STOP: base = config->fake_stop_ms; break;
+        case FAKE_DESTROY: base = config->fake_destroy_ms; break;
+    }
+
+    uint64_t first = mix(container->hash ^ mix(config->fake_seed) ^
+                         ((uint64_t)call_salt[call] << 56) ^ ++container->calls);
+    uint64_t second = mix(first);
+
+    int span = base * config->fake_jitter_percent / 100;
+    *latency_ms = base - span + (span > 0 ? (int)(first % (uint64_t)(2 * span + 1)) : 0);
+    return (second >> 11) * (1.0 / 9007199254740992.0) < config->fake_failure_rate;
+}
+
+// Wait out a call's latency
+static void fake_delay(int latency_ms) {
+    struct timespec delay = { latency_ms / 1000, (latency_ms % 1000) * 1000000L };
+    while (latency_ms > 0 && nanosleep(&delay, &delay) != 0) {
+        // Interrupted by a signal, sleep the rest
+    }
+}
+
+// Remember an image as cached on this node (caller holds fake_mutex)
+static void record_image_locked(const char* image) {
+    for (int i = 0; i < fake_image_count; i++) {
+        if (strcmp(fake_images[i], image) == 0) return;
+    }
+    int slot = fake_image_count < FAKE_MAX_IMAGES ? fake_image_count++ : FAKE_MAX_IMAGES - 1;
+    strncpy(fake_images[slot], image, MAX_NAME_LEN - 1);
+}
+
+// Move a container in or out of RUNNING, keeping usage in step (caller holds fake_mutex)
+static void set_state_locked(fake_container_t* container, container_state_t state) {
+    if (container->state == CONTAINER_RUNNING) {
+        fake_cpu_used -= container->cpu;
+        fake_memory_used -= container->memory;
+    }
+    container->state = state;
+    if (state == CONTAINER_RUNNING) {
+        fake_cpu_used += container->cpu;
+        fake_memory_used += container->memory;
+    }
+}
+
+// Create a container, stopped
+static int fake_create(const lxc_config_t* config) {
+    int latency_ms;
+
+    if (!config || strlen(config->name) == 0) {
+        printf("Error: Invalid container configuration\n");
+        return -1;
+    }
+
+    pthread_mutex_lock(&fake_mutex);
+    fake_container_t* container = find_locked(config->name, 1);
+    if (!container) {
+        pthread_mutex_unlock(&fake_mutex);
+        printf("Error creating container %s: out of memory\n", config->name);
+        return -1;
+    }
+    if (container->exists) {
+        pthread_mutex_unlock(&fake_mutex);
+        printf("Container %s already exists\n", config->name);
+        return 0;
+    }
+    int fails = draw_locked(container, FAKE_CREATE, &latency_ms);
+    pthread_mutex_unlock(&fake_mutex);
+
+    fake_delay(latency_ms);
+    if (fails) {
+        printf("Error creating container %s: injected failure\n", config->name);
+        return -1;
+    }
+
+    const char* image = (strlen(config->image) > 0) ? config->image : DEFAULT_IMAGE;
+    pthread_mutex_lock(&fake_mutex);
+    if (!container->exists) {
+        container->exists = 1;
+        container->state = CONTAINER_STOPPED;
+        container->cpu = config->cpu_limit;
+        container->memory = config->memory_limit;
+        fake_count++;
+    }
+    record_image_locked(image);
+    pthread_mutex_unlock(&fake_mutex);
+    return 0;
+}
+
+// Move an existing container to RUNNING or STOPPED; like LXD, asking for the
+// state it is already in fails
+static int fake_transition(const char* name, int call, container_state_t target) {
+    const char* verb = (call == FAKE_START) ? "starting" : "stopping";
+    int latency_ms;
+
+    if (!name) return -1;
+
+    pthread_mutex_lock(&fake_mutex);
+    fake_container_t* container = find_locked(name, 0);
+    if (!container || !container->exists) {
+        pthread_mutex_unlock(&fake_mutex);
+        printf("Error: Container %s does not exist\n", name);
+        return -1;
+    }
+    if (container->state == target) {
+        pthread_mutex_unlock(&fake_mutex);
+        printf("Error %s container %s: already %s\n", verb, name,
+               target == CONTAINER_RUNNING ? "running" : "stopped");
+        return -1;
+    }
+    int fails = draw_locked(container, call, &latency_ms);
+    pthread_mutex_unlock(&fake_mutex);
+
+    fake_delay(latency_ms);
+    if (fails) {
+        printf("Error %s container %s: injected failure\n", verb, name);
+        return -1;
+    }
+
+    pthread_mutex_lock(&fake_mutex);
+    if (container->exists) {
+        set_state_locked(container, target);
+    }
+    pthread_mutex_unlock(&fake_mutex);
+    return 0;
+}
+
+// Start a container
+static int fake_start(const char* name) {
+    return fake_transition(name, FAKE_START, CONTAINER_RUNNING);
+}
+
+// Stop a container
+static int fake_stop(const char* name) {
+    return fake_transition(name, FAKE_STOP, CONTAINER_STOPPED);
+}
+
+// Remove a container, stopping it first; a missing one counts as removed
+static int fake_destroy(const char* name) {
+    int latency_ms;
+
+    if (!name) return -1;
+
+    pthread_mutex_lock(&fake_mutex);
+    fake_container_t* container = find_locked(name, 0);
+    if (!container || !container->exists) {
+        pthread_mutex_unlock(&fake_mutex);
+        printf("Container %s does not exist\n", name);
+        return 0;
+    }
+    int fails = draw_locked(container, FAKE_DESTROY, &latency_ms);
+    pthread_mutex_unlock(&fake_mutex);
+
+    fake_delay(latency_ms);
+    if (fails) {
+        printf("Error destroying container %s: injected failure\n", name);
+        return -1;
+    }
+
+    pthread_mutex_lock(&fake_mutex);
+    if (container->exists) {
+        set_state_locked(container, CONTAINER_STOPPED);
+        container->exists = 0;
+        fake_count--;
+    }
+    pthread_mutex_unlock(&fake_mutex);
+    return 0;
+}
+
+// Check if a container exists
+static int fake_exists(const char* name) {
+    pthread_mutex_lock(&fake_mutex);
+    fake_container_t* container = find_locked(name, 0);
+    int exists = container && container->exists;
+    pthread_mutex_unlock(&fake_mutex);
+    return exists;
+}
+
+// Get container state
+static container_state_t fake_state(const char* name) {
+    container_state_t state = CONTAINER_ERROR;
+
+    pthread_mutex_lock(&fake_mutex);
+    fake_container_t* container = find_locked(name, 0);
+    if (container && container->exists) {
+        state = container->state;
+    }
+    pthread_mutex_unlock(&fake_mutex);
+    return state;
+}
+
+// Get the state of every container, returns the count
+static int fake_list(char (*names)[MAX_NAME_LEN], container_state_t* states, int max_containers) {
+    int count = 0;
+
+    if (!names || !states) return -1;
+
+    pthread_mutex_lock(&fake_mutex);
+    for (int i = 0; i < FAKE_BUCKETS && count < max_containers; i++) {
+        for (fake_container_t* container = fake_buckets[i]; container && count < max_containers;
+             container = container->next) {
+            if (!container->exists) continue;
+            strcpy(names[count], container->name);
+            states[count] = container->state;
+            count++;
+        }
+    }
+    pthread_mutex_unlock(&fake_mutex);
+    return count;
+}
+
+// Usage from the requests of running containers against the configured capacity
+static int fake_resources(resource_info_t* resources) {
+    const daemon_config_t* config = config_current();
+
+    if (!resources) return -1;
+
+    pthread_mutex_lock(&fake_mutex);
+    resources->cpu_usage = 100.0 * fake_cpu_used / config->fake_cpus;
+    resources->memory_usage = 100.0 * fake_memory_used / config->fake_memory;
+    resources->container_count = fake_count;
+    memset(resources->image_digest, 0, IMAGE_DIGEST_BYTES);
+    for (int i = 0; i < fake_image_count; i++) {
+        image_digest_add(resources->image_digest, fake_images[i]);
+    }
+    pthread_mutex_unlock(&fake_mutex);
+
+    if (resources->cpu_usage > 100.0) resources->cpu_usage = 100.0;
+    if (resources->memory_usage > 100.0) resources->memory_usage = 100.0;
+    resources->disk_usage = 0.0;
+    resources->max_containers = config->node_max_containers;
+    resources->cpu_capacity = config->fake_cpus;
+    resources->memory_capacity = config->fake_memory;
+    return 0;
+}
+
+// Stop a container and write its name and requests to a file
+static int fake_export(const char* name, const char* path, int stateful) {
+    (void)stateful;
+    if (!name || !path) return -1;
+
+    pthread_mutex_lock(&fake_mutex);
+    fake_container_t* container = find_locked(name, 0);
+    if (!container || !container->exists) {
+        pthread_mutex_unlock(&fake_mutex);
+        printf("Error: Container %s does not exist\n", name);
+        return -1;
+    }
+    set_state_locked(container, CONTAINER_STOPPED);
+    int cpu = container->cpu;
+    int memory = container->memory;
+    pthread_mutex_unlock(&fake_mutex);
+
+    FILE* file = fopen(path, "w");
+    if (!file) {
+        printf("Error exporting container %s: cannot create %s\n", name, path);
+        return -1;
+    }
+    fprintf(file, "%s\n%d %d\n", name, cpu, memory);
+    fclose(file);
+    return 0;
+}
+
+// Recreate a container, stopped, from a file made by fake_export
+static int fake_import(const char* path) {
+    lxc_config_t config;
+    char line[MAX_NAME_LEN] = "";
+
+    if (!path) return -1;
+
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        printf("Error importing %s: cannot open it\n", path);
+        return -1;
+    }
+    memset(&config, 0, sizeof(config));
+    int valid = fgets(line, sizeof(line), file) != NULL &&
+                fscanf(file, "%d %d", &config.cpu_limit, &config.memory_limit) == 2;
+    fclose(file);
+
+    line[strcspn(line, "\n")] = '\0';
+    if (!valid || strlen(line) == 0) {
+        printf("Error importing %s: not a fake runtime export\n", path);
+        return -1;
+    }
+
+    pthread_mutex_lock(&fake_mutex);
+    fake_container_t* container = find_locked(line, 1);
+    if (!container) {
+        pthread_mutex_unlock(&fake_mutex);
+        printf("Error importing %s: out of memory\n", path);
+        return -1;
+    }
+    if (container->exists) {
+        pthread_mutex_unlock(&fake_mutex);
+        printf("Error importing %s: container %s already exists\n", path, line);
+        return -1;
+    }
+    container->exists = 1;
+    container->state = CONTAINER_STOPPED;
+    container->cpu = config.cpu_limit;
+    container->memory = config.memory_limit;
+    fake_count++;
+    pthread_mutex_unlock(&fake_mutex);
+    return 0;
+}
+
+// In-memory runtime with configurable latencies and failures
+const runtime_backend_t fake_runtime = {
+    .name = "fake",
+    .create = fake_create,
+    .start = fake_start,
+    .stop = fake_stop,
+    .destroy = fake_destroy,
+    .exists = fake_exists,
+    .state = fake_state,
+    .list = fake_list,
+    .resources = fake_resources,
+    .export_container = fake_export,
+    .import_container = fake_import,
+};
@@ -0,0 +1,99 @@
+#include "../include/inventory.h"
+
+// 64-bit FNV-1a over a container name
+static uint64_t hash_name(const char* name) {
+    uint64_t hash = 14695981039346656037ULL;
+    while (*name) {
+        hash ^= (unsigned char)*name++;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// Final avalanche so (name, state) pairs spread over the whole word
+static uint64_t mix(uint64_t value) {
+    value ^= value >> 30;
+    value *= 0xbf58476d1ce4e5b9ULL;
+    value ^= value >> 27;
+    value *= 0x94d049bb133111ebULL;
+    value ^= value >> 31;
+    return value;
+}
+
+// Hash of one inventory item
+static uint64_t item_hash(const char* name, container_state_t state) {
+    return mix(hash_name(name) ^ ((uint64_t)(state + 1) * 0x9e3779b97f4a7c15ULL));
+}
+
+// Empty the tree
+void inventory_reset(inventory_tree_t* tree) {
+    memset(tree, 0, sizeof(inventory_tree_t));
+}
+
+// Leaf a container name belongs to
+int inventory_leaf_of(const char* name) {
+    return (int)(hash_name(name) >> 56);
+}
+
+// Add a container to the tree
+void inventory_add(inventory_tree_t* tree, const char* name, container_state_t state) {
+    uint64_t hash = item_hash(name, state);
+    int leaf = inventory_leaf_of(name);
+
+    tree->leaves[leaf] += hash;
+    tree->branches[leaf / INVENTORY_FANOUT] += hash;
+    tree->root += hash;
+    tree->count++;
+}
+
+// Remove a container previously added with the same state
+void inventory_remove(inventory_tree_t* tree, const char* name, container_state_t state) {
+    uint64_t hash = item_hash(name, state);
+    int leaf = inventory_leaf_of(name);
+
+    tree->leaves[leaf] -= hash;
+    tree->branches[leaf / INVENTORY_FANOUT] -= hash;
+    tree->root -= hash;
+    tree->count--;
+}
+
+// Append one item to an ITEMS reply, -1 if it does not fit
+int inventory_append_item(char* buffer, size_t* length, size_t capacity,
+                          const char* name, container_state_t state) {
+    size_t name_length = strlen(name);
+    if (name_length > 255) name_length = 255;
+
+    size_t needed = sizeof(uint16_t) + 2 + name_length;
+    if (*length + needed > capacity) return -1;
+
+    uint16_t leaf = (uint16_t)inventory_leaf_of(name);
+    char* out = buffer + *length;
+
+    memcpy(out, &leaf, sizeof(leaf));
+    out[2] = (char)state;
+    out[3] = (char)name_length;
+    memcpy(out + 4, name, name_length);
+
+    *length += needed;
+    return 0;
+}
+
+// Read one item from an ITEMS reply, returns the bytes consumed or 0 if the
+// data is truncated
+size_t inventory_read_item(const char* data, size_t size, int* leaf,
+                           char* name, container_state_t* state) {
+    if (size < 4) return 0;
+
+    uint16_t leaf_number;
+    memcpy(&leaf_number, data, sizeof(leaf_number));
+
+    size_t name_length = (unsigned char)data[3];
+    if (size < 4 + name_length || leaf_number >= INVENTORY_LEAVES) return 0;
+
+    *leaf = leaf_number;
+    *state = (container_state_t)(unsigned char)data[2];
+    memcpy(name, data + 4, name_length);
+    name[name_length] = '\0';
+
+    return 4 + name_length;
+}
@@ -1,6 +1,15 @@
 #include "../include/lxc_manager.h"
+#include "../include/config.h"
 #include <sys/wait.h>
 
+#define MAX_LAUNCHED_IMAGES 64
+#define IMAGE_DIGEST_HASHES 3
+
+// Images this worker has launched from, remote images are cached by LXD after first use
+static char launched_images[MAX_LAUNCHED_IMAGES][MAX_NAME_LEN];
+static int launched_image_count = 0;
+static pthread_mutex_t launched_images_mutex = PTHREAD_MUTEX_INITIALIZER;
+
 // Execute a system command and return the exit code
 int execute_command(const char* command, char* output, size_t output_size) {
     FILE* pipe = popen(command, "r");
@@ -19,7 +28,7 @@ int execute_command(const char* command, char* output, size_t output_size) {
 }
 
 // Check if LXC container exists
-int lxc_container_exists(const char* name) {
+static int lxd_exists(const char* name) {
     char command[MAX_COMMAND_LEN];
     snprintf(command, sizeof(command), "lxc info %s >/dev/null 2>&1", name);
     return (execute_command(command, NULL, 0) == 0) ? 1 : 0;
@@ -77,8 +86,28 @@ int generate_lxc_config_file(const lxc_config_t* config, const char* output_path
     return 0;
 }
 
+// Remember an image that is now in the local LXD image cache
+static void record_launched_image(const char* image) {
+    pthread_mutex_lock(&launched_images_mutex);
+    
+    for (int i = 0; i < launched_image_count; i++) {
+        if (strcmp(launched_images[i], image) == 0) {
+            pthread_mutex_unlock(&launched_images_mutex);
+            return;
+        }
+    }
+    
+    // Oldest entry makes room once the list is full
+    int slot = launched_image_count < MAX_LAUNCHED_IMAGES ?
+               launched_image_count++ : MAX_LAUNCHED_IMAGES - 1;
+    strncpy(launched_images[slot], image, MAX_NAME_LEN - 1);
+    launched_images[slot][MAX_NAME_LEN - 1] = '\0';
+    
+    pthread_mutex_unlock(&launched_images_mutex);
+}
+
 // Create LXC container
-int lxc_create_container(const lxc_config_t* config) {
+static int lxd_create(const lxc_config_t* config) {
     if (!config || strlen(config->name) == 0) {
         printf("Error: Invalid container configuration\n");
         return -1;
@@ -88,19 +117,14 @@ int lxc_create_container(const lxc_config_t* config) {
     char output[MAX_LOG_LEN];
     
     // Check if container already exists
-    if (lxc_container_exists(config->name)) {
+    if (lxd_exists(config->name)) {
         printf("Container %s already exists\n", config->name);
         return 0;
     }
     
     // Create container with specified image
-    if (strlen(config->image) > 0) {
-        snprintf(command, sizeof(command), 
-                "lxc launch %s %s", config->image, config->name);
-    } else {
-        snprintf(command, sizeof(command), 
-                "lxc launch ubuntu:20.04 %s", config->name);
-    }
+    const char* image = (strlen(config->image) > 0) ? config->image : DEFAULT_IMAGE;
+    snprintf(command, sizeof(command), "lxc launch %s %s", image, config->name);
     
     printf("Creating container: %s\n", command);
     int result = execute_command(command, output, sizeof(output));
@@ -110,6 +134,8 @@ int lxc_create_container(const lxc_config_t* config) {
         return -1;
     }
     
+    record_launched_image(image);
+    
     // Stop the container (it starts automatically)
     snprintf(command, sizeof(command), "lxc stop %s", config->name);
     execute_command(command, NULL, 0);
@@ -151,13 +177,13 @@ int lxc_create_container(const lxc_config_t* config) {
 }
 
 // Start LXC container
-int lxc_start_container(const char* name) {
+static int lxd_start(const char* name) {
     if (!name) return -1;
     
     char command[MAX_COMMAND_LEN];
     char output[MAX_LOG_LEN];
     
-    if (!lxc_container_exists(name)) {
+    if (!lxd_exists(name)) {
         printf("Error: Container %s does not exist\n", name);
         return -1;
     }
@@ -176,13 +202,13 @@ int lxc_start_container(const char* name) {
 }
 
 // Stop LXC container
-int lxc_stop_container(const char* name) {
+static int lxd_stop(const char* name) {
     if (!name) return -1;
     
     char command[MAX_COMMAND_LEN];
     char output[MAX_LOG_LEN];
     
-    if (!lxc_container_exists(name)) {
+    if (!lxd_exists(name)) {
         printf("Error: Container %s does not exist\n", name);
         return -1;
     }
@@ -200,20 +226,75 @@ int lxc_stop_container(const char* name) {
     return 0;
 }
 
+// Forward declaration, export checks the state before stopping
+static container_state_t lxd_state(const char* name);
+
+// Stop a container and export it to a tarball, optionally keeping its runtime state
+static int lxd_export(const char* name, const char* path, int stateful) {
+    if (!name || !path) return -1;
+    
+    char command[MAX_COMMAND_LEN];
+    char output[MAX_LOG_LEN];
+    
+    if (!lxd_exists(name)) {
+        printf("Error: Container %s does not exist\n", name);
+        return -1;
+    }
+    
+    if (lxd_state(name) == CONTAINER_RUNNING) {
+        snprintf(command, sizeof(command), "lxc stop %s%s", stateful ? "--stateful " : "", name);
+        if (execute_command(command, output, sizeof(output)) != 0) {
+            printf("Error stopping container %s for export: %s\n", name, output);
+            return -1;
+        }
+    }
+    
+    snprintf(command, sizeof(command), "lxc export %s %s --instance-only", name, path);
+    printf("Exporting container: %s\n", name);
+    
+    int result = execute_command(command, output, sizeof(output));
+    if (result != 0) {
+        printf("Error exporting container %s: %s\n", name, output);
+        unlink(path);
+        return -1;
+    }
+    
+    return 0;
+}
+
+// Import a container from a tarball made by lxd_export
+static int lxd_import(const char* path) {
+    if (!path) return -1;
+    
+    char command[MAX_COMMAND_LEN];
+    char output[MAX_LOG_LEN];
+    
+    snprintf(command, sizeof(command), "lxc import %s", path);
+    printf("Importing container from %s\n", path);
+    
+    int result = execute_command(command, output, sizeof(output));
+    if (result != 0) {
+        printf("Error importing %s: %s\n", path, output);
+        return -1;
+    }
+    
+    return 0;
+}
+
 // Destroy LXC container
-int lxc_destroy_container(const char* name) {
+static int lxd_destroy(const char* name) {
     if (!name) return -1;
     
     char command[MAX_COMMAND_LEN];
     char output[MAX_LOG_LEN];
     
-    if (!lxc_container_exists(name)) {
+    if (!lxd_exists(name)) {
         printf("Container %s does not exist\n", name);
         return 0;
     }
     
     // Stop container first if running
-    lxc_stop_container(name);
+    lxd_stop(name);
     
     snprintf(command, sizeof(command), "lxc delete %s", name);
     printf("Destroying container: %s\n", name);
@@ -228,14 +309,29 @@ int lxc_destroy_container(const char* name) {
     return 0;
 }
 
+// Map an LXD status column to a container state
+static container_state_t parse_container_state(const char* status) {
+    if (strstr(status, "RUNNING")) {
+        return CONTAINER_RUNNING;
+    } else if (strstr(status, "STOPPED")) {
+        return CONTAINER_STOPPED;
+    } else if (strstr(status, "STARTING")) {
+        return CONTAINER_STARTING;
+    } else if (strstr(status, "STOPPING")) {
+        return CONTAINER_STOPPING;
+    }
+    
+    return CONTAINER_ERROR;
+}
+
 // Get container state
-container_state_t lxc_get_container_state(const char* name) {
+static container_state_t lxd_state(const char* name) {
     if (!name) return CONTAINER_ERROR;
     
     char command[MAX_COMMAND_LEN];
     char output[MAX_LOG_LEN];
     
-    if (!lxc_container_exists(name)) {
+    if (!lxd_exists(name)) {
         return CONTAINER_ERROR;
     }
     
@@ -246,21 +342,40 @@ container_state_t lxc_get_container_state(const char* name) {
     }
     
     // Parse output to determine state
-    if (strstr(output, "RUNNING")) {
-        return CONTAINER_RUNNING;
-    } else if (strstr(output, "STOPPED")) {
-        return CONTAINER_STOPPED;
-    } else if (strstr(output, "STARTING")) {
-        return CONTAINER_STARTING;
-    } else if (strstr(output, "STOPPING")) {
-        return CONTAINER_STOPPING;
+    return parse_container_state(output);
+}
+
+// Get the state of every container with one lxc call, returns the count or -1
+static int lxd_list(char (*names)[MAX_NAME_LEN], container_state_t* states,
+                    int max_containers) {
+    if (!names || !states) return -1;
+    
+    FILE* pipe = popen("lxc list --format csv -c ns", "r");
+    if (!pipe) {
+        printf("Error: Failed to list containers\n");
+        return -1;
     }
     
-    return CONTAINER_ERROR;
+    char line[MAX_COMMAND_LEN];
+    int count = 0;
+    
+    while (count < max_containers && fgets(line, sizeof(line), pipe)) {
+        char* comma = strchr(line, ',');
+        if (!comma) continue;
+        
+        *comma = '\0';
+        strncpy(names[count], line, MAX_NAME_LEN - 1);
+        names[count][MAX_NAME_LEN - 1] = '\0';
+        states[count] = parse_container_state(comma + 1);
+        count++;
+    }
+    
+    int exit_code = pclose(pipe);
+    return (WEXITSTATUS(exit_code) == 0) ? count : -1;
 }
 
 // Get system resource information
-int get_system_resources(resource_info_t* resources) {
+static int lxd_resources(resource_info_t* resources) {
     if (!resources) return -1;
     
     char command[MAX_COMMAND_LEN];
@@ -294,7 +409,31 @@ int get_system_resources(resource_info_t* resources) {
     }
     
     // Set max containers (configurable)
-    resources->max_containers = 50;
+    resources->max_containers = config_current()->node_max_containers;
+    
+    // Digest of cached images: aliases known to LXD plus images launched from
+    memset(resources->image_digest, 0, IMAGE_DIGEST_BYTES);
+    snprintf(command, sizeof(command), "lxc image list --format csv -c l 2>/dev/null");
+    if (execute_command(command, output, sizeof(output)) == 0) {
+        char* saveptr = NULL;
+        for (char* alias = strtok_r(output, "\n,", &saveptr); alias;
+             alias = strtok_r(NULL, "\n,", &saveptr)) {
+            if (strlen(alias) > 0) {
+                image_digest_add(resources->image_digest, alias);
+            }
+        }
+    }
+    
+    pthread_mutex_lock(&launched_images_mutex);
+    for (int i = 0; i < launched_image_count; i++) {
+        image_digest_add(resources->image_digest, launched_images[i]);
+    }
+    pthread_mutex_unlock(&launched_images_mutex);
+    
+    // Allocatable capacity for request based scheduling
+    resources->cpu_capacity = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    resources->memory_capacity = (int)((long long)sysconf(_SC_PHYS_PAGES) *
+                                       sysconf(_SC_PAGESIZE) / (1024 * 1024));
     
     return 0;
 }
@@ -305,7 +444,7 @@ int monitor_container(const char* name, char* log_buffer, size_t buffer_size) {
     
     char command[MAX_COMMAND_LEN];
     
-    if (!lxc_container_exists(name)) {
+    if (!lxd_exists(name)) {
         snprintf(log_buffer, buffer_size, "Container %s does not exist", name);
         return -1;
     }
@@ -318,4 +457,133 @@ int monitor_container(const char* name, char* log_buffer, size_t buffer_size) {
     }
     
     return 0;
-}
\ No newline at end of file
+}
+
+// The LXD command line client
+const runtime_backend_t lxd_runtime = {
+    .name = "lxd",
+    .create = lxd_create,
+    .start = lxd_start,
+    .stop = lxd_stop,
+    .destroy = lxd_destroy,
+    .exists = lxd_exists,
+    .state = lxd_state,
+    .list = lxd_list,
+    .resources = lxd_resources,
+    .export_container = lxd_export,
+    .import_container = lxd_import,
+};
+
+// Backend the lxc_* functions run through, chosen before any thread starts
+static const runtime_backend_t* runtime = &lxd_runtime;
+
+// Select the runtime backend by name
+int lxc_set_runtime(const char* name) {
+    static const runtime_backend_t* backends[] = { &lxd_runtime, &fake_runtime };
+    
+    for (size_t i = 0; i < sizeof(backends) / sizeof(backends[0]); i++) {
+        if (name && strcmp(name, backends[i]->name) == 0) {
+            runtime = backends[i];
+            return 0;
+        }
+    }
+    
+    printf("Error: Unknown container runtime %s\n", name ? name : "(null)");
+    return -1;
+}
+
+// Name of the selected runtime backend
+const char* lxc_runtime_name(void) {
+    return runtime->name;
+}
+
+// Create a container, stopped
+int lxc_create_container(const lxc_config_t* config) {
+    return runtime->create(config);
+}
+
+// Start a container
+int lxc_start_container(const char* name) {
+    return runtime->start(name);
+}
+
+// Stop a container
+int lxc_stop_container(const char* name) {
+    return runtime->stop(name);
+}
+
+// Stop and remove a container; one that does not exist counts as removed
+int lxc_destroy_container(const char* name) {
+    return runtime->destroy(name);
+}
+
+// Check if a container exists
+int lxc_container_exists(const char* name) {
+    return name ? runtime->exists(name) : 0;
+}
+
+// Get container state
+container_state_t lxc_get_container_state(const char* name) {
+    return name ? runtime->state(name) : CONTAINER_ERROR;
+}
+
+// Get the state of every container, returns the count or -1
+int lxc_list_container_states(char (*names)[MAX_NAME_LEN], container_state_t* states,
+                              int max_containers) {
+    return runtime->list(names, states, max_containers);
+}
+
+// Get system resource information
+int get_system_resources(resource_info_t* resources) {
+    return runtime->resources(resources);
+}
+
+// Stop a container and export it to a file, optionally keeping its runtime state
+int lxc_export_container(const char* name, const char* path, int stateful) {
+    return runtime->export_container(name, path, stateful);
+}
+
+// Import a container from a file made by lxc_export_container
+int lxc_import_container(const char* path) {
+    return runtime->import_container(path);
+}
+
+// Bit positions of an image name in the digest (FNV-1a with double hashing)
+static void image_digest_bits(const char* image, unsigned int bits[IMAGE_DIGEST_HASHES]) {
+    unsigned long long hash = 14695981039346656037ULL;
+    for (const char* p = image; *p; p++) {
+        hash ^= (unsigned char)*p;
+        hash *= 1099511628211ULL;
+    }
+    
+    unsigned int h1 = (unsigned int)hash;
+    unsigned int h2 = (unsigned int)(hash >> 32) | 1;
+    for (int i = 0; i < IMAGE_DIGEST_HASHES; i++) {
+        bits[i] = (h1 + i * h2) % (IMAGE_DIGEST_BYTES * 8);
+    }
+}
+
+// Add an image name to a cache digest
+void image_digest_add(unsigned char* digest, const char* image) {
+    if (!digest || !image) return;
+    
+    unsigned int bits[IMAGE_DIGEST_HASHES];
+    image_digest_bits(image, bits);
+    for (int i = 0; i < IMAGE_DIGEST_HASHES; i++) {
+        digest[bits[i] / 8] |= (unsigned char)(1 << (bits[i] % 8));
+    }
+}
+
+// Check whether an image is probably in a cache digest (false positives possible)
+int image_digest_contains(const unsigned char* digest, const char* image) {
+    if (!digest || !image) return 0;
+    
+    unsigned int bits[IMAGE_DIGEST_HASHES];
+    image_digest_bits(image, bits);
+    for (int i = 0; i < IMAGE_DIGEST_HASHES; i++) {
+        if (!(digest[bits[i] / 8] & (1 << (bits[i] % 8)))) {
+            return 0;
+        }
+    }
+    return 1;
+}
@@ -0,0 +1,352 @@
+#include "../include/metrics.h"
+#include <stdarg.h>
+
+// Counter words live in per-thread shards so the hot path only touches its own
+// cache lines; a scrape sums the shards. Series are registered once and never
+// removed, so their slots can be read without the registry lock.
+typedef struct {
+    uint64_t values[METRICS_MAX_SLOTS];
+} __attribute__((aligned(64))) metrics_shard_t;
+
+typedef struct {
+    char name[96];
+    char labels[160];      // Prometheus label pairs without braces, may be empty
+    char help[160];
+    int histogram;
+    int slot;              // First counter word
+} metrics_series_t;
+
+static metrics_shard_t shards[METRICS_SHARDS];
+static metrics_series_t series[METRICS_MAX_SERIES];
+static int series_count = 0;
+static int slots_used = 0;
+static int next_shard = 0;
+static __thread int thread_shard = -1;
+static pthread_mutex_t registry_mutex = PTHREAD_MUTEX_INITIALIZER;
+static metrics_collector_t metrics_collector = NULL;
+
+// Upper bounds of the finite latency buckets in seconds; the last bucket is +Inf
+static const double bucket_bounds[METRICS_BUCKETS - 1] = {
+    0.0001, 0.0005, 0.001, 0.005, 0.01, 0.05, 0.1, 0.5, 1, 5, 10, 30
+};
+
+// Register a series, or return the existing one with the same name and labels
+static int register_series(const char* name, const char* labels, const char* help, int histogram) {
+    int slots = histogram ? METRICS_HISTOGRAM_SLOTS : 1;
+    int id = -1;
+
+    if (!labels) labels = "";
+
+    pthread_mutex_lock(&registry_mutex);
+
+    for (int i = 0; i < series_count; i++) {
+        if (strcmp(series[i].name, name) == 0 && strcmp(series[i].labels, labels) == 0) {
+            pthread_mutex_unlock(&registry_mutex);
+            return i;
+        }
+    }
+
+    if (series_count < METRICS_MAX_SERIES && slots_used + slots <= METRICS_MAX_SLOTS) {
+        metrics_series_t* entry = &series[series_count];
+        strncpy(entry->name, name, sizeof(entry->name) - 1);
+        strncpy(entry->labels, labels, sizeof(entry->labels) - 1);
+        strncpy(entry->help, help, sizeof(entry->help) - 1);
+        entry->histogram = histogram;
+        entry->slot = slots_used;
+        slots_used += slots;
+        id = series_count++;
+    } else {
+        printf("Warning: Metric %s not registered, registry is full\n", name);
+    }
+
+    pthread_mutex_unlock(&registry_mutex);
+    return id;
+}
+
+// Register a monotonically increasing counter
+int metrics_counter(const char* name, const char* labels, const char* help) {
+    return register_series(name, labels, help, 0);
+}
+
+// Register a latency histogram in seconds
+int metrics_histogram(const char* name, const char* labels, const char* help) {
+    return register_series(name, labels, help, 1);
+}
+
+// Register the wait-time histogram of one named lock
+int metrics_lock_histogram(const char* lock) {
+    char labels[MAX_NAME_LEN];
+    snprintf(labels, sizeof(labels), "lock=\"%s\"", lock);
+    return metrics_histogram("lxc_lock_wait_seconds", labels, "Time spent waiting to acquire a lock");
+}
+
+// The calling thread's shard, assigned on first use
+static uint64_t* shard_values(void) {
+    if (thread_shard < 0) {
+        thread_shard = __atomic_fetch_add(&next_shard, 1, __ATOMIC_RELAXED) % METRICS_SHARDS;
+    }
+    return shards[thread_shard].values;
+}
+
+// Add to a counter
+void metrics_add(int id, uint64_t value) {
+    if (id < 0) return;
+    __atomic_fetch_add(&shard_values()[series[id].slot], value, __ATOMIC_RELAXED);
+}
+
+// Record one latency sample
+void metrics_observe(int id, double seconds) {
+    if (id < 0) return;
+
+    uint64_t* values = shard_values() + series[id].slot;
+    int bucket = 0;
+    while (bucket < METRICS_BUCKETS - 1 && seconds > bucket_bounds[bucket]) {
+        bucket++;
+    }
+
+    __atomic_fetch_add(&values[bucket], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&values[METRICS_BUCKETS], (uint64_t)(seconds * 1000000.0), __ATOMIC_RELAXED);
+    __atomic_fetch_add(&values[METRICS_BUCKETS + 1], 1, __ATOMIC_RELAXED);
+}
+
+// Seconds since a CLOCK_MONOTONIC timestamp
+double metrics_elapsed(const struct timespec* start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+// Lock a mutex and record how long the caller waited; the uncontended case
+// costs one trylock and no clock read
+void metrics_lock(pthread_mutex_t* mutex, int histogram) {
+    if (pthread_mutex_trylock(mutex) == 0) {
+        metrics_observe(histogram, 0.0);
+        return;
+    }
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    pthread_mutex_lock(mutex);
+    metrics_observe(histogram, metrics_elapsed(&start));
+}
+
+// Append formatted text to the scrape output, up to METRICS_MAX_BODY
+void metrics_printf(metrics_buffer_t* out, const char* format, ...) {
+    va_list args;
+
+    while (1) {
+        size_t room = out->capacity - out->length;
+
+        if (room > 0) {
+            va_start(args, format);
+            int written = vsnprintf(out->data + out->length, room, format, args);
+            va_end(args);
+
+            if (written < 0) return;
+            if ((size_t)written < room) {
+                out->length += written;
+                return;
+            }
+        }
+
+        size_t capacity = out->capacity ? out->capacity * 2 : 16384;
+        if (capacity > METRICS_MAX_BODY || out->capacity == METRICS_MAX_BODY) return;
+
+        char* grown = realloc(out->data, capacity);
+        if (!grown) return;
+        out->data = grown;
+        out->capacity = capacity;
+    }
+}
+
+// HELP and TYPE lines for a gauge written by a collector
+void metrics_gauge_header(metrics_buffer_t* out, const char* name, const char* help) {
+    metrics_printf(out, "# HELP %s %s\n# TYPE %s gauge\n", name, help, name);
+}
+
+// Sum a counter word over every shard
+static uint64_t slot_total(int slot) {
+    uint64_t total = 0;
+    for (int i = 0; i < METRICS_SHARDS; i++) {
+        total += __atomic_load_n(&shards[i].values[slot], __ATOMIC_RELAXED);
+    }
+    return total;
+}
+
+// Write one series in the Prometheus text format
+static void render_series(metrics_buffer_t* out, const metrics_series_t* entry) {
+    const char* separator = entry->labels[0] ? "," : "";
+
+    if (!entry->histogram) {
+        if (entry->labels[0]) {
+            metrics_printf(out, "%s{%s} %llu\n", entry->name, entry->labels,
+                           (unsigned long long)slot_total(entry->slot));
+        } else {
+            metrics_printf(out, "%s %llu\n", entry->name, (unsigned long long)slot_total(entry->slot));
+        }
+        return;
+    }
+
+    uint64_t cumulative = 0;
+    for (int bucket = 0; bucket < METRICS_BUCKETS; bucket++) {
+        cumulative += slot_total(entry->slot + bucket);
+        if (bucket < METRICS_BUCKETS - 1) {
+            metrics_printf(out, "%s_bucket{%s%sle=\"%g\"} %llu\n", entry->name, entry->labels,
+                           separator, bucket_bounds[bucket], (unsigned long long)cumulative);
+        } else {
+            metrics_printf(out, "%s_bucket{%s%sle=\"+Inf\"} %llu\n", entry->name, entry->labels,
+                           separator, (unsigned long long)cumulative);
+        }
+    }
+
+    double sum = slot_total(entry->slot + METRICS_BUCKETS) / 1000000.0;
+    unsigned long long count = slot_total(entry->slot + METRICS_BUCKETS + 1);
+    if (entry->labels[0]) {
+        metrics_printf(out, "%s_sum{%s} %.6f\n%s_count{%s} %llu\n", entry->name, entry->labels,
+                       sum, entry->name, entry->labels, count);
+    } else {
+        metrics_printf(out, "%s_sum %.6f\n%s_count %llu\n", entry->name, sum, entry->name, count);
+    }
+}
+
+// Write every registered series grouped by name, then the collector's gauges
+static void render_metrics(metrics_buffer_t* out) {
+    pthread_mutex_lock(&registry_mutex);
+    int count = series_count;
+    pthread_mutex_unlock(&registry_mutex);
+
+    for (int i = 0; i < count; i++) {
+        int seen = 0;
+        for (int j = 0; j < i && !seen; j++) {
+            seen = (strcmp(series[j].name, series[i].name) == 0);
+        }
+        if (seen) continue;
+
+        metrics_printf(out, "# HELP %s %s\n# TYPE %s %s\n", series[i].name, series[i].help,
+                       series[i].name, series[i].histogram ? "histogram" : "counter");
+        for (int j = i; j < count; j++) {
+            if (strcmp(series[j].name, series[i].name) == 0) {
+                render_series(out, &series[j]);
+            }
+        }
+    }
+
+    if (metrics_collector) {
+        metrics_collector(out);
+    }
+}
+
+// Send a whole buffer, giving up if the scraper goes away
+static void send_all(int fd, const char* data, size_t length) {
+    while (length > 0) {
+        ssize_t sent = send(fd, data, length, MSG_NOSIGNAL);
+        if (sent <= 0) {
+            if (sent < 0 && errno == EINTR) continue;
+            return;
+        }
+        data += sent;
+        length -= sent;
+    }
+}
+
+// Answer one HTTP request; only GET /metrics is served
+static void serve_scrape(int fd, metrics_buffer_t* body) {
+    char request[1024];
+    size_t length = 0;
+    struct timeval timeout = { 2, 0 };
+
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    while (length < sizeof(request) - 1) {
+        ssize_t received = recv(fd, request + length, sizeof(request) - 1 - length, 0);
+        if (received <= 0) break;
+        length += received;
+        request[length] = '\0';
+        if (strstr(request, "\r\n\r\n") || strstr(request, "\n\n")) break;
+    }
+    request[length] = '\0';
+
+    char header[256];
+    body->length = 0;
+
+    if (strncmp(request, "GET /metrics", 12) == 0 &&
+        (request[12] == ' ' || request[12] == '?' || request[12] == '\r')) {
+        render_metrics(body);
+        snprintf(header, sizeof(header),
+                 "HTTP/1.1 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n"
+                 "Content-Length: %zu\r\nConnection: close\r\n\r\n", body->length);
+    } else {
+        metrics_printf(body, "not found\n");
+        snprintf(header, sizeof(header),
+                 "HTTP/1.1 404 Not Found\r\nContent-Type: text/plain\r\n"
+                 "Content-Length: %zu\r\nConnection: close\r\n\r\n", body->length);
+    }
+
+    send_all(fd, header, strlen(header));
+    send_all(fd, body->data, body->length);
+}
+
+// Scrapes are rare, so one thread answers them one at a time
+static void* metrics_thread(void* arg) {
+    int listen_fd = *(int*)arg;
+    metrics_buffer_t body = { NULL, 0, 0 };
+    free(arg);
+
+    while (1) {
+        int fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        serve_scrape(fd, &body);
+        close(fd);
+    }
+
+    free(body.data);
+    close(listen_fd);
+    return NULL;
+}
+
+// Start the HTTP listener for /metrics
+int init_metrics(int port, metrics_collector_t collector) {
+    struct sockaddr_in address;
+    int reuse = 1;
+    pthread_t tid;
+
+    metrics_collector = collector;
+    if (port <= 0) return 0;
+
+    int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (listen_fd < 0) return -1;
+    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = INADDR_ANY;
+    address.sin_port = htons(port);
+
+    if (bind(listen_fd, (struct sockaddr*)&address, sizeof(address)) < 0 ||
+        listen(listen_fd, 16) < 0) {
+        printf("Error: Failed to open metrics port %d: %s\n", port, strerror(errno));
+        close(listen_fd);
+        return -1;
+    }
+
+    int* arg = malloc(sizeof(int));
+    if (!arg) {
+        close(listen_fd);
+        return -1;
+    }
+    *arg = listen_fd;
+
+    if (pthread_create(&tid, NULL, metrics_thread, arg) != 0) {
+        printf("Error: Failed to start metrics thread\n");
+        free(arg);
+        close(listen_fd);
+        return -1;
+    }
+    pthread_detach(tid);
+
+    printf("Metrics available at http://0.0.0.0:%d/metrics\n", port);
+    return 0;
+}
@@ -0,0 +1,222 @@
+#include "../include/migration.h"
+#include <poll.h>
+#include <sys/sendfile.h>
+
+#define MIGRATION_PIPE_SIZE (1024 * 1024)
+#define MIGRATION_CHUNK (64 * 1024)
+
+// Fills token with a fresh random one-time migration token
+int migration_token(char* token) {
+    unsigned char bytes[(MIGRATION_TOKEN_LEN - 1) / 2];
+
+    int fd = open("/dev/urandom", O_RDONLY);
+    if (fd < 0) {
+        printf("Error: Cannot open /dev/urandom: %s\n", strerror(errno));
+        return -1;
+    }
+    ssize_t got = read(fd, bytes, sizeof(bytes));
+    close(fd);
+    if (got != (ssize_t)sizeof(bytes)) {
+        printf("Error: Cannot read a migration token\n");
+        return -1;
+    }
+
+    for (size_t i = 0; i < sizeof(bytes); i++) {
+        snprintf(token + i * 2, 3, "%02x", bytes[i]);
+    }
+    return 0;
+}
+
+// Reads the peer's token and compares it without stopping at the first mismatch
+static int check_peer_token(int fd, const char* token) {
+    char presented[MIGRATION_TOKEN_LEN];
+    size_t received = 0;
+
+    while (received < sizeof(presented)) {
+        ssize_t got = recv(fd, presented + received, sizeof(presented) - received, 0);
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) return -1;
+        received += got;
+    }
+
+    unsigned char difference = 0;
+    for (size_t i = 0; i < sizeof(presented); i++) {
+        difference |= (unsigned char)(presented[i] ^ token[i]);
+    }
+    return difference == 0 ? 0 : -1;
+}
+
+// Opens a listener on an ephemeral port for one transfer
+int migration_listen(int* port) {
+    struct sockaddr_in address;
+    socklen_t length = sizeof(address);
+
+    int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (listen_fd < 0) return -1;
+
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = INADDR_ANY;
+    address.sin_port = 0;
+
+    if (bind(listen_fd, (struct sockaddr*)&address, sizeof(address)) < 0 ||
+        listen(listen_fd, 1) < 0 ||
+        getsockname(listen_fd, (struct sockaddr*)&address, &length) < 0) {
+        printf("Error: Failed to open migration listener: %s\n", strerror(errno));
+        close(listen_fd);
+        return -1;
+    }
+
+    *port = ntohs(address.sin_port);
+    return listen_fd;
+}
+
+// Waits for the target to connect and present the migration token, then
+// streams the file with sendfile. Peers without the token are turned away.
+int migration_send_file(int listen_fd, const char* token, const char* path) {
+    struct timeval timeout = { .tv_sec = MIGRATION_IO_TIMEOUT };
+    time_t deadline = time(NULL) + MIGRATION_ACCEPT_TIMEOUT;
+    struct stat st;
+    int fd = -1;
+
+    while (fd < 0) {
+        struct pollfd pfd = { .fd = listen_fd, .events = POLLIN };
+        int remaining = (int)(deadline - time(NULL));
+        if (remaining <= 0 || poll(&pfd, 1, remaining * 1000) <= 0) {
+            printf("Error: Migration target did not connect for %s\n", path);
+            return -1;
+        }
+
+        struct sockaddr_in peer;
+        socklen_t peer_length = sizeof(peer);
+        fd = accept(listen_fd, (struct sockaddr*)&peer, &peer_length);
+        if (fd < 0) continue;
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+        if (check_peer_token(fd, token) != 0) {
+            char peer_ip[INET_ADDRSTRLEN] = "?";
+            inet_ntop(AF_INET, &peer.sin_addr, peer_ip, sizeof(peer_ip));
+            printf("Warning: Rejected migration peer %s without a valid token\n", peer_ip);
+            close(fd);
+            fd = -1;
+        }
+    }
+
+    int file_fd = open(path, O_RDONLY);
+    if (file_fd < 0 || fstat(file_fd, &st) < 0) {
+        printf("Error: Cannot read migration file %s: %s\n", path, strerror(errno));
+        if (file_fd >= 0) close(file_fd);
+        close(fd);
+        return -1;
+    }
+
+    // The file goes from page cache to socket without passing through user space
+    off_t offset = 0;
+    int result = 0;
+    while (offset < st.st_size) {
+        ssize_t sent = sendfile(fd, file_fd, &offset, st.st_size - offset);
+        if (sent < 0 && errno == EINTR) continue;
+        if (sent <= 0) {
+            printf("Error: Migration send of %s failed: %s\n", path,
+                   sent < 0 ? strerror(errno) : "connection closed");
+            result = -1;
+            break;
+        }
+    }
+
+    close(file_fd);
+    close(fd);
+    return result;
+}
+
+// Connects to the source, presents the token and splices the stream into
+// path, removed on failure
+int migration_receive_file(const char* ip, int port, const char* token, const char* path,
+                           long long size) {
+    struct sockaddr_in address;
+    struct timeval timeout = { .tv_sec = MIGRATION_IO_TIMEOUT };
+    int pipe_fds[2];
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    if (inet_pton(AF_INET, ip, &address.sin_addr) <= 0 ||
+        connect(fd, (struct sockaddr*)&address, sizeof(address)) < 0) {
+        printf("Error: Cannot reach migration source %s:%d: %s\n", ip, port, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    char presented[MIGRATION_TOKEN_LEN];
+    memset(presented, 0, sizeof(presented));
+    snprintf(presented, sizeof(presented), "%s", token);
+    if (send(fd, presented, sizeof(presented), MSG_NOSIGNAL) != (ssize_t)sizeof(presented)) {
+        printf("Error: Cannot send migration token to %s:%d: %s\n", ip, port, strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    int file_fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (file_fd < 0) {
+        printf("Error: Cannot create migration file %s: %s\n", path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    if (pipe(pipe_fds) < 0) {
+        close(file_fd);
+        close(fd);
+        unlink(path);
+        return -1;
+    }
+    // A larger pipe means fewer splice round trips; the default size still works
+    fcntl(pipe_fds[1], F_SETPIPE_SZ, MIGRATION_PIPE_SIZE);
+
+    // socket -> pipe -> file keeps the payload in kernel pages
+    long long received = 0;
+    int result = 0;
+    while (received < size) {
+        size_t chunk = size - received < MIGRATION_CHUNK ? (size_t)(size - received) : MIGRATION_CHUNK;
+        ssize_t in = splice(fd, NULL, pipe_fds[1], NULL, chunk, SPLICE_F_MOVE | SPLICE_F_MORE);
+        if (in < 0 && errno == EINTR) continue;
+        if (in <= 0) {
+            printf("Error: Migration receive from %s:%d failed: %s\n", ip, port,
+                   in < 0 ? strerror(errno) : "connection closed early");
+            result = -1;
+            break;
+        }
+
+        ssize_t pending = in;
+        while (pending > 0) {
+            ssize_t out = splice(pipe_fds[0], NULL, file_fd, NULL, pending, SPLICE_F_MOVE);
+            if (out < 0 && errno == EINTR) continue;
+            if (out <= 0) {
+                printf("Error: Cannot write migration file %s: %s\n", path, strerror(errno));
+                result = -1;
+                break;
+            }
+            pending -= out;
+        }
+        if (result < 0) break;
+        received += in;
+    }
+
+    close(pipe_fds[0]);
+    close(pipe_fds[1]);
+    if (close(file_fd) < 0) result = -1;
+    close(fd);
+    if (result < 0) unlink(path);
+    return result;
+}
+
+// Staging file for one side of a migration; the suffix keeps co-located workers apart
+void migration_path(const char* dir, const char* name, int op_id, const char* suffix,
+                    char* path, size_t size) {
+    snprintf(path, size, "%s/lxc-migrate-%s-%d.%s", dir, name, op_id, suffix);
+}
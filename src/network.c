@@ -1,21 +1,114 @@
 #include "../include/distributed_lxc.h"
+#include "../include/config.h"
+#include "../include/metrics.h"
 
 // Global variables for network communication
 static int server_socket = -1;
-static node_t nodes[MAX_NODES];
-static int node_count = 0;
-static pthread_mutex_t nodes_mutex = PTHREAD_MUTEX_INITIALIZER;
+static message_handler_t message_handler = NULL;
+static disconnect_handler_t disconnect_handler = NULL;
+static registration_guard_t registration_guard = NULL;
+node_t nodes[MAX_NODES];
+int node_count = 0;
+pthread_mutex_t nodes_mutex = PTHREAD_MUTEX_INITIALIZER;
+unsigned long nodes_generation = 0;   // Bumped whenever node membership or state changes
+
+// Message counters by type, registered on first use
+static const char* message_type_labels[] = {
+    "register_node", "node_heartbeat", "deploy_container", "start_container",
+    "stop_container", "delete_container", "container_status", "node_status",
+    "error", "ack", "redirect", "inventory_sync", "inventory_reply", "migrate_export",
+    "migrate_ready", "migrate_import"
+};
+#define MESSAGE_TYPE_COUNT ((int)(sizeof(message_type_labels) / sizeof(message_type_labels[0])))
+
+static int messages_sent[MESSAGE_TYPE_COUNT];
+static int messages_received[MESSAGE_TYPE_COUNT];
+static int send_failures = -1;
+static int nodes_lock_wait = -1;
+static pthread_once_t message_metrics_once = PTHREAD_ONCE_INIT;
+static pthread_once_t nodes_metrics_once = PTHREAD_ONCE_INIT;
+
+// Register the per-type message counters
+static void register_message_metrics(void) {
+    char labels[MAX_NAME_LEN];
+
+    for (int i = 0; i < MESSAGE_TYPE_COUNT; i++) {
+        snprintf(labels, sizeof(labels), "type=\"%s\"", message_type_labels[i]);
+        messages_sent[i] = metrics_counter("lxc_messages_sent_total", labels, "Messages sent by type");
+        messages_received[i] = metrics_counter("lxc_messages_received_total", labels,
+                                               "Messages received by type");
+    }
+    send_failures = metrics_counter("lxc_message_send_failures_total", NULL,
+                                    "Messages that could not be sent");
+}
+
+// Count one message of a type
+static void count_message(int* counters, message_type_t type) {
+    pthread_once(&message_metrics_once, register_message_metrics);
+    if ((int)type >= 0 && (int)type < MESSAGE_TYPE_COUNT) {
+        metrics_add(counters[type], 1);
+    }
+}
+
+// Sends on one socket are serialized so that threads writing to the same
+// worker cannot interleave two messages. Sockets share a lock by descriptor.
+#define SEND_LOCKS 64
+static pthread_mutex_t send_locks[SEND_LOCKS];
+static pthread_once_t send_locks_once = PTHREAD_ONCE_INIT;
+
+// Initialize the per-socket send locks
+static void init_send_locks(void) {
+    for (int i = 0; i < SEND_LOCKS; i++) {
+        pthread_mutex_init(&send_locks[i], NULL);
+    }
+}
+
+// Register the nodes_mutex wait histogram
+static void register_nodes_metrics(void) {
+    nodes_lock_wait = metrics_lock_histogram("nodes");
+}
+
+// Take nodes_mutex, recording how long it took
+void lock_nodes(void) {
+    pthread_once(&nodes_metrics_once, register_nodes_metrics);
+    metrics_lock(&nodes_mutex, nodes_lock_wait);
+}
+
+// Install the coordinator handler for heartbeats and worker replies
+void set_message_handler(message_handler_t handler) {
+    message_handler = handler;
+}
+
+// Install the coordinator callback for closed worker connections
+void set_disconnect_handler(disconnect_handler_t handler) {
+    disconnect_handler = handler;
+}
+
+// Install the coordinator check that may turn registrations away
+void set_registration_guard(registration_guard_t guard) {
+    registration_guard = guard;
+}
 
 // Send a message over a socket
 int send_message(int socket_fd, const message_t* msg) {
     if (socket_fd < 0 || !msg) return -1;
     
-    ssize_t bytes_sent = send(socket_fd, msg, sizeof(message_t), 0);
+    pthread_once(&send_locks_once, init_send_locks);
+    pthread_mutex_t* send_lock = &send_locks[socket_fd % SEND_LOCKS];
+
+    // A peer that went away must not kill the process with SIGPIPE
+    pthread_mutex_lock(send_lock);
+    ssize_t bytes_sent = send(socket_fd, msg, sizeof(message_t), MSG_NOSIGNAL);
+    pthread_mutex_unlock(send_lock);
     if (bytes_sent != sizeof(message_t)) {
         printf("Error: Failed to send complete message (%zd bytes sent)\n", bytes_sent);
+        count_message(messages_sent, msg->type);
+        metrics_add(send_failures, 1);
         return -1;
     }
     
+    count_message(messages_sent, msg->type);
+    
     return 0;
 }
 
@@ -23,7 +116,8 @@ int send_message(int socket_fd, const message_t* msg) {
 int receive_message(int socket_fd, message_t* msg) {
     if (socket_fd < 0 || !msg) return -1;
     
-    ssize_t bytes_received = recv(socket_fd, msg, sizeof(message_t), 0);
+    // Messages are fixed size; wait for all of it rather than failing on a short read
+    ssize_t bytes_received = recv(socket_fd, msg, sizeof(message_t), MSG_WAITALL);
     if (bytes_received != sizeof(message_t)) {
         if (bytes_received == 0) {
             printf("Connection closed by peer\n");
@@ -35,6 +129,7 @@ int receive_message(int socket_fd, message_t* msg) {
         return -1;
     }
     
+    count_message(messages_received, msg->type);
     return 0;
 }
 
@@ -65,7 +160,7 @@ void create_message(message_t* msg, message_type_t type, const char* sender_id,
 node_t* find_node_by_id(const char* node_id) {
     if (!node_id) return NULL;
     
-    pthread_mutex_lock(&nodes_mutex);
+    lock_nodes();
     for (int i = 0; i < node_count; i++) {
         if (strcmp(nodes[i].id, node_id) == 0) {
             pthread_mutex_unlock(&nodes_mutex);
@@ -77,16 +172,12 @@ node_t* find_node_by_id(const char* node_id) {
 }
 
 // Add a new node to the cluster
-int register_node(const char* node_id, const char* hostname, const char* ip_address, int port) {
+int register_node(const char* node_id, const char* hostname, const char* ip_address, int port,
+                  const char* labels) {
     if (!node_id || !hostname || !ip_address) return -1;
+    if (!labels) labels = "";
     
-    pthread_mutex_lock(&nodes_mutex);
-    
-    if (node_count >= MAX_NODES) {
-        pthread_mutex_unlock(&nodes_mutex);
-        printf("Error: Maximum number of nodes reached\n");
-        return -1;
-    }
+    lock_nodes();
     
     // Check if node already exists
     for (int i = 0; i < node_count; i++) {
@@ -95,35 +186,92 @@ int register_node(const char* node_id, const char* hostname, const char* ip_addr
             strcpy(nodes[i].hostname, hostname);
             strcpy(nodes[i].ip_address, ip_address);
             nodes[i].port = port;
+            strncpy(nodes[i].labels, labels, MAX_NAME_LEN - 1);
             nodes[i].state = NODE_CONNECTED;
             nodes[i].last_heartbeat = time(NULL);
+            nodes_generation++;
             pthread_mutex_unlock(&nodes_mutex);
             return 0;
         }
     }
     
+    if (node_count >= config_current()->max_nodes) {
+        pthread_mutex_unlock(&nodes_mutex);
+        printf("Error: Maximum number of nodes reached\n");
+        return -1;
+    }
+    
     // Add new node
     strcpy(nodes[node_count].id, node_id);
     strcpy(nodes[node_count].hostname, hostname);
     strcpy(nodes[node_count].ip_address, ip_address);
     nodes[node_count].port = port;
+    strncpy(nodes[node_count].labels, labels, MAX_NAME_LEN - 1);
+    nodes[node_count].labels[MAX_NAME_LEN - 1] = '\0';
     nodes[node_count].state = NODE_CONNECTED;
     nodes[node_count].last_heartbeat = time(NULL);
     nodes[node_count].container_count = 0;
+    nodes[node_count].cpu_requested = 0;
+    nodes[node_count].memory_requested = 0;
+    nodes[node_count].reserved_cpu = 0.0;
+    nodes[node_count].reserved_memory = 0.0;
+    nodes[node_count].pending_placements = 0;
+    nodes[node_count].settled_placements = 0;
     memset(&nodes[node_count].resources, 0, sizeof(resource_info_t));
     
     node_count++;
+    nodes_generation++;
     pthread_mutex_unlock(&nodes_mutex);
     
     printf("Node %s registered successfully\n", node_id);
     return 0;
 }
 
+// Re-create a node recovered from the state log; it stays disconnected until
+// the worker registers again
+int restore_node(const char* node_id, const char* hostname, const char* ip_address, int port,
+                 const char* labels) {
+    if (!node_id || !hostname || !ip_address) return -1;
+    if (!labels) labels = "";
+    
+    lock_nodes();
+    
+    node_t* node = NULL;
+    for (int i = 0; i < node_count; i++) {
+        if (strcmp(nodes[i].id, node_id) == 0) {
+            node = &nodes[i];
+            break;
+        }
+    }
+    
+    if (!node) {
+        if (node_count >= MAX_NODES) {
+            pthread_mutex_unlock(&nodes_mutex);
+            printf("Error: Maximum number of nodes reached\n");
+            return -1;
+        }
+        node = &nodes[node_count++];
+        memset(node, 0, sizeof(node_t));
+        strncpy(node->id, node_id, MAX_NAME_LEN - 1);
+        node->state = NODE_DISCONNECTED;
+        node->socket_fd = -1;
+    }
+    
+    strncpy(node->hostname, hostname, MAX_NAME_LEN - 1);
+    strncpy(node->ip_address, ip_address, INET_ADDRSTRLEN - 1);
+    node->port = port;
+    strncpy(node->labels, labels, MAX_NAME_LEN - 1);
+    nodes_generation++;
+    
+    pthread_mutex_unlock(&nodes_mutex);
+    return 0;
+}
+
 // Remove a node from the cluster
 int unregister_node(const char* node_id) {
     if (!node_id) return -1;
     
-    pthread_mutex_lock(&nodes_mutex);
+    lock_nodes();
     
     for (int i = 0; i < node_count; i++) {
         if (strcmp(nodes[i].id, node_id) == 0) {
@@ -137,6 +285,7 @@ int unregister_node(const char* node_id) {
                 nodes[j] = nodes[j + 1];
             }
             node_count--;
+            nodes_generation++;
             pthread_mutex_unlock(&nodes_mutex);
             
             printf("Node %s unregistered\n", node_id);
@@ -155,10 +304,11 @@ void* handle_client_connection(void* arg) {
     
     message_t msg;
     char node_id[MAX_NAME_LEN] = {0};
+    int redirected = 0;
     
     printf("New client connected (socket %d)\n", client_socket);
     
-    while (1) {
+    while (!redirected) {
         if (receive_message(client_socket, &msg) != 0) {
             break;
         }
@@ -169,12 +319,27 @@ void* handle_client_connection(void* arg) {
                 char* data_ptr = msg.data;
                 char hostname[MAX_NAME_LEN];
                 char ip_address[INET_ADDRSTRLEN];
+                char labels[MAX_NAME_LEN] = "";
                 int port;
                 
-                sscanf(data_ptr, "%s %s %d", hostname, ip_address, &port);
+                sscanf(data_ptr, "%255s %15s %d %255s", hostname, ip_address, &port, labels);
+                if (strcmp(labels, "-") == 0) {
+                    labels[0] = '\0';
+                }
+                
+                // Point the worker at another coordinator when this one may not take it
+                char redirect[MAX_NAME_LEN];
+                if (registration_guard && registration_guard(redirect, sizeof(redirect)) != 0) {
+                    message_t redirect_msg;
+                    create_message(&redirect_msg, MSG_REDIRECT, "coordinator", msg.sender_id,
+                                   redirect, strlen(redirect));
+                    send_message(client_socket, &redirect_msg);
+                    redirected = 1;
+                    break;
+                }
                 
                 strcpy(node_id, msg.sender_id);
-                if (register_node(node_id, hostname, ip_address, port) == 0) {
+                if (register_node(node_id, hostname, ip_address, port, labels) == 0) {
                     // Update socket in node structure
                     node_t* node = find_node_by_id(node_id);
                     if (node) {
@@ -185,6 +350,10 @@ void* handle_client_connection(void* arg) {
                     message_t ack_msg;
                     create_message(&ack_msg, MSG_ACK, "coordinator", node_id, "registered", 10);
                     send_message(client_socket, &ack_msg);
+                    
+                    if (message_handler) {
+                        message_handler(&msg);
+                    }
                 }
                 break;
             }
@@ -199,6 +368,10 @@ void* handle_client_connection(void* arg) {
                     if (msg.data_length >= sizeof(resource_info_t)) {
                         memcpy(&node->resources, msg.data, sizeof(resource_info_t));
                     }
+                    
+                    if (message_handler) {
+                        message_handler(&msg);
+                    }
                 }
                 break;
             }
@@ -214,12 +387,34 @@ void* handle_client_connection(void* arg) {
                             break;
                         }
                     }
+                    
+                    if (message_handler) {
+                        message_handler(&msg);
+                    }
+                }
+                break;
+            }
+            
+            case MSG_INVENTORY_REPLY:
+            case MSG_MIGRATE_READY: {
+                if (find_node_by_id(msg.sender_id) && message_handler) {
+                    message_handler(&msg);
                 }
                 break;
             }
             
             case MSG_ERROR: {
                 printf("Error from node %s: %s\n", msg.sender_id, msg.data);
+                if (message_handler) {
+                    message_handler(&msg);
+                }
+                break;
+            }
+            
+            case MSG_ACK: {
+                if (message_handler) {
+                    message_handler(&msg);
+                }
                 break;
             }
             
@@ -233,10 +428,16 @@ void* handle_client_connection(void* arg) {
     if (strlen(node_id) > 0) {
         node_t* node = find_node_by_id(node_id);
         if (node) {
+            lock_nodes();
             node->state = NODE_DISCONNECTED;
             node->socket_fd = -1;
+            nodes_generation++;
+            pthread_mutex_unlock(&nodes_mutex);
         }
         printf("Node %s disconnected\n", node_id);
+        if (disconnect_handler) {
+            disconnect_handler(node_id);
+        }
     }
     
     close(client_socket);
@@ -344,6 +545,30 @@ int init_worker_node(const char* coordinator_ip, int coordinator_port) {
     return socket_fd;
 }
 
+// Drop every worker connection; the workers reconnect and find the new leader
+void disconnect_nodes(void) {
+    lock_nodes();
+    for (int i = 0; i < node_count; i++) {
+        if (nodes[i].socket_fd >= 0) {
+            shutdown(nodes[i].socket_fd, SHUT_RDWR);
+        }
+    }
+    pthread_mutex_unlock(&nodes_mutex);
+}
+
+// Forget all nodes before the registry is rebuilt from replicated state
+void reset_nodes(void) {
+    lock_nodes();
+    for (int i = 0; i < node_count; i++) {
+        if (nodes[i].socket_fd >= 0) {
+            shutdown(nodes[i].socket_fd, SHUT_RDWR);
+        }
+    }
+    node_count = 0;
+    nodes_generation++;
+    pthread_mutex_unlock(&nodes_mutex);
+}
+
 // Cleanup network resources
 void cleanup_network_resources(void) {
     if (server_socket >= 0) {
@@ -351,12 +576,13 @@ void cleanup_network_resources(void) {
         server_socket = -1;
     }
     
-    pthread_mutex_lock(&nodes_mutex);
+    lock_nodes();
     for (int i = 0; i < node_count; i++) {
         if (nodes[i].socket_fd >= 0) {
             close(nodes[i].socket_fd);
         }
     }
     node_count = 0;
+    nodes_generation++;
     pthread_mutex_unlock(&nodes_mutex);
 }
\ No newline at end of file
@@ -0,0 +1,356 @@
+#include "../include/operations.h"
+#include "../include/metrics.h"
+
+// Operation table indexed by id & (MAX_OPERATIONS - 1). Terminal operations
+// stay pollable until their slot is reused by a later id.
+static operation_t operations[MAX_OPERATIONS];
+static int next_operation_id = 1;
+static operation_handler_t completion_handler = NULL;
+static pthread_mutex_t operations_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t operations_cond = PTHREAD_COND_INITIALIZER;
+static struct timespec operation_started[MAX_OPERATIONS];   // Monotonic creation time per slot
+
+// Metric ids, registered by init_operations
+static int operation_duration[OP_MIGRATE + 1] = { -1, -1, -1, -1, -1 };
+static int operation_outcomes[OP_MIGRATE + 1][OP_TIMED_OUT + 1];
+static int operations_lock_wait = -1;
+
+#define OPERATION_SLOT(id) ((id) & (MAX_OPERATIONS - 1))
+#define TIMEOUT_BATCH 64
+
+// Take operations_mutex, recording how long it took
+static void lock_operations(void) {
+    metrics_lock(&operations_mutex, operations_lock_wait);
+}
+
+// Check whether a state is final
+int operation_is_terminal(operation_state_t state) {
+    return state == OP_SUCCEEDED || state == OP_FAILED || state == OP_TIMED_OUT;
+}
+
+// Human readable operation type
+const char* operation_type_name(operation_type_t type) {
+    switch (type) {
+        case OP_DEPLOY: return "DEPLOY";
+        case OP_START:  return "START";
+        case OP_STOP:   return "STOP";
+        case OP_DELETE: return "DELETE";
+        case OP_MIGRATE: return "MIGRATE";
+        default:        return "UNKNOWN";
+    }
+}
+
+// Human readable operation state
+const char* operation_state_name(operation_state_t state) {
+    switch (state) {
+        case OP_PENDING:   return "PENDING";
+        case OP_RUNNING:   return "RUNNING";
+        case OP_SUCCEEDED: return "SUCCEEDED";
+        case OP_FAILED:    return "FAILED";
+        case OP_TIMED_OUT: return "TIMED_OUT";
+        default:           return "UNKNOWN";
+    }
+}
+
+// Register the callback invoked when operations finish
+void set_operation_handler(operation_handler_t handler) {
+    lock_operations();
+    completion_handler = handler;
+    pthread_mutex_unlock(&operations_mutex);
+}
+
+// Create a new pending operation, returns its id or -1 if the table is full
+int operation_create(operation_type_t type, const char* container_id,
+                     const char* node_id, int timeout_seconds) {
+    if (!container_id) return -1;
+    if (timeout_seconds <= 0) timeout_seconds = DEFAULT_OPERATION_TIMEOUT;
+
+    lock_operations();
+
+    // Skip ids whose slot still holds a live operation, so one long-running
+    // operation does not block creation once ids wrap around to its slot
+    int id = next_operation_id;
+    operation_t* op = NULL;
+    for (int probe = 0; probe < MAX_OPERATIONS; probe++) {
+        operation_t* candidate = &operations[OPERATION_SLOT(id)];
+        if (candidate->id == 0 || operation_is_terminal(candidate->state)) {
+            op = candidate;
+            break;
+        }
+        id = (id == 0x7fffffff) ? 1 : id + 1;
+    }
+
+    if (!op) {
+        pthread_mutex_unlock(&operations_mutex);
+        printf("Error: Too many operations in flight (limit %d)\n", MAX_OPERATIONS);
+        return -1;
+    }
+
+    next_operation_id = (id == 0x7fffffff) ? 1 : id + 1;
+
+    memset(op, 0, sizeof(operation_t));
+    op->id = id;
+    op->type = type;
+    op->state = OP_PENDING;
+    strncpy(op->container_id, container_id, MAX_NAME_LEN - 1);
+    if (node_id) {
+        strncpy(op->node_id, node_id, MAX_NAME_LEN - 1);
+    }
+    op->created_at = time(NULL);
+    op->deadline = op->created_at + timeout_seconds;
+    clock_gettime(CLOCK_MONOTONIC, &operation_started[OPERATION_SLOT(id)]);
+
+    pthread_mutex_unlock(&operations_mutex);
+    return id;
+}
+
+// Move an operation from PENDING to RUNNING once its command is sent
+int operation_mark_running(int id) {
+    lock_operations();
+
+    operation_t* op = &operations[OPERATION_SLOT(id)];
+    if (op->id != id || op->state != OP_PENDING) {
+        pthread_mutex_unlock(&operations_mutex);
+        return -1;
+    }
+
+    op->state = OP_RUNNING;
+    pthread_cond_broadcast(&operations_cond);
+    pthread_mutex_unlock(&operations_mutex);
+    return 0;
+}
+
+// Give an unfinished operation timeout_seconds from now before it times out
+int operation_restart_timer(int id, int timeout_seconds) {
+    if (timeout_seconds <= 0) timeout_seconds = DEFAULT_OPERATION_TIMEOUT;
+
+    lock_operations();
+
+    operation_t* op = &operations[OPERATION_SLOT(id)];
+    if (op->id != id || operation_is_terminal(op->state)) {
+        pthread_mutex_unlock(&operations_mutex);
+        return -1;
+    }
+
+    op->deadline = time(NULL) + timeout_seconds;
+    pthread_mutex_unlock(&operations_mutex);
+    return 0;
+}
+
+// Move an operation into a terminal state and notify waiters
+int operation_complete(int id, operation_state_t state, const char* result) {
+    if (!operation_is_terminal(state)) return -1;
+
+    lock_operations();
+
+    operation_t* op = &operations[OPERATION_SLOT(id)];
+    if (op->id != id || operation_is_terminal(op->state)) {
+        // Unknown, recycled or already finished (e.g. reply after timeout)
+        pthread_mutex_unlock(&operations_mutex);
+        return -1;
+    }
+
+    op->state = state;
+    op->completed_at = time(NULL);
+    metrics_observe(operation_duration[op->type], metrics_elapsed(&operation_started[OPERATION_SLOT(id)]));
+    metrics_add(operation_outcomes[op->type][state], 1);
+    if (result) {
+        strncpy(op->result, result, MAX_NAME_LEN - 1);
+        op->result[MAX_NAME_LEN - 1] = '\0';
+    }
+
+    operation_t finished = *op;
+    operation_handler_t handler = completion_handler;
+
+    pthread_cond_broadcast(&operations_cond);
+    pthread_mutex_unlock(&operations_mutex);
+
+    if (handler) {
+        handler(&finished);
+    }
+    return 0;
+}
+
+// Copy the current state of an operation, returns -1 if it is unknown
+int operation_get(int id, operation_t* op) {
+    if (!op || id <= 0) return -1;
+
+    lock_operations();
+
+    const operation_t* slot = &operations[OPERATION_SLOT(id)];
+    if (slot->id != id) {
+        pthread_mutex_unlock(&operations_mutex);
+        return -1;
+    }
+
+    *op = *slot;
+    pthread_mutex_unlock(&operations_mutex);
+    return 0;
+}
+
+// Block until the operation is terminal and the absolute deadline has not passed
+static operation_state_t wait_locked(int id, const struct timespec* deadline) {
+    while (1) {
+        const operation_t* op = &operations[OPERATION_SLOT(id)];
+        if (op->id != id) {
+            return OP_FAILED;
+        }
+        if (operation_is_terminal(op->state)) {
+            return op->state;
+        }
+        if (pthread_cond_timedwait(&operations_cond, &operations_mutex, deadline) == ETIMEDOUT) {
+            op = &operations[OPERATION_SLOT(id)];
+            return (op->id == id) ? op->state : OP_FAILED;
+        }
+    }
+}
+
+// Wait for a single operation, returns its state when done or when waiting gave up
+operation_state_t operation_wait(int id, int timeout_seconds) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeout_seconds;
+
+    lock_operations();
+    operation_state_t state = wait_locked(id, &deadline);
+    pthread_mutex_unlock(&operations_mutex);
+
+    return state;
+}
+
+// Wait for a batch of operations under one shared deadline, returns how many finished
+int operation_wait_all(const int* ids, int count, int timeout_seconds) {
+    if (!ids || count <= 0) return 0;
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeout_seconds;
+
+    int finished = 0;
+
+    lock_operations();
+    for (int i = 0; i < count; i++) {
+        if (operation_is_terminal(wait_locked(ids[i], &deadline))) {
+            finished++;
+        }
+    }
+    pthread_mutex_unlock(&operations_mutex);
+
+    return finished;
+}
+
+// Collect ids of operations that have not finished yet
+int operation_list_active(int* ids, int max_ids) {
+    if (!ids || max_ids <= 0) return 0;
+
+    int count = 0;
+
+    lock_operations();
+    for (int i = 0; i < MAX_OPERATIONS && count < max_ids; i++) {
+        if (operations[i].id != 0 && !operation_is_terminal(operations[i].state)) {
+            ids[count++] = operations[i].id;
+        }
+    }
+    pthread_mutex_unlock(&operations_mutex);
+
+    return count;
+}
+
+// Expire operations whose deadline has passed
+static void* operation_timeout_thread(void* arg) {
+    (void)arg;
+
+    while (1) {
+        sleep(1);
+
+        time_t now = time(NULL);
+        int scan_from = 0;
+
+        while (scan_from < MAX_OPERATIONS) {
+            operation_t expired[TIMEOUT_BATCH];
+            int expired_count = 0;
+
+            lock_operations();
+            for (; scan_from < MAX_OPERATIONS && expired_count < TIMEOUT_BATCH; scan_from++) {
+                operation_t* op = &operations[scan_from];
+                if (op->id != 0 && !operation_is_terminal(op->state) && now >= op->deadline) {
+                    op->state = OP_TIMED_OUT;
+                    op->completed_at = now;
+                    strcpy(op->result, "timed out");
+                    metrics_observe(operation_duration[op->type],
+                                    metrics_elapsed(&operation_started[scan_from]));
+                    metrics_add(operation_outcomes[op->type][OP_TIMED_OUT], 1);
+                    expired[expired_count++] = *op;
+                }
+            }
+            operation_handler_t handler = completion_handler;
+            if (expired_count > 0) {
+                pthread_cond_broadcast(&operations_cond);
+            }
+            pthread_mutex_unlock(&operations_mutex);
+
+            for (int i = 0; handler && i < expired_count; i++) {
+                printf("Operation %d (%s %s) timed out\n", expired[i].id,
+                       operation_type_name(expired[i].type), expired[i].container_id);
+                handler(&expired[i]);
+            }
+        }
+    }
+
+    return NULL;
+}
+
+// Start the operation engine
+int init_operations(void) {
+    pthread_t timeout_tid;
+    char labels[MAX_NAME_LEN];
+
+    for (int type = OP_DEPLOY; type <= OP_MIGRATE; type++) {
+        snprintf(labels, sizeof(labels), "type=\"%s\"", operation_type_name(type));
+        operation_duration[type] = metrics_histogram("lxc_operation_duration_seconds", labels,
+                                                     "Time from creating an operation to its outcome");
+        for (int state = OP_SUCCEEDED; state <= OP_TIMED_OUT; state++) {
+            snprintf(labels, sizeof(labels), "type=\"%s\",state=\"%s\"",
+                     operation_type_name(type), operation_state_name(state));
+            operation_outcomes[type][state] = metrics_counter("lxc_operations_total", labels,
+                                                              "Finished operations by type and outcome");
+        }
+    }
+    operations_lock_wait = metrics_lock_histogram("operations");
+
+    if (pthread_create(&timeout_tid, NULL, operation_timeout_thread, NULL) != 0) {
+        printf("Error: Failed to start operation timeout thread\n");
+        return -1;
+    }
+
+    pthread_detach(timeout_tid);
+    return 0;
+}
+
+// List in-flight operations and a summary of finished ones
+void list_operations(void) {
+    int counts[OP_TIMED_OUT + 1] = {0};
+
+    lock_operations();
+
+    printf("\n=== Operations ===\n");
+    printf("%-8s %-8s %-10s %-30s %-15s\n", "ID", "Type", "State", "Container", "Node");
+    printf("------------------------------------------------------------------------\n");
+
+    for (int i = 0; i < MAX_OPERATIONS; i++) {
+        operation_t* op = &operations[i];
+        if (op->id == 0) continue;
+
+        counts[op->state]++;
+        if (!operation_is_terminal(op->state)) {
+            printf("%-8d %-8s %-10s %-30s %-15s\n", op->id, operation_type_name(op->type),
+                   operation_state_name(op->state), op->container_id, op->node_id);
+        }
+    }
+
+    pthread_mutex_unlock(&operations_mutex);
+
+    printf("pending: %d  running: %d  succeeded: %d  failed: %d  timed out: %d\n",
+           counts[OP_PENDING], counts[OP_RUNNING], counts[OP_SUCCEEDED],
+           counts[OP_FAILED], counts[OP_TIMED_OUT]);
+}
@@ -0,0 +1,220 @@
+#include "../include/preemption.h"
+#include "../include/operations.h"
+#include "../include/config.h"
+#include "../include/raft.h"
+
+// Evicted containers waiting for a node, in eviction order (protected by preemption_mutex)
+static requeue_entry_t requeue_queue[PREEMPTION_QUEUE_SLOTS];
+static int requeue_count = 0;
+static requeue_entry_t evictions[PREEMPTION_QUEUE_SLOTS];   // Victims whose delete is in flight
+static int eviction_count = 0;
+static unsigned long requeued_total = 0;
+static unsigned long placed_total = 0;
+static preemption_deployer_t requeue_deployer = NULL;
+static pthread_mutex_t preemption_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t preemption_cond = PTHREAD_COND_INITIALIZER;
+
+// Append an entry to the queue (caller holds preemption_mutex)
+static int enqueue_locked(const requeue_entry_t* entry) {
+    if (requeue_count >= PREEMPTION_QUEUE_SLOTS) {
+        printf("Error: Requeue full, container %s evicted by %s is dropped\n",
+               entry->config.name, entry->evicted_by);
+        return -1;
+    }
+
+    requeue_queue[requeue_count++] = *entry;
+    pthread_cond_signal(&preemption_cond);
+    return 0;
+}
+
+// Due entry with the highest priority, earliest evicted first; sets wake to
+// the next retry time when nothing is due (caller holds preemption_mutex)
+static int next_due_locked(time_t now, time_t* wake) {
+    int best = -1;
+
+    *wake = now + PREEMPTION_MAX_BACKOFF;
+    for (int i = 0; i < requeue_count; i++) {
+        const requeue_entry_t* entry = &requeue_queue[i];
+        if (entry->next_attempt > now) {
+            if (entry->next_attempt < *wake) *wake = entry->next_attempt;
+            continue;
+        }
+        if (best < 0 || entry->config.priority > requeue_queue[best].config.priority) {
+            best = i;
+        }
+    }
+
+    return best;
+}
+
+// Seconds before a retry, doubling with every failed attempt
+static int requeue_backoff(int attempts) {
+    int backoff = PREEMPTION_BASE_BACKOFF;
+    for (int i = 1; i < attempts && backoff < PREEMPTION_MAX_BACKOFF; i++) {
+        backoff *= 2;
+    }
+    return backoff > PREEMPTION_MAX_BACKOFF ? PREEMPTION_MAX_BACKOFF : backoff;
+}
+
+// Put an entry back for another attempt after delay seconds
+static void retry_later(requeue_entry_t* entry, int delay) {
+    entry->next_attempt = time(NULL) + delay;
+
+    pthread_mutex_lock(&preemption_mutex);
+    enqueue_locked(entry);
+    pthread_mutex_unlock(&preemption_mutex);
+}
+
+// Places evicted containers again as room appears, most important first
+static void* requeue_thread(void* arg) {
+    (void)arg;
+
+    while (1) {
+        requeue_entry_t entry;
+        time_t wake;
+        int index;
+
+        pthread_mutex_lock(&preemption_mutex);
+        while ((index = next_due_locked(time(NULL), &wake)) < 0) {
+            struct timespec deadline = { wake, 0 };
+            pthread_cond_timedwait(&preemption_cond, &preemption_mutex, &deadline);
+        }
+        entry = requeue_queue[index];
+        for (int i = index; i < requeue_count - 1; i++) {
+            requeue_queue[i] = requeue_queue[i + 1];
+        }
+        requeue_count--;
+        pthread_mutex_unlock(&preemption_mutex);
+
+        // Only the leader places containers; keep the entry in case it becomes one again
+        if (raft_enabled() && !raft_is_leader()) {
+            retry_later(&entry, PREEMPTION_MAX_BACKOFF);
+            continue;
+        }
+
+        int op_id = requeue_deployer(&entry.config, entry.desired_state);
+        if (op_id == 0) {
+            // Handed to the tenant queue, which places it when its turn comes
+            printf("Requeued container %s waits in the queue of tenant %s\n",
+                   entry.config.name, entry.config.tenant);
+            continue;
+        }
+        operation_state_t state = op_id > 0 ? operation_wait(op_id, DEFAULT_OPERATION_TIMEOUT)
+                                            : OP_FAILED;
+
+        // A timed out deploy stays in the registry for the reconciler, so only
+        // a definite failure is retried
+        if (state == OP_FAILED) {
+            entry.attempts++;
+            retry_later(&entry, requeue_backoff(entry.attempts));
+            continue;
+        }
+
+        pthread_mutex_lock(&preemption_mutex);
+        placed_total++;
+        pthread_mutex_unlock(&preemption_mutex);
+        printf("Requeued container %s placed again (operation %d, %d retries)\n",
+               entry.config.name, op_id, entry.attempts);
+    }
+
+    return NULL;
+}
+
+// Start the requeue thread
+int init_preemption(preemption_deployer_t deployer) {
+    pthread_t tid;
+
+    if (!deployer) return -1;
+    requeue_deployer = deployer;
+
+    if (pthread_create(&tid, NULL, requeue_thread, NULL) != 0) {
+        printf("Error: Failed to start requeue thread\n");
+        return -1;
+    }
+
+    pthread_detach(tid);
+    return 0;
+}
+
+// Remember a victim until its delete finishes
+int preemption_evict(const char* container_id, const lxc_config_t* config,
+                     container_state_t desired_state, const char* evicted_by) {
+    if (!container_id || !config) return -1;
+
+    pthread_mutex_lock(&preemption_mutex);
+    if (eviction_count >= PREEMPTION_QUEUE_SLOTS) {
+        pthread_mutex_unlock(&preemption_mutex);
+        printf("Error: Too many evictions in flight, container %s is not requeued\n",
+               container_id);
+        return -1;
+    }
+
+    requeue_entry_t* entry = &evictions[eviction_count++];
+    memset(entry, 0, sizeof(*entry));
+    strncpy(entry->container_id, container_id, MAX_NAME_LEN - 1);
+    entry->config = *config;
+    entry->desired_state = desired_state;
+    strncpy(entry->evicted_by, evicted_by ? evicted_by : "-", MAX_NAME_LEN - 1);
+    pthread_mutex_unlock(&preemption_mutex);
+
+    return 0;
+}
+
+// A delete finished; a victim that is gone is queued to be placed again, one
+// that survived is forgotten so it is never placed twice
+void preemption_evicted(const char* container_id, int succeeded) {
+    if (!container_id) return;
+
+    pthread_mutex_lock(&preemption_mutex);
+    for (int i = 0; i < eviction_count; i++) {
+        if (strcmp(evictions[i].container_id, container_id) != 0) continue;
+
+        requeue_entry_t entry = evictions[i];
+        evictions[i] = evictions[--eviction_count];
+        if (succeeded) {
+            // Hold off one backoff step so the evictor gets the room it made
+            entry.queued_at = time(NULL);
+            entry.next_attempt = entry.queued_at + PREEMPTION_BASE_BACKOFF;
+            if (enqueue_locked(&entry) == 0) {
+                requeued_total++;
+                printf("Container %s (priority %d) requeued after eviction by %s\n",
+                       entry.config.name, entry.config.priority, entry.evicted_by);
+            }
+        }
+        break;
+    }
+    pthread_mutex_unlock(&preemption_mutex);
+}
+
+// Copy the requeue counters
+void preemption_status(preemption_status_t* status) {
+    pthread_mutex_lock(&preemption_mutex);
+    status->waiting = requeue_count;
+    status->evicting = eviction_count;
+    status->requeued = requeued_total;
+    status->placed = placed_total;
+    pthread_mutex_unlock(&preemption_mutex);
+}
+
+// Print preemption settings and the requeue
+void show_preemption(void) {
+    time_t now = time(NULL);
+
+    printf("\n=== Preemption ===\n");
+    pthread_mutex_lock(&preemption_mutex);
+    printf("Enabled: %s  Requeued: %lu  Placed again: %lu  Waiting: %d  Evicting: %d\n",
+           config_current()->preemption ? "yes" : "no", requeued_total, placed_total,
+           requeue_count, eviction_count);
+    printf("%-20s %-9s %-20s %-9s %-8s %-10s\n", "Name", "Priority", "Evicted by", "Waiting",
+           "Retries", "Next try");
+    printf("-------------------------------------------------------------------------------\n");
+    for (int i = 0; i < requeue_count; i++) {
+        const requeue_entry_t* entry = &requeue_queue[i];
+        char waiting[32];
+        long next = entry->next_attempt > now ? (long)(entry->next_attempt - now) : 0;
+        snprintf(waiting, sizeof(waiting), "%lds", (long)(now - entry->queued_at));
+        printf("%-20s %-9d %-20s %-9s %-8d %lds\n", entry->config.name, entry->config.priority,
+               entry->evicted_by, waiting, entry->attempts, next);
+    }
+    pthread_mutex_unlock(&preemption_mutex);
+}
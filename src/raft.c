@@ -0,0 +1,1392 @@
+#include "../include/raft.h"
+#include <netinet/tcp.h>
+
+#define RAFT_META_FILE "raft.meta"
+#define RAFT_MAX_PAYLOAD (512UL * 1024 * 1024)
+#define RAFT_RECONNECT_MS 200
+#define RAFT_SNAPSHOT_WAIT_MS 1000
+
+// RPCs exchanged between coordinators
+typedef enum {
+    RAFT_REQUEST_VOTE = 1,
+    RAFT_VOTE_REPLY,
+    RAFT_APPEND_ENTRIES,
+    RAFT_APPEND_REPLY,
+    RAFT_INSTALL_SNAPSHOT,
+    RAFT_SNAPSHOT_REPLY
+} raft_message_type_t;
+
+// RPC header, followed by length payload bytes
+typedef struct {
+    uint32_t type;
+    uint32_t from;
+    uint64_t term;
+    uint64_t index;      // Vote: last log index. Append: prev index. Replies: match index or retry hint
+    uint64_t log_term;   // Vote: last log term. Append: prev entry term
+    uint64_t commit;     // Append: leader commit index
+    uint32_t count;      // Append: entries in the payload
+    uint32_t success;    // Replies: vote granted or entries stored
+    uint64_t length;     // Payload bytes
+} raft_message_t;
+
+// Log entry after the snapshot, kept in memory for replication
+typedef struct {
+    unsigned long term;
+    wal_record_type_t type;
+    size_t length;
+    char* data;
+} raft_entry_t;
+
+// Replication state for a cluster member
+typedef struct {
+    raft_peer_t address;
+    int fd;                      // Outbound connection, -1 while down
+    unsigned long next_index;    // Next entry to send
+    unsigned long match_index;   // Highest entry known to be stored there
+    int inflight;                // AppendEntries sent but not answered yet
+    int snapshot_inflight;
+    int vote_requested;          // RequestVote sent in the current term
+    long long last_sent_ms;
+} raft_member_t;
+
+typedef struct {
+    raft_member_t* member;
+    int fd;
+} raft_reader_arg_t;
+
+// Cluster configuration
+static int raft_active = 0;
+static int raft_running = 0;
+static char raft_dir[MAX_PATH_LEN];
+static int self_id = 0;
+static int self_index = -1;
+static raft_member_t members[MAX_RAFT_PEERS];
+static int member_count = 0;
+static int election_timeout_ms = DEFAULT_ELECTION_TIMEOUT_MS;
+static int heartbeat_ms = DEFAULT_ELECTION_TIMEOUT_MS / 10;
+static raft_apply_handler_t apply_handler = NULL;
+static raft_reset_handler_t reset_handler = NULL;
+static raft_role_handler_t role_handler = NULL;
+
+// Persistent state, written to raft.meta before it is acted on
+static unsigned long current_term = 0;
+static int voted_for = 0;
+
+// Volatile state (protected by raft_mutex). Entries after base_index live in
+// log_entries[index - base_index - 1]; everything up to base_index is in the
+// snapshot.
+static raft_role_t role = RAFT_FOLLOWER;
+static int leader_id = 0;
+static int leader_ready = 0;         // Log applied and term's first entry appended
+static int votes = 0;
+static raft_entry_t* log_entries = NULL;
+static size_t log_capacity = 0;
+static unsigned long base_index = 0;
+static unsigned long base_term = 0;
+static unsigned long last_index = 0;
+static unsigned long commit_index = 0;
+static unsigned long last_applied = 0;
+static unsigned long local_durable = 0;
+static int rebuild_pending = 0;      // Lost leadership with state from uncommitted entries
+static int applying = 0;             // Apply thread is running a handler
+static int installing = 0;           // A snapshot from the leader is being installed
+static long long last_contact_ms = 0;
+static int current_timeout_ms = DEFAULT_ELECTION_TIMEOUT_MS;
+static unsigned int timeout_seed = 1;
+
+static pthread_mutex_t raft_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t raft_cond = PTHREAD_COND_INITIALIZER;     // Senders and state changes
+static pthread_cond_t apply_cond = PTHREAD_COND_INITIALIZER;    // Apply thread
+static pthread_cond_t commit_cond = PTHREAD_COND_INITIALIZER;   // raft_wait_commit
+
+// Monotonic clock in milliseconds
+static long long now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+// Absolute CLOCK_REALTIME deadline for a condition wait
+static void deadline_after(struct timespec* deadline, int ms) {
+    clock_gettime(CLOCK_REALTIME, deadline);
+    deadline->tv_sec += ms / 1000;
+    deadline->tv_nsec += (long)(ms % 1000) * 1000000;
+    if (deadline->tv_nsec >= 1000000000L) {
+        deadline->tv_sec++;
+        deadline->tv_nsec -= 1000000000L;
+    }
+}
+
+// Votes or acknowledgements needed for a decision
+static int quorum(void) {
+    return member_count / 2 + 1;
+}
+
+// Pick a new randomized election timeout (caller holds raft_mutex)
+static void reset_election_timer_locked(void) {
+    last_contact_ms = now_ms();
+    current_timeout_ms = election_timeout_ms + rand_r(&timeout_seed) % election_timeout_ms;
+}
+
+// Parse "id=ip:raft_port:client_port,..." into peers, returns the count or -1
+int raft_parse_peers(const char* spec, raft_peer_t* peers, int max_peers) {
+    if (!spec || !peers) return -1;
+
+    char buffer[MAX_COMMAND_LEN];
+    strncpy(buffer, spec, sizeof(buffer) - 1);
+    buffer[sizeof(buffer) - 1] = '\0';
+
+    int count = 0;
+    char* saveptr = NULL;
+    for (char* item = strtok_r(buffer, ", ", &saveptr); item;
+         item = strtok_r(NULL, ", ", &saveptr)) {
+        raft_peer_t peer;
+        memset(&peer, 0, sizeof(peer));
+
+        if (count >= max_peers ||
+            sscanf(item, "%d=%15[^:]:%d:%d", &peer.id, peer.ip_address,
+                   &peer.raft_port, &peer.client_port) != 4 ||
+            peer.id <= 0 || peer.raft_port <= 0 || peer.client_port <= 0) {
+            printf("Error: Invalid cluster peer %s\n", item);
+            return -1;
+        }
+        peers[count++] = peer;
+    }
+
+    return count;
+}
+
+// Term of the entry at index, 0 if it is not in memory (caller holds raft_mutex)
+static unsigned long term_at(unsigned long index) {
+    if (index == base_index) return base_term;
+    if (index > base_index && index <= last_index) {
+        return log_entries[index - base_index - 1].term;
+    }
+    return 0;
+}
+
+// Add an entry to the in-memory log (caller holds raft_mutex)
+static int append_memory_locked(unsigned long term, wal_record_type_t type,
+                                const void* data, size_t length) {
+    size_t count = last_index - base_index;
+
+    if (count == log_capacity) {
+        size_t capacity = log_capacity ? log_capacity * 2 : 1024;
+        raft_entry_t* grown = realloc(log_entries, capacity * sizeof(raft_entry_t));
+        if (!grown) {
+            printf("Error: Out of memory for replicated log\n");
+            return -1;
+        }
+        log_entries = grown;
+        log_capacity = capacity;
+    }
+
+    raft_entry_t* entry = &log_entries[count];
+    entry->term = term;
+    entry->type = type;
+    entry->length = length;
+    entry->data = NULL;
+
+    if (length > 0) {
+        entry->data = malloc(length);
+        if (!entry->data) {
+            printf("Error: Out of memory for replicated log\n");
+            return -1;
+        }
+        memcpy(entry->data, data, length);
+    }
+
+    last_index++;
+    return 0;
+}
+
+// Drop in-memory entries from index on (caller holds raft_mutex)
+static void truncate_memory_locked(unsigned long index) {
+    while (last_index >= index && last_index > base_index) {
+        free(log_entries[last_index - base_index - 1].data);
+        last_index--;
+    }
+}
+
+// Drop in-memory entries up to index once a snapshot covers them
+// (caller holds raft_mutex)
+static void compact_memory_locked(unsigned long index, unsigned long term) {
+    if (index <= base_index) return;
+
+    if (index > last_index) {
+        truncate_memory_locked(base_index + 1);
+        base_index = index;
+        base_term = term;
+        last_index = index;
+        return;
+    }
+
+    size_t dropped = index - base_index;
+    size_t remaining = last_index - index;
+
+    for (size_t i = 0; i < dropped; i++) {
+        free(log_entries[i].data);
+    }
+    memmove(log_entries, log_entries + dropped, remaining * sizeof(raft_entry_t));
+
+    base_index = index;
+    base_term = term;
+}
+
+// Copy an entry so it can be applied without holding raft_mutex; returns the
+// payload buffer the caller must free (caller holds raft_mutex)
+static void* copy_entry_locked(unsigned long index, wal_entry_t* entry) {
+    raft_entry_t* source = &log_entries[index - base_index - 1];
+    void* data = NULL;
+
+    if (source->length > 0) {
+        data = malloc(source->length);
+        if (data) memcpy(data, source->data, source->length);
+    }
+
+    entry->lsn = index;
+    entry->term = source->term;
+    entry->type = source->type;
+    entry->data = data;
+    entry->length = data ? source->length : 0;
+    return data;
+}
+
+// Persist term and vote (caller holds raft_mutex)
+static void persist_meta_locked(void) {
+    char path[MAX_PATH_LEN + 32];
+    char temp_path[MAX_PATH_LEN + 32];
+
+    snprintf(path, sizeof(path), "%s/%s", raft_dir, RAFT_META_FILE);
+    snprintf(temp_path, sizeof(temp_path), "%s/%s.tmp", raft_dir, RAFT_META_FILE);
+
+    FILE* file = fopen(temp_path, "w");
+    if (!file) {
+        printf("Error: Cannot write %s: %s\n", temp_path, strerror(errno));
+        return;
+    }
+
+    fprintf(file, "%lu %d\n", current_term, voted_for);
+    fflush(file);
+    fsync(fileno(file));
+    fclose(file);
+
+    if (rename(temp_path, path) != 0) {
+        printf("Error: Cannot replace %s: %s\n", path, strerror(errno));
+    }
+}
+
+// Load term and vote from a previous run
+static void load_meta(void) {
+    char path[MAX_PATH_LEN + 32];
+    snprintf(path, sizeof(path), "%s/%s", raft_dir, RAFT_META_FILE);
+
+    FILE* file = fopen(path, "r");
+    if (!file) return;
+
+    if (fscanf(file, "%lu %d", &current_term, &voted_for) != 2) {
+        current_term = 0;
+        voted_for = 0;
+    }
+    fclose(file);
+}
+
+// Set the commit index and wake whoever waits on it (caller holds raft_mutex)
+static void set_commit_locked(unsigned long index) {
+    if (index <= commit_index) return;
+
+    commit_index = index;
+    pthread_cond_broadcast(&commit_cond);
+    pthread_cond_signal(&apply_cond);
+}
+
+// Step down to follower, adopting a newer term (caller holds raft_mutex)
+static void become_follower_locked(unsigned long term) {
+    if (term > current_term) {
+        current_term = term;
+        voted_for = 0;
+        persist_meta_locked();
+    }
+
+    if (role == RAFT_LEADER) {
+        // The state machine may hold entries that never committed
+        printf("Stepping down as leader in term %lu\n", current_term);
+        rebuild_pending = 1;
+        pthread_cond_signal(&apply_cond);
+    }
+
+    role = RAFT_FOLLOWER;
+    leader_ready = 0;
+    pthread_cond_broadcast(&raft_cond);
+    pthread_cond_broadcast(&commit_cond);
+}
+
+// Take over as leader (caller holds raft_mutex)
+static void become_leader_locked(void) {
+    role = RAFT_LEADER;
+    leader_id = self_id;
+    leader_ready = 0;
+
+    for (int i = 0; i < member_count; i++) {
+        members[i].next_index = last_index + 1;
+        members[i].match_index = 0;
+        members[i].inflight = 0;
+        members[i].snapshot_inflight = 0;
+        members[i].last_sent_ms = 0;
+    }
+
+    printf("Elected leader for term %lu\n", current_term);
+    pthread_cond_signal(&apply_cond);
+    pthread_cond_broadcast(&raft_cond);
+}
+
+// Start an election for the next term (caller holds raft_mutex)
+static void start_election_locked(void) {
+    current_term++;
+    role = RAFT_CANDIDATE;
+    voted_for = self_id;
+    leader_id = 0;
+    votes = 1;
+    persist_meta_locked();
+
+    for (int i = 0; i < member_count; i++) {
+        members[i].vote_requested = 0;
+    }
+
+    reset_election_timer_locked();
+
+    if (votes >= quorum()) {
+        become_leader_locked();
+    }
+    pthread_cond_broadcast(&raft_cond);
+}
+
+// Commit the highest entry of this term stored on a quorum (caller holds raft_mutex)
+static void advance_commit_locked(void) {
+    if (role != RAFT_LEADER) return;
+
+    unsigned long matches[MAX_RAFT_PEERS];
+    for (int i = 0; i < member_count; i++) {
+        if (i == self_index) {
+            matches[i] = (local_durable < last_index) ? local_durable : last_index;
+        } else {
+            matches[i] = members[i].match_index;
+        }
+    }
+
+    // Partial selection sort, descending, up to the quorum position
+    int needed = quorum();
+    for (int i = 0; i < needed; i++) {
+        for (int j = i + 1; j < member_count; j++) {
+            if (matches[j] > matches[i]) {
+                unsigned long swap = matches[i];
+                matches[i] = matches[j];
+                matches[j] = swap;
+            }
+        }
+    }
+
+    unsigned long candidate = matches[needed - 1];
+    if (candidate > commit_index && term_at(candidate) == current_term) {
+        set_commit_locked(candidate);
+    }
+}
+
+// Track local group commits; the leader counts itself once entries are on disk
+static void raft_durable(unsigned long lsn) {
+    pthread_mutex_lock(&raft_mutex);
+    local_durable = lsn;
+    advance_commit_locked();
+    pthread_mutex_unlock(&raft_mutex);
+}
+
+// Append an entry of the current term locally, returns its index or 0
+// (caller holds raft_mutex)
+static unsigned long append_local_locked(wal_record_type_t type, const void* data, size_t length) {
+    wal_entry_t entry = { last_index + 1, current_term, type, data, length };
+
+    if (wal_append_entry(&entry) != 0) {
+        printf("Error: Failed to append entry %lu to the log\n", entry.lsn);
+        return 0;
+    }
+    if (append_memory_locked(current_term, type, data, length) != 0) {
+        return 0;
+    }
+
+    pthread_cond_broadcast(&raft_cond);
+    return entry.lsn;
+}
+
+// Apply the entry after last_applied with raft_mutex released
+// (caller holds raft_mutex)
+static void apply_next_locked(void) {
+    unsigned long index = last_applied + 1;
+    wal_entry_t entry;
+    void* data = copy_entry_locked(index, &entry);
+
+    applying = 1;
+    pthread_mutex_unlock(&raft_mutex);
+
+    apply_handler(&entry);
+    free(data);
+
+    pthread_mutex_lock(&raft_mutex);
+    applying = 0;
+    if (last_applied == index - 1) {
+        last_applied = index;
+    }
+    pthread_cond_broadcast(&raft_cond);
+}
+
+// Rebuild the state machine from the snapshot; committed entries are then
+// applied by the apply loop (caller holds raft_mutex)
+static void rebuild_state_locked(void) {
+    applying = 1;
+    pthread_mutex_unlock(&raft_mutex);
+
+    if (role_handler) role_handler(0);
+
+    printf("Rebuilding state from the committed log\n");
+    if (reset_handler) reset_handler();
+    wal_restore_snapshot(apply_handler);
+
+    pthread_mutex_lock(&raft_mutex);
+    applying = 0;
+    last_applied = base_index;
+    pthread_cond_broadcast(&raft_cond);
+}
+
+// Bring a new leader's state machine up to its log, then append an entry of
+// the new term so earlier entries can commit (caller holds raft_mutex)
+static void promote_locked(void) {
+    unsigned long term = current_term;
+
+    while (role == RAFT_LEADER && current_term == term && last_applied < last_index &&
+           last_applied >= base_index) {
+        apply_next_locked();
+    }
+
+    if (role != RAFT_LEADER || current_term != term) return;
+
+    if (append_local_locked(WAL_NOOP, NULL, 0) == 0) return;
+    last_applied = last_index;
+    leader_ready = 1;
+
+    pthread_mutex_unlock(&raft_mutex);
+    if (role_handler) role_handler(1);
+    pthread_mutex_lock(&raft_mutex);
+}
+
+// Apply committed entries on followers and handle role changes
+static void* raft_apply_thread(void* arg) {
+    (void)arg;
+
+    pthread_mutex_lock(&raft_mutex);
+    while (raft_running) {
+        if (installing) {
+            pthread_cond_wait(&apply_cond, &raft_mutex);
+        } else if (rebuild_pending) {
+            rebuild_pending = 0;
+            rebuild_state_locked();
+        } else if (role == RAFT_LEADER && !leader_ready) {
+            promote_locked();
+        } else if (role != RAFT_LEADER && last_applied < commit_index &&
+                   last_applied >= base_index) {
+            apply_next_locked();
+        } else {
+            pthread_cond_wait(&apply_cond, &raft_mutex);
+        }
+    }
+    pthread_mutex_unlock(&raft_mutex);
+    return NULL;
+}
+
+// Write a whole buffer to a socket
+static int send_all(int fd, const void* data, size_t length) {
+    const char* bytes = (const char*)data;
+
+    while (length > 0) {
+        ssize_t sent = send(fd, bytes, length, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        bytes += sent;
+        length -= sent;
+    }
+    return 0;
+}
+
+// Read exactly length bytes from a socket
+static int recv_all(int fd, void* data, size_t length) {
+    char* bytes = (char*)data;
+
+    while (length > 0) {
+        ssize_t received = recv(fd, bytes, length, 0);
+        if (received < 0 && errno == EINTR) continue;
+        if (received <= 0) return -1;
+        bytes += received;
+        length -= received;
+    }
+    return 0;
+}
+
+// Send an RPC with its payload
+static int send_frame(int fd, const raft_message_t* msg, const void* payload) {
+    if (send_all(fd, msg, sizeof(*msg)) != 0) return -1;
+    if (msg->length > 0 && send_all(fd, payload, msg->length) != 0) return -1;
+    return 0;
+}
+
+// Receive an RPC; the payload, if any, is malloc'd for the caller
+static int recv_frame(int fd, raft_message_t* msg, char** payload) {
+    *payload = NULL;
+
+    if (recv_all(fd, msg, sizeof(*msg)) != 0) return -1;
+    if (msg->length == 0) return 0;
+    if (msg->length > RAFT_MAX_PAYLOAD) return -1;
+
+    *payload = malloc(msg->length);
+    if (!*payload) return -1;
+
+    if (recv_all(fd, *payload, msg->length) != 0) {
+        free(*payload);
+        *payload = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+// Handle a reply on an outbound connection (caller holds raft_mutex)
+static void handle_reply_locked(raft_member_t* member, const raft_message_t* msg) {
+    if (msg->term > current_term) {
+        become_follower_locked(msg->term);
+        return;
+    }
+
+    switch (msg->type) {
+        case RAFT_VOTE_REPLY:
+            if (role == RAFT_CANDIDATE && msg->term == current_term && msg->success) {
+                votes++;
+                if (votes >= quorum()) {
+                    become_leader_locked();
+                }
+            }
+            break;
+
+        case RAFT_APPEND_REPLY:
+            if (role != RAFT_LEADER || msg->term != current_term) break;
+
+            if (member->inflight > 0) member->inflight--;
+
+            if (msg->success) {
+                if (msg->index > member->match_index) {
+                    member->match_index = msg->index;
+                }
+                if (member->next_index <= member->match_index) {
+                    member->next_index = member->match_index + 1;
+                }
+                advance_commit_locked();
+            } else {
+                // Rewind to the follower's hint; later pipelined batches fail the same way
+                unsigned long hint = msg->index + 1;
+                if (hint <= member->match_index) hint = member->match_index + 1;
+                if (hint < member->next_index) member->next_index = hint;
+                member->inflight = 0;
+            }
+            break;
+
+        case RAFT_SNAPSHOT_REPLY:
+            if (role != RAFT_LEADER || msg->term != current_term) break;
+
+            member->snapshot_inflight = 0;
+            if (msg->success && msg->index > member->match_index) {
+                member->match_index = msg->index;
+                member->next_index = msg->index + 1;
+                advance_commit_locked();
+            }
+            break;
+
+        default:
+            break;
+    }
+
+    pthread_cond_broadcast(&raft_cond);
+}
+
+// Read replies from an outbound connection until it fails
+static void* raft_reader_thread(void* arg) {
+    raft_reader_arg_t* reader = (raft_reader_arg_t*)arg;
+    raft_member_t* member = reader->member;
+    int fd = reader->fd;
+    free(reader);
+
+    raft_message_t msg;
+    char* payload;
+
+    while (recv_frame(fd, &msg, &payload) == 0) {
+        pthread_mutex_lock(&raft_mutex);
+        handle_reply_locked(member, &msg);
+        pthread_mutex_unlock(&raft_mutex);
+        free(payload);
+    }
+
+    pthread_mutex_lock(&raft_mutex);
+    if (member->fd == fd) {
+        member->fd = -1;
+        member->inflight = 0;
+        member->snapshot_inflight = 0;
+        if (role == RAFT_LEADER) {
+            member->next_index = member->match_index + 1;
+        }
+    }
+    pthread_cond_broadcast(&raft_cond);
+    pthread_mutex_unlock(&raft_mutex);
+
+    close(fd);
+    return NULL;
+}
+
+// Open a replication connection to a member
+static int connect_member(const raft_peer_t* peer) {
+    struct sockaddr_in address;
+    struct timeval timeout = { 1, 0 };
+    int one = 1;
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(peer->raft_port);
+
+    if (inet_pton(AF_INET, peer->ip_address, &address.sin_addr) <= 0 ||
+        connect(fd, (struct sockaddr*)&address, sizeof(address)) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+// Build the next AppendEntries batch for a member into buffer, returns 0 if
+// nothing could be encoded (caller holds raft_mutex)
+static int build_append_locked(raft_member_t* member, raft_message_t* msg,
+                               char** buffer, size_t* capacity, size_t* length) {
+    unsigned long prev = member->next_index - 1;
+    unsigned int count = 0;
+
+    *length = 0;
+    for (unsigned long index = member->next_index;
+         index <= last_index && count < RAFT_MAX_BATCH && *length < RAFT_MAX_BATCH_BYTES;
+         index++, count++) {
+        raft_entry_t* source = &log_entries[index - base_index - 1];
+        wal_entry_t entry = { index, source->term, source->type, source->data, source->length };
+
+        if (wal_encode_entry(buffer, length, capacity, &entry) != 0) {
+            return 0;
+        }
+    }
+
+    memset(msg, 0, sizeof(*msg));
+    msg->type = RAFT_APPEND_ENTRIES;
+    msg->from = self_id;
+    msg->term = current_term;
+    msg->index = prev;
+    msg->log_term = term_at(prev);
+    msg->commit = commit_index;
+    msg->count = count;
+    msg->length = *length;
+
+    member->next_index += count;
+    member->inflight++;
+    member->last_sent_ms = now_ms();
+    return 1;
+}
+
+// Drive replication and vote requests for one member
+static void* raft_sender_thread(void* arg) {
+    raft_member_t* member = (raft_member_t*)arg;
+    char* buffer = NULL;
+    size_t capacity = 0;
+
+    pthread_mutex_lock(&raft_mutex);
+    while (raft_running) {
+        if (member->fd < 0) {
+            pthread_mutex_unlock(&raft_mutex);
+            int fd = connect_member(&member->address);
+            pthread_mutex_lock(&raft_mutex);
+
+            if (fd < 0) {
+                struct timespec deadline;
+                deadline_after(&deadline, RAFT_RECONNECT_MS);
+                pthread_cond_timedwait(&raft_cond, &raft_mutex, &deadline);
+                continue;
+            }
+
+            raft_reader_arg_t* reader = malloc(sizeof(raft_reader_arg_t));
+            pthread_t reader_tid;
+            if (!reader) {
+                close(fd);
+                continue;
+            }
+            reader->member = member;
+            reader->fd = fd;
+
+            if (pthread_create(&reader_tid, NULL, raft_reader_thread, reader) != 0) {
+                free(reader);
+                close(fd);
+                continue;
+            }
+            pthread_detach(reader_tid);
+
+            member->fd = fd;
+            member->inflight = 0;
+            member->snapshot_inflight = 0;
+            member->vote_requested = 0;
+            if (role == RAFT_LEADER) {
+                member->next_index = member->match_index + 1;
+            }
+        }
+
+        raft_message_t msg;
+        size_t length = 0;
+        int send_snapshot = 0;
+        int have_message = 0;
+        long long now = now_ms();
+
+        memset(&msg, 0, sizeof(msg));
+
+        if (role == RAFT_CANDIDATE && !member->vote_requested) {
+            msg.type = RAFT_REQUEST_VOTE;
+            msg.from = self_id;
+            msg.term = current_term;
+            msg.index = last_index;
+            msg.log_term = term_at(last_index);
+            member->vote_requested = 1;
+            have_message = 1;
+        } else if (role == RAFT_LEADER) {
+            if (member->next_index <= base_index) {
+                // The entries it needs were compacted, ship the snapshot instead
+                if (!member->snapshot_inflight) {
+                    member->snapshot_inflight = 1;
+                    msg.type = RAFT_INSTALL_SNAPSHOT;
+                    msg.from = self_id;
+                    msg.term = current_term;
+                    send_snapshot = 1;
+                }
+            } else if (member->inflight < RAFT_MAX_INFLIGHT &&
+                       (member->next_index <= last_index ||
+                        now - member->last_sent_ms >= heartbeat_ms)) {
+                have_message = build_append_locked(member, &msg, &buffer, &capacity, &length);
+            }
+        }
+
+        if (!have_message && !send_snapshot) {
+            struct timespec deadline;
+            deadline_after(&deadline, heartbeat_ms);
+            pthread_cond_timedwait(&raft_cond, &raft_mutex, &deadline);
+            continue;
+        }
+
+        int fd = member->fd;
+        pthread_mutex_unlock(&raft_mutex);
+
+        char* snapshot = NULL;
+        const char* payload = buffer;
+        int result = 0;
+
+        if (send_snapshot) {
+            size_t snapshot_length = 0;
+            if (wal_read_snapshot(&snapshot, &snapshot_length) == 0) {
+                msg.length = snapshot_length;
+                payload = snapshot;
+            } else {
+                result = -1;
+            }
+        }
+
+        if (result == 0) {
+            result = send_frame(fd, &msg, payload);
+        }
+        free(snapshot);
+
+        pthread_mutex_lock(&raft_mutex);
+        if (result != 0 && member->fd == fd) {
+            // The reader thread notices and resets the connection
+            shutdown(fd, SHUT_RDWR);
+            member->snapshot_inflight = 0;
+        }
+    }
+    pthread_mutex_unlock(&raft_mutex);
+
+    free(buffer);
+    return NULL;
+}
+
+// Handle RequestVote (caller holds raft_mutex)
+static void handle_vote_locked(const raft_message_t* msg, raft_message_t* reply) {
+    if (msg->term > current_term) {
+        become_follower_locked(msg->term);
+    }
+
+    int granted = 0;
+    if (msg->term == current_term && (voted_for == 0 || voted_for == (int)msg->from)) {
+        unsigned long last_term = term_at(last_index);
+
+        // Only vote for candidates whose log is at least as up to date
+        if (msg->log_term > last_term ||
+            (msg->log_term == last_term && msg->index >= last_index)) {
+            granted = 1;
+            voted_for = msg->from;
+            persist_meta_locked();
+            reset_election_timer_locked();
+        }
+    }
+
+    reply->type = RAFT_VOTE_REPLY;
+    reply->term = current_term;
+    reply->success = granted;
+}
+
+// Handle AppendEntries, syncing accepted entries before replying
+static void handle_append(const raft_message_t* msg, const char* payload, raft_message_t* reply) {
+    unsigned long match = 0;
+    unsigned long leader_commit = 0;
+    int success = 0;
+
+    pthread_mutex_lock(&raft_mutex);
+
+    reply->type = RAFT_APPEND_REPLY;
+
+    if (msg->term < current_term) {
+        reply->term = current_term;
+        reply->index = last_index;
+        pthread_mutex_unlock(&raft_mutex);
+        return;
+    }
+
+    if (msg->term > current_term || role != RAFT_FOLLOWER) {
+        become_follower_locked(msg->term);
+    }
+    leader_id = msg->from;
+    reset_election_timer_locked();
+
+    unsigned long prev = msg->index;
+
+    if (prev > last_index) {
+        reply->index = last_index;
+    } else if (prev > base_index && term_at(prev) != msg->log_term) {
+        // Committed entries always match, so the leader can resume from there
+        reply->index = commit_index;
+    } else {
+        size_t offset = 0;
+        unsigned int decoded = 0;
+        success = 1;
+
+        for (; decoded < msg->count; decoded++) {
+            wal_entry_t entry;
+            size_t size = wal_decode_entry(payload + offset, msg->length - offset, &entry);
+            if (size == 0 || entry.lsn != prev + 1 + decoded) {
+                success = 0;
+                break;
+            }
+            offset += size;
+
+            if (entry.lsn <= base_index) continue;
+
+            if (entry.lsn <= last_index) {
+                if (term_at(entry.lsn) == entry.term) continue;
+
+                // Conflicting uncommitted suffix from an older leader
+                truncate_memory_locked(entry.lsn);
+                if (wal_truncate(entry.lsn) != 0) {
+                    success = 0;
+                    break;
+                }
+                if (local_durable >= entry.lsn) {
+                    local_durable = entry.lsn - 1;
+                }
+            }
+
+            if (wal_append_entry(&entry) != 0 ||
+                append_memory_locked(entry.term, entry.type, entry.data, entry.length) != 0) {
+                success = 0;
+                break;
+            }
+        }
+
+        match = prev + decoded;
+        leader_commit = (msg->commit < match) ? msg->commit : match;
+        reply->index = success ? match : commit_index;
+    }
+
+    reply->term = current_term;
+    pthread_mutex_unlock(&raft_mutex);
+
+    // Acknowledge only what is on disk
+    if (success && wal_sync(match) != 0) {
+        success = 0;
+    }
+
+    if (success) {
+        pthread_mutex_lock(&raft_mutex);
+        if (leader_commit <= last_index) {
+            set_commit_locked(leader_commit);
+        }
+        pthread_mutex_unlock(&raft_mutex);
+    }
+
+    reply->success = success;
+}
+
+// Handle InstallSnapshot by replacing local state and log
+static void handle_install(const raft_message_t* msg, const char* payload, raft_message_t* reply) {
+    pthread_mutex_lock(&raft_mutex);
+
+    reply->type = RAFT_SNAPSHOT_REPLY;
+
+    if (msg->term < current_term) {
+        reply->term = current_term;
+        pthread_mutex_unlock(&raft_mutex);
+        return;
+    }
+
+    if (msg->term > current_term || role != RAFT_FOLLOWER) {
+        become_follower_locked(msg->term);
+    }
+    leader_id = msg->from;
+    reset_election_timer_locked();
+
+    // Keep the apply thread away from the state machine while it is replaced
+    installing = 1;
+    while (applying) {
+        pthread_cond_wait(&raft_cond, &raft_mutex);
+    }
+    pthread_mutex_unlock(&raft_mutex);
+
+    if (reset_handler) reset_handler();
+    int result = wal_install_snapshot(payload, msg->length, apply_handler);
+
+    unsigned long index = 0;
+    unsigned long term = 0;
+    wal_snapshot_position(&index, &term);
+
+    pthread_mutex_lock(&raft_mutex);
+    if (result == 0) {
+        truncate_memory_locked(base_index + 1);
+        base_index = index;
+        base_term = term;
+        last_index = index;
+        last_applied = index;
+        local_durable = index;
+        if (commit_index < index) commit_index = index;
+    }
+    installing = 0;
+    rebuild_pending = 0;
+    pthread_cond_signal(&apply_cond);
+
+    reply->term = current_term;
+    reply->index = (result == 0) ? index : last_index;
+    reply->success = (result == 0);
+    pthread_mutex_unlock(&raft_mutex);
+}
+
+// Serve RPCs from one member
+static void* raft_inbound_thread(void* arg) {
+    int fd = *(int*)arg;
+    free(arg);
+
+    raft_message_t msg;
+    char* payload;
+
+    while (recv_frame(fd, &msg, &payload) == 0) {
+        raft_message_t reply;
+        memset(&reply, 0, sizeof(reply));
+
+        switch (msg.type) {
+            case RAFT_REQUEST_VOTE:
+                pthread_mutex_lock(&raft_mutex);
+                handle_vote_locked(&msg, &reply);
+                pthread_mutex_unlock(&raft_mutex);
+                break;
+            case RAFT_APPEND_ENTRIES:
+                handle_append(&msg, payload, &reply);
+                break;
+            case RAFT_INSTALL_SNAPSHOT:
+                handle_install(&msg, payload, &reply);
+                break;
+            default:
+                free(payload);
+                continue;
+        }
+
+        free(payload);
+        reply.from = self_id;
+
+        if (send_frame(fd, &reply, NULL) != 0) break;
+    }
+
+    close(fd);
+    return NULL;
+}
+
+// Accept replication connections from other members
+static void* raft_listener_thread(void* arg) {
+    int listen_fd = *(int*)arg;
+    free(arg);
+
+    while (raft_running) {
+        int fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            printf("Error accepting replication connection: %s\n", strerror(errno));
+            continue;
+        }
+
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        int* fd_ptr = malloc(sizeof(int));
+        pthread_t tid;
+        if (!fd_ptr) {
+            close(fd);
+            continue;
+        }
+        *fd_ptr = fd;
+
+        if (pthread_create(&tid, NULL, raft_inbound_thread, fd_ptr) != 0) {
+            free(fd_ptr);
+            close(fd);
+        } else {
+            pthread_detach(tid);
+        }
+    }
+
+    close(listen_fd);
+    return NULL;
+}
+
+// Start elections when the leader goes quiet
+static void* raft_ticker_thread(void* arg) {
+    (void)arg;
+
+    while (raft_running) {
+        pthread_mutex_lock(&raft_mutex);
+        if (role != RAFT_LEADER && !installing &&
+            now_ms() - last_contact_ms >= current_timeout_ms) {
+            start_election_locked();
+        }
+        pthread_mutex_unlock(&raft_mutex);
+
+        usleep(10000);
+    }
+    return NULL;
+}
+
+// Configure replication; call before wal_open so recovered log entries reach
+// raft_load_entry
+int init_raft(const char* state_dir, int id, const raft_peer_t* peers, int peer_count,
+              int timeout_ms, raft_apply_handler_t apply,
+              raft_reset_handler_t reset, raft_role_handler_t role_changed) {
+    if (!state_dir || !peers || !apply || peer_count <= 0 || peer_count > MAX_RAFT_PEERS) {
+        return -1;
+    }
+
+    self_index = -1;
+    for (int i = 0; i < peer_count; i++) {
+        memset(&members[i], 0, sizeof(raft_member_t));
+        members[i].address = peers[i];
+        members[i].fd = -1;
+        if (peers[i].id == id) {
+            self_index = i;
+        }
+    }
+
+    if (self_index < 0) {
+        printf("Error: Cluster node id %d is not in the peer list\n", id);
+        return -1;
+    }
+
+    strncpy(raft_dir, state_dir, MAX_PATH_LEN - 1);
+    self_id = id;
+    member_count = peer_count;
+    election_timeout_ms = (timeout_ms > 0) ? timeout_ms : DEFAULT_ELECTION_TIMEOUT_MS;
+    heartbeat_ms = election_timeout_ms / 10;
+    if (heartbeat_ms < 10) heartbeat_ms = 10;
+    apply_handler = apply;
+    reset_handler = reset;
+    role_handler = role_changed;
+    timeout_seed = (unsigned int)(time(NULL) ^ (getpid() << 8) ^ id);
+
+    mkdir(raft_dir, 0755);
+    load_meta();
+
+    raft_active = 1;
+    return 0;
+}
+
+// Take a log entry found by wal_open into the in-memory log
+void raft_load_entry(const wal_entry_t* entry) {
+    pthread_mutex_lock(&raft_mutex);
+
+    if (last_index == base_index && last_index == 0) {
+        base_index = entry->lsn - 1;
+        last_index = base_index;
+    }
+
+    if (entry->lsn <= last_index) {
+        truncate_memory_locked(entry->lsn);
+    }
+
+    if (entry->lsn == last_index + 1) {
+        append_memory_locked(entry->term, entry->type, entry->data, entry->length);
+    }
+
+    pthread_mutex_unlock(&raft_mutex);
+}
+
+// Start replication threads once the log has been recovered
+int raft_start(void) {
+    unsigned long snapshot_index = 0;
+    unsigned long snapshot_term = 0;
+    raft_member_t* self = &members[self_index];
+
+    wal_snapshot_position(&snapshot_index, &snapshot_term);
+
+    pthread_mutex_lock(&raft_mutex);
+    if (last_index == base_index) {
+        base_index = snapshot_index;
+        last_index = snapshot_index;
+    }
+    base_term = snapshot_term;
+    commit_index = base_index;
+    last_applied = base_index;
+    local_durable = last_index;
+    role = RAFT_FOLLOWER;
+    reset_election_timer_locked();
+    raft_running = 1;
+    pthread_mutex_unlock(&raft_mutex);
+
+    wal_set_durable_handler(raft_durable);
+
+    int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    struct sockaddr_in address;
+
+    if (listen_fd < 0) {
+        printf("Error creating replication socket: %s\n", strerror(errno));
+        return -1;
+    }
+    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = INADDR_ANY;
+    address.sin_port = htons(self->address.raft_port);
+
+    if (bind(listen_fd, (struct sockaddr*)&address, sizeof(address)) < 0 ||
+        listen(listen_fd, MAX_RAFT_PEERS * 2) < 0) {
+        printf("Error: Cannot listen for replication on port %d: %s\n",
+               self->address.raft_port, strerror(errno));
+        close(listen_fd);
+        return -1;
+    }
+
+    pthread_t tid;
+    int* fd_ptr = malloc(sizeof(int));
+    if (!fd_ptr) {
+        close(listen_fd);
+        return -1;
+    }
+    *fd_ptr = listen_fd;
+
+    if (pthread_create(&tid, NULL, raft_listener_thread, fd_ptr) != 0) {
+        free(fd_ptr);
+        close(listen_fd);
+        return -1;
+    }
+    pthread_detach(tid);
+
+    if (pthread_create(&tid, NULL, raft_apply_thread, NULL) != 0 ||
+        pthread_detach(tid) != 0 ||
+        pthread_create(&tid, NULL, raft_ticker_thread, NULL) != 0 ||
+        pthread_detach(tid) != 0) {
+        printf("Error: Failed to start replication threads\n");
+        return -1;
+    }
+
+    for (int i = 0; i < member_count; i++) {
+        if (i == self_index) continue;
+        if (pthread_create(&tid, NULL, raft_sender_thread, &members[i]) != 0) {
+            printf("Error: Failed to start replication thread for member %d\n",
+                   members[i].address.id);
+            return -1;
+        }
+        pthread_detach(tid);
+    }
+
+    printf("Cluster member %d replicating on port %d with %d member(s), term %lu, log %lu-%lu\n",
+           self_id, self->address.raft_port, member_count, current_term, base_index, last_index);
+    return 0;
+}
+
+// Check whether this coordinator is part of a replicated cluster
+int raft_enabled(void) {
+    return raft_active;
+}
+
+// Check whether this coordinator may change state
+int raft_is_leader(void) {
+    pthread_mutex_lock(&raft_mutex);
+    int leader = (role == RAFT_LEADER && leader_ready);
+    pthread_mutex_unlock(&raft_mutex);
+    return leader;
+}
+
+// Worker-facing address of the current leader, -1 if unknown
+int raft_leader_address(char* ip_address, int* port) {
+    int result = -1;
+
+    pthread_mutex_lock(&raft_mutex);
+    for (int i = 0; i < member_count && leader_id != 0; i++) {
+        if (members[i].address.id == leader_id) {
+            strcpy(ip_address, members[i].address.ip_address);
+            *port = members[i].address.client_port;
+            result = 0;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&raft_mutex);
+
+    return result;
+}
+
+// Append a state change on the leader. The caller has already applied it to
+// the state machine; returns the entry index or 0 when not the leader.
+unsigned long raft_propose(wal_record_type_t type, const void* data, size_t length) {
+    pthread_mutex_lock(&raft_mutex);
+
+    if (role != RAFT_LEADER || !leader_ready) {
+        pthread_mutex_unlock(&raft_mutex);
+        return 0;
+    }
+
+    unsigned long index = append_local_locked(type, data, length);
+    if (index > 0) {
+        last_applied = index;
+    }
+
+    pthread_mutex_unlock(&raft_mutex);
+    return index;
+}
+
+// Wait until an entry is committed by a quorum, -1 on timeout or lost leadership
+int raft_wait_commit(unsigned long index, int timeout_ms) {
+    struct timespec deadline;
+    deadline_after(&deadline, timeout_ms);
+
+    pthread_mutex_lock(&raft_mutex);
+
+    unsigned long term = current_term;
+    int result = 0;
+
+    if (index == 0) {
+        result = (role == RAFT_LEADER && leader_ready) ? 0 : -1;
+    } else {
+        while (commit_index < index && role == RAFT_LEADER && current_term == term) {
+            if (pthread_cond_timedwait(&commit_cond, &raft_mutex, &deadline) == ETIMEDOUT) {
+                break;
+            }
+        }
+        result = (commit_index >= index && role == RAFT_LEADER && current_term == term) ? 0 : -1;
+    }
+
+    pthread_mutex_unlock(&raft_mutex);
+    return result;
+}
+
+// Entry index and term the state machine reflects, for a snapshot. On the
+// leader this waits briefly for applied entries to commit; returns -1 when no
+// consistent point is available.
+int raft_snapshot_point(unsigned long* index, unsigned long* term) {
+    struct timespec deadline;
+    deadline_after(&deadline, RAFT_SNAPSHOT_WAIT_MS);
+
+    pthread_mutex_lock(&raft_mutex);
+
+    if (rebuild_pending || installing || (role == RAFT_LEADER && !leader_ready)) {
+        pthread_mutex_unlock(&raft_mutex);
+        return -1;
+    }
+
+    while (role == RAFT_LEADER && commit_index < last_applied) {
+        if (pthread_cond_timedwait(&commit_cond, &raft_mutex, &deadline) == ETIMEDOUT) {
+            break;
+        }
+    }
+
+    int result = -1;
+    if (commit_index >= last_applied && last_applied >= base_index && !rebuild_pending) {
+        *index = last_applied;
+        *term = term_at(last_applied);
+        result = 0;
+    }
+
+    pthread_mutex_unlock(&raft_mutex);
+    return result;
+}
+
+// Release in-memory entries covered by a snapshot
+void raft_compact(unsigned long index, unsigned long term) {
+    pthread_mutex_lock(&raft_mutex);
+    if (index <= last_index) {
+        compact_memory_locked(index, term);
+    }
+    pthread_mutex_unlock(&raft_mutex);
+}
+
+// Print replication status
+void show_raft(void) {
+    static const char* role_names[] = { "FOLLOWER", "CANDIDATE", "LEADER" };
+
+    printf("\n=== Cluster ===\n");
+    if (!raft_active) {
+        printf("Standalone (set node_id and peers in the [cluster] section)\n");
+        return;
+    }
+
+    pthread_mutex_lock(&raft_mutex);
+
+    printf("Member %d  Role: %s%s  Term: %lu  Leader: %d\n", self_id, role_names[role],
+           (role == RAFT_LEADER && !leader_ready) ? " (catching up)" : "",
+           current_term, leader_id);
+    printf("Log: %lu-%lu  Commit: %lu  Applied: %lu\n",
+           base_index, last_index, commit_index, last_applied);
+    printf("%-6s %-22s %-8s %-10s %-10s %-8s\n", "Id", "Address", "Link", "Next", "Match", "Inflight");
+    printf("----------------------------------------------------------------------\n");
+
+    for (int i = 0; i < member_count; i++) {
+        raft_member_t* member = &members[i];
+        char address[64];
+
+        snprintf(address, sizeof(address), "%s:%d", member->address.ip_address,
+                 member->address.raft_port);
+        if (i == self_index) {
+            printf("%-6d %-22s %-8s %-10lu %-10lu %-8s\n", member->address.id, address, "self",
+                   last_index + 1, local_durable, "-");
+        } else if (role != RAFT_LEADER) {
+            printf("%-6d %-22s %-8s %-10s %-10s %-8s\n", member->address.id, address,
+                   member->fd >= 0 ? "up" : "down", "-", "-", "-");
+        } else {
+            printf("%-6d %-22s %-8s %-10lu %-10lu %-8d\n", member->address.id, address,
+                   member->fd >= 0 ? "up" : "down", member->next_index, member->match_index,
+                   member->inflight);
+        }
+    }
+
+    pthread_mutex_unlock(&raft_mutex);
+}
@@ -0,0 +1,514 @@
+#include "../include/rebalancer.h"
+#include "../include/operations.h"
+#include "../include/config.h"
+#include "../include/raft.h"
+#include "../include/rollout.h"
+#include "../include/scheduler.h"
+
+// External declarations from network.c
+extern node_t nodes[];
+extern int node_count;
+extern pthread_mutex_t nodes_mutex;
+extern void lock_nodes(void);
+extern node_t* find_node_by_id(const char* node_id);
+
+// How a container changes node. Members of a replica group are treated as
+// stateless and redeployed, a fresh copy coming up before the old one goes;
+// anything else is migrated with its rootfs.
+typedef enum {
+    MOVE_MIGRATE,
+    MOVE_REDEPLOY
+} move_kind_t;
+
+typedef enum {
+    MOVE_STEP_TRANSFER,     // Migrate, or deploy the new copy
+    MOVE_STEP_START,        // Start the new copy
+    MOVE_STEP_DELETE_OLD,   // Retire the old copy
+    MOVE_STEP_UNDO,         // Delete a new copy that would not start
+    MOVE_STEP_DONE
+} move_step_t;
+
+// One planned move
+typedef struct {
+    move_kind_t kind;
+    move_step_t step;
+    int start;              // Container is meant to run
+    int op_id;              // Operation of the current step, 0 when none
+    int failed;
+    char id[MAX_NAME_LEN];
+    char new_id[MAX_NAME_LEN];
+    char from[MAX_NAME_LEN];
+    char to[MAX_NAME_LEN];
+    lxc_config_t config;
+} rebalance_move_t;
+
+// A node's load as the rebalancer sees it
+typedef struct {
+    char id[MAX_NAME_LEN];
+    double load;            // Mean of CPU%, memory% and container slots used
+    double per_container;   // Load one of its containers is assumed to carry
+    int exhausted;          // Nothing left to move off it this pass
+} node_load_t;
+
+static rebalance_lister_t rebalance_lister = NULL;
+static rebalance_status_t status;
+static int wake_pending = 0;
+static pthread_mutex_t rebalancer_mutex = PTHREAD_MUTEX_INITIALIZER;  // status, wake_pending
+static pthread_cond_t rebalancer_cond = PTHREAD_COND_INITIALIZER;
+
+// Working state of a pass, used by the rebalancer thread only
+static rebalance_container_t containers[MAX_CONTAINERS];
+static int tried[MAX_CONTAINERS];
+static node_load_t loads[MAX_NODES];
+static rebalance_move_t moves[REBALANCE_MAX_MOVES];
+static char recent_ids[REBALANCE_RECENT_MOVES][MAX_NAME_LEN];
+static time_t recent_times[REBALANCE_RECENT_MOVES];
+static int recent_next = 0;
+
+// Measure connected, heartbeating nodes, returns how many
+static int measure_nodes(node_load_t* out, int heartbeat_timeout) {
+    time_t now = time(NULL);
+    int count = 0;
+
+    lock_nodes();
+    for (int i = 0; i < node_count; i++) {
+        node_t* node = &nodes[i];
+        if (node->state != NODE_CONNECTED || now - node->last_heartbeat > heartbeat_timeout ||
+            node->resources.max_containers <= 0) {
+            continue;
+        }
+
+        double usage = node->resources.cpu_usage + node->resources.memory_usage;
+        double slots = 100.0 * node->container_count / node->resources.max_containers;
+        // Usage is split evenly over the node's containers
+        double usage_each = node->container_count > 0 ? usage / node->container_count : 0.0;
+
+        node_load_t* load = &out[count++];
+        strcpy(load->id, node->id);
+        load->load = (usage + slots) / 3.0;
+        load->per_container = (usage_each + 100.0 / node->resources.max_containers) / 3.0;
+        load->exhausted = 0;
+    }
+    pthread_mutex_unlock(&nodes_mutex);
+
+    return count;
+}
+
+// Index of a node in a load snapshot, -1 if it is not there
+static int find_load(const node_load_t* snapshot, int count, const char* node_id) {
+    for (int i = 0; i < count; i++) {
+        if (strcmp(snapshot[i].id, node_id) == 0) return i;
+    }
+    return -1;
+}
+
+// Busiest and idlest node of a snapshot, returns the spread between them
+static double load_spread(const node_load_t* snapshot, int count, int* busiest, int* idlest) {
+    *busiest = -1;
+    *idlest = -1;
+    for (int i = 0; i < count; i++) {
+        if (*busiest < 0 || snapshot[i].load > snapshot[*busiest].load) *busiest = i;
+        if (*idlest < 0 || snapshot[i].load < snapshot[*idlest].load) *idlest = i;
+    }
+    return count > 1 ? snapshot[*busiest].load - snapshot[*idlest].load : 0.0;
+}
+
+// Whether a container moved within the cooldown
+static int recently_moved(const char* container_id, int cooldown) {
+    time_t now = time(NULL);
+    for (int i = 0; i < REBALANCE_RECENT_MOVES; i++) {
+        if (recent_times[i] != 0 && now - recent_times[i] < cooldown &&
+            strcmp(recent_ids[i], container_id) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Remember a moved container under its new id
+static void remember_move(const char* container_id) {
+    strcpy(recent_ids[recent_next], container_id);
+    recent_times[recent_next] = time(NULL);
+    recent_next = (recent_next + 1) % REBALANCE_RECENT_MOVES;
+}
+
+// Replica group of a container
+static const char* container_group(const rebalance_container_t* container) {
+    return container->config.group[0] ? container->config.group : container->config.name;
+}
+
+// Whether other containers share this one's replica group
+static int is_replica(int index, int count) {
+    const char* group = container_group(&containers[index]);
+    for (int i = 0; i < count; i++) {
+        if (i != index && strcmp(container_group(&containers[i]), group) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Best container to move off a node: settled and not moved lately, running
+// replicas first as they are cheapest to move, then running singletons, then
+// stopped containers which only free a slot
+static int pick_candidate(const char* node_id, int count, int cooldown) {
+    int best = -1;
+    int best_rank = 0;
+
+    for (int i = 0; i < count; i++) {
+        rebalance_container_t* container = &containers[i];
+        if (tried[i] || strcmp(container->node_id, node_id) != 0 ||
+            container->state != container->desired_state ||
+            (container->state != CONTAINER_RUNNING && container->state != CONTAINER_STOPPED) ||
+            recently_moved(container->id, cooldown)) {
+            continue;
+        }
+
+        int rank = (container->state == CONTAINER_STOPPED) ? 2 : (is_replica(i, count) ? 0 : 1);
+        if (best < 0 || rank < best_rank) {
+            best = i;
+            best_rank = rank;
+        }
+    }
+    return best;
+}
+
+// Whether a container carries placement rules only the scheduler can check
+static int has_constraints(const lxc_config_t* config) {
+    return config->affinity[0] || config->anti_affinity[0] || config->spread_key[0];
+}
+
+// Unfinished rollouts own their group's placement
+static int rollout_in_progress(void) {
+    static rollout_info_t infos[MAX_ROLLOUTS];
+    int count = rollout_list(infos, MAX_ROLLOUTS);
+
+    for (int i = 0; i < count; i++) {
+        if (infos[i].state == ROLLOUT_RUNNING || infos[i].state == ROLLOUT_PAUSED ||
+            infos[i].state == ROLLOUT_ROLLING_BACK) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Submit the operation for a move's current step; returns its id, 0 if the
+// step finished without one, -1 on failure
+static int issue_step(rebalance_move_t* move) {
+    switch (move->step) {
+        case MOVE_STEP_TRANSFER:
+            return (move->kind == MOVE_MIGRATE) ? migrate_container(move->id, move->to, 0)
+                                                : deploy_container(move->to, &move->config);
+        case MOVE_STEP_START:
+            return start_container(move->new_id);
+        case MOVE_STEP_DELETE_OLD:
+            return delete_container(move->id);
+        case MOVE_STEP_UNDO:
+            return delete_container(move->new_id);
+        default:
+            return -1;
+    }
+}
+
+// Move on after a step finished
+static void advance_move(rebalance_move_t* move, int succeeded) {
+    switch (move->step) {
+        case MOVE_STEP_TRANSFER:
+            if (!succeeded) {
+                move->failed = 1;
+                move->step = MOVE_STEP_DONE;
+            } else if (move->kind == MOVE_MIGRATE) {
+                move->step = MOVE_STEP_DONE;
+            } else {
+                move->step = move->start ? MOVE_STEP_START : MOVE_STEP_DELETE_OLD;
+            }
+            break;
+        case MOVE_STEP_START:
+            if (!succeeded) {
+                // Keep the old copy serving and drop the new one
+                move->failed = 1;
+                move->step = MOVE_STEP_UNDO;
+            } else {
+                move->step = MOVE_STEP_DELETE_OLD;
+            }
+            break;
+        case MOVE_STEP_DELETE_OLD:
+            if (!succeeded) {
+                move->failed = 1;
+            }
+            move->step = MOVE_STEP_DONE;
+            break;
+        default:
+            move->step = MOVE_STEP_DONE;
+            break;
+    }
+}
+
+// Drive the planned moves to completion, all of them stepping in parallel
+static void run_moves(int count) {
+    int ids[REBALANCE_MAX_MOVES];
+
+    while (1) {
+        int waiting = 0;
+        for (int i = 0; i < count; i++) {
+            rebalance_move_t* move = &moves[i];
+            while (move->step != MOVE_STEP_DONE && move->op_id == 0) {
+                int op_id = issue_step(move);
+                if (op_id > 0) {
+                    move->op_id = op_id;
+                    ids[waiting++] = op_id;
+                } else {
+                    advance_move(move, op_id == 0);
+                }
+            }
+        }
+        if (waiting == 0) break;
+
+        operation_wait_all(ids, waiting, REBALANCE_STEP_TIMEOUT);
+
+        for (int i = 0; i < count; i++) {
+            rebalance_move_t* move = &moves[i];
+            if (move->op_id == 0) continue;
+
+            operation_t op;
+            int succeeded = (operation_get(move->op_id, &op) == 0 && op.state == OP_SUCCEEDED);
+            move->op_id = 0;
+            advance_move(move, succeeded);
+        }
+    }
+}
+
+// Record the outcome of a pass
+static void finish_pass(const char* result) {
+    pthread_mutex_lock(&rebalancer_mutex);
+    status.running = 0;
+    status.passes++;
+    status.last_pass = time(NULL);
+    strncpy(status.last_result, result, MAX_NAME_LEN - 1);
+    pthread_mutex_unlock(&rebalancer_mutex);
+}
+
+// Measure the cluster and, if the load spread is over the threshold, move up
+// to max_moves containers from the busiest nodes to ones the scheduler picks
+static void rebalance_pass(void) {
+    const daemon_config_t* config = config_current();
+    int threshold = config->rebalance_threshold;
+    int max_moves = config->rebalance_max_moves;
+    int cooldown = config->rebalance_cooldown;
+    int busiest, idlest;
+    char result[MAX_NAME_LEN];
+
+    if (max_moves > REBALANCE_MAX_MOVES) max_moves = REBALANCE_MAX_MOVES;
+
+    if (raft_enabled() && !raft_is_leader()) {
+        finish_pass("skipped, not the leader");
+        return;
+    }
+    if (rollout_in_progress()) {
+        finish_pass("skipped, rollout in progress");
+        return;
+    }
+
+    int count = rebalance_lister(containers, MAX_CONTAINERS);
+    int load_count = measure_nodes(loads, config->heartbeat_timeout);
+    double spread = load_spread(loads, load_count, &busiest, &idlest);
+
+    pthread_mutex_lock(&rebalancer_mutex);
+    status.running = 1;
+    status.imbalance = spread;
+    strcpy(status.busiest, load_count > 1 ? loads[busiest].id : "-");
+    strcpy(status.idlest, load_count > 1 ? loads[idlest].id : "-");
+    pthread_mutex_unlock(&rebalancer_mutex);
+
+    if (load_count < 2) {
+        finish_pass("skipped, fewer than two nodes");
+        return;
+    }
+
+    memset(tried, 0, sizeof(tried));
+    int planned = 0;
+    while (planned < max_moves) {
+        int hot = -1;
+        int cold = -1;
+        for (int i = 0; i < load_count; i++) {
+            if (!loads[i].exhausted && (hot < 0 || loads[i].load > loads[hot].load)) hot = i;
+            if (cold < 0 || loads[i].load < loads[cold].load) cold = i;
+        }
+        if (hot < 0 || loads[hot].load - loads[cold].load < threshold) break;
+
+        int candidate = pick_candidate(loads[hot].id, count, cooldown);
+        if (candidate < 0) {
+            loads[hot].exhausted = 1;
+            continue;
+        }
+        tried[candidate] = 1;
+
+        // Unconstrained containers go to the idlest node if it has room; the
+        // scheduler places the rest so affinity and spread rules hold
+        rebalance_container_t* container = &containers[candidate];
+        int target = -1;
+        if (!has_constraints(&container->config) &&
+            scheduler_node_fits(find_node_by_id(loads[cold].id), &container->config)) {
+            target = cold;
+        } else {
+            node_t* node = find_best_node_excluding(&container->config, loads[hot].id);
+            target = node ? find_load(loads, load_count, node->id) : -1;
+        }
+        double delta = loads[hot].per_container;
+
+        // A move is only worth its disruption if it narrows the spread; an
+        // exact swap of levels is left alone
+        if (target < 0 || loads[target].load + delta > loads[hot].load - delta + 0.001) {
+            continue;
+        }
+
+        rebalance_move_t* move = &moves[planned++];
+        memset(move, 0, sizeof(rebalance_move_t));
+        move->kind = is_replica(candidate, count) ? MOVE_REDEPLOY : MOVE_MIGRATE;
+        move->step = MOVE_STEP_TRANSFER;
+        move->start = (container->desired_state == CONTAINER_RUNNING);
+        strcpy(move->id, container->id);
+        strcpy(move->from, loads[hot].id);
+        strcpy(move->to, loads[target].id);
+        snprintf(move->new_id, sizeof(move->new_id), "%.127s_%.127s",
+                 loads[target].id, container->name);
+        move->config = container->config;
+
+        loads[hot].load -= delta;
+        loads[target].load += delta;
+    }
+
+    if (planned == 0) {
+        finish_pass(spread < threshold ? "balanced" : "no movable containers");
+        return;
+    }
+
+    printf("Rebalancer: load spread %.1f between %s and %s, moving %d container(s)\n",
+           spread, loads[busiest].id, loads[idlest].id, planned);
+    for (int i = 0; i < planned; i++) {
+        printf("Rebalancer: %s %s from %s to %s\n",
+               moves[i].kind == MOVE_MIGRATE ? "migrating" : "redeploying",
+               moves[i].id, moves[i].from, moves[i].to);
+    }
+
+    pthread_mutex_lock(&rebalancer_mutex);
+    status.moves += planned;
+    pthread_mutex_unlock(&rebalancer_mutex);
+
+    run_moves(planned);
+
+    int failed = 0;
+    for (int i = 0; i < planned; i++) {
+        if (moves[i].failed) {
+            failed++;
+        } else {
+            remember_move(moves[i].new_id);
+        }
+    }
+
+    pthread_mutex_lock(&rebalancer_mutex);
+    status.failed += failed;
+    pthread_mutex_unlock(&rebalancer_mutex);
+
+    snprintf(result, sizeof(result), "moved %d of %d", planned - failed, planned);
+    printf("Rebalancer: %s\n", result);
+    finish_pass(result);
+}
+
+// Runs a pass every interval seconds or when triggered
+static void* rebalancer_thread(void* arg) {
+    (void)arg;
+    time_t next_pass = 0;
+
+    while (1) {
+        pthread_mutex_lock(&rebalancer_mutex);
+        while (!wake_pending) {
+            int interval = config_current()->rebalance_interval;
+            time_t now = time(NULL);
+            struct timespec deadline = { 0, 0 };
+
+            if (interval > 0) {
+                if (next_pass == 0 || next_pass > now + interval) {
+                    next_pass = now + interval;
+                }
+                if (now >= next_pass) break;
+                deadline.tv_sec = next_pass;
+            } else {
+                // Disabled; look again later in case a reload enables it
+                next_pass = 0;
+                deadline.tv_sec = now + REBALANCE_RECHECK;
+            }
+            pthread_cond_timedwait(&rebalancer_cond, &rebalancer_mutex, &deadline);
+        }
+        wake_pending = 0;
+        pthread_mutex_unlock(&rebalancer_mutex);
+
+        rebalance_pass();
+        next_pass = time(NULL) + config_current()->rebalance_interval;
+    }
+
+    return NULL;
+}
+
+// Start the background rebalancer
+int init_rebalancer(rebalance_lister_t lister) {
+    pthread_t tid;
+
+    if (!lister) return -1;
+    rebalance_lister = lister;
+    strcpy(status.busiest, "-");
+    strcpy(status.idlest, "-");
+    strcpy(status.last_result, "-");
+
+    if (pthread_create(&tid, NULL, rebalancer_thread, NULL) != 0) {
+        printf("Error: Failed to start rebalancer thread\n");
+        return -1;
+    }
+
+    pthread_detach(tid);
+    return 0;
+}
+
+// Run a pass as soon as the current one, if any, is done
+void rebalancer_trigger(void) {
+    pthread_mutex_lock(&rebalancer_mutex);
+    wake_pending = 1;
+    pthread_cond_signal(&rebalancer_cond);
+    pthread_mutex_unlock(&rebalancer_mutex);
+}
+
+// Copy the rebalancer status
+void rebalancer_status(rebalance_status_t* out) {
+    pthread_mutex_lock(&rebalancer_mutex);
+    *out = status;
+    pthread_mutex_unlock(&rebalancer_mutex);
+}
+
+// Print rebalancer settings, the last pass and current node loads
+void show_rebalancer(void) {
+    static node_load_t snapshot[MAX_NODES];
+    const daemon_config_t* config = config_current();
+    rebalance_status_t current;
+    int busiest, idlest;
+
+    rebalancer_status(&current);
+    int count = measure_nodes(snapshot, config->heartbeat_timeout);
+    double spread = load_spread(snapshot, count, &busiest, &idlest);
+
+    printf("\n=== Rebalancer ===\n");
+    if (config->rebalance_interval > 0) {
+        printf("Interval: %ds  ", config->rebalance_interval);
+    } else {
+        printf("Interval: on request  ");
+    }
+    printf("Threshold: %d  Max moves: %d  Cooldown: %ds\n", config->rebalance_threshold,
+           config->rebalance_max_moves, config->rebalance_cooldown);
+    printf("Passes: %lu  Moves: %lu  Failed: %lu  Last: %s%s\n", current.passes, current.moves,
+           current.failed, current.last_result, current.running ? " (pass running)" : "");
+    printf("Load spread now: %.1f\n", spread);
+    printf("%-30s %-8s\n", "Node", "Load");
+    printf("---------------------------------------\n");
+    for (int i = 0; i < count; i++) {
+        printf("%-30s %-8.1f\n", snapshot[i].id, snapshot[i].load);
+    }
+}
@@ -0,0 +1,302 @@
+#include "../include/reconciler.h"
+
+// Dirty set: containers whose desired or observed state changed since they
+// were last reconciled. Entries live in a fixed slot array chained into hash
+// buckets by id; queued entries are also linked into a FIFO. An entry whose
+// correction is in flight stays in the table (parked) so its attempt count
+// survives until the container converges.
+typedef struct {
+    char container_id[MAX_NAME_LEN];
+    int next_in_bucket;
+    int next_in_queue;
+    int queued;            // Linked into the FIFO
+    int running;           // Handler is working on it
+    int redirty;           // Marked again while running
+    int attempts;          // Corrections or retries since it last converged
+    time_t not_before;     // Backoff deadline
+} dirty_entry_t;
+
+static dirty_entry_t entries[RECONCILE_SLOTS];
+static int buckets[RECONCILE_BUCKETS];
+static int free_head = -1;
+static int queue_head = -1;
+static int queue_tail = -1;
+static int queued_count = 0;
+static int entry_count = 0;
+static reconcile_handler_t reconcile_handler = NULL;
+static pthread_mutex_t reconciler_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t reconciler_cond = PTHREAD_COND_INITIALIZER;
+
+// Counters for show_reconciler
+static unsigned long marks = 0;
+static unsigned long dropped_marks = 0;
+static unsigned long passes = 0;
+static unsigned long corrections = 0;
+static unsigned long retries = 0;
+static unsigned long given_up = 0;
+
+// FNV-1a hash of a container id
+static unsigned int hash_id(const char* id) {
+    unsigned int hash = 2166136261u;
+    while (*id) {
+        hash ^= (unsigned char)*id++;
+        hash *= 16777619u;
+    }
+    return hash & (RECONCILE_BUCKETS - 1);
+}
+
+// Find the entry for a container (caller holds reconciler_mutex)
+static int find_entry_locked(const char* container_id) {
+    for (int i = buckets[hash_id(container_id)]; i >= 0; i = entries[i].next_in_bucket) {
+        if (strcmp(entries[i].container_id, container_id) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Take a free entry and link it into its bucket (caller holds reconciler_mutex)
+static int insert_entry_locked(const char* container_id) {
+    if (free_head < 0) return -1;
+
+    int index = free_head;
+    dirty_entry_t* entry = &entries[index];
+    free_head = entry->next_in_bucket;
+
+    unsigned int bucket = hash_id(container_id);
+    memset(entry, 0, sizeof(dirty_entry_t));
+    strncpy(entry->container_id, container_id, MAX_NAME_LEN - 1);
+    entry->next_in_queue = -1;
+    entry->next_in_bucket = buckets[bucket];
+    buckets[bucket] = index;
+    entry_count++;
+    return index;
+}
+
+// Unlink an entry from its bucket and free it (caller holds reconciler_mutex)
+static void remove_entry_locked(int index) {
+    int* link = &buckets[hash_id(entries[index].container_id)];
+
+    while (*link >= 0 && *link != index) {
+        link = &entries[*link].next_in_bucket;
+    }
+    if (*link == index) {
+        *link = entries[index].next_in_bucket;
+    }
+
+    entries[index].container_id[0] = '\0';
+    entries[index].next_in_bucket = free_head;
+    free_head = index;
+    entry_count--;
+}
+
+// Append an entry to the FIFO (caller holds reconciler_mutex)
+static void enqueue_locked(int index) {
+    entries[index].queued = 1;
+    entries[index].next_in_queue = -1;
+
+    if (queue_tail >= 0) {
+        entries[queue_tail].next_in_queue = index;
+    } else {
+        queue_head = index;
+    }
+    queue_tail = index;
+    queued_count++;
+}
+
+// Pop the FIFO head (caller holds reconciler_mutex)
+static int dequeue_locked(void) {
+    int index = queue_head;
+    if (index < 0) return -1;
+
+    queue_head = entries[index].next_in_queue;
+    if (queue_head < 0) queue_tail = -1;
+    entries[index].queued = 0;
+    queued_count--;
+    return index;
+}
+
+// Backoff before retrying after the given number of attempts
+static time_t backoff_seconds(int attempts) {
+    time_t delay = RECONCILE_BASE_BACKOFF;
+    for (int i = 1; i < attempts && delay < RECONCILE_MAX_BACKOFF; i++) {
+        delay *= 2;
+    }
+    return (delay < RECONCILE_MAX_BACKOFF) ? delay : RECONCILE_MAX_BACKOFF;
+}
+
+// Queue a container for reconciliation. Cheap enough to call from every
+// state change; a container already queued is not queued twice.
+void reconciler_mark_dirty(const char* container_id) {
+    if (!container_id || !*container_id) return;
+
+    pthread_mutex_lock(&reconciler_mutex);
+
+    marks++;
+    int index = find_entry_locked(container_id);
+
+    if (index < 0) {
+        index = insert_entry_locked(container_id);
+        if (index < 0) {
+            // Every container is already dirty; this one is picked up on its next change
+            dropped_marks++;
+            pthread_mutex_unlock(&reconciler_mutex);
+            return;
+        }
+    }
+
+    dirty_entry_t* entry = &entries[index];
+    if (entry->running) {
+        entry->redirty = 1;
+    } else if (!entry->queued) {
+        // A parked entry comes back after its failed correction, so back off
+        entry->not_before = entry->attempts > 0 ? time(NULL) + backoff_seconds(entry->attempts) : 0;
+        enqueue_locked(index);
+        pthread_cond_signal(&reconciler_cond);
+    }
+
+    pthread_mutex_unlock(&reconciler_mutex);
+}
+
+// Take the first queued entry whose backoff has expired, rotating the others
+// to the back; sets *wait_until to the earliest deadline when none is ready
+// (caller holds reconciler_mutex)
+static int next_ready_locked(time_t now, time_t* wait_until) {
+    int scanned = queued_count;
+    *wait_until = 0;
+
+    while (scanned-- > 0) {
+        int index = dequeue_locked();
+        if (entries[index].not_before <= now) {
+            return index;
+        }
+
+        if (*wait_until == 0 || entries[index].not_before < *wait_until) {
+            *wait_until = entries[index].not_before;
+        }
+        enqueue_locked(index);
+    }
+
+    return -1;
+}
+
+// Drain the dirty set, one container at a time
+static void* reconciler_thread(void* arg) {
+    (void)arg;
+
+    pthread_mutex_lock(&reconciler_mutex);
+
+    while (1) {
+        time_t wait_until;
+        int index = next_ready_locked(time(NULL), &wait_until);
+
+        if (index < 0) {
+            if (wait_until > 0) {
+                struct timespec deadline = { wait_until, 0 };
+                pthread_cond_timedwait(&reconciler_cond, &reconciler_mutex, &deadline);
+            } else {
+                pthread_cond_wait(&reconciler_cond, &reconciler_mutex);
+            }
+            continue;
+        }
+
+        dirty_entry_t* entry = &entries[index];
+
+        if (entry->attempts >= RECONCILE_MAX_ATTEMPTS) {
+            printf("Reconciler: giving up on container %s after %d attempts\n",
+                   entry->container_id, entry->attempts);
+            given_up++;
+            remove_entry_locked(index);
+            continue;
+        }
+
+        char container_id[MAX_NAME_LEN];
+        strcpy(container_id, entry->container_id);
+        entry->running = 1;
+        passes++;
+
+        pthread_mutex_unlock(&reconciler_mutex);
+        reconcile_result_t result = reconcile_handler(container_id);
+        pthread_mutex_lock(&reconciler_mutex);
+
+        entry->running = 0;
+
+        switch (result) {
+            case RECONCILE_CONVERGED:
+                if (entry->redirty) {
+                    entry->redirty = 0;
+                    entry->attempts = 0;
+                    entry->not_before = 0;
+                    enqueue_locked(index);
+                } else {
+                    remove_entry_locked(index);
+                }
+                break;
+
+            case RECONCILE_CORRECTING:
+                // Parked until the operation's completion marks it again
+                corrections++;
+                entry->attempts++;
+                if (entry->redirty) {
+                    entry->redirty = 0;
+                    entry->not_before = time(NULL) + backoff_seconds(entry->attempts);
+                    enqueue_locked(index);
+                }
+                break;
+
+            case RECONCILE_RETRY:
+                retries++;
+                entry->attempts++;
+                entry->redirty = 0;
+                entry->not_before = time(NULL) + backoff_seconds(entry->attempts);
+                enqueue_locked(index);
+                break;
+        }
+    }
+
+    return NULL;
+}
+
+// Start the reconciler thread
+int init_reconciler(reconcile_handler_t handler) {
+    pthread_t tid;
+
+    if (!handler) return -1;
+
+    pthread_mutex_lock(&reconciler_mutex);
+    reconcile_handler = handler;
+    for (int i = 0; i < RECONCILE_BUCKETS; i++) {
+        buckets[i] = -1;
+    }
+    for (int i = 0; i < RECONCILE_SLOTS; i++) {
+        entries[i].next_in_bucket = (i + 1 < RECONCILE_SLOTS) ? i + 1 : -1;
+    }
+    free_head = 0;
+    pthread_mutex_unlock(&reconciler_mutex);
+
+    if (pthread_create(&tid, NULL, reconciler_thread, NULL) != 0) {
+        printf("Error: Failed to start reconciler thread\n");
+        return -1;
+    }
+
+    pthread_detach(tid);
+    return 0;
+}
+
+// Print dirty set size and counters
+void show_reconciler(void) {
+    pthread_mutex_lock(&reconciler_mutex);
+
+    printf("\n=== Reconciler ===\n");
+    printf("Dirty: %d (queued %d, awaiting corrections %d)\n",
+           entry_count, queued_count, entry_count - queued_count);
+    printf("Marks: %lu (dropped %lu)  Passes: %lu  Corrections: %lu  Retries: %lu  Given up: %lu\n",
+           marks, dropped_marks, passes, corrections, retries, given_up);
+
+    int shown = 0;
+    for (int index = queue_head; index >= 0 && shown < 10; index = entries[index].next_in_queue, shown++) {
+        printf("  %s (attempts %d)\n", entries[index].container_id, entries[index].attempts);
+    }
+
+    pthread_mutex_unlock(&reconciler_mutex);
+}
@@ -0,0 +1,746 @@
+#include "../include/rollout.h"
+#include "../include/operations.h"
+#include "../include/raft.h"
+
+// Steps of one replacement. A surge replacement brings the new instance up on
+// another node before retiring the old one; an in-place replacement retires
+// the old instance first and may reuse its node.
+typedef enum {
+    STEP_DEPLOY,
+    STEP_START,
+    STEP_STOP_OLD,
+    STEP_DELETE_OLD,
+    STEP_DONE
+} replacement_step_t;
+
+static const replacement_step_t surge_steps[] = {
+    STEP_DEPLOY, STEP_START, STEP_STOP_OLD, STEP_DELETE_OLD, STEP_DONE
+};
+static const replacement_step_t in_place_steps[] = {
+    STEP_STOP_OLD, STEP_DELETE_OLD, STEP_DEPLOY, STEP_START, STEP_DONE
+};
+static const char* step_names[] = { "deploy", "start", "stop", "delete", "finish" };
+
+// One instance being replaced
+typedef struct {
+    int surge;
+    int start_new;          // Old instance was meant to run, so the new one is started
+    int stop_old;           // Old instance may be running and must be stopped first
+    int costs_availability; // In-place replacement of a running instance
+    int position;           // Index into the step sequence
+    int op_id;              // Operation of the current step, 0 when none
+    char name[MAX_NAME_LEN];
+    char old_id[MAX_NAME_LEN];
+    char old_node[MAX_NAME_LEN];
+    char new_id[MAX_NAME_LEN];
+    char new_node[MAX_NAME_LEN];
+} replacement_t;
+
+// Rolling update of one replica group
+typedef struct {
+    int used;
+    char group[MAX_NAME_LEN];
+    lxc_config_t target;
+    lxc_config_t previous;      // Spec the group ran before, the rollback target
+    int has_previous;
+    rollout_state_t state;
+    rollout_state_t paused_from;
+    rollout_failure_policy_t on_failure;
+    int max_unavailable;
+    int max_surge;
+    replacement_t replacements[ROLLOUT_MAX_PARALLEL];
+    int in_flight;
+    int updated;
+    int outdated;
+    int failed;
+    char missing[ROLLOUT_MAX_PARALLEL][MAX_NAME_LEN];  // Retired instances whose
+    int missing_start[ROLLOUT_MAX_PARALLEL];           // replacement never got created
+    int missing_count;
+    int tripped;                // A replacement failed since the last check
+    int aborting;               // Abort once the replacements in flight finish
+    time_t started_at;
+    char reason[MAX_NAME_LEN];
+} rollout_t;
+
+static rollout_t rollouts[MAX_ROLLOUTS];
+static rollout_member_t members[MAX_CONTAINERS];
+static rollout_lister_t rollout_lister = NULL;
+static pthread_mutex_t rollout_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Operation completions wake the rollout thread; kept apart from
+// rollout_mutex because they can fire inside calls the thread makes
+static int wake_pending = 0;
+static pthread_mutex_t wake_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wake_cond = PTHREAD_COND_INITIALIZER;
+
+// Human readable rollout state
+const char* rollout_state_name(rollout_state_t state) {
+    switch (state) {
+        case ROLLOUT_RUNNING:      return "RUNNING";
+        case ROLLOUT_PAUSED:       return "PAUSED";
+        case ROLLOUT_ROLLING_BACK: return "ROLLING_BACK";
+        case ROLLOUT_SUCCEEDED:    return "SUCCEEDED";
+        case ROLLOUT_ROLLED_BACK:  return "ROLLED_BACK";
+        case ROLLOUT_ABORTED:      return "ABORTED";
+        default:                   return "UNKNOWN";
+    }
+}
+
+// Whether a rollout still owns its group
+static int rollout_active(const rollout_t* rollout) {
+    return rollout->used && (rollout->state == ROLLOUT_RUNNING || rollout->state == ROLLOUT_PAUSED ||
+                             rollout->state == ROLLOUT_ROLLING_BACK);
+}
+
+// Whether a container already runs the spec; names and groups are per instance
+static int same_spec(const lxc_config_t* a, const lxc_config_t* b) {
+    return strcmp(a->image, b->image) == 0 &&
+           strcmp(a->config_file, b->config_file) == 0 &&
+           strcmp(a->affinity, b->affinity) == 0 &&
+           strcmp(a->anti_affinity, b->anti_affinity) == 0 &&
+           strcmp(a->spread_key, b->spread_key) == 0 &&
+           a->cpu_limit == b->cpu_limit &&
+           a->memory_limit == b->memory_limit &&
+           a->privileged == b->privileged;
+}
+
+// Find the latest rollout of a group (caller holds rollout_mutex)
+static rollout_t* find_rollout_locked(const char* group) {
+    for (int i = 0; i < MAX_ROLLOUTS; i++) {
+        if (rollouts[i].used && strcmp(rollouts[i].group, group) == 0) {
+            return &rollouts[i];
+        }
+    }
+    return NULL;
+}
+
+// Step a replacement is on
+static replacement_step_t current_step(const replacement_t* replacement) {
+    return (replacement->surge ? surge_steps : in_place_steps)[replacement->position];
+}
+
+// Whether a container name is being replaced (caller holds rollout_mutex)
+static int name_in_flight_locked(const rollout_t* rollout, const char* name) {
+    for (int i = 0; i < rollout->in_flight; i++) {
+        if (strcmp(rollout->replacements[i].name, name) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Whether a node already hosts one side of a replacement (caller holds rollout_mutex)
+static int node_busy_locked(const rollout_t* rollout, const char* node_id) {
+    for (int i = 0; i < rollout->in_flight; i++) {
+        const replacement_t* replacement = &rollout->replacements[i];
+        if (strcmp(replacement->old_node, node_id) == 0 ||
+            strcmp(replacement->new_node, node_id) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Issue the operation for the current step, returns its id, 0 when the step
+// needs none, or -1 with the reason in why (caller holds rollout_mutex)
+static int issue_step_locked(rollout_t* rollout, replacement_t* replacement, char* why, size_t why_size) {
+    int op_id = 0;
+
+
+    switch (current_step(replacement)) {
+        case STEP_DEPLOY: {
+            lxc_config_t config = rollout->target;
+            strcpy(config.name, replacement->name);
+            strcpy(config.group, rollout->group);
+
+            if (!replacement->surge) {
+                node_t* node = find_best_node(&config);
+                if (!node) {
+                    snprintf(why, why_size, "no node available for %.200s", replacement->name);
+                    return -1;
+                }
+                strcpy(replacement->new_node, node->id);
+            }
+            snprintf(replacement->new_id, sizeof(replacement->new_id), "%.127s_%.127s",
+                     replacement->new_node, replacement->name);
+            op_id = deploy_container(replacement->new_node, &config);
+            break;
+        }
+        case STEP_START:
+            op_id = replacement->start_new ? start_container(replacement->new_id) : 0;
+            break;
+        case STEP_STOP_OLD:
+            op_id = replacement->stop_old ? stop_container(replacement->old_id) : 0;
+            break;
+        case STEP_DELETE_OLD:
+            op_id = replacement->old_id[0] ? delete_container(replacement->old_id) : 0;
+            break;
+        default:
+            break;
+    }
+
+    if (op_id < 0) {
+        snprintf(why, why_size, "could not %s %.200s", step_names[current_step(replacement)],
+                 replacement->name);
+    }
+    return op_id;
+}
+
+// Move a replacement along, returns 1 when done, 0 while waiting on an
+// operation, -1 on failure (caller holds rollout_mutex)
+static int advance_replacement_locked(rollout_t* rollout, replacement_t* replacement) {
+    while (1) {
+        if (replacement->op_id > 0) {
+            operation_t op;
+            if (operation_get(replacement->op_id, &op) != 0) {
+                snprintf(rollout->reason, sizeof(rollout->reason), "operation %d of %.200s lost",
+                         replacement->op_id, replacement->name);
+                return -1;
+            }
+            if (!operation_is_terminal(op.state)) {
+                return 0;
+            }
+            if (op.state != OP_SUCCEEDED) {
+                snprintf(rollout->reason, sizeof(rollout->reason), "%s %.200s %s",
+                         operation_type_name(op.type), op.container_id,
+                         operation_state_name(op.state));
+                return -1;
+            }
+            replacement->op_id = 0;
+            replacement->position++;
+        }
+
+        if (current_step(replacement) == STEP_DONE) {
+            return 1;
+        }
+
+        char why[MAX_NAME_LEN];
+        int op_id = issue_step_locked(rollout, replacement, why, sizeof(why));
+        if (op_id < 0) {
+            strcpy(rollout->reason, why);
+            return -1;
+        }
+        if (op_id == 0) {
+            replacement->position++;
+            continue;
+        }
+        replacement->op_id = op_id;
+        return 0;
+    }
+}
+
+// Drop a replacement from the in-flight list (caller holds rollout_mutex)
+static void remove_replacement_locked(rollout_t* rollout, int index) {
+    rollout->in_flight--;
+    if (index != rollout->in_flight) {
+        rollout->replacements[index] = rollout->replacements[rollout->in_flight];
+    }
+}
+
+// Record a failed replacement. A surge instance that never came up is
+// removed so the old one keeps serving alone; an in-place one whose old
+// instance is already gone is remembered so it gets created again
+// (caller holds rollout_mutex)
+static void fail_replacement_locked(rollout_t* rollout, int index) {
+    replacement_t* replacement = &rollout->replacements[index];
+
+    printf("Rollout %s: replacing %s failed: %s\n", rollout->group, replacement->name,
+           rollout->reason);
+    if (replacement->surge && current_step(replacement) == STEP_START) {
+        delete_container(replacement->new_id);
+    } else if (!replacement->surge && current_step(replacement) == STEP_DEPLOY) {
+        if (rollout->missing_count < ROLLOUT_MAX_PARALLEL) {
+            strcpy(rollout->missing[rollout->missing_count], replacement->name);
+            rollout->missing_start[rollout->missing_count] = replacement->start_new;
+            rollout->missing_count++;
+        } else {
+            printf("Rollout %s: %s must be deployed again by hand\n", rollout->group,
+                   replacement->name);
+        }
+    }
+
+    rollout->failed++;
+    rollout->tripped = 1;
+    remove_replacement_locked(rollout, index);
+}
+
+// Start replacing one member (caller holds rollout_mutex)
+static void begin_replacement_locked(rollout_t* rollout, const rollout_member_t* member,
+                                     int surge, const char* surge_node) {
+    replacement_t* replacement = &rollout->replacements[rollout->in_flight++];
+
+    memset(replacement, 0, sizeof(replacement_t));
+    replacement->surge = surge;
+    replacement->start_new = (member->desired_state == CONTAINER_RUNNING);
+    replacement->stop_old = (member->state != CONTAINER_STOPPED);
+    replacement->costs_availability = !surge && member->state == CONTAINER_RUNNING &&
+                                      member->desired_state == CONTAINER_RUNNING;
+    strcpy(replacement->name, member->name);
+    strcpy(replacement->old_id, member->id);
+    strcpy(replacement->old_node, member->node_id);
+    if (surge) {
+        strcpy(replacement->new_node, surge_node);
+    }
+
+    if (member->id[0]) {
+        printf("Rollout %s: replacing %s on %s (%s)\n", rollout->group, member->name,
+               member->node_id, surge ? "surge" : "in place");
+    } else {
+        printf("Rollout %s: deploying %s again\n", rollout->group, member->name);
+    }
+
+    int result = advance_replacement_locked(rollout, replacement);
+    if (result < 0) {
+        fail_replacement_locked(rollout, rollout->in_flight - 1);
+    } else if (result > 0) {
+        remove_replacement_locked(rollout, rollout->in_flight - 1);
+    }
+}
+
+// Start as many replacements as the limits allow. Members that are already
+// down go first since replacing them costs no availability; running ones
+// are spread over nodes not already busy with a replacement before doubling
+// up (caller holds rollout_mutex)
+static void fill_replacements_locked(rollout_t* rollout, int count) {
+    int surging = 0;
+    int unavailable = 0;
+    int started = 0;
+
+    for (int i = 0; i < rollout->in_flight; i++) {
+        if (rollout->replacements[i].surge) {
+            surging++;
+        } else if (rollout->replacements[i].costs_availability) {
+            unavailable++;
+        }
+    }
+
+    // Updated instances that are down also count against max_unavailable
+    for (int i = 0; i < count; i++) {
+        if (same_spec(&members[i].config, &rollout->target) &&
+            members[i].desired_state == CONTAINER_RUNNING && members[i].state != CONTAINER_RUNNING &&
+            !name_in_flight_locked(rollout, members[i].name)) {
+            unavailable++;
+        }
+    }
+
+    // Instances lost to failed replacements are created again first
+    for (int n = rollout->missing_count; n > 0 && rollout->in_flight < ROLLOUT_MAX_PARALLEL; n--) {
+        rollout_member_t missing;
+        rollout->missing_count--;
+        memset(&missing, 0, sizeof(missing));
+        strcpy(missing.name, rollout->missing[rollout->missing_count]);
+        missing.state = CONTAINER_STOPPED;
+        missing.desired_state = rollout->missing_start[rollout->missing_count] ? CONTAINER_RUNNING
+                                                                              : CONTAINER_STOPPED;
+        begin_replacement_locked(rollout, &missing, 0, NULL);
+        started++;
+    }
+
+    for (int pass = 0; pass < 3; pass++) {
+        for (int i = 0; i < count; i++) {
+            rollout_member_t* member = &members[i];
+
+            if (rollout->in_flight >= ROLLOUT_MAX_PARALLEL) {
+                return;
+            }
+            if (same_spec(&member->config, &rollout->target) ||
+                member->state == CONTAINER_STARTING || member->state == CONTAINER_STOPPING ||
+                name_in_flight_locked(rollout, member->name)) {
+                continue;
+            }
+
+            int down = !(member->state == CONTAINER_RUNNING &&
+                         member->desired_state == CONTAINER_RUNNING);
+            if ((pass == 0) != down || (pass == 1 && node_busy_locked(rollout, member->node_id))) {
+                continue;
+            }
+
+            if (down) {
+                begin_replacement_locked(rollout, member, 0, NULL);
+                started++;
+                continue;
+            }
+
+            if (surging < rollout->max_surge) {
+                lxc_config_t config = rollout->target;
+                strcpy(config.name, member->name);
+                strcpy(config.group, rollout->group);
+
+                node_t* node = find_best_node(&config);
+                if (node && strcmp(node->id, member->node_id) != 0) {
+                    char node_id[MAX_NAME_LEN];
+                    strcpy(node_id, node->id);
+                    begin_replacement_locked(rollout, member, 1, node_id);
+                    surging++;
+                    started++;
+                    continue;
+                }
+            }
+
+            if (unavailable < rollout->max_unavailable) {
+                begin_replacement_locked(rollout, member, 0, NULL);
+                unavailable++;
+                started++;
+                continue;
+            }
+
+            // Both budgets are used up until a replacement finishes
+            return;
+        }
+    }
+
+    if (started == 0 && rollout->in_flight == 0 && rollout->outdated > 0 && !rollout->tripped) {
+        snprintf(rollout->reason, sizeof(rollout->reason), "waiting for capacity");
+    }
+}
+
+// Swap target and previous spec and replace back (caller holds rollout_mutex)
+static void begin_rollback_locked(rollout_t* rollout) {
+    lxc_config_t failed = rollout->target;
+    rollout->target = rollout->previous;
+    rollout->previous = failed;
+    rollout->state = ROLLOUT_ROLLING_BACK;
+    printf("Rollout %s: rolling back to image %s\n", rollout->group, rollout->target.image);
+}
+
+// One progress check of a rollout (caller holds rollout_mutex)
+static void tick_rollout_locked(rollout_t* rollout) {
+    int count = rollout_lister(rollout->group, members, MAX_CONTAINERS);
+
+    // Replacements in flight finish even while paused
+    for (int i = 0; i < rollout->in_flight; ) {
+        int result = advance_replacement_locked(rollout, &rollout->replacements[i]);
+        if (result == 0) {
+            i++;
+        } else if (result < 0) {
+            fail_replacement_locked(rollout, i);
+        } else {
+            remove_replacement_locked(rollout, i);
+        }
+    }
+
+    rollout->updated = 0;
+    rollout->outdated = 0;
+    for (int i = 0; i < count; i++) {
+        if (same_spec(&members[i].config, &rollout->target)) {
+            rollout->updated++;
+        } else {
+            rollout->outdated++;
+        }
+    }
+
+    if (rollout->tripped) {
+        rollout->tripped = 0;
+        if (rollout->state == ROLLOUT_RUNNING && rollout->on_failure == ROLLOUT_ON_FAILURE_ROLLBACK &&
+            rollout->has_previous) {
+            begin_rollback_locked(rollout);
+            return;
+        }
+        if (rollout->state != ROLLOUT_PAUSED) {
+            rollout->paused_from = rollout->state;
+            rollout->state = ROLLOUT_PAUSED;
+            printf("Rollout %s: paused after a failure\n", rollout->group);
+        }
+    }
+
+    if (rollout->aborting && rollout->in_flight == 0) {
+        rollout->state = ROLLOUT_ABORTED;
+        printf("Rollout %s: aborted\n", rollout->group);
+        return;
+    }
+
+    if (rollout->state != ROLLOUT_RUNNING && rollout->state != ROLLOUT_ROLLING_BACK) {
+        return;
+    }
+
+    if (rollout->outdated == 0 && rollout->in_flight == 0 && rollout->missing_count == 0) {
+        rollout->state = (rollout->state == ROLLOUT_RUNNING) ? ROLLOUT_SUCCEEDED : ROLLOUT_ROLLED_BACK;
+        rollout->reason[0] = '\0';
+        printf("Rollout %s: %s, %d container(s) on image %s\n", rollout->group,
+               rollout_state_name(rollout->state), rollout->updated, rollout->target.image);
+        return;
+    }
+
+    fill_replacements_locked(rollout, count);
+}
+
+// Drive every active rollout, waking on operation completions and on a
+// short tick; only the leader issues operations
+static void* rollout_thread(void* arg) {
+    (void)arg;
+    int busy = 0;
+
+    while (1) {
+        pthread_mutex_lock(&wake_mutex);
+        if (!wake_pending) {
+            if (busy) {
+                struct timespec deadline;
+                clock_gettime(CLOCK_REALTIME, &deadline);
+                deadline.tv_nsec += ROLLOUT_TICK_MS * 1000000L;
+                if (deadline.tv_nsec >= 1000000000L) {
+                    deadline.tv_sec++;
+                    deadline.tv_nsec -= 1000000000L;
+                }
+                pthread_cond_timedwait(&wake_cond, &wake_mutex, &deadline);
+            } else {
+                pthread_cond_wait(&wake_cond, &wake_mutex);
+            }
+        }
+        wake_pending = 0;
+        pthread_mutex_unlock(&wake_mutex);
+
+        pthread_mutex_lock(&rollout_mutex);
+        busy = 0;
+        for (int i = 0; i < MAX_ROLLOUTS; i++) {
+            if (!rollout_active(&rollouts[i])) continue;
+            busy = 1;
+            if (!raft_enabled() || raft_is_leader()) {
+                tick_rollout_locked(&rollouts[i]);
+            }
+        }
+        pthread_mutex_unlock(&rollout_mutex);
+    }
+
+    return NULL;
+}
+
+// Wake the rollout thread, called whenever an operation finishes
+void rollout_notify(void) {
+    pthread_mutex_lock(&wake_mutex);
+    wake_pending = 1;
+    pthread_cond_signal(&wake_cond);
+    pthread_mutex_unlock(&wake_mutex);
+}
+
+// Start the rollout thread
+int init_rollout(rollout_lister_t lister) {
+    pthread_t tid;
+
+    if (!lister) return -1;
+    rollout_lister = lister;
+
+    if (pthread_create(&tid, NULL, rollout_thread, NULL) != 0) {
+        printf("Error: Failed to start rollout thread\n");
+        return -1;
+    }
+
+    pthread_detach(tid);
+    return 0;
+}
+
+// Begin rolling a group onto a new spec
+int rollout_start(const char* group, const lxc_config_t* target, int max_unavailable,
+                  int max_surge, rollout_failure_policy_t on_failure) {
+    if (!group || !target) return -1;
+
+    if (max_unavailable < 0 || max_surge < 0 || max_unavailable + max_surge == 0) {
+        printf("Error: max_unavailable and max_surge must not both be 0\n");
+        return -1;
+    }
+
+    pthread_mutex_lock(&rollout_mutex);
+
+    rollout_t* rollout = find_rollout_locked(group);
+    if (rollout && rollout_active(rollout)) {
+        pthread_mutex_unlock(&rollout_mutex);
+        printf("Error: Group %s already has a rollout in progress\n", group);
+        return -1;
+    }
+
+    int count = rollout_lister(group, members, MAX_CONTAINERS);
+    if (count == 0) {
+        pthread_mutex_unlock(&rollout_mutex);
+        printf("Error: Group %s has no containers\n", group);
+        return -1;
+    }
+
+    // Reuse the group's old entry, a free one, or the oldest finished one
+    if (!rollout) {
+        for (int i = 0; i < MAX_ROLLOUTS; i++) {
+            if (!rollouts[i].used) {
+                rollout = &rollouts[i];
+                break;
+            }
+            if (!rollout_active(&rollouts[i]) &&
+                (!rollout || rollouts[i].started_at < rollout->started_at)) {
+                rollout = &rollouts[i];
+            }
+        }
+    }
+    if (!rollout) {
+        pthread_mutex_unlock(&rollout_mutex);
+        printf("Error: Too many rollouts in progress\n");
+        return -1;
+    }
+
+    memset(rollout, 0, sizeof(rollout_t));
+    rollout->used = 1;
+    strncpy(rollout->group, group, MAX_NAME_LEN - 1);
+    rollout->target = *target;
+    strcpy(rollout->target.group, rollout->group);
+    rollout->state = ROLLOUT_RUNNING;
+    rollout->on_failure = on_failure;
+    rollout->max_unavailable = max_unavailable < ROLLOUT_MAX_PARALLEL ? max_unavailable : ROLLOUT_MAX_PARALLEL;
+    rollout->max_surge = max_surge < ROLLOUT_MAX_PARALLEL ? max_surge : ROLLOUT_MAX_PARALLEL;
+    rollout->started_at = time(NULL);
+
+    for (int i = 0; i < count; i++) {
+        if (!same_spec(&members[i].config, target)) {
+            if (!rollout->has_previous) {
+                rollout->previous = members[i].config;
+                rollout->has_previous = 1;
+            }
+            rollout->outdated++;
+        } else {
+            rollout->updated++;
+        }
+    }
+
+    printf("Rollout %s: %d of %d container(s) to move to image %s (max unavailable %d, max surge %d)\n",
+           group, rollout->outdated, count, target->image, rollout->max_unavailable, rollout->max_surge);
+
+    pthread_mutex_unlock(&rollout_mutex);
+
+    rollout_notify();
+    return 0;
+}
+
+// Stop issuing replacements; those in flight still finish
+int rollout_pause(const char* group) {
+    pthread_mutex_lock(&rollout_mutex);
+
+    rollout_t* rollout = find_rollout_locked(group);
+    if (!rollout || (rollout->state != ROLLOUT_RUNNING && rollout->state != ROLLOUT_ROLLING_BACK)) {
+        pthread_mutex_unlock(&rollout_mutex);
+        printf("Error: Group %s has no running rollout\n", group);
+        return -1;
+    }
+
+    rollout->paused_from = rollout->state;
+    rollout->state = ROLLOUT_PAUSED;
+    snprintf(rollout->reason, sizeof(rollout->reason), "paused by request");
+    printf("Rollout %s: paused\n", group);
+
+    pthread_mutex_unlock(&rollout_mutex);
+    return 0;
+}
+
+// Continue a paused rollout in the direction it was going
+int rollout_resume(const char* group) {
+    pthread_mutex_lock(&rollout_mutex);
+
+    rollout_t* rollout = find_rollout_locked(group);
+    if (!rollout || rollout->state != ROLLOUT_PAUSED || rollout->aborting) {
+        pthread_mutex_unlock(&rollout_mutex);
+        printf("Error: Group %s has no paused rollout\n", group);
+        return -1;
+    }
+
+    rollout->state = rollout->paused_from;
+    rollout->reason[0] = '\0';
+    printf("Rollout %s: resumed\n", group);
+
+    pthread_mutex_unlock(&rollout_mutex);
+
+    rollout_notify();
+    return 0;
+}
+
+// Replace the group back onto the spec it ran before the rollout
+int rollout_rollback(const char* group) {
+    pthread_mutex_lock(&rollout_mutex);
+
+    rollout_t* rollout = find_rollout_locked(group);
+    if (!rollout || rollout->aborting || !rollout->has_previous ||
+        (rollout->state != ROLLOUT_RUNNING && rollout->state != ROLLOUT_SUCCEEDED &&
+         !(rollout->state == ROLLOUT_PAUSED && rollout->paused_from == ROLLOUT_RUNNING))) {
+        pthread_mutex_unlock(&rollout_mutex);
+        printf("Error: Group %s has no rollout to roll back\n", group);
+        return -1;
+    }
+
+    rollout->reason[0] = '\0';
+    begin_rollback_locked(rollout);
+
+    pthread_mutex_unlock(&rollout_mutex);
+
+    rollout_notify();
+    return 0;
+}
+
+// Give up on a rollout once its replacements in flight finish
+int rollout_abort(const char* group) {
+    pthread_mutex_lock(&rollout_mutex);
+
+    rollout_t* rollout = find_rollout_locked(group);
+    if (!rollout || !rollout_active(rollout)) {
+        pthread_mutex_unlock(&rollout_mutex);
+        printf("Error: Group %s has no rollout in progress\n", group);
+        return -1;
+    }
+
+    rollout->aborting = 1;
+    if (rollout->state != ROLLOUT_PAUSED) {
+        rollout->paused_from = rollout->state;
+        rollout->state = ROLLOUT_PAUSED;
+    }
+    snprintf(rollout->reason, sizeof(rollout->reason), "aborting");
+
+    pthread_mutex_unlock(&rollout_mutex);
+
+    rollout_notify();
+    return 0;
+}
+
+// Copy rollout summaries, returns how many
+int rollout_list(rollout_info_t* infos, int max_infos) {
+    int count = 0;
+
+    pthread_mutex_lock(&rollout_mutex);
+
+    for (int i = 0; i < MAX_ROLLOUTS && count < max_infos; i++) {
+        rollout_t* rollout = &rollouts[i];
+        if (!rollout->used) continue;
+
+        rollout_info_t* info = &infos[count++];
+        memset(info, 0, sizeof(rollout_info_t));
+        strcpy(info->group, rollout->group);
+        strcpy(info->image, rollout->target.image);
+        info->state = rollout->state;
+        info->on_failure = rollout->on_failure;
+        info->max_unavailable = rollout->max_unavailable;
+        info->max_surge = rollout->max_surge;
+        info->updated = rollout->updated;
+        info->total = rollout->updated + rollout->outdated + rollout->missing_count;
+        info->in_flight = rollout->in_flight;
+        info->failed = rollout->failed;
+        info->started_at = rollout->started_at;
+        strcpy(info->reason, rollout->reason);
+    }
+
+    pthread_mutex_unlock(&rollout_mutex);
+    return count;
+}
+
+// Print every rollout
+void show_rollouts(void) {
+    static rollout_info_t infos[MAX_ROLLOUTS];
+    int count = rollout_list(infos, MAX_ROLLOUTS);
+
+    printf("\n=== Rollouts ===\n");
+    printf("%-20s %-13s %-20s %-9s %-9s %-7s %-9s %s\n",
+           "Group", "State", "Image", "Updated", "InFlight", "Failed", "Unav/Surge", "Reason");
+    printf("------------------------------------------------------------------------------------------\n");
+
+    for (int i = 0; i < count; i++) {
+        rollout_info_t* info = &infos[i];
+        char updated[32];
+        char limits[32];
+        snprintf(updated, sizeof(updated), "%d/%d", info->updated, info->total);
+        snprintf(limits, sizeof(limits), "%d/%d", info->max_unavailable, info->max_surge);
+
+        printf("%-20s %-13s %-20s %-9s %-9d %-7d %-9s %s\n", info->group,
+               rollout_state_name(info->state), info->image, updated, info->in_flight,
+               info->failed, limits, info->reason);
+    }
+}
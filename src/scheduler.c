@@ -0,0 +1,1194 @@
+#include "../include/scheduler.h"
+#include "../include/lxc_manager.h"
+
+extern node_t nodes[];
+extern int node_count;
+extern pthread_mutex_t nodes_mutex;
+extern void lock_nodes(void);
+extern unsigned long nodes_generation;
+
+// Scheduler settings
+static scheduler_policy_t current_policy = SCHED_SPREAD;
+static int headroom_percent = 10;
+static int sample_size = DEFAULT_SAMPLE_SIZE;
+static double locality_bonus = DEFAULT_LOCALITY_BONUS;
+static int heartbeat_timeout = DEFAULT_HEARTBEAT_TIMEOUT;
+static double cpu_weight = 0.3;       // Spread score weights (protected by nodes_mutex)
+static double memory_weight = 0.3;
+static double disk_weight = 0.2;
+static double load_weight = 0.2;
+static unsigned int sample_seed = 1;   // rand_r state, protected by nodes_mutex
+static const node_t* excluded_node = NULL;  // Skipped by the current selection (nodes_mutex)
+
+// Placement reservation, slot indexed by operation id (protected by nodes_mutex)
+typedef struct {
+    int operation_id;
+    char node_id[MAX_NAME_LEN];
+    double cpu;
+    double memory;
+    int settled;
+} reservation_t;
+
+static reservation_t reservations[MAX_RESERVATIONS];
+
+#define RESERVATION_SLOT(id) ((id) & (MAX_RESERVATIONS - 1))
+
+// Node index (protected by nodes_mutex). Spread scores are kept in an indexed
+// max-heap that is updated whenever a node's inputs change; an id hash table
+// maps node ids to positions in nodes[]. Both are rebuilt when the node table
+// changes shape (nodes_generation moves).
+#define NODE_ID_SLOTS (2 * MAX_NODES)
+#define SCORE_INELIGIBLE -1e9
+
+static int score_heap[MAX_NODES];      // Node indices, best spread score first
+static int heap_position[MAX_NODES];   // Heap slot of each node index
+static double node_scores[MAX_NODES];
+static int heap_size = 0;
+static int node_id_slots[NODE_ID_SLOTS];  // Node index + 1, 0 when empty
+static unsigned long indexed_generation = (unsigned long)-1;
+
+// Constraint indexes (protected by nodes_mutex). Node labels map to the set of
+// nodes carrying them, and every replica group keeps a per-node container
+// count, so affinity, anti-affinity and spread are evaluated with bitset
+// operations rather than per-node string matching.
+#define MAX_LABELS 1024
+#define GROUP_BUCKETS 256                  // Must be a power of two
+#define NODE_SET_WORDS ((MAX_NODES + 63) / 64)
+
+typedef struct {
+    unsigned long long bits[NODE_SET_WORDS];
+} node_set_t;
+
+typedef struct {
+    char label[MAX_NAME_LEN];      // "key=value"
+    node_set_t nodes;
+} label_entry_t;
+
+// A group exists while at least one of its containers is placed
+typedef struct group_entry {
+    struct group_entry* next;      // Hash bucket chain
+    char name[MAX_NAME_LEN];
+    int total;                     // Containers of the group on all nodes
+    int counts[MAX_NODES];         // Containers of the group on each node
+    node_set_t nodes;              // Nodes with at least one container of the group
+} group_entry_t;
+
+static label_entry_t label_entries[MAX_LABELS];
+static int label_count = 0;
+static int label_slots[2 * MAX_LABELS];   // Entry index + 1, 0 when empty
+static group_entry_t* group_buckets[GROUP_BUCKETS];
+
+// Select the placement policy
+void scheduler_set_policy(scheduler_policy_t policy) {
+    current_policy = policy;
+}
+
+// Current placement policy
+scheduler_policy_t scheduler_get_policy(void) {
+    return current_policy;
+}
+
+// Parse a policy name such as "best-fit"
+int scheduler_parse_policy(const char* name, scheduler_policy_t* policy) {
+    if (!name || !policy) return -1;
+
+    if (strcmp(name, "spread") == 0) {
+        *policy = SCHED_SPREAD;
+    } else if (strcmp(name, "best-fit") == 0) {
+        *policy = SCHED_BEST_FIT;
+    } else if (strcmp(name, "worst-fit") == 0) {
+        *policy = SCHED_WORST_FIT;
+    } else if (strcmp(name, "p2c") == 0) {
+        *policy = SCHED_P2C;
+    } else {
+        return -1;
+    }
+
+    return 0;
+}
+
+// Human readable policy name
+const char* scheduler_policy_name(scheduler_policy_t policy) {
+    switch (policy) {
+        case SCHED_SPREAD:    return "spread";
+        case SCHED_BEST_FIT:  return "best-fit";
+        case SCHED_WORST_FIT: return "worst-fit";
+        case SCHED_P2C:       return "p2c";
+        default:              return "unknown";
+    }
+}
+
+// Percentage of each node's capacity kept free by the bin-packing policies
+void scheduler_set_headroom(int percent) {
+    if (percent < 0) percent = 0;
+    if (percent > 90) percent = 90;
+    headroom_percent = percent;
+}
+
+// Number of nodes the p2c policy samples per placement
+void scheduler_set_sample_size(int size) {
+    if (size < 1) size = 1;
+    if (size > MAX_NODES) size = MAX_NODES;
+    sample_size = size;
+}
+
+// Spread score weights; cached scores are recomputed on the next placement
+void scheduler_set_weights(double cpu, double memory, double disk, double load) {
+    if (cpu < 0.0 || memory < 0.0 || disk < 0.0 || load < 0.0) {
+        printf("Error: Scheduler weights must not be negative\n");
+        return;
+    }
+
+    lock_nodes();
+    cpu_weight = cpu;
+    memory_weight = memory;
+    disk_weight = disk;
+    load_weight = load;
+    indexed_generation = (unsigned long)-1;
+    pthread_mutex_unlock(&nodes_mutex);
+}
+
+// Seconds without a heartbeat before a node stops receiving placements
+void scheduler_set_heartbeat_timeout(int seconds) {
+    heartbeat_timeout = (seconds < 1) ? 1 : seconds;
+}
+
+// Score points added to nodes that already cache the requested image
+void scheduler_set_locality_bonus(double bonus) {
+    locality_bonus = (bonus < 0.0) ? 0.0 : bonus;
+}
+
+// Locality bonus a node earns for an image, on the 0-100 spread scale
+static double locality_score(const node_t* node, const char* image) {
+    if (locality_bonus <= 0.0) return 0.0;
+    return image_digest_contains(node->resources.image_digest, image) ? locality_bonus : 0.0;
+}
+
+// Image a request will launch from
+static const char* config_image(const lxc_config_t* config) {
+    return strlen(config->image) > 0 ? config->image : DEFAULT_IMAGE;
+}
+
+// Allocatable amount of a capacity after headroom
+static int allocatable(int capacity) {
+    return capacity - (capacity * headroom_percent) / 100;
+}
+
+// Check whether a node's allocatable capacity can hold the request
+int scheduler_node_fits(const node_t* node, const lxc_config_t* config) {
+    if (!node || !config) return 0;
+
+    // Nodes that have not reported capacity yet cannot be packed against
+    if (node->resources.cpu_capacity <= 0 || node->resources.memory_capacity <= 0) {
+        return 0;
+    }
+
+    if (node->cpu_requested + config->cpu_limit > allocatable(node->resources.cpu_capacity)) {
+        return 0;
+    }
+
+    if (node->memory_requested + config->memory_limit >
+        allocatable(node->resources.memory_capacity)) {
+        return 0;
+    }
+
+    return 1;
+}
+
+// Usage based score including outstanding reservations, higher is better
+static double spread_score(const node_t* node) {
+    double cpu_used = node->resources.cpu_usage + node->reserved_cpu;
+    double memory_used = node->resources.memory_usage + node->reserved_memory;
+    double cpu_available = 100.0 - (cpu_used > 100.0 ? 100.0 : cpu_used);
+    double memory_available = 100.0 - (memory_used > 100.0 ? 100.0 : memory_used);
+    double disk_available = 100.0 - node->resources.disk_usage;
+    double container_load = (double)node->container_count / node->resources.max_containers;
+
+    // Weighted scoring, CPU and memory 30% each, disk and load 20% by default
+    return (cpu_available * cpu_weight +
+            memory_available * memory_weight +
+            disk_available * disk_weight +
+            (1.0 - container_load) * 100.0 * load_weight);
+}
+
+// FNV-1a hash of a string
+static unsigned long hash_string(const char* str) {
+    unsigned long hash = 2166136261UL;
+    while (*str) {
+        hash ^= (unsigned char)*str++;
+        hash *= 16777619UL;
+    }
+    return hash;
+}
+
+// Node set helpers
+static void node_set_add(node_set_t* set, int index) {
+    set->bits[index / 64] |= 1ULL << (index % 64);
+}
+
+static void node_set_remove(node_set_t* set, int index) {
+    set->bits[index / 64] &= ~(1ULL << (index % 64));
+}
+
+static void node_set_and(node_set_t* set, const node_set_t* other) {
+    for (int w = 0; w < NODE_SET_WORDS; w++) set->bits[w] &= other->bits[w];
+}
+
+static void node_set_and_not(node_set_t* set, const node_set_t* other) {
+    for (int w = 0; w < NODE_SET_WORDS; w++) set->bits[w] &= ~other->bits[w];
+}
+
+static int node_set_empty(const node_set_t* set) {
+    for (int w = 0; w < NODE_SET_WORDS; w++) {
+        if (set->bits[w]) return 0;
+    }
+    return 1;
+}
+
+// Group a container belongs to, its name when no group was given
+static const char* config_group(const lxc_config_t* config) {
+    return strlen(config->group) > 0 ? config->group : config->name;
+}
+
+// Find a label entry, optionally creating it (caller holds nodes_mutex)
+static label_entry_t* lookup_label(const char* label, int create) {
+    unsigned long slot = hash_string(label) % (2 * MAX_LABELS);
+    while (label_slots[slot] != 0) {
+        label_entry_t* entry = &label_entries[label_slots[slot] - 1];
+        if (strcmp(entry->label, label) == 0) {
+            return entry;
+        }
+        slot = (slot + 1) % (2 * MAX_LABELS);
+    }
+
+    if (!create || label_count >= MAX_LABELS) return NULL;
+
+    label_entry_t* entry = &label_entries[label_count];
+    memset(entry, 0, sizeof(label_entry_t));
+    snprintf(entry->label, sizeof(entry->label), "%s", label);
+    label_slots[slot] = ++label_count;
+    return entry;
+}
+
+// Find a group entry, optionally creating it (caller holds nodes_mutex)
+static group_entry_t* lookup_group(const char* name, int create) {
+    group_entry_t** bucket = &group_buckets[hash_string(name) & (GROUP_BUCKETS - 1)];
+    for (group_entry_t* entry = *bucket; entry; entry = entry->next) {
+        if (strcmp(entry->name, name) == 0) {
+            return entry;
+        }
+    }
+
+    if (!create) return NULL;
+
+    group_entry_t* entry = calloc(1, sizeof(group_entry_t));
+    if (!entry) {
+        printf("Error: No memory to index group %s\n", name);
+        return NULL;
+    }
+    snprintf(entry->name, sizeof(entry->name), "%s", name);
+    entry->next = *bucket;
+    *bucket = entry;
+    return entry;
+}
+
+// Unlink and free a group with no containers left (caller holds nodes_mutex)
+static void drop_group(group_entry_t* group) {
+    group_entry_t** link = &group_buckets[hash_string(group->name) & (GROUP_BUCKETS - 1)];
+    while (*link != group) {
+        link = &(*link)->next;
+    }
+    *link = group->next;
+    free(group);
+}
+
+// Free every group entry (caller holds nodes_mutex)
+static void clear_groups(void) {
+    for (int b = 0; b < GROUP_BUCKETS; b++) {
+        while (group_buckets[b]) {
+            group_entry_t* next = group_buckets[b]->next;
+            free(group_buckets[b]);
+            group_buckets[b] = next;
+        }
+    }
+}
+
+// Add a node's comma separated labels to the inverted index
+static void index_node_labels(int index) {
+    char labels[MAX_NAME_LEN];
+    char* saveptr = NULL;
+
+    strcpy(labels, nodes[index].labels);
+    for (char* label = strtok_r(labels, ",", &saveptr); label;
+         label = strtok_r(NULL, ",", &saveptr)) {
+        label_entry_t* entry = lookup_label(label, 1);
+        if (entry) {
+            node_set_add(&entry->nodes, index);
+        }
+    }
+}
+
+// Count a container of a group in or out of a node (caller holds nodes_mutex)
+static void adjust_group_locked(const lxc_config_t* config, int index, int delta) {
+    group_entry_t* group = lookup_group(config_group(config), delta > 0);
+    if (!group) return;
+
+    int before = group->counts[index];
+    group->counts[index] += delta;
+    if (group->counts[index] > 0) {
+        node_set_add(&group->nodes, index);
+    } else {
+        group->counts[index] = 0;
+        node_set_remove(&group->nodes, index);
+    }
+
+    group->total += group->counts[index] - before;
+    if (group->total <= 0) {
+        drop_group(group);
+    }
+}
+
+// Spread score used as the heap key, nodes known to be unusable sink to the bottom
+static double index_score(const node_t* node) {
+    if (node->state != NODE_CONNECTED || node->resources.max_containers <= 0) {
+        return SCORE_INELIGIBLE;
+    }
+    return spread_score(node);
+}
+
+// Swap two heap slots and keep positions in sync
+static void heap_swap(int a, int b) {
+    int node_a = score_heap[a];
+    int node_b = score_heap[b];
+
+    score_heap[a] = node_b;
+    score_heap[b] = node_a;
+    heap_position[node_b] = a;
+    heap_position[node_a] = b;
+}
+
+// Move a heap slot up while it beats its parent
+static void heap_sift_up(int pos) {
+    while (pos > 0) {
+        int parent = (pos - 1) / 2;
+        if (node_scores[score_heap[pos]] <= node_scores[score_heap[parent]]) break;
+        heap_swap(pos, parent);
+        pos = parent;
+    }
+}
+
+// Move a heap slot down while a child beats it
+static void heap_sift_down(int pos) {
+    while (1) {
+        int left = 2 * pos + 1;
+        int right = left + 1;
+        int largest = pos;
+
+        if (left < heap_size && node_scores[score_heap[left]] > node_scores[score_heap[largest]]) {
+            largest = left;
+        }
+        if (right < heap_size && node_scores[score_heap[right]] > node_scores[score_heap[largest]]) {
+            largest = right;
+        }
+        if (largest == pos) break;
+
+        heap_swap(pos, largest);
+        pos = largest;
+    }
+}
+
+// Rebuild the id table, score heap, label index and group counts from scratch
+// (caller holds nodes_mutex)
+static void rebuild_index_locked(void) {
+    memset(node_id_slots, 0, sizeof(node_id_slots));
+    memset(label_slots, 0, sizeof(label_slots));
+    label_count = 0;
+    clear_groups();
+
+    for (int i = 0; i < node_count; i++) {
+        unsigned long slot = hash_string(nodes[i].id) % NODE_ID_SLOTS;
+        while (node_id_slots[slot] != 0) {
+            slot = (slot + 1) % NODE_ID_SLOTS;
+        }
+        node_id_slots[slot] = i + 1;
+
+        node_scores[i] = index_score(&nodes[i]);
+        score_heap[i] = i;
+        heap_position[i] = i;
+
+        index_node_labels(i);
+        for (int c = 0; c < nodes[i].container_count; c++) {
+            adjust_group_locked(&nodes[i].containers[c].config, i, 1);
+        }
+    }
+
+    heap_size = node_count;
+    for (int pos = heap_size / 2 - 1; pos >= 0; pos--) {
+        heap_sift_down(pos);
+    }
+
+    indexed_generation = nodes_generation;
+}
+
+// Make sure the index matches the node table, returns 1 if it was rebuilt
+// (caller holds nodes_mutex)
+static int ensure_index_locked(void) {
+    if (indexed_generation != nodes_generation || heap_size != node_count) {
+        rebuild_index_locked();
+        return 1;
+    }
+    return 0;
+}
+
+// Find node by id (caller holds nodes_mutex)
+static node_t* find_node_locked(const char* node_id) {
+    ensure_index_locked();
+
+    unsigned long slot = hash_string(node_id) % NODE_ID_SLOTS;
+    while (node_id_slots[slot] != 0) {
+        node_t* node = &nodes[node_id_slots[slot] - 1];
+        if (strcmp(node->id, node_id) == 0) {
+            return node;
+        }
+        slot = (slot + 1) % NODE_ID_SLOTS;
+    }
+    return NULL;
+}
+
+// Recompute a node's spread score after its inputs changed (caller holds nodes_mutex)
+static void update_node_score_locked(node_t* node) {
+    ensure_index_locked();
+
+    int index = (int)(node - nodes);
+    if (index < 0 || index >= heap_size) return;
+
+    double old_score = node_scores[index];
+    node_scores[index] = index_score(node);
+
+    if (node_scores[index] > old_score) {
+        heap_sift_up(heap_position[index]);
+    } else {
+        heap_sift_down(heap_position[index]);
+    }
+}
+
+// Connected and heartbeating, whether or not it has a free container slot
+static int node_reachable(const node_t* node, time_t now) {
+    return node->state == NODE_CONNECTED &&
+           (now - node->last_heartbeat) <= heartbeat_timeout &&
+           node->resources.max_containers > 0;
+}
+
+// Check the time dependent conditions that cannot be part of the heap key
+static int node_eligible(const node_t* node, time_t now) {
+    return node != excluded_node &&
+           node_reachable(node, now) &&
+           node->container_count < node->resources.max_containers;
+}
+
+// Best-first walk of the score heap to the top eligible node, O(log n) when the
+// top nodes are usable. The locality bonus is not part of the heap key, so the
+// walk continues only while a lower ranked node could still win with it
+// (caller holds nodes_mutex).
+static node_t* select_spread_locked(time_t now, const char* image, double* score) {
+    static int candidates[MAX_NODES];   // Heap slots ordered as a max-heap by score
+    int candidate_count = 0;
+    node_t* best_node = NULL;
+    double max_bonus = locality_bonus > 0.0 ? locality_bonus : 0.0;
+
+    ensure_index_locked();
+    if (heap_size == 0) return NULL;
+
+    candidates[candidate_count++] = 0;
+
+    while (candidate_count > 0) {
+        // Pop the best candidate
+        int pos = candidates[0];
+        candidates[0] = candidates[--candidate_count];
+        for (int c = 0; ; ) {
+            int left = 2 * c + 1, right = left + 1, largest = c;
+            if (left < candidate_count &&
+                node_scores[score_heap[candidates[left]]] > node_scores[score_heap[candidates[largest]]]) {
+                largest = left;
+            }
+            if (right < candidate_count &&
+                node_scores[score_heap[candidates[right]]] > node_scores[score_heap[candidates[largest]]]) {
+                largest = right;
+            }
+            if (largest == c) break;
+            int tmp = candidates[c];
+            candidates[c] = candidates[largest];
+            candidates[largest] = tmp;
+            c = largest;
+        }
+
+        node_t* node = &nodes[score_heap[pos]];
+        double raw_score = node_scores[score_heap[pos]];
+        if (raw_score <= SCORE_INELIGIBLE) {
+            break;   // Everything below is ineligible too
+        }
+        if (best_node && raw_score + max_bonus <= *score) {
+            break;   // Nothing left can overtake the best node
+        }
+        if (node_eligible(node, now)) {
+            double node_score = raw_score + locality_score(node, image);
+            if (!best_node || node_score > *score) {
+                *score = node_score;
+                best_node = node;
+            }
+        }
+
+        // Children are the next candidates
+        for (int child = 2 * pos + 1; child <= 2 * pos + 2 && child < heap_size; child++) {
+            int c = candidate_count++;
+            candidates[c] = child;
+            while (c > 0) {
+                int parent = (c - 1) / 2;
+                if (node_scores[score_heap[candidates[c]]] <=
+                    node_scores[score_heap[candidates[parent]]]) {
+                    break;
+                }
+                int tmp = candidates[c];
+                candidates[c] = candidates[parent];
+                candidates[parent] = tmp;
+                c = parent;
+            }
+        }
+    }
+
+    return best_node;
+}
+
+// Score a few random eligible nodes and keep the best (caller holds nodes_mutex).
+// Sampling avoids herding onto one globally top-ranked node when data is stale.
+// When every draw misses, e.g. on a mostly full fleet, the spread heap answers.
+static node_t* select_sampled_locked(time_t now, const char* image, double* score) {
+    node_t* best_node = NULL;
+    int sampled = 0;
+
+    if (node_count == 0) return NULL;
+
+    // Bounded rejection sampling so a mostly unusable fleet cannot spin forever
+    for (int attempt = 0; attempt < 4 * sample_size && sampled < sample_size; attempt++) {
+        node_t* node = &nodes[rand_r(&sample_seed) % node_count];
+        if (!node_eligible(node, now)) {
+            continue;
+        }
+
+        sampled++;
+        double node_score = spread_score(node) + locality_score(node, image);
+        if (!best_node || node_score > *score) {
+            *score = node_score;
+            best_node = node;
+        }
+    }
+
+    if (!best_node) {
+        best_node = select_spread_locked(now, image, score);
+    }
+
+    return best_node;
+}
+
+// Fraction of allocatable capacity left after placing the request, averaged over CPU and memory
+static double remaining_fraction(const node_t* node, const lxc_config_t* config) {
+    int cpu_allocatable = allocatable(node->resources.cpu_capacity);
+    int memory_allocatable = allocatable(node->resources.memory_capacity);
+
+    double cpu_left = (double)(cpu_allocatable - node->cpu_requested - config->cpu_limit) /
+                      cpu_allocatable;
+    double memory_left = (double)(memory_allocatable - node->memory_requested -
+                                  config->memory_limit) / memory_allocatable;
+
+    return (cpu_left + memory_left) / 2.0;
+}
+
+// Check whether a container asks for any placement constraint
+static int has_constraints(const lxc_config_t* config) {
+    return strlen(config->affinity) > 0 || strlen(config->anti_affinity) > 0 ||
+           strlen(config->spread_key) > 0;
+}
+
+// Nodes matching one constraint term: "group=<name>" matches nodes running
+// that group, anything else is a node label (caller holds nodes_mutex)
+static const node_set_t* term_nodes(const char* term) {
+    if (strncmp(term, "group=", 6) == 0) {
+        group_entry_t* group = lookup_group(term + 6, 0);
+        return group ? &group->nodes : NULL;
+    }
+    label_entry_t* entry = lookup_label(term, 0);
+    return entry ? &entry->nodes : NULL;
+}
+
+// Narrow the allowed set to the least loaded domains of the spread key
+// (caller holds nodes_mutex)
+static void apply_spread_locked(const lxc_config_t* config, node_set_t* allowed) {
+    char prefix[MAX_NAME_LEN + 1];
+    node_set_t spread_set;
+    int min_count = -1;
+    group_entry_t* group = lookup_group(config_group(config), 0);
+
+    snprintf(prefix, sizeof(prefix), "%s=", config->spread_key);
+    size_t prefix_len = strlen(prefix);
+    memset(&spread_set, 0, sizeof(spread_set));
+
+    for (int l = 0; l < label_count; l++) {
+        label_entry_t* domain = &label_entries[l];
+        if (strncmp(domain->label, prefix, prefix_len) != 0) continue;
+
+        node_set_t candidates = domain->nodes;
+        node_set_and(&candidates, allowed);
+        if (node_set_empty(&candidates)) continue;
+
+        // Replicas already in this domain, over all of its nodes
+        int count = 0;
+        for (int w = 0; group && w < NODE_SET_WORDS; w++) {
+            unsigned long long bits = domain->nodes.bits[w];
+            while (bits) {
+                count += group->counts[w * 64 + __builtin_ctzll(bits)];
+                bits &= bits - 1;
+            }
+        }
+
+        if (min_count < 0 || count < min_count) {
+            min_count = count;
+            spread_set = candidates;
+        } else if (count == min_count) {
+            for (int w = 0; w < NODE_SET_WORDS; w++) spread_set.bits[w] |= candidates.bits[w];
+        }
+    }
+
+    // Nodes without the spread key are never chosen
+    *allowed = spread_set;
+}
+
+// Nodes a request's constraints allow, starting from the eligible nodes or,
+// for preemption, from every reachable node whether full or not. Returns -1
+// when an affinity term matches no node (caller holds nodes_mutex).
+static int allowed_nodes_locked(const lxc_config_t* config, time_t now, int include_full,
+                                node_set_t* allowed) {
+    char terms[MAX_NAME_LEN];
+    char* saveptr = NULL;
+
+    ensure_index_locked();
+    memset(allowed, 0, sizeof(*allowed));
+    for (int i = 0; i < node_count; i++) {
+        if (include_full ? node_reachable(&nodes[i], now) : node_eligible(&nodes[i], now)) {
+            node_set_add(allowed, i);
+        }
+    }
+
+    if (!has_constraints(config)) return 0;
+
+    strcpy(terms, config->affinity);
+    for (char* term = strtok_r(terms, ",", &saveptr); term; term = strtok_r(NULL, ",", &saveptr)) {
+        const node_set_t* matching = term_nodes(term);
+        if (!matching) return -1;
+        node_set_and(allowed, matching);
+    }
+
+    strcpy(terms, config->anti_affinity);
+    for (char* term = strtok_r(terms, ",", &saveptr); term; term = strtok_r(NULL, ",", &saveptr)) {
+        const node_set_t* matching = term_nodes(term);
+        if (matching) {
+            node_set_and_not(allowed, matching);
+        }
+    }
+
+    if (strlen(config->spread_key) > 0) {
+        apply_spread_locked(config, allowed);
+    }
+
+    return 0;
+}
+
+// Best allowed node under the given policy for a constrained request
+// (caller holds nodes_mutex)
+static node_t* select_constrained_locked(const lxc_config_t* config, scheduler_policy_t policy,
+                                         time_t now, double* score) {
+    node_set_t allowed;
+
+    if (allowed_nodes_locked(config, now, 0, &allowed) != 0) return NULL;
+
+    node_t* best_node = NULL;
+    for (int w = 0; w < NODE_SET_WORDS; w++) {
+        unsigned long long bits = allowed.bits[w];
+        while (bits) {
+            node_t* node = &nodes[w * 64 + __builtin_ctzll(bits)];
+            bits &= bits - 1;
+
+            double node_score;
+            if (policy == SCHED_BEST_FIT || policy == SCHED_WORST_FIT) {
+                if (!scheduler_node_fits(node, config)) continue;
+                double left = remaining_fraction(node, config);
+                node_score = (policy == SCHED_BEST_FIT) ? -left : left;
+                node_score += locality_score(node, config_image(config)) / 100.0;
+            } else {
+                node_score = spread_score(node) + locality_score(node, config_image(config));
+            }
+
+            if (!best_node || node_score > *score) {
+                *score = node_score;
+                best_node = node;
+            }
+        }
+    }
+
+    return best_node;
+}
+
+// Account a container's request against a node. Called after the container
+// was added to node->containers, which an index rebuild already counts.
+void scheduler_commit(node_t* node, const lxc_config_t* config) {
+    if (!node || !config) return;
+
+    lock_nodes();
+    if (!ensure_index_locked()) {
+        adjust_group_locked(config, (int)(node - nodes), 1);
+    }
+    node->cpu_requested += config->cpu_limit;
+    node->memory_requested += config->memory_limit;
+    update_node_score_locked(node);
+    pthread_mutex_unlock(&nodes_mutex);
+}
+
+// Return a container's request to a node. Called after the container was
+// removed from node->containers.
+void scheduler_release(node_t* node, const lxc_config_t* config) {
+    if (!node || !config) return;
+
+    lock_nodes();
+    if (!ensure_index_locked()) {
+        adjust_group_locked(config, (int)(node - nodes), -1);
+    }
+    node->cpu_requested -= config->cpu_limit;
+    node->memory_requested -= config->memory_limit;
+    if (node->cpu_requested < 0) node->cpu_requested = 0;
+    if (node->memory_requested < 0) node->memory_requested = 0;
+    update_node_score_locked(node);
+    pthread_mutex_unlock(&nodes_mutex);
+}
+
+// Estimated share of a node, in percent, that a request will consume
+static double estimate_percent(int request, int capacity) {
+    if (request <= 0 || capacity <= 0) {
+        return RESERVATION_DEFAULT_PERCENT;
+    }
+    return (double)request * 100.0 / capacity;
+}
+
+// Drop a reservation and its contribution to the node (caller holds nodes_mutex)
+static void release_reservation_locked(reservation_t* reservation) {
+    node_t* node = find_node_locked(reservation->node_id);
+    if (node) {
+        node->reserved_cpu -= reservation->cpu;
+        node->reserved_memory -= reservation->memory;
+        node->pending_placements--;
+        if (reservation->settled) {
+            node->settled_placements--;
+        }
+        if (node->pending_placements <= 0) {
+            // Clear accumulated floating point drift
+            node->reserved_cpu = 0.0;
+            node->reserved_memory = 0.0;
+            node->pending_placements = 0;
+            node->settled_placements = 0;
+        }
+        update_node_score_locked(node);
+    }
+    reservation->operation_id = 0;
+}
+
+// Optimistically charge a placement to a node until telemetry catches up
+void scheduler_reserve(node_t* node, const lxc_config_t* config, int operation_id) {
+    if (!node || !config || operation_id <= 0) return;
+
+    lock_nodes();
+
+    reservation_t* reservation = &reservations[RESERVATION_SLOT(operation_id)];
+    if (reservation->operation_id != 0) {
+        // Slot still held by a reservation that was never settled
+        release_reservation_locked(reservation);
+    }
+
+    reservation->operation_id = operation_id;
+    snprintf(reservation->node_id, sizeof(reservation->node_id), "%s", node->id);
+    reservation->cpu = estimate_percent(config->cpu_limit, node->resources.cpu_capacity);
+    reservation->memory = estimate_percent(config->memory_limit,
+                                           node->resources.memory_capacity);
+    reservation->settled = 0;
+
+    node->reserved_cpu += reservation->cpu;
+    node->reserved_memory += reservation->memory;
+    node->pending_placements++;
+    update_node_score_locked(node);
+
+    pthread_mutex_unlock(&nodes_mutex);
+}
+
+// Resolve a reservation when its deploy operation finishes. Failed placements
+// are released at once; successful ones wait for the node's next heartbeat.
+void scheduler_settle_reservation(int operation_id, int succeeded) {
+    if (operation_id <= 0) return;
+
+    lock_nodes();
+
+    reservation_t* reservation = &reservations[RESERVATION_SLOT(operation_id)];
+    if (reservation->operation_id == operation_id) {
+        if (!succeeded) {
+            release_reservation_locked(reservation);
+        } else if (!reservation->settled) {
+            node_t* node = find_node_locked(reservation->node_id);
+            reservation->settled = 1;
+            if (node) {
+                node->settled_placements++;
+            }
+        }
+    }
+
+    pthread_mutex_unlock(&nodes_mutex);
+}
+
+// A fresh heartbeat changes the node's score and reflects acknowledged
+// placements, so their reservations can go
+void scheduler_heartbeat(const char* node_id) {
+    if (!node_id) return;
+
+    lock_nodes();
+
+    node_t* node = find_node_locked(node_id);
+    if (node) {
+        update_node_score_locked(node);
+    }
+    if (node && node->settled_placements > 0) {
+        for (int i = 0; i < MAX_RESERVATIONS && node->settled_placements > 0; i++) {
+            reservation_t* reservation = &reservations[i];
+            if (reservation->operation_id != 0 && reservation->settled &&
+                strcmp(reservation->node_id, node_id) == 0) {
+                release_reservation_locked(reservation);
+            }
+        }
+    }
+
+    pthread_mutex_unlock(&nodes_mutex);
+}
+
+// Pick a node under the current policy, never the one named by excluded_id
+static node_t* select_node(const lxc_config_t* config, const char* excluded_id) {
+    if (!config) return NULL;
+
+    node_t* best_node = NULL;
+    double best_score = -1e9;
+    time_t current_time = time(NULL);
+    scheduler_policy_t policy = current_policy;
+
+    lock_nodes();
+    excluded_node = excluded_id ? find_node_locked(excluded_id) : NULL;
+
+    if (has_constraints(config)) {
+        best_node = select_constrained_locked(config, policy, current_time, &best_score);
+    } else if (policy == SCHED_SPREAD) {
+        // Spread scores do not depend on the request, so the index answers directly
+        best_node = select_spread_locked(current_time, config_image(config), &best_score);
+    } else if (policy == SCHED_P2C) {
+        best_node = select_sampled_locked(current_time, config_image(config), &best_score);
+    } else {
+        // Fit depends on the request size, so bin-packing scans all nodes
+        for (int i = 0; i < node_count; i++) {
+            node_t* node = &nodes[i];
+
+            // Skip disconnected, unresponsive or full nodes
+            if (!node_eligible(node, current_time) || !scheduler_node_fits(node, config)) {
+                continue;
+            }
+
+            // Best-fit prefers the least space left over, worst-fit the most;
+            // locality is scaled to the 0-1 fraction range
+            double left = remaining_fraction(node, config);
+            double score = (policy == SCHED_BEST_FIT) ? -left : left;
+            score += locality_score(node, config_image(config)) / 100.0;
+
+            if (score > best_score) {
+                best_score = score;
+                best_node = node;
+            }
+        }
+    }
+
+    excluded_node = NULL;
+    pthread_mutex_unlock(&nodes_mutex);
+
+    if (best_node) {
+        printf("Selected node %s (%s score: %.2f) for container %s\n",
+               best_node->id, scheduler_policy_name(policy), best_score, config->name);
+    } else {
+        printf("No suitable node found for container %s\n", config->name);
+    }
+
+    return best_node;
+}
+
+// Whether some reachable node could take the request once it had room: the
+// request is within the node's capacity and the node carries every label the
+// affinity asks for. "group=" terms and anti-affinity change as containers
+// come and go, so they never rule a node out here. With no reachable node
+// yet, anything could fit.
+int scheduler_could_place(const lxc_config_t* config) {
+    char terms[MAX_NAME_LEN];
+    char* saveptr = NULL;
+    node_set_t possible;
+    int reachable = 0;
+    time_t now = time(NULL);
+
+    if (!config) return 0;
+
+    lock_nodes();
+    ensure_index_locked();
+    memset(&possible, 0, sizeof(possible));
+    for (int i = 0; i < node_count; i++) {
+        const node_t* node = &nodes[i];
+        if (!node_reachable(node, now)) continue;
+        reachable++;
+
+        // Nodes that have not reported capacity yet may be large enough
+        if (node->resources.cpu_capacity > 0 &&
+            config->cpu_limit > allocatable(node->resources.cpu_capacity)) continue;
+        if (node->resources.memory_capacity > 0 &&
+            config->memory_limit > allocatable(node->resources.memory_capacity)) continue;
+        node_set_add(&possible, i);
+    }
+
+    snprintf(terms, sizeof(terms), "%s", config->affinity);
+    for (char* term = strtok_r(terms, ",", &saveptr); term; term = strtok_r(NULL, ",", &saveptr)) {
+        if (strncmp(term, "group=", 6) == 0) continue;
+        const node_set_t* matching = term_nodes(term);
+        if (!matching) {
+            memset(&possible, 0, sizeof(possible));
+            break;
+        }
+        node_set_and(&possible, matching);
+    }
+
+    int result = reachable == 0 || !node_set_empty(&possible);
+    pthread_mutex_unlock(&nodes_mutex);
+    return result;
+}
+
+// Find best node for container deployment based on the current policy
+node_t* find_best_node(const lxc_config_t* config) {
+    return select_node(config, NULL);
+}
+
+// Find best node other than node_id, e.g. a migration target
+node_t* find_best_node_excluding(const lxc_config_t* config, const char* node_id) {
+    return select_node(config, node_id);
+}
+
+// What a node lacks before a request fits; zero or less means nothing
+typedef struct {
+    int slots;
+    int cpu;
+    int memory;
+} shortfall_t;
+
+// A lower-priority container that could make room
+typedef struct {
+    int index;              // Position in node->containers
+    int priority;
+    int running;
+    int cpu;
+    int memory;
+} victim_t;
+
+// Lowest priority first; among equals containers that are not running, then
+// the largest request, so fewer have to go
+static int compare_victims(const void* a, const void* b) {
+    const victim_t* left = a;
+    const victim_t* right = b;
+
+    if (left->priority != right->priority) {
+        return left->priority < right->priority ? -1 : 1;
+    }
+    if (left->running != right->running) {
+        return left->running - right->running;
+    }
+    return (right->cpu + right->memory) - (left->cpu + left->memory);
+}
+
+// Check whether evicting the given totals covers a shortfall
+static int shortfall_covered(const shortfall_t* need, int slots, int cpu, int memory) {
+    return slots >= need->slots && cpu >= need->cpu && memory >= need->memory;
+}
+
+// Cheaper preemption: lower highest victim priority, then fewer victims, then
+// a lower priority sum
+static int plan_cheaper(const preemption_plan_t* plan, const preemption_plan_t* best) {
+    if (plan->max_priority != best->max_priority) return plan->max_priority < best->max_priority;
+    if (plan->count != best->count) return plan->count < best->count;
+    return plan->priority_sum < best->priority_sum;
+}
+
+// Cheapest set of victims on one node, or -1 if evicting every lower-priority
+// container would not make room or cannot beat best (NULL when there is no
+// plan yet). Caller holds nodes_mutex and the coordinator's container lock.
+static int plan_node_locked(const node_t* node, const lxc_config_t* config, int packing,
+                            const preemption_plan_t* best, preemption_plan_t* plan) {
+    static victim_t candidates[MAX_CONTAINERS];   // Used under nodes_mutex only
+    shortfall_t need;
+    int candidate_count = 0;
+    int min_priority = 0;
+    int slots = 0, cpu = 0, memory = 0;
+
+    need.slots = node->container_count + 1 - node->resources.max_containers;
+    need.cpu = 0;
+    need.memory = 0;
+    if (packing) {
+        if (node->resources.cpu_capacity <= 0 || node->resources.memory_capacity <= 0) {
+            return -1;
+        }
+        need.cpu = node->cpu_requested + config->cpu_limit -
+                   allocatable(node->resources.cpu_capacity);
+        need.memory = node->memory_requested + config->memory_limit -
+                      allocatable(node->resources.memory_capacity);
+    }
+
+    // Containers with an operation in flight are left alone
+    for (int i = 0; i < node->container_count; i++) {
+        const container_t* container = &node->containers[i];
+        if (container->config.priority >= config->priority ||
+            container->state == CONTAINER_STARTING || container->state == CONTAINER_STOPPING) {
+            continue;
+        }
+
+        victim_t* victim = &candidates[candidate_count++];
+        victim->index = i;
+        victim->priority = container->config.priority;
+        victim->running = (container->state == CONTAINER_RUNNING);
+        victim->cpu = container->config.cpu_limit;
+        victim->memory = container->config.memory_limit;
+        if (candidate_count == 1 || victim->priority < min_priority) {
+            min_priority = victim->priority;
+        }
+        slots++;
+        cpu += victim->cpu;
+        memory += victim->memory;
+    }
+
+    // Cheap rejections before sorting: not enough to free, or every victim
+    // here would outrank the best plan's worst victim
+    if (!shortfall_covered(&need, slots, cpu, memory)) return -1;
+    if (best && best->count > 0 && candidate_count > 0 && min_priority > best->max_priority) {
+        return -1;
+    }
+
+    // Take the lowest priorities until the request fits; the last one taken
+    // is the lowest possible highest victim priority on this node
+    qsort(candidates, candidate_count, sizeof(victim_t), compare_victims);
+    int taken = 0;
+    slots = cpu = memory = 0;
+    while (!shortfall_covered(&need, slots, cpu, memory)) {
+        slots++;
+        cpu += candidates[taken].cpu;
+        memory += candidates[taken].memory;
+        taken++;
+    }
+
+    // Reprieve the most important victims the request can do without
+    int keep[MAX_CONTAINERS];
+    for (int i = taken - 1; i >= 0; i--) {
+        keep[i] = shortfall_covered(&need, slots - 1, cpu - candidates[i].cpu,
+                                    memory - candidates[i].memory);
+        if (keep[i]) {
+            slots--;
+            cpu -= candidates[i].cpu;
+            memory -= candidates[i].memory;
+        }
+    }
+
+    memset(plan, 0, sizeof(*plan));
+    strcpy(plan->node_id, node->id);
+    for (int i = 0; i < taken; i++) {
+        if (keep[i]) continue;
+        if (plan->count >= PREEMPTION_MAX_VICTIMS) return -1;
+        strcpy(plan->victims[plan->count++], node->containers[candidates[i].index].id);
+        plan->max_priority = candidates[i].priority;   // Ascending, so the last is highest
+        plan->priority_sum += candidates[i].priority;
+    }
+
+    return 0;
+}
+
+// Find the node where evicting the cheapest set of lower-priority containers
+// makes room for a request that fits nowhere. Nodes that have nothing to free
+// or cannot beat the best plan so far are rejected in one pass over their
+// containers; only the rest are sorted. Caller holds the coordinator's
+// container lock so node container lists stay put. Returns -1 if no plan exists.
+int scheduler_plan_preemption(const lxc_config_t* config, preemption_plan_t* plan) {
+    preemption_plan_t candidate;
+    node_set_t allowed;
+    int found = 0;
+    time_t current_time = time(NULL);
+    int packing = (current_policy == SCHED_BEST_FIT || current_policy == SCHED_WORST_FIT);
+
+    if (!config || !plan) return -1;
+    memset(plan, 0, sizeof(*plan));
+
+    lock_nodes();
+    if (allowed_nodes_locked(config, current_time, 1, &allowed) == 0) {
+        for (int w = 0; w < NODE_SET_WORDS; w++) {
+            unsigned long long bits = allowed.bits[w];
+            while (bits) {
+                node_t* node = &nodes[w * 64 + __builtin_ctzll(bits)];
+                bits &= bits - 1;
+
+                if (plan_node_locked(node, config, packing, found ? plan : NULL,
+                                     &candidate) != 0) {
+                    continue;
+                }
+                if (!found || plan_cheaper(&candidate, plan)) {
+                    *plan = candidate;
+                    found = 1;
+                }
+                if (plan->count == 0) break;   // Room without evicting anything
+            }
+            if (found && plan->count == 0) break;
+        }
+    }
+    pthread_mutex_unlock(&nodes_mutex);
+
+    if (!found) {
+        printf("No preemption frees a node for container %s (priority %d)\n",
+               config->name, config->priority);
+        return -1;
+    }
+
+    printf("Preemption plan for %s (priority %d): %d victim(s) on node %s, highest priority %d\n",
+           config->name, config->priority, plan->count, plan->node_id, plan->max_priority);
+    return 0;
+}
+
+// Print scheduler settings and per-node allocation
+void show_scheduler(void) {
+    printf("\n=== Scheduler ===\n");
+    printf("Policy: %s  Headroom: %d%%  Sample size: %d  Locality bonus: %.1f\n",
+           scheduler_policy_name(current_policy), headroom_percent, sample_size, locality_bonus);
+    printf("Weights: cpu %.2f memory %.2f disk %.2f load %.2f  Heartbeat timeout: %ds\n",
+           cpu_weight, memory_weight, disk_weight, load_weight, heartbeat_timeout);
+    printf("%-15s %-12s %-20s %-8s %-10s %-10s\n", "Node", "CPU req/cap",
+           "Memory req/cap (MB)", "Pending", "Rsv CPU%", "Rsv Mem%");
+    printf("------------------------------------------------------------------------------\n");
+
+    lock_nodes();
+    for (int i = 0; i < node_count; i++) {
+        node_t* node = &nodes[i];
+        char cpu[32];
+        char memory[64];
+
+        snprintf(cpu, sizeof(cpu), "%d/%d", node->cpu_requested, node->resources.cpu_capacity);
+        snprintf(memory, sizeof(memory), "%d/%d", node->memory_requested,
+                 node->resources.memory_capacity);
+        printf("%-15s %-12s %-20s %-8d %-10.1f %-10.1f\n", node->id, cpu, memory,
+               node->pending_placements, node->reserved_cpu, node->reserved_memory);
+    }
+    pthread_mutex_unlock(&nodes_mutex);
+}
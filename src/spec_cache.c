@@ -0,0 +1,245 @@
+#include "../include/spec_cache.h"
+#include "../include/yaml_parser.h"
+#include "../include/metrics.h"
+
+// One parsed spec and the file identity it was parsed from
+typedef struct {
+    int used;
+    char path[MAX_PATH_LEN];
+    uint64_t path_hash;
+    dev_t device;
+    ino_t inode;
+    off_t size;
+    struct timespec mtime;
+    time_t verified_at;            // When the content was last hashed
+    uint64_t content_hash;
+    lxc_config_t config;
+    unsigned long uses;
+    unsigned long last_used;       // Lookup tick, for eviction
+} spec_entry_t;
+
+// Cached specs and counters (protected by spec_cache_mutex)
+static spec_entry_t spec_entries[SPEC_CACHE_ENTRIES];
+static unsigned long lookup_tick = 0;
+static unsigned long hits_total = 0;
+static unsigned long revalidated_total = 0;
+static unsigned long parsed_total = 0;
+static pthread_mutex_t spec_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int hit_counter = -1;
+static int revalidated_counter = -1;
+static int parsed_counter = -1;
+
+// 64-bit FNV-1a over a byte range
+static uint64_t hash_bytes(const char* data, size_t length) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (unsigned char)data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// Register the lookup counters
+int init_spec_cache(void) {
+    hit_counter = metrics_counter("lxc_spec_cache_lookups_total", "result=\"hit\"",
+                                  "Spec lookups by whether the file had to be read or parsed");
+    revalidated_counter = metrics_counter("lxc_spec_cache_lookups_total", "result=\"revalidated\"",
+                                          "Spec lookups by whether the file had to be read or parsed");
+    parsed_counter = metrics_counter("lxc_spec_cache_lookups_total", "result=\"parsed\"",
+                                     "Spec lookups by whether the file had to be read or parsed");
+    return 0;
+}
+
+// Find the entry for a path (caller holds spec_cache_mutex)
+static spec_entry_t* find_entry_locked(const char* path, uint64_t path_hash) {
+    for (int i = 0; i < SPEC_CACHE_ENTRIES; i++) {
+        spec_entry_t* entry = &spec_entries[i];
+        if (entry->used && entry->path_hash == path_hash && strcmp(entry->path, path) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+// A free entry, or the least recently used one (caller holds spec_cache_mutex)
+static spec_entry_t* claim_entry_locked(void) {
+    spec_entry_t* oldest = &spec_entries[0];
+    for (int i = 0; i < SPEC_CACHE_ENTRIES; i++) {
+        if (!spec_entries[i].used) return &spec_entries[i];
+        if (spec_entries[i].last_used < oldest->last_used) oldest = &spec_entries[i];
+    }
+    return oldest;
+}
+
+// Whether a file still has the identity an entry recorded
+static int same_file(const spec_entry_t* entry, const struct stat* info) {
+    return entry->device == info->st_dev && entry->inode == info->st_ino &&
+           entry->size == info->st_size && entry->mtime.tv_sec == info->st_mtim.tv_sec &&
+           entry->mtime.tv_nsec == info->st_mtim.tv_nsec;
+}
+
+// Record a file's identity and when its content was checked
+static void remember_file(spec_entry_t* entry, const struct stat* info, time_t now) {
+    entry->device = info->st_dev;
+    entry->inode = info->st_ino;
+    entry->size = info->st_size;
+    entry->mtime = info->st_mtim;
+    entry->verified_at = now;
+}
+
+// Read up to capacity bytes of a file into a new buffer, NULL on error
+static char* read_spec(const char* path, size_t capacity, size_t* length) {
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        printf("Error: Cannot open file %s\n", path);
+        return NULL;
+    }
+
+    char* data = malloc(capacity);
+    if (!data) {
+        fclose(file);
+        return NULL;
+    }
+    *length = fread(data, 1, capacity, file);
+    int failed = ferror(file);
+    fclose(file);
+
+    if (failed) {
+        printf("Error: Cannot read file %s\n", path);
+        free(data);
+        return NULL;
+    }
+    return data;
+}
+
+// Load a container spec, parsing the file only when its content changed.
+// An unchanged file identity is trusted without a read once it was hashed in
+// a later second than its mtime; otherwise the content hash decides, so an
+// edit that keeps size and mtime is still seen.
+int spec_cache_load(const char* path, lxc_config_t* config) {
+    struct stat info;
+    uint64_t cached_hash = 0;
+    int cached = 0;
+    size_t length = 0;
+
+    if (!path || !config) return -1;
+    if (stat(path, &info) != 0) {
+        printf("Error: Cannot open file %s\n", path);
+        return -1;
+    }
+    if (strlen(path) >= MAX_PATH_LEN || info.st_size >= SPEC_CACHE_MAX_FILE) {
+        return parse_lxc_yaml(path, config);
+    }
+
+    uint64_t path_hash = hash_bytes(path, strlen(path));
+    time_t now = time(NULL);
+
+    pthread_mutex_lock(&spec_cache_mutex);
+    spec_entry_t* entry = find_entry_locked(path, path_hash);
+    if (entry && same_file(entry, &info) && entry->verified_at > info.st_mtim.tv_sec) {
+        *config = entry->config;
+        entry->uses++;
+        entry->last_used = ++lookup_tick;
+        hits_total++;
+        pthread_mutex_unlock(&spec_cache_mutex);
+        metrics_add(hit_counter, 1);
+        return 0;
+    }
+    if (entry) {
+        cached = 1;
+        cached_hash = entry->content_hash;
+    }
+    pthread_mutex_unlock(&spec_cache_mutex);
+
+    // A file that grew since the stat is caught by the next lookup's stat
+    char* data = read_spec(path, info.st_size + 1, &length);
+    if (!data) return -1;
+    uint64_t content_hash = hash_bytes(data, length);
+
+    // Touched or recently written but the same content: keep the parsed spec
+    if (cached && content_hash == cached_hash) {
+        pthread_mutex_lock(&spec_cache_mutex);
+        entry = find_entry_locked(path, path_hash);
+        if (entry && entry->content_hash == content_hash) {
+            remember_file(entry, &info, now);
+            *config = entry->config;
+            entry->uses++;
+            entry->last_used = ++lookup_tick;
+            revalidated_total++;
+            pthread_mutex_unlock(&spec_cache_mutex);
+            free(data);
+            metrics_add(revalidated_counter, 1);
+            return 0;
+        }
+        pthread_mutex_unlock(&spec_cache_mutex);
+    }
+
+    // Parse the bytes that were hashed, so the entry matches its hash even if
+    // the file changes again meanwhile
+    int result = parse_lxc_yaml_buffer(data, length, path, config);
+    free(data);
+    if (result != 0) return -1;
+
+    // A replaced spec's heap strings are not freed: configs copied from it
+    // into the registry may still point at them
+    pthread_mutex_lock(&spec_cache_mutex);
+    entry = find_entry_locked(path, path_hash);
+    if (!entry) {
+        entry = claim_entry_locked();
+        memset(entry, 0, sizeof(*entry));
+        entry->used = 1;
+        strcpy(entry->path, path);
+        entry->path_hash = path_hash;
+    }
+    remember_file(entry, &info, now);
+    entry->content_hash = content_hash;
+    entry->config = *config;
+    entry->uses++;
+    entry->last_used = ++lookup_tick;
+    parsed_total++;
+    pthread_mutex_unlock(&spec_cache_mutex);
+    metrics_add(parsed_counter, 1);
+    return 0;
+}
+
+// Forget every cached spec
+void spec_cache_clear(void) {
+    pthread_mutex_lock(&spec_cache_mutex);
+    memset(spec_entries, 0, sizeof(spec_entries));
+    pthread_mutex_unlock(&spec_cache_mutex);
+}
+
+// Copy the cache counters
+void spec_cache_status(spec_cache_status_t* status) {
+    pthread_mutex_lock(&spec_cache_mutex);
+    status->entries = 0;
+    for (int i = 0; i < SPEC_CACHE_ENTRIES; i++) {
+        status->entries += spec_entries[i].used;
+    }
+    status->hits = hits_total;
+    status->revalidated = revalidated_total;
+    status->parsed = parsed_total;
+    pthread_mutex_unlock(&spec_cache_mutex);
+}
+
+// Print the cache counters and every cached spec
+void show_spec_cache(void) {
+    spec_cache_status_t status;
+    time_t now = time(NULL);
+
+    spec_cache_status(&status);
+    printf("\n=== Spec Cache ===\n");
+    printf("Entries: %d/%d  Hits: %lu  Revalidated: %lu  Parsed: %lu\n", status.entries,
+           SPEC_CACHE_ENTRIES, status.hits, status.revalidated, status.parsed);
+    printf("%-40s %-20s %-8s %-10s\n", "Path", "Name", "Uses", "Verified");
+    printf("-------------------------------------------------------------------------------\n");
+
+    pthread_mutex_lock(&spec_cache_mutex);
+    for (int i = 0; i < SPEC_CACHE_ENTRIES; i++) {
+        const spec_entry_t* entry = &spec_entries[i];
+        if (!entry->used) continue;
+        printf("%-40.40s %-20.20s %-8lu %lds ago\n", entry->path, entry->config.name, entry->uses,
+               (long)(now - entry->verified_at));
+    }
+    pthread_mutex_unlock(&spec_cache_mutex);
+}
@@ -0,0 +1,534 @@
+#include "../include/tenants.h"
+#include "../include/raft.h"
+
+// External declarations from network.c
+extern node_t nodes[];
+extern int node_count;
+extern pthread_mutex_t nodes_mutex;
+extern void lock_nodes(void);
+
+// Usage, limits and pending deployments of one tenant. Usage is charged by
+// containers in the registry; reservations cover deployments admitted but
+// still being placed, so concurrent admissions cannot overrun a quota.
+typedef struct {
+    char name[MAX_NAME_LEN];
+    int cpu_used;
+    int memory_used;
+    int containers;
+    int cpu_reserved;
+    int memory_reserved;
+    int containers_reserved;
+    int cpu_quota;              // 0 when unlimited
+    int memory_quota;
+    int container_quota;
+    double weight;
+    int head;                   // Pending deployments, oldest first; pool indices, -1 when empty
+    int tail;
+    int pending;
+    unsigned long admitted;
+} tenant_t;
+
+// A deployment waiting for its turn
+typedef struct {
+    lxc_config_t config;
+    container_state_t desired_state;
+    time_t queued_at;
+    unsigned long stuck_round;  // Last dispatch round in which no node had room for it
+    int next;                   // Next entry of the same tenant, or of the free list
+} pending_t;
+
+// Cluster totals the shares are measured against
+typedef struct {
+    double cpu;
+    double memory;
+    double slots;
+} cluster_capacity_t;
+
+// Tenant table, hashed by name, and the pending pool (protected by tenants_mutex)
+static tenant_t tenants[MAX_TENANTS];
+static int tenant_count = 0;
+static int tenant_slots[TENANT_SLOTS];   // Tenant index + 1, 0 when empty
+static pending_t pending_pool[TENANT_QUEUE_SLOTS];
+static int free_pending = -1;
+static int total_pending = 0;
+static int wake_pending = 0;
+static unsigned long dispatch_rounds = 0;
+static tenant_placer_t tenant_placer = NULL;
+static pthread_mutex_t tenants_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t tenants_cond = PTHREAD_COND_INITIALIZER;
+
+// FNV-1a hash of a string
+static unsigned long hash_string(const char* str) {
+    unsigned long hash = 2166136261UL;
+    while (*str) {
+        hash ^= (unsigned char)*str++;
+        hash *= 16777619UL;
+    }
+    return hash;
+}
+
+// Copy a tenant's limits from the configuration, unlimited when not listed
+static void apply_quota(tenant_t* tenant, const daemon_config_t* config) {
+    tenant->cpu_quota = 0;
+    tenant->memory_quota = 0;
+    tenant->container_quota = 0;
+    tenant->weight = 1.0;
+
+    for (int i = 0; i < config->tenant_quota_count; i++) {
+        const tenant_quota_t* quota = &config->tenant_quotas[i];
+        if (strcmp(quota->name, tenant->name) == 0) {
+            tenant->cpu_quota = quota->cpu;
+            tenant->memory_quota = quota->memory;
+            tenant->container_quota = quota->containers;
+            tenant->weight = quota->weight;
+            break;
+        }
+    }
+}
+
+// Find a tenant, optionally creating it (caller holds tenants_mutex)
+static tenant_t* lookup_tenant_locked(const char* name, int create) {
+    if (!name || name[0] == '\0') name = DEFAULT_TENANT;
+
+    unsigned long slot = hash_string(name) % TENANT_SLOTS;
+    while (tenant_slots[slot] != 0) {
+        tenant_t* tenant = &tenants[tenant_slots[slot] - 1];
+        if (strcmp(tenant->name, name) == 0) {
+            return tenant;
+        }
+        slot = (slot + 1) % TENANT_SLOTS;
+    }
+
+    if (!create) return NULL;
+    if (tenant_count >= MAX_TENANTS) {
+        printf("Error: Tenant table full, cannot track tenant %s\n", name);
+        return NULL;
+    }
+
+    tenant_t* tenant = &tenants[tenant_count];
+    memset(tenant, 0, sizeof(tenant_t));
+    strncpy(tenant->name, name, MAX_NAME_LEN - 1);
+    tenant->head = -1;
+    tenant->tail = -1;
+    apply_quota(tenant, config_current());
+    tenant_slots[slot] = ++tenant_count;
+    return tenant;
+}
+
+// Check whether a request ever fits the tenant's limits
+static int within_limits(const tenant_t* tenant, const lxc_config_t* config) {
+    return (tenant->cpu_quota == 0 || config->cpu_limit <= tenant->cpu_quota) &&
+           (tenant->memory_quota == 0 || config->memory_limit <= tenant->memory_quota);
+}
+
+// Check whether a request fits what the tenant has left, O(1)
+static int within_quota(const tenant_t* tenant, const lxc_config_t* config) {
+    return (tenant->cpu_quota == 0 ||
+            tenant->cpu_used + tenant->cpu_reserved + config->cpu_limit <= tenant->cpu_quota) &&
+           (tenant->memory_quota == 0 ||
+            tenant->memory_used + tenant->memory_reserved + config->memory_limit <=
+            tenant->memory_quota) &&
+           (tenant->container_quota == 0 ||
+            tenant->containers + tenant->containers_reserved + 1 <= tenant->container_quota);
+}
+
+// Hold or return an admitted request's share while it is placed (caller holds tenants_mutex)
+static void reserve_locked(tenant_t* tenant, const lxc_config_t* config, int sign) {
+    tenant->cpu_reserved += sign * config->cpu_limit;
+    tenant->memory_reserved += sign * config->memory_limit;
+    tenant->containers_reserved += sign;
+}
+
+// Sum the capacity of connected nodes
+static void measure_cluster(cluster_capacity_t* capacity) {
+    memset(capacity, 0, sizeof(*capacity));
+
+    lock_nodes();
+    for (int i = 0; i < node_count; i++) {
+        if (nodes[i].state != NODE_CONNECTED) continue;
+        capacity->cpu += nodes[i].resources.cpu_capacity;
+        capacity->memory += nodes[i].resources.memory_capacity;
+        capacity->slots += nodes[i].resources.max_containers;
+    }
+    pthread_mutex_unlock(&nodes_mutex);
+}
+
+// Largest share of any cluster resource the tenant holds or is being given,
+// divided by its weight (caller holds tenants_mutex)
+static double dominant_share(const tenant_t* tenant, const cluster_capacity_t* capacity) {
+    double share = 0.0;
+
+    if (capacity->cpu > 0) {
+        double cpu = (tenant->cpu_used + tenant->cpu_reserved) / capacity->cpu;
+        if (cpu > share) share = cpu;
+    }
+    if (capacity->memory > 0) {
+        double memory = (tenant->memory_used + tenant->memory_reserved) / capacity->memory;
+        if (memory > share) share = memory;
+    }
+    if (capacity->slots > 0) {
+        double slots = (tenant->containers + tenant->containers_reserved) / capacity->slots;
+        if (slots > share) share = slots;
+    }
+
+    return share / tenant->weight;
+}
+
+// Let the dispatcher look at the queue again (caller holds tenants_mutex)
+static void wake_dispatcher_locked(void) {
+    wake_pending = 1;
+    pthread_cond_signal(&tenants_cond);
+}
+
+// Append a deployment to its tenant's queue (caller holds tenants_mutex)
+static int enqueue_locked(tenant_t* tenant, const lxc_config_t* config,
+                          container_state_t desired_state) {
+    if (free_pending < 0) {
+        printf("Error: Deployment queue full, container %s of tenant %s is refused\n",
+               config->name, tenant->name);
+        return -1;
+    }
+
+    int index = free_pending;
+    pending_t* entry = &pending_pool[index];
+    free_pending = entry->next;
+
+    entry->config = *config;
+    entry->desired_state = desired_state;
+    entry->queued_at = time(NULL);
+    entry->stuck_round = 0;
+    entry->next = -1;
+
+    if (tenant->tail >= 0) {
+        pending_pool[tenant->tail].next = index;
+    } else {
+        tenant->head = index;
+    }
+    tenant->tail = index;
+    tenant->pending++;
+    total_pending++;
+    wake_dispatcher_locked();
+    return 0;
+}
+
+// Unlink an entry from its tenant's queue, given the entry before it or -1
+// (caller holds tenants_mutex)
+static void dequeue_locked(tenant_t* tenant, int index, int previous) {
+    int next = pending_pool[index].next;
+
+    if (previous >= 0) {
+        pending_pool[previous].next = next;
+    } else {
+        tenant->head = next;
+    }
+    if (tenant->tail == index) tenant->tail = previous;
+    tenant->pending--;
+    total_pending--;
+
+    pending_pool[index].next = free_pending;
+    free_pending = index;
+}
+
+// Oldest deployment of a tenant that has not been stuck this round, and the
+// entry before it. Entries that found no room are passed over, so a large
+// request does not hold up smaller ones behind it. Returns -1 when none is
+// left (caller holds tenants_mutex).
+static int candidate_locked(const tenant_t* tenant, int* previous) {
+    *previous = -1;
+    for (int index = tenant->head; index >= 0; index = pending_pool[index].next) {
+        if (pending_pool[index].stuck_round != dispatch_rounds) return index;
+        *previous = index;
+    }
+    return -1;
+}
+
+// Tenant whose candidate deployment should go next: the lowest dominant share
+// among those with work that fits their quota (caller holds tenants_mutex)
+static tenant_t* next_tenant_locked(const cluster_capacity_t* capacity, int* index,
+                                    int* previous) {
+    tenant_t* best = NULL;
+    double best_share = 0.0;
+
+    for (int i = 0; i < tenant_count; i++) {
+        tenant_t* tenant = &tenants[i];
+        int candidate_previous;
+        int candidate = candidate_locked(tenant, &candidate_previous);
+        if (candidate < 0 || !within_quota(tenant, &pending_pool[candidate].config)) {
+            continue;
+        }
+
+        double share = dominant_share(tenant, capacity);
+        if (!best || share < best_share) {
+            best = tenant;
+            best_share = share;
+            *index = candidate;
+            *previous = candidate_previous;
+        }
+    }
+
+    return best;
+}
+
+// Place pending deployments in dominant-share order until none can go
+static void dispatch_round(void) {
+    cluster_capacity_t capacity;
+    measure_cluster(&capacity);
+
+    pthread_mutex_lock(&tenants_mutex);
+    dispatch_rounds++;
+
+    tenant_t* tenant;
+    int index, previous;
+    while ((tenant = next_tenant_locked(&capacity, &index, &previous)) != NULL) {
+        pending_t entry = pending_pool[index];
+
+        if (time(NULL) - entry.queued_at > TENANT_PENDING_TIMEOUT) {
+            dequeue_locked(tenant, index, previous);
+            printf("Error: Container %s of tenant %s found no node within %ds, dropped\n",
+                   entry.config.name, tenant->name, TENANT_PENDING_TIMEOUT);
+            continue;
+        }
+
+        // Only the dispatcher removes entries, so index and previous stay valid while unlocked
+        reserve_locked(tenant, &entry.config, 1);
+        pthread_mutex_unlock(&tenants_mutex);
+
+        int op_id = tenant_placer(&entry.config, entry.desired_state);
+
+        pthread_mutex_lock(&tenants_mutex);
+        reserve_locked(tenant, &entry.config, -1);
+        if (op_id > 0) {
+            dequeue_locked(tenant, index, previous);
+            tenant->admitted++;
+            printf("Admitted container %s of tenant %s (operation %d, %d still pending)\n",
+                   entry.config.name, tenant->name, op_id, tenant->pending);
+        } else if (op_id == TENANT_NO_ROOM) {
+            pending_pool[index].stuck_round = dispatch_rounds;
+        } else {
+            dequeue_locked(tenant, index, previous);
+            printf("Error: Container %s of tenant %s cannot be placed, dropped\n",
+                   entry.config.name, tenant->name);
+        }
+    }
+    pthread_mutex_unlock(&tenants_mutex);
+}
+
+// Places pending deployments when capacity frees up, and retries while blocked
+static void* tenant_dispatch_thread(void* arg) {
+    (void)arg;
+
+    while (1) {
+        pthread_mutex_lock(&tenants_mutex);
+        while (!wake_pending) {
+            if (total_pending == 0) {
+                pthread_cond_wait(&tenants_cond, &tenants_mutex);
+                continue;
+            }
+            struct timespec deadline = { time(NULL) + TENANT_RETRY_INTERVAL, 0 };
+            if (pthread_cond_timedwait(&tenants_cond, &tenants_mutex, &deadline) == ETIMEDOUT) {
+                break;
+            }
+        }
+        wake_pending = 0;
+        pthread_mutex_unlock(&tenants_mutex);
+
+        // Only the leader places containers; the queue waits for it to lead again
+        if (raft_enabled() && !raft_is_leader()) continue;
+
+        dispatch_round();
+    }
+
+    return NULL;
+}
+
+// Start the deployment dispatcher
+int init_tenants(tenant_placer_t placer) {
+    pthread_t tid;
+
+    if (!placer) return -1;
+    tenant_placer = placer;
+
+    pthread_mutex_lock(&tenants_mutex);
+    for (int i = TENANT_QUEUE_SLOTS - 1; i >= 0; i--) {
+        pending_pool[i].next = free_pending;
+        free_pending = i;
+    }
+    pthread_mutex_unlock(&tenants_mutex);
+
+    if (pthread_create(&tid, NULL, tenant_dispatch_thread, NULL) != 0) {
+        printf("Error: Failed to start deployment dispatcher thread\n");
+        return -1;
+    }
+
+    pthread_detach(tid);
+    return 0;
+}
+
+// Pick up changed tenant limits
+void tenants_configure(const daemon_config_t* config) {
+    pthread_mutex_lock(&tenants_mutex);
+    for (int i = 0; i < tenant_count; i++) {
+        apply_quota(&tenants[i], config);
+    }
+    wake_dispatcher_locked();
+    pthread_mutex_unlock(&tenants_mutex);
+}
+
+// Admit a deployment: placed at once when its tenant is within quota and
+// nothing is waiting, queued otherwise. Returns the operation id, 0 when
+// queued, or -1 when refused.
+int tenant_submit(const lxc_config_t* config, container_state_t desired_state) {
+    if (!config) return -1;
+
+    pthread_mutex_lock(&tenants_mutex);
+    tenant_t* tenant = lookup_tenant_locked(config->tenant, 1);
+    if (!tenant) {
+        pthread_mutex_unlock(&tenants_mutex);
+        return -1;
+    }
+
+    if (!within_limits(tenant, config)) {
+        pthread_mutex_unlock(&tenants_mutex);
+        printf("Error: Container %s asks for more than tenant %s's quota\n", config->name,
+               tenant->name);
+        return -1;
+    }
+
+    // While anything waits, the dispatcher decides the order, so newcomers line up
+    if (total_pending > 0 || !within_quota(tenant, config)) {
+        int result = enqueue_locked(tenant, config, desired_state);
+        int pending = tenant->pending;
+        pthread_mutex_unlock(&tenants_mutex);
+        if (result == 0) {
+            printf("Container %s queued for tenant %s (%d pending)\n", config->name,
+                   tenant->name, pending);
+        }
+        return result;
+    }
+
+    reserve_locked(tenant, config, 1);
+    pthread_mutex_unlock(&tenants_mutex);
+
+    int op_id = tenant_placer(config, desired_state);
+
+    pthread_mutex_lock(&tenants_mutex);
+    reserve_locked(tenant, config, -1);
+    int result = op_id;
+    if (op_id > 0) {
+        tenant->admitted++;
+    } else if (op_id == TENANT_NO_ROOM) {
+        // No node has room now; wait for capacity instead of failing
+        result = enqueue_locked(tenant, config, desired_state);
+        if (result == 0) {
+            printf("Container %s queued for tenant %s until a node has room\n", config->name,
+                   tenant->name);
+        }
+    }
+    pthread_mutex_unlock(&tenants_mutex);
+
+    return result;
+}
+
+// Charge a container entering the registry to its tenant
+void tenant_charge(const lxc_config_t* config) {
+    if (!config) return;
+
+    pthread_mutex_lock(&tenants_mutex);
+    tenant_t* tenant = lookup_tenant_locked(config->tenant, 1);
+    if (tenant) {
+        tenant->cpu_used += config->cpu_limit;
+        tenant->memory_used += config->memory_limit;
+        tenant->containers++;
+    }
+    pthread_mutex_unlock(&tenants_mutex);
+}
+
+// Credit a container leaving the registry; its room may let a pending one in
+void tenant_release(const lxc_config_t* config) {
+    if (!config) return;
+
+    pthread_mutex_lock(&tenants_mutex);
+    tenant_t* tenant = lookup_tenant_locked(config->tenant, 0);
+    if (tenant) {
+        tenant->cpu_used -= config->cpu_limit;
+        tenant->memory_used -= config->memory_limit;
+        tenant->containers--;
+        if (tenant->cpu_used < 0) tenant->cpu_used = 0;
+        if (tenant->memory_used < 0) tenant->memory_used = 0;
+        if (tenant->containers < 0) tenant->containers = 0;
+    }
+    if (total_pending > 0) {
+        wake_dispatcher_locked();
+    }
+    pthread_mutex_unlock(&tenants_mutex);
+}
+
+// Forget usage before the registry is rebuilt; pending deployments stay
+void tenants_reset(void) {
+    pthread_mutex_lock(&tenants_mutex);
+    for (int i = 0; i < tenant_count; i++) {
+        tenants[i].cpu_used = 0;
+        tenants[i].memory_used = 0;
+        tenants[i].containers = 0;
+    }
+    pthread_mutex_unlock(&tenants_mutex);
+}
+
+// Copy tenant usage, limits and shares, returns how many
+int tenants_list(tenant_info_t* out, int max_tenants) {
+    cluster_capacity_t capacity;
+    int count = 0;
+
+    measure_cluster(&capacity);
+
+    pthread_mutex_lock(&tenants_mutex);
+    for (int i = 0; i < tenant_count && count < max_tenants; i++) {
+        const tenant_t* tenant = &tenants[i];
+        tenant_info_t* info = &out[count++];
+
+        strcpy(info->name, tenant->name);
+        info->cpu_used = tenant->cpu_used;
+        info->memory_used = tenant->memory_used;
+        info->containers = tenant->containers;
+        info->cpu_quota = tenant->cpu_quota;
+        info->memory_quota = tenant->memory_quota;
+        info->container_quota = tenant->container_quota;
+        info->weight = tenant->weight;
+        info->dominant_share = dominant_share(tenant, &capacity);
+        info->pending = tenant->pending;
+        info->admitted = tenant->admitted;
+    }
+    pthread_mutex_unlock(&tenants_mutex);
+
+    return count;
+}
+
+// Format "used/quota", with "-" for an unlimited quota
+static void format_usage(char* buffer, size_t size, int used, int quota) {
+    if (quota > 0) {
+        snprintf(buffer, size, "%d/%d", used, quota);
+    } else {
+        snprintf(buffer, size, "%d/-", used);
+    }
+}
+
+// Print tenant usage, limits and queues
+void show_tenants(void) {
+    static tenant_info_t snapshot[MAX_TENANTS];
+    int count = tenants_list(snapshot, MAX_TENANTS);
+
+    printf("\n=== Tenants ===\n");
+    printf("%-20s %-7s %-7s %-12s %-16s %-12s %-8s %-8s\n", "Tenant", "Weight", "Share",
+           "CPU", "Memory (MB)", "Containers", "Pending", "Admitted");
+    printf("--------------------------------------------------------------------------------------------\n");
+    for (int i = 0; i < count; i++) {
+        char cpu[32], memory[32], containers[32];
+        format_usage(cpu, sizeof(cpu), snapshot[i].cpu_used, snapshot[i].cpu_quota);
+        format_usage(memory, sizeof(memory), snapshot[i].memory_used, snapshot[i].memory_quota);
+        format_usage(containers, sizeof(containers), snapshot[i].containers,
+                     snapshot[i].container_quota);
+        printf("%-20s %-7.2f %-7.3f %-12s %-16s %-12s %-8d %-8lu\n", snapshot[i].name,
+               snapshot[i].weight, snapshot[i].dominant_share, cpu, memory, containers,
+               snapshot[i].pending, snapshot[i].admitted);
+    }
+}
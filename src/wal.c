@@ -0,0 +1,1007 @@
+#include "../include/wal.h"
+#include <dirent.h>
+#include <sys/mman.h>
+
+#define WAL_SEGMENT_PREFIX "wal-"
+#define WAL_SEGMENT_SUFFIX ".log"
+#define WAL_SNAPSHOT_TEMP "snapshot.tmp"
+#define WAL_SNAPSHOT_MAGIC "DLXCSNAP"
+#define WAL_SNAPSHOT_VERSION 2
+#define WAL_INITIAL_BUFFER (64 * 1024)
+
+#define WAL_ALIGN(len) (((len) + 7) & ~(size_t)7)
+
+// Snapshot file header, followed by records in the log format
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t crc;            // CRC32 over the record bytes
+    uint64_t lsn;            // Last log record covered by the snapshot
+    uint64_t term;           // Term of that record
+    uint64_t length;         // Record bytes after the header
+    uint64_t records;
+} wal_snapshot_header_t;
+
+struct wal_snapshot {
+    unsigned long lsn;
+    unsigned long term;
+    char* data;
+    size_t length;
+    size_t capacity;
+    unsigned long records;
+};
+
+// Log state. Appends go to an in-memory buffer under wal_mutex; the flush
+// thread swaps it out and writes and fsyncs it as one batch, so concurrent
+// writers share a single fdatasync (group commit). wal_io_mutex serializes
+// writes to the segment file with segment rotation and truncation.
+//
+// A segment named after lsn N supersedes records >= N in earlier segments, so
+// truncating the log only needs a new segment.
+static char wal_dir[MAX_PATH_LEN];
+static int segment_fd = -1;
+static unsigned long segment_start = 0;
+static unsigned long last_lsn = 0;
+static unsigned long durable_lsn = 0;
+static unsigned long snapshot_lsn = 0;
+static unsigned long snapshot_term = 0;
+static unsigned long records_since_snapshot = 0;
+static unsigned long appended_records = 0;
+static unsigned long sync_count = 0;
+static int snapshot_interval = WAL_DEFAULT_SNAPSHOT_INTERVAL;
+static int wal_failed = 0;
+static int wal_running = 0;
+static int checkpoint_running = 0;
+static char* pending_buffer = NULL;
+static size_t pending_length = 0;
+static size_t pending_capacity = 0;
+static char* flush_buffer = NULL;
+static size_t flush_capacity = 0;
+static wal_checkpoint_handler_t checkpoint_handler = NULL;
+static wal_durable_handler_t durable_handler = NULL;
+static pthread_t flush_tid;
+static pthread_mutex_t wal_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t wal_io_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t snapshot_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t flush_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t durable_cond = PTHREAD_COND_INITIALIZER;
+
+static uint32_t crc_table[256];
+static pthread_once_t crc_once = PTHREAD_ONCE_INIT;
+
+// Build the CRC32 (IEEE 802.3) lookup table
+static void init_crc_table(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320U : crc >> 1;
+        }
+        crc_table[i] = crc;
+    }
+}
+
+// Continue a CRC32 over another buffer
+static uint32_t crc32_update(uint32_t crc, const void* data, size_t length) {
+    const unsigned char* bytes = (const unsigned char*)data;
+
+    pthread_once(&crc_once, init_crc_table);
+
+    crc = ~crc;
+    for (size_t i = 0; i < length; i++) {
+        crc = crc_table[(crc ^ bytes[i]) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+// Checksum of a record header (crc field excluded) and its payload
+static uint32_t record_crc(const wal_record_header_t* header, const void* payload) {
+    uint32_t crc = crc32_update(0, &header->length, sizeof(header->length));
+    crc = crc32_update(crc, &header->type, sizeof(header->type));
+    crc = crc32_update(crc, &header->lsn, sizeof(header->lsn));
+    crc = crc32_update(crc, &header->term, sizeof(header->term));
+    return crc32_update(crc, payload, header->length);
+}
+
+// Append one encoded record to a growable buffer
+int wal_encode_entry(char** buffer, size_t* length, size_t* capacity, const wal_entry_t* entry) {
+    size_t data_length = entry->length;
+    size_t record_size = sizeof(wal_record_header_t) + WAL_ALIGN(data_length);
+
+    if (*length + record_size > *capacity) {
+        size_t new_capacity = *capacity ? *capacity : WAL_INITIAL_BUFFER;
+        while (*length + record_size > new_capacity) {
+            new_capacity *= 2;
+        }
+
+        char* new_buffer = realloc(*buffer, new_capacity);
+        if (!new_buffer) {
+            printf("Error: Out of memory for log buffer\n");
+            return -1;
+        }
+        *buffer = new_buffer;
+        *capacity = new_capacity;
+    }
+
+    wal_record_header_t header;
+    memset(&header, 0, sizeof(header));
+    header.length = (uint32_t)data_length;
+    header.type = (uint32_t)entry->type;
+    header.lsn = entry->lsn;
+    header.term = (uint32_t)entry->term;
+    header.crc = record_crc(&header, entry->data);
+
+    char* out = *buffer + *length;
+    memcpy(out, &header, sizeof(header));
+    if (data_length > 0) {
+        memcpy(out + sizeof(header), entry->data, data_length);
+    }
+    memset(out + sizeof(header) + data_length, 0, WAL_ALIGN(data_length) - data_length);
+
+    *length += record_size;
+    return 0;
+}
+
+// Decode the record at the start of data, returns its encoded size or 0 if
+// the record is torn or corrupt. The entry points into data.
+size_t wal_decode_entry(const char* data, size_t size, wal_entry_t* entry) {
+    wal_record_header_t header;
+
+    if (size < sizeof(header)) return 0;
+    memcpy(&header, data, sizeof(header));
+
+    size_t record_size = sizeof(header) + WAL_ALIGN((size_t)header.length);
+    if (header.length > size || record_size > size) return 0;
+
+    const char* payload = data + sizeof(header);
+    if (header.lsn == 0 || record_crc(&header, payload) != header.crc) return 0;
+
+    entry->lsn = header.lsn;
+    entry->term = header.term;
+    entry->type = (wal_record_type_t)header.type;
+    entry->data = payload;
+    entry->length = header.length;
+    return record_size;
+}
+
+// Replay valid records with min_lsn < lsn < max_lsn (0 for no upper bound)
+// from a mapped region. Stops at the first torn or corrupt record and returns
+// the number of bytes consumed.
+static size_t replay_records(const char* data, size_t size, unsigned long min_lsn,
+                             unsigned long max_lsn, wal_replay_handler_t replay,
+                             unsigned long* last, unsigned long* applied) {
+    size_t offset = 0;
+    wal_entry_t entry;
+
+    while (offset < size) {
+        size_t record_size = wal_decode_entry(data + offset, size - offset, &entry);
+        if (record_size == 0) break;
+
+        if (entry.lsn > min_lsn && (max_lsn == 0 || entry.lsn < max_lsn)) {
+            replay(&entry);
+            (*applied)++;
+            if (last && entry.lsn > *last) {
+                *last = entry.lsn;
+            }
+        }
+
+        offset += record_size;
+    }
+
+    return offset;
+}
+
+// Write a whole buffer, retrying on short writes
+static int write_all(int fd, const char* data, size_t length) {
+    while (length > 0) {
+        ssize_t written = write(fd, data, length);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        data += written;
+        length -= written;
+    }
+    return 0;
+}
+
+// Make directory entries (renames, new files) durable
+static void sync_directory(void) {
+    int fd = open(wal_dir, O_RDONLY | O_DIRECTORY);
+    if (fd >= 0) {
+        fsync(fd);
+        close(fd);
+    }
+}
+
+// Path of a file in the state directory
+static void state_path(char* buffer, size_t size, const char* name) {
+    snprintf(buffer, size, "%s/%s", wal_dir, name);
+}
+
+// Path of the segment whose first record is start
+static void segment_path(char* buffer, size_t size, unsigned long start) {
+    snprintf(buffer, size, "%s/" WAL_SEGMENT_PREFIX "%020lu" WAL_SEGMENT_SUFFIX, wal_dir, start);
+}
+
+// Create a fresh segment starting at lsn start
+static int open_segment(unsigned long start) {
+    char path[MAX_PATH_LEN];
+    segment_path(path, sizeof(path), start);
+
+    // A segment with this name holds no valid records, or start would be higher
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+    if (fd < 0) {
+        printf("Error: Cannot create log segment %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    sync_directory();
+    return fd;
+}
+
+// Order segment start numbers for qsort
+static int compare_lsn(const void* a, const void* b) {
+    unsigned long left = *(const unsigned long*)a;
+    unsigned long right = *(const unsigned long*)b;
+    return (left > right) - (left < right);
+}
+
+// Collect the start lsn of every segment in the state directory, sorted
+static int list_segments(unsigned long** starts) {
+    DIR* dir = opendir(wal_dir);
+    if (!dir) return -1;
+
+    int count = 0;
+    int capacity = 0;
+    struct dirent* entry;
+    *starts = NULL;
+
+    while ((entry = readdir(dir)) != NULL) {
+        unsigned long start;
+        char suffix[8];
+
+        if (sscanf(entry->d_name, WAL_SEGMENT_PREFIX "%lu%7s", &start, suffix) != 2 ||
+            strcmp(suffix, WAL_SEGMENT_SUFFIX) != 0) {
+            continue;
+        }
+
+        if (count == capacity) {
+            capacity = capacity ? capacity * 2 : 16;
+            unsigned long* grown = realloc(*starts, capacity * sizeof(unsigned long));
+            if (!grown) break;
+            *starts = grown;
+        }
+        (*starts)[count++] = start;
+    }
+
+    closedir(dir);
+    qsort(*starts, count, sizeof(unsigned long), compare_lsn);
+    return count;
+}
+
+// Map a file read-only, returns NULL for missing or empty files
+static const char* map_file(const char* path, size_t* size) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return NULL;
+    }
+
+    void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return NULL;
+
+    madvise(data, st.st_size, MADV_SEQUENTIAL);
+    *size = st.st_size;
+    return (const char*)data;
+}
+
+// Check a snapshot image and return its header
+static int validate_snapshot(const char* data, size_t size, wal_snapshot_header_t* header) {
+    if (size < sizeof(*header)) return -1;
+    memcpy(header, data, sizeof(*header));
+
+    if (memcmp(header->magic, WAL_SNAPSHOT_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != WAL_SNAPSHOT_VERSION ||
+        header->length != size - sizeof(*header) ||
+        crc32_update(0, data + sizeof(*header), header->length) != header->crc) {
+        return -1;
+    }
+    return 0;
+}
+
+// Replay a validated snapshot image
+static int replay_snapshot(const char* data, const wal_snapshot_header_t* header,
+                           wal_replay_handler_t restore, unsigned long* applied) {
+    size_t used = replay_records(data + sizeof(*header), header->length, 0, 0,
+                                 restore, NULL, applied);
+    return (used == header->length) ? 0 : -1;
+}
+
+// Load the snapshot, returns 0 if none exists and -1 if it is corrupt
+static int load_snapshot(wal_replay_handler_t restore, unsigned long* applied) {
+    char path[MAX_PATH_LEN];
+    size_t size = 0;
+
+    state_path(path, sizeof(path), WAL_SNAPSHOT_FILE);
+    const char* data = map_file(path, &size);
+    if (!data) return 0;
+
+    wal_snapshot_header_t header;
+    int result = -1;
+
+    if (validate_snapshot(data, size, &header) == 0 &&
+        replay_snapshot(data, &header, restore, applied) == 0) {
+        snapshot_lsn = header.lsn;
+        snapshot_term = header.term;
+        result = 0;
+    }
+
+    if (result != 0) {
+        printf("Error: Snapshot %s is corrupt, move it aside to start without it\n", path);
+    }
+
+    munmap((void*)data, size);
+    return result;
+}
+
+// Delete segments that only hold records up to lsn
+static void drop_covered_segments(unsigned long lsn) {
+    unsigned long* starts = NULL;
+    int count = list_segments(&starts);
+
+    for (int i = 0; i + 1 < count; i++) {
+        if (starts[i + 1] <= lsn + 1) {
+            char segment[MAX_PATH_LEN];
+            segment_path(segment, sizeof(segment), starts[i]);
+            unlink(segment);
+        }
+    }
+    free(starts);
+}
+
+// Delete segments whose first record is at or after lsn
+static void drop_segments_from(unsigned long lsn) {
+    unsigned long* starts = NULL;
+    int count = list_segments(&starts);
+
+    for (int i = 0; i < count; i++) {
+        if (starts[i] >= lsn) {
+            char segment[MAX_PATH_LEN];
+            segment_path(segment, sizeof(segment), starts[i]);
+            unlink(segment);
+        }
+    }
+    free(starts);
+}
+
+// Start a detached thread that writes a snapshot
+static void* checkpoint_thread(void* arg) {
+    (void)arg;
+
+    checkpoint_handler();
+
+    pthread_mutex_lock(&wal_mutex);
+    checkpoint_running = 0;
+    pthread_mutex_unlock(&wal_mutex);
+    return NULL;
+}
+
+// Write the pending buffer to the current segment and fsync it
+static void flush_pending(void) {
+    pthread_mutex_lock(&wal_io_mutex);
+    pthread_mutex_lock(&wal_mutex);
+
+    char* data = pending_buffer;
+    size_t length = pending_length;
+    size_t capacity = pending_capacity;
+    unsigned long target = last_lsn;
+    int fd = segment_fd;
+
+    pending_buffer = flush_buffer;
+    pending_capacity = flush_capacity;
+    pending_length = 0;
+    flush_buffer = data;
+    flush_capacity = capacity;
+
+    pthread_mutex_unlock(&wal_mutex);
+
+    int result = 0;
+    if (length > 0) {
+        result = write_all(fd, data, length);
+        if (result == 0) {
+            result = fdatasync(fd);
+        }
+    }
+
+    pthread_mutex_lock(&wal_mutex);
+    if (result == 0) {
+        durable_lsn = target;
+        if (length > 0) sync_count++;
+    } else {
+        printf("Error: Failed to write log segment: %s\n", strerror(errno));
+        wal_failed = 1;
+    }
+    wal_durable_handler_t handler = durable_handler;
+    pthread_cond_broadcast(&durable_cond);
+    pthread_mutex_unlock(&wal_mutex);
+
+    pthread_mutex_unlock(&wal_io_mutex);
+
+    if (result == 0 && length > 0 && handler) {
+        handler(target);
+    }
+}
+
+// Group commit loop
+static void* wal_flush_thread(void* arg) {
+    (void)arg;
+
+    pthread_mutex_lock(&wal_mutex);
+    while (1) {
+        while (wal_running && pending_length == 0) {
+            pthread_cond_wait(&flush_cond, &wal_mutex);
+        }
+        if (!wal_running && pending_length == 0) break;
+
+        pthread_mutex_unlock(&wal_mutex);
+        flush_pending();
+        pthread_mutex_lock(&wal_mutex);
+
+        if (checkpoint_handler && !checkpoint_running && !wal_failed &&
+            records_since_snapshot >= (unsigned long)snapshot_interval) {
+            pthread_t tid;
+            checkpoint_running = 1;
+            if (pthread_create(&tid, NULL, checkpoint_thread, NULL) == 0) {
+                pthread_detach(tid);
+            } else {
+                checkpoint_running = 0;
+            }
+        }
+    }
+    pthread_mutex_unlock(&wal_mutex);
+    return NULL;
+}
+
+// Recover state from the snapshot and log in dir, then open a new segment for
+// appends. Snapshot records go to restore and log records after the snapshot
+// to replay. Nothing is logged during recovery because appends are refused
+// until it completes.
+int wal_open(const char* dir, int interval, wal_replay_handler_t restore,
+             wal_replay_handler_t replay, wal_checkpoint_handler_t checkpoint) {
+    if (!dir || !restore || !replay) return -1;
+
+    struct timespec started, finished;
+    clock_gettime(CLOCK_MONOTONIC, &started);
+
+    strncpy(wal_dir, dir, MAX_PATH_LEN - 1);
+    if (mkdir(wal_dir, 0755) != 0 && errno != EEXIST) {
+        printf("Error: Cannot create state directory %s: %s\n", wal_dir, strerror(errno));
+        return -1;
+    }
+
+    unsigned long snapshot_records = 0;
+    if (load_snapshot(restore, &snapshot_records) != 0) {
+        return -1;
+    }
+
+    unsigned long* starts = NULL;
+    int segment_count = list_segments(&starts);
+    if (segment_count < 0) {
+        printf("Error: Cannot read state directory %s: %s\n", wal_dir, strerror(errno));
+        return -1;
+    }
+
+    unsigned long log_records = 0;
+    last_lsn = snapshot_lsn;
+
+    for (int i = 0; i < segment_count; i++) {
+        char path[MAX_PATH_LEN];
+        segment_path(path, sizeof(path), starts[i]);
+
+        // Segments wholly covered by the snapshot are left over from a crash
+        if (i + 1 < segment_count && starts[i + 1] <= snapshot_lsn + 1) {
+            unlink(path);
+            continue;
+        }
+
+        // A later segment starting here replaces anything logged after it
+        if (starts[i] > 0 && starts[i] - 1 < last_lsn) {
+            last_lsn = starts[i] - 1 < snapshot_lsn ? snapshot_lsn : starts[i] - 1;
+        }
+
+        size_t size = 0;
+        const char* data = map_file(path, &size);
+        if (!data) continue;
+
+        unsigned long bound = (i + 1 < segment_count) ? starts[i + 1] : 0;
+        size_t used = replay_records(data, size, snapshot_lsn, bound, replay,
+                                     &last_lsn, &log_records);
+        if (used < size) {
+            printf("Warning: Ignoring %zu bytes of torn log tail in %s\n", size - used, path);
+        }
+        munmap((void*)data, size);
+    }
+    free(starts);
+
+    segment_fd = open_segment(last_lsn + 1);
+    if (segment_fd < 0) return -1;
+
+    segment_start = last_lsn + 1;
+    durable_lsn = last_lsn;
+    records_since_snapshot = log_records;
+    snapshot_interval = interval > 0 ? interval : WAL_DEFAULT_SNAPSHOT_INTERVAL;
+    checkpoint_handler = checkpoint;
+    wal_failed = 0;
+    wal_running = 1;
+
+    if (pthread_create(&flush_tid, NULL, wal_flush_thread, NULL) != 0) {
+        printf("Error: Failed to start log flush thread\n");
+        close(segment_fd);
+        segment_fd = -1;
+        wal_running = 0;
+        return -1;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &finished);
+    double elapsed_ms = (finished.tv_sec - started.tv_sec) * 1000.0 +
+                        (finished.tv_nsec - started.tv_nsec) / 1e6;
+
+    printf("Recovered state from %s: %lu snapshot records, %lu log records in %.1f ms\n",
+           wal_dir, snapshot_records, log_records, elapsed_ms);
+    return 0;
+}
+
+// Flush outstanding records and stop the flush thread
+void wal_close(void) {
+    pthread_mutex_lock(&wal_mutex);
+    if (!wal_running) {
+        pthread_mutex_unlock(&wal_mutex);
+        return;
+    }
+    wal_running = 0;
+    pthread_cond_signal(&flush_cond);
+    pthread_mutex_unlock(&wal_mutex);
+
+    pthread_join(flush_tid, NULL);
+
+    pthread_mutex_lock(&wal_io_mutex);
+    pthread_mutex_lock(&wal_mutex);
+    if (segment_fd >= 0) {
+        close(segment_fd);
+        segment_fd = -1;
+    }
+    pthread_mutex_unlock(&wal_mutex);
+    pthread_mutex_unlock(&wal_io_mutex);
+}
+
+// Register the callback told about group commits
+void wal_set_durable_handler(wal_durable_handler_t handler) {
+    pthread_mutex_lock(&wal_mutex);
+    durable_handler = handler;
+    pthread_mutex_unlock(&wal_mutex);
+}
+
+// Check whether mutations are being logged
+int wal_enabled(void) {
+    pthread_mutex_lock(&wal_mutex);
+    int enabled = wal_running;
+    pthread_mutex_unlock(&wal_mutex);
+    return enabled;
+}
+
+// Encode a record into the pending batch (caller holds wal_mutex)
+static int append_locked(const wal_entry_t* entry) {
+    if (wal_encode_entry(&pending_buffer, &pending_length, &pending_capacity, entry) != 0) {
+        wal_failed = 1;
+        pthread_cond_broadcast(&durable_cond);
+        return -1;
+    }
+
+    last_lsn = entry->lsn;
+    records_since_snapshot++;
+    appended_records++;
+    pthread_cond_signal(&flush_cond);
+    return 0;
+}
+
+// Queue a record for the next group commit, returns its lsn or 0 when the
+// log is disabled or broken
+unsigned long wal_append(wal_record_type_t type, const void* data, size_t length) {
+    if (!data) return 0;
+
+    pthread_mutex_lock(&wal_mutex);
+
+    if (!wal_running || wal_failed) {
+        pthread_mutex_unlock(&wal_mutex);
+        return 0;
+    }
+
+    wal_entry_t entry = { last_lsn + 1, 0, type, data, length };
+    unsigned long lsn = (append_locked(&entry) == 0) ? entry.lsn : 0;
+
+    pthread_mutex_unlock(&wal_mutex);
+    return lsn;
+}
+
+// Queue a record with a caller assigned lsn and term; the lsn must directly
+// follow the last one
+int wal_append_entry(const wal_entry_t* entry) {
+    if (!entry) return -1;
+
+    pthread_mutex_lock(&wal_mutex);
+
+    if (!wal_running || wal_failed || entry->lsn != last_lsn + 1) {
+        pthread_mutex_unlock(&wal_mutex);
+        return -1;
+    }
+
+    int result = append_locked(entry);
+
+    pthread_mutex_unlock(&wal_mutex);
+    return result;
+}
+
+// Discard records from lsn on by starting a new segment at lsn
+int wal_truncate(unsigned long lsn) {
+    pthread_mutex_lock(&wal_io_mutex);
+    pthread_mutex_lock(&wal_mutex);
+
+    if (!wal_running || wal_failed || lsn <= snapshot_lsn) {
+        pthread_mutex_unlock(&wal_mutex);
+        pthread_mutex_unlock(&wal_io_mutex);
+        return -1;
+    }
+
+    if (lsn > last_lsn) {
+        pthread_mutex_unlock(&wal_mutex);
+        pthread_mutex_unlock(&wal_io_mutex);
+        return 0;
+    }
+
+    char* data = pending_buffer;
+    size_t length = pending_length;
+    size_t capacity = pending_capacity;
+    int old_fd = segment_fd;
+
+    pending_buffer = flush_buffer;
+    pending_capacity = flush_capacity;
+    pending_length = 0;
+    flush_buffer = data;
+    flush_capacity = capacity;
+
+    pthread_mutex_unlock(&wal_mutex);
+
+    // Earlier records in the batch still count, the rest is superseded
+    int result = (length > 0) ? write_all(old_fd, data, length) : 0;
+    if (result == 0) {
+        result = fdatasync(old_fd);
+    }
+    close(old_fd);
+
+    drop_segments_from(lsn);
+    int new_fd = (result == 0) ? open_segment(lsn) : -1;
+
+    pthread_mutex_lock(&wal_mutex);
+    segment_fd = new_fd;
+    if (new_fd >= 0) {
+        segment_start = lsn;
+        last_lsn = lsn - 1;
+        durable_lsn = lsn - 1;
+    } else {
+        printf("Error: Failed to truncate log at lsn %lu\n", lsn);
+        wal_failed = 1;
+    }
+    pthread_cond_broadcast(&durable_cond);
+    pthread_mutex_unlock(&wal_mutex);
+
+    pthread_mutex_unlock(&wal_io_mutex);
+    return (new_fd >= 0) ? 0 : -1;
+}
+
+// Highest lsn handed out so far
+unsigned long wal_last_lsn(void) {
+    pthread_mutex_lock(&wal_mutex);
+    unsigned long lsn = last_lsn;
+    pthread_mutex_unlock(&wal_mutex);
+    return lsn;
+}
+
+// Wait until every record up to lsn is on disk, returns -1 if the log failed
+int wal_sync(unsigned long lsn) {
+    pthread_mutex_lock(&wal_mutex);
+
+    while (!wal_failed && durable_lsn < lsn) {
+        pthread_cond_wait(&durable_cond, &wal_mutex);
+    }
+    int result = wal_failed ? -1 : 0;
+
+    pthread_mutex_unlock(&wal_mutex);
+    return result;
+}
+
+// Report the lsn and term the current snapshot covers
+void wal_snapshot_position(unsigned long* lsn, unsigned long* term) {
+    pthread_mutex_lock(&wal_mutex);
+    if (lsn) *lsn = snapshot_lsn;
+    if (term) *term = snapshot_term;
+    pthread_mutex_unlock(&wal_mutex);
+}
+
+// Start a snapshot of state that reflects every record up to lsn. Pending
+// records are flushed and later ones go to a new segment. The caller must
+// block mutations until all state has been added, then commit.
+wal_snapshot_t* wal_snapshot_begin(unsigned long lsn, unsigned long term) {
+    pthread_mutex_lock(&snapshot_mutex);
+    pthread_mutex_lock(&wal_io_mutex);
+    pthread_mutex_lock(&wal_mutex);
+
+    if (!wal_running || wal_failed) {
+        pthread_mutex_unlock(&wal_mutex);
+        pthread_mutex_unlock(&wal_io_mutex);
+        pthread_mutex_unlock(&snapshot_mutex);
+        return NULL;
+    }
+
+    char* data = pending_buffer;
+    size_t length = pending_length;
+    size_t capacity = pending_capacity;
+    unsigned long cut = last_lsn;
+    int old_fd = segment_fd;
+
+    pending_buffer = flush_buffer;
+    pending_capacity = flush_capacity;
+    pending_length = 0;
+    flush_buffer = data;
+    flush_capacity = capacity;
+    records_since_snapshot = 0;
+
+    pthread_mutex_unlock(&wal_mutex);
+
+    int result = 0;
+    if (length > 0) {
+        result = write_all(old_fd, data, length);
+    }
+    if (result == 0) {
+        result = fdatasync(old_fd);
+    }
+    close(old_fd);
+
+    int new_fd = (result == 0) ? open_segment(cut + 1) : -1;
+
+    pthread_mutex_lock(&wal_mutex);
+    segment_fd = new_fd;
+    if (new_fd >= 0) {
+        segment_start = cut + 1;
+        durable_lsn = cut;
+        if (length > 0) sync_count++;
+    } else {
+        printf("Error: Failed to rotate log segment\n");
+        wal_failed = 1;
+    }
+    pthread_cond_broadcast(&durable_cond);
+    pthread_mutex_unlock(&wal_mutex);
+
+    pthread_mutex_unlock(&wal_io_mutex);
+
+    wal_snapshot_t* snapshot = (new_fd >= 0) ? calloc(1, sizeof(wal_snapshot_t)) : NULL;
+    if (!snapshot) {
+        pthread_mutex_unlock(&snapshot_mutex);
+        return NULL;
+    }
+
+    snapshot->lsn = (lsn < cut) ? lsn : cut;
+    snapshot->term = term;
+    return snapshot;
+}
+
+// Add one record of state to a snapshot
+int wal_snapshot_add(wal_snapshot_t* snapshot, wal_record_type_t type,
+                     const void* data, size_t length) {
+    if (!snapshot || !data) return -1;
+
+    wal_entry_t entry = { snapshot->lsn ? snapshot->lsn : 1, snapshot->term, type, data, length };
+    if (wal_encode_entry(&snapshot->data, &snapshot->length, &snapshot->capacity, &entry) != 0) {
+        return -1;
+    }
+
+    snapshot->records++;
+    return 0;
+}
+
+// Write the snapshot atomically and drop the log segments it covers
+int wal_snapshot_commit(wal_snapshot_t* snapshot) {
+    if (!snapshot) return -1;
+
+    char temp_path[MAX_PATH_LEN];
+    char path[MAX_PATH_LEN];
+    state_path(temp_path, sizeof(temp_path), WAL_SNAPSHOT_TEMP);
+    state_path(path, sizeof(path), WAL_SNAPSHOT_FILE);
+
+    wal_snapshot_header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, WAL_SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = WAL_SNAPSHOT_VERSION;
+    header.crc = crc32_update(0, snapshot->data, snapshot->length);
+    header.lsn = snapshot->lsn;
+    header.term = snapshot->term;
+    header.length = snapshot->length;
+    header.records = snapshot->records;
+
+    int result = -1;
+    int fd = open(temp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd >= 0) {
+        if (write_all(fd, (const char*)&header, sizeof(header)) == 0 &&
+            write_all(fd, snapshot->data, snapshot->length) == 0 &&
+            fsync(fd) == 0) {
+            result = 0;
+        }
+        close(fd);
+    }
+
+    if (result == 0 && rename(temp_path, path) != 0) {
+        result = -1;
+    }
+
+    if (result != 0) {
+        printf("Error: Failed to write snapshot %s: %s\n", path, strerror(errno));
+        unlink(temp_path);
+    } else {
+        sync_directory();
+        drop_covered_segments(snapshot->lsn);
+
+        pthread_mutex_lock(&wal_mutex);
+        snapshot_lsn = snapshot->lsn;
+        snapshot_term = snapshot->term;
+        pthread_mutex_unlock(&wal_mutex);
+
+        printf("Snapshot written at lsn %lu (%lu records)\n", snapshot->lsn, snapshot->records);
+    }
+
+    free(snapshot->data);
+    free(snapshot);
+    pthread_mutex_unlock(&snapshot_mutex);
+    return result;
+}
+
+// Replay the current snapshot again, used to rebuild state from scratch
+int wal_restore_snapshot(wal_replay_handler_t restore) {
+    unsigned long applied = 0;
+
+    pthread_mutex_lock(&snapshot_mutex);
+    int result = load_snapshot(restore, &applied);
+    pthread_mutex_unlock(&snapshot_mutex);
+
+    return result;
+}
+
+// Read the current snapshot file into a malloc'd buffer
+int wal_read_snapshot(char** data, size_t* length) {
+    char path[MAX_PATH_LEN];
+    size_t size = 0;
+
+    pthread_mutex_lock(&snapshot_mutex);
+
+    state_path(path, sizeof(path), WAL_SNAPSHOT_FILE);
+    const char* mapped = map_file(path, &size);
+    if (!mapped) {
+        pthread_mutex_unlock(&snapshot_mutex);
+        return -1;
+    }
+
+    *data = malloc(size);
+    if (*data) {
+        memcpy(*data, mapped, size);
+        *length = size;
+    }
+    munmap((void*)mapped, size);
+
+    pthread_mutex_unlock(&snapshot_mutex);
+    return *data ? 0 : -1;
+}
+
+// Replace the whole log with a snapshot received from elsewhere and replay it
+int wal_install_snapshot(const char* data, size_t length, wal_replay_handler_t restore) {
+    wal_snapshot_header_t header;
+    char temp_path[MAX_PATH_LEN];
+    char path[MAX_PATH_LEN];
+
+    if (!data || validate_snapshot(data, length, &header) != 0) {
+        printf("Error: Received snapshot is corrupt\n");
+        return -1;
+    }
+
+    state_path(temp_path, sizeof(temp_path), WAL_SNAPSHOT_TEMP);
+    state_path(path, sizeof(path), WAL_SNAPSHOT_FILE);
+
+    pthread_mutex_lock(&snapshot_mutex);
+    pthread_mutex_lock(&wal_io_mutex);
+    pthread_mutex_lock(&wal_mutex);
+
+    if (!wal_running || wal_failed) {
+        pthread_mutex_unlock(&wal_mutex);
+        pthread_mutex_unlock(&wal_io_mutex);
+        pthread_mutex_unlock(&snapshot_mutex);
+        return -1;
+    }
+
+    // Unwritten records are replaced by the snapshot
+    pending_length = 0;
+    int old_fd = segment_fd;
+    segment_fd = -1;
+
+    pthread_mutex_unlock(&wal_mutex);
+
+    close(old_fd);
+
+    int result = -1;
+    int fd = open(temp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd >= 0) {
+        if (write_all(fd, data, length) == 0 && fsync(fd) == 0 &&
+            rename(temp_path, path) == 0) {
+            result = 0;
+        }
+        close(fd);
+    }
+
+    int new_fd = -1;
+    if (result == 0) {
+        sync_directory();
+        drop_segments_from(0);
+        new_fd = open_segment(header.lsn + 1);
+    }
+
+    pthread_mutex_lock(&wal_mutex);
+    segment_fd = new_fd;
+    if (new_fd >= 0) {
+        segment_start = header.lsn + 1;
+        last_lsn = header.lsn;
+        durable_lsn = header.lsn;
+        snapshot_lsn = header.lsn;
+        snapshot_term = header.term;
+        records_since_snapshot = 0;
+    } else {
+        printf("Error: Failed to install snapshot: %s\n", strerror(errno));
+        wal_failed = 1;
+    }
+    pthread_cond_broadcast(&durable_cond);
+    pthread_mutex_unlock(&wal_mutex);
+
+    pthread_mutex_unlock(&wal_io_mutex);
+
+    unsigned long applied = 0;
+    if (new_fd >= 0) {
+        result = replay_snapshot(data, &header, restore, &applied);
+    }
+
+    pthread_mutex_unlock(&snapshot_mutex);
+
+    if (new_fd >= 0) {
+        printf("Installed snapshot at lsn %lu (%lu records)\n", header.lsn, applied);
+    }
+    return (new_fd >= 0) ? result : -1;
+}
+
+// Print log status
+void show_wal(void) {
+    pthread_mutex_lock(&wal_mutex);
+
+    printf("\n=== State Log ===\n");
+    if (!wal_running) {
+        printf("Disabled (set state_dir in coordinator.conf)\n");
+        pthread_mutex_unlock(&wal_mutex);
+        return;
+    }
+
+    printf("Directory: %s  Segment: %lu  %s\n", wal_dir, segment_start,
+           wal_failed ? "FAILED" : "OK");
+    printf("Last lsn: %lu  Durable lsn: %lu  Snapshot lsn: %lu\n",
+           last_lsn, durable_lsn, snapshot_lsn);
+    printf("Records since snapshot: %lu/%d  Appended: %lu  Syncs: %lu\n",
+           records_since_snapshot, snapshot_interval, appended_records, sync_count);
+
+    pthread_mutex_unlock(&wal_mutex);
+}
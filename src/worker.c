@@ -1,17 +1,74 @@
 #include "../include/distributed_lxc.h"
 #include "../include/yaml_parser.h"
 #include "../include/lxc_manager.h"
+#include "../include/config.h"
+#include "../include/inventory.h"
+#include "../include/metrics.h"
+#include "../include/migration.h"
+#include "../include/executor.h"
 #include <sys/utsname.h>
 
+#define MAX_COORDINATORS 8
+
 // Worker node state
 static char node_id[MAX_NAME_LEN];
 static char coordinator_ip[INET_ADDRSTRLEN];
 static int coordinator_port;
 static int coordinator_socket = -1;
+static char coordinator_ips[MAX_COORDINATORS][INET_ADDRSTRLEN];   // Addresses to fall back on
+static int coordinator_ports[MAX_COORDINATORS];
+static int coordinator_total = 0;
+static char node_labels[MAX_NAME_LEN] = "";
 static container_t local_containers[MAX_CONTAINERS];
 static int local_container_count = 0;
+static inventory_tree_t local_inventory;    // Hash tree over local_containers
 static pthread_mutex_t local_containers_mutex = PTHREAD_MUTEX_INITIALIZER;
 static volatile int running = 1;
+static volatile time_t last_heartbeat_sent = 0;
+static pthread_mutex_t send_mutex = PTHREAD_MUTEX_INITIALIZER;   // One message on the socket at a time
+
+// Metrics for commands run against the container runtime
+enum { COMMAND_DEPLOY, COMMAND_START, COMMAND_STOP, COMMAND_DELETE, COMMAND_KINDS };
+static const char* command_labels[COMMAND_KINDS] = { "deploy", "start", "stop", "delete" };
+static int command_duration[COMMAND_KINDS];
+static int command_failures[COMMAND_KINDS];
+static int local_containers_lock_wait = -1;
+
+// Take local_containers_mutex, recording how long it took
+static void lock_local_containers(void) {
+    metrics_lock(&local_containers_mutex, local_containers_lock_wait);
+}
+
+// Register the worker's metrics before any thread records into them
+static void register_worker_metrics(void) {
+    char labels[64];
+    
+    for (int i = 0; i < COMMAND_KINDS; i++) {
+        snprintf(labels, sizeof(labels), "command=\"%s\"", command_labels[i]);
+        command_duration[i] = metrics_histogram("lxc_worker_command_duration_seconds", labels,
+                                                "Time spent handling a container command");
+        command_failures[i] = metrics_counter("lxc_worker_command_failures_total", labels,
+                                              "Container commands that failed");
+    }
+    local_containers_lock_wait = metrics_lock_histogram("local_containers");
+}
+
+// Record one handled command
+static void record_command(int command, const struct timespec* started, int result) {
+    metrics_observe(command_duration[command], metrics_elapsed(started));
+    if (result != 0) {
+        metrics_add(command_failures[command], 1);
+    }
+}
+
+// Send a message to the coordinator; executor, heartbeat and migration
+// threads all reply on the same socket
+static int send_to_coordinator(const message_t* msg) {
+    pthread_mutex_lock(&send_mutex);
+    int result = send_message(coordinator_socket, msg);
+    pthread_mutex_unlock(&send_mutex);
+    return result;
+}
 
 // Generate unique node ID
 void generate_node_id(char* buffer, size_t buffer_size) {
@@ -24,28 +81,120 @@ void generate_node_id(char* buffer, size_t buffer_size) {
     }
 }
 
+// Change a local container's state and its inventory hash (caller holds
+// local_containers_mutex)
+static void set_local_state_locked(container_t* container, container_state_t state) {
+    inventory_remove(&local_inventory, container->name, container->state);
+    container->state = state;
+    inventory_add(&local_inventory, container->name, container->state);
+}
+
+// Compare local containers with what the runtime reports and send the
+// coordinator a status update for each one that changed behind our back
+static void report_observed_states(void) {
+    static char names[MAX_CONTAINERS][MAX_NAME_LEN];
+    static container_state_t states[MAX_CONTAINERS];
+    
+    int count = lxc_list_container_states(names, states, MAX_CONTAINERS);
+    if (count < 0) return;
+    
+    lock_local_containers();
+    
+    for (int i = 0; i < local_container_count; i++) {
+        container_t* container = &local_containers[i];
+        
+        // Containers mid-command are reported when the command finishes
+        if (container->state == CONTAINER_STARTING || container->state == CONTAINER_STOPPING) {
+            continue;
+        }
+        
+        container_state_t observed = CONTAINER_ERROR;   // Gone from the runtime
+        for (int j = 0; j < count; j++) {
+            if (strcmp(names[j], container->name) == 0) {
+                observed = states[j];
+                break;
+            }
+        }
+        
+        if (observed != container->state) {
+            printf("Container %s changed state outside a command, reporting it\n", container->name);
+            set_local_state_locked(container, observed);
+            
+            message_t msg;
+            create_message(&msg, MSG_CONTAINER_STATUS, node_id, "coordinator",
+                          container, sizeof(container_t));
+            send_to_coordinator(&msg);
+        }
+    }
+    
+    pthread_mutex_unlock(&local_containers_mutex);
+}
+
 // Send heartbeat to coordinator
 void* heartbeat_thread(void* arg) {
-    while (running && coordinator_socket >= 0) {
+    while (running) {
         message_t msg;
         resource_info_t resources;
         
-        // Get current system resources
-        if (get_system_resources(&resources) == 0) {
+        // Get current system resources; skipped while reconnecting
+        if (coordinator_socket >= 0 && get_system_resources(&resources) == 0) {
             create_message(&msg, MSG_NODE_HEARTBEAT, node_id, "coordinator", 
                           &resources, sizeof(resource_info_t));
             
-            if (send_message(coordinator_socket, &msg) != 0) {
+            if (send_to_coordinator(&msg) != 0) {
                 printf("Warning: Failed to send heartbeat\n");
+            } else {
+                last_heartbeat_sent = time(NULL);
             }
+            
+            report_observed_states();
         }
         
-        sleep(10); // Send heartbeat every 10 seconds
+        sleep(config_current()->heartbeat_interval);
     }
     
     return NULL;
 }
 
+// Find a local container by name (caller holds local_containers_mutex).
+// Entries move when another container is deleted, so the pointer is only
+// good until the mutex is released.
+static container_t* find_local_container_locked(const char* name) {
+    for (int i = 0; i < local_container_count; i++) {
+        if (strcmp(local_containers[i].name, name) == 0) {
+            return &local_containers[i];
+        }
+    }
+    return NULL;
+}
+
+// Add a container the runtime now holds to the local list
+static int add_local_container(const lxc_config_t* config, container_state_t state) {
+    lock_local_containers();
+    
+    if (local_container_count >= MAX_CONTAINERS) {
+        pthread_mutex_unlock(&local_containers_mutex);
+        printf("Error: Maximum container limit reached\n");
+        return -1;
+    }
+    
+    container_t* container = &local_containers[local_container_count];
+    
+    snprintf(container->id, sizeof(container->id), "%s_%s", 
+            node_id, config->name);
+    strcpy(container->name, config->name);
+    strcpy(container->node_id, node_id);
+    container->state = state;
+    container->config = *config;
+    container->created_at = time(NULL);
+    container->started_at = (state == CONTAINER_RUNNING) ? container->created_at : 0;
+    inventory_add(&local_inventory, container->name, container->state);
+    
+    local_container_count++;
+    pthread_mutex_unlock(&local_containers_mutex);
+    return 0;
+}
+
 // Handle container deployment
 int handle_deploy_container(const lxc_config_t* config) {
     if (!config) return -1;
@@ -58,29 +207,11 @@ int handle_deploy_container(const lxc_config_t* config) {
         return -1;
     }
     
-    // Add to local container list
-    pthread_mutex_lock(&local_containers_mutex);
-    
-    if (local_container_count < MAX_CONTAINERS) {
-        container_t* container = &local_containers[local_container_count];
-        
-        snprintf(container->id, sizeof(container->id), "%s_%s", 
-                node_id, config->name);
-        strcpy(container->name, config->name);
-        strcpy(container->node_id, node_id);
-        container->state = CONTAINER_STOPPED;
-        container->config = *config;
-        container->created_at = time(NULL);
-        
-        local_container_count++;
-        printf("Container %s deployed successfully\n", config->name);
-    } else {
-        pthread_mutex_unlock(&local_containers_mutex);
-        printf("Error: Maximum container limit reached\n");
+    if (add_local_container(config, CONTAINER_STOPPED) != 0) {
         return -1;
     }
     
-    pthread_mutex_unlock(&local_containers_mutex);
+    printf("Container %s deployed successfully\n", config->name);
     return 0;
 }
 
@@ -91,43 +222,47 @@ int handle_start_container(const char* container_name) {
     printf("Starting container: %s\n", container_name);
     
     // Find container in local list
-    pthread_mutex_lock(&local_containers_mutex);
-    
-    container_t* container = NULL;
-    for (int i = 0; i < local_container_count; i++) {
-        if (strcmp(local_containers[i].name, container_name) == 0) {
-            container = &local_containers[i];
-            break;
-        }
-    }
+    lock_local_containers();
     
+    container_t* container = find_local_container_locked(container_name);
     if (!container) {
         pthread_mutex_unlock(&local_containers_mutex);
         printf("Error: Container %s not found locally\n", container_name);
         return -1;
     }
     
-    container->state = CONTAINER_STARTING;
+    set_local_state_locked(container, CONTAINER_STARTING);
     pthread_mutex_unlock(&local_containers_mutex);
     
-    // Start the container
-    if (lxc_start_container(container_name) == 0) {
-        pthread_mutex_lock(&local_containers_mutex);
-        container->state = CONTAINER_RUNNING;
-        container->started_at = time(NULL);
+    // Start the container; one that is already running counts, so repeated
+    // commands from the reconciler converge
+    int started = lxc_start_container(container_name) == 0 ||
+                  lxc_get_container_state(container_name) == CONTAINER_RUNNING;
+    
+    // Commands for other containers may have moved the entry meanwhile
+    lock_local_containers();
+    container = find_local_container_locked(container_name);
+    if (!container) {
         pthread_mutex_unlock(&local_containers_mutex);
+        printf("Error: Container %s was removed while starting\n", container_name);
+        return -1;
+    }
+    
+    if (started) {
+        set_local_state_locked(container, CONTAINER_RUNNING);
+        container->started_at = time(NULL);
         
         // Notify coordinator of status change
         message_t msg;
         create_message(&msg, MSG_CONTAINER_STATUS, node_id, "coordinator", 
                       container, sizeof(container_t));
-        send_message(coordinator_socket, &msg);
+        pthread_mutex_unlock(&local_containers_mutex);
+        send_to_coordinator(&msg);
         
         printf("Container %s started successfully\n", container_name);
         return 0;
     } else {
-        pthread_mutex_lock(&local_containers_mutex);
-        container->state = CONTAINER_ERROR;
+        set_local_state_locked(container, CONTAINER_ERROR);
         pthread_mutex_unlock(&local_containers_mutex);
         
         printf("Error: Failed to start container %s\n", container_name);
@@ -142,42 +277,45 @@ int handle_stop_container(const char* container_name) {
     printf("Stopping container: %s\n", container_name);
     
     // Find container in local list
-    pthread_mutex_lock(&local_containers_mutex);
-    
-    container_t* container = NULL;
-    for (int i = 0; i < local_container_count; i++) {
-        if (strcmp(local_containers[i].name, container_name) == 0) {
-            container = &local_containers[i];
-            break;
-        }
-    }
+    lock_local_containers();
     
+    container_t* container = find_local_container_locked(container_name);
     if (!container) {
         pthread_mutex_unlock(&local_containers_mutex);
         printf("Error: Container %s not found locally\n", container_name);
         return -1;
     }
     
-    container->state = CONTAINER_STOPPING;
+    set_local_state_locked(container, CONTAINER_STOPPING);
     pthread_mutex_unlock(&local_containers_mutex);
     
-    // Stop the container
-    if (lxc_stop_container(container_name) == 0) {
-        pthread_mutex_lock(&local_containers_mutex);
-        container->state = CONTAINER_STOPPED;
+    // Stop the container, treating an already stopped one as success
+    int stopped = lxc_stop_container(container_name) == 0 ||
+                  lxc_get_container_state(container_name) == CONTAINER_STOPPED;
+    
+    // Commands for other containers may have moved the entry meanwhile
+    lock_local_containers();
+    container = find_local_container_locked(container_name);
+    if (!container) {
         pthread_mutex_unlock(&local_containers_mutex);
+        printf("Error: Container %s was removed while stopping\n", container_name);
+        return -1;
+    }
+    
+    if (stopped) {
+        set_local_state_locked(container, CONTAINER_STOPPED);
         
         // Notify coordinator of status change
         message_t msg;
         create_message(&msg, MSG_CONTAINER_STATUS, node_id, "coordinator", 
                       container, sizeof(container_t));
-        send_message(coordinator_socket, &msg);
+        pthread_mutex_unlock(&local_containers_mutex);
+        send_to_coordinator(&msg);
         
         printf("Container %s stopped successfully\n", container_name);
         return 0;
     } else {
-        pthread_mutex_lock(&local_containers_mutex);
-        container->state = CONTAINER_ERROR;
+        set_local_state_locked(container, CONTAINER_ERROR);
         pthread_mutex_unlock(&local_containers_mutex);
         
         printf("Error: Failed to stop container %s\n", container_name);
@@ -192,7 +330,7 @@ int handle_delete_container(const char* container_name) {
     printf("Deleting container: %s\n", container_name);
     
     // Find and remove container from local list
-    pthread_mutex_lock(&local_containers_mutex);
+    lock_local_containers();
     
     int container_index = -1;
     for (int i = 0; i < local_container_count; i++) {
@@ -209,6 +347,8 @@ int handle_delete_container(const char* container_name) {
     }
     
     // Remove from local list
+    inventory_remove(&local_inventory, local_containers[container_index].name,
+                     local_containers[container_index].state);
     for (int i = container_index; i < local_container_count - 1; i++) {
         local_containers[i] = local_containers[i + 1];
     }
@@ -226,101 +366,451 @@ int handle_delete_container(const char* container_name) {
     }
 }
 
+// Send an ACK or ERROR that completes an operation
+static void send_operation_reply(int operation_id, message_type_t type, const char* text) {
+    message_t reply;
+    create_message(&reply, type, node_id, "coordinator", text, strlen(text));
+    reply.operation_id = operation_id;
+    send_to_coordinator(&reply);
+}
+
+// Set a local container's state if it is still listed
+static void set_local_state(const char* name, container_state_t state) {
+    lock_local_containers();
+    for (int i = 0; i < local_container_count; i++) {
+        if (strcmp(local_containers[i].name, name) == 0) {
+            set_local_state_locked(&local_containers[i], state);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&local_containers_mutex);
+}
+
+// Migration source: stop and export the container, then serve the export to
+// the target worker. The coordinator deletes our copy once the target has it.
+static void run_migration_export(void* arg) {
+    message_t* msg = (message_t*)arg;
+    migration_export_t request = *(migration_export_t*)msg->data;
+    int operation_id = msg->operation_id;
+    char path[MAX_PATH_LEN];
+    struct stat st;
+    int port;
+    free(msg);
+    
+    request.name[MAX_NAME_LEN - 1] = '\0';
+    migration_path(config_current()->migration_dir, request.name, operation_id, "out",
+                   path, sizeof(path));
+    
+    // Mid-command state keeps the observer from reporting the stop
+    set_local_state(request.name, CONTAINER_STOPPING);
+    if (lxc_export_container(request.name, path, request.checkpoint) != 0 ||
+        stat(path, &st) != 0) {
+        set_local_state(request.name, lxc_get_container_state(request.name));
+        send_operation_reply(operation_id, MSG_ERROR, "export failed");
+        return;
+    }
+    set_local_state(request.name, CONTAINER_STOPPED);
+    
+    int listen_fd = migration_listen(&port);
+    if (listen_fd < 0) {
+        unlink(path);
+        send_operation_reply(operation_id, MSG_ERROR, "migration listen failed");
+        return;
+    }
+    
+    migration_offer_t offer;
+    memset(&offer, 0, sizeof(offer));
+    strcpy(offer.name, request.name);
+    offer.port = port;
+    offer.size = st.st_size;
+    memcpy(offer.token, request.token, sizeof(offer.token));
+    
+    message_t ready;
+    create_message(&ready, MSG_MIGRATE_READY, node_id, "coordinator", &offer, sizeof(offer));
+    ready.operation_id = operation_id;
+    send_to_coordinator(&ready);
+    
+    printf("Serving %s (%lld bytes) for migration on port %d\n", request.name, offer.size, port);
+    if (migration_send_file(listen_fd, request.token, path) != 0) {
+        send_operation_reply(operation_id, MSG_ERROR, "migration transfer failed");
+    }
+    
+    close(listen_fd);
+    unlink(path);
+}
+
+// Migration target: pull the export straight from the source worker and import it
+static void run_migration_import(void* arg) {
+    message_t* msg = (message_t*)arg;
+    migration_import_t request = *(migration_import_t*)msg->data;
+    int operation_id = msg->operation_id;
+    char path[MAX_PATH_LEN];
+    free(msg);
+    
+    // Heap pointers from the coordinator are meaningless here
+    request.config.environment_vars = NULL;
+    request.config.mount_points = NULL;
+    request.config.network_config = NULL;
+    request.config.name[MAX_NAME_LEN - 1] = '\0';
+    request.source_ip[INET_ADDRSTRLEN - 1] = '\0';
+    request.token[MIGRATION_TOKEN_LEN - 1] = '\0';
+    
+    migration_path(config_current()->migration_dir, request.config.name, operation_id, "in",
+                   path, sizeof(path));
+    
+    struct timespec started;
+    clock_gettime(CLOCK_MONOTONIC, &started);
+    int result = migration_receive_file(request.source_ip, request.source_port, request.token,
+                                        path, request.size);
+    if (result == 0) {
+        result = lxc_import_container(path);
+        unlink(path);
+    }
+    container_state_t state = CONTAINER_STOPPED;
+    if (result == 0) {
+        if (request.start && lxc_start_container(request.config.name) == 0) {
+            state = CONTAINER_RUNNING;
+        }
+        result = add_local_container(&request.config, state);
+    }
+    
+    if (result == 0) {
+        printf("Container %s migrated in from %s in %.2fs\n", request.config.name,
+               request.source_ip, metrics_elapsed(&started));
+        send_operation_reply(operation_id, MSG_ACK,
+                             state == CONTAINER_RUNNING ? "running" : "stopped");
+    } else {
+        send_operation_reply(operation_id, MSG_ERROR, "migration import failed");
+    }
+}
+
+// Hand a migration step to the executor under the container's key, so it
+// runs in order with any deploy/start/stop/delete for the same container
+static void queue_migration(const message_t* msg, const char* name, executor_job_t job) {
+    char key[MAX_NAME_LEN];
+    snprintf(key, sizeof(key), "%.*s", MAX_NAME_LEN - 1, name);
+    
+    message_t* copy = malloc(sizeof(message_t));
+    if (!copy) {
+        send_operation_reply(msg->operation_id, MSG_ERROR, "out of memory");
+        return;
+    }
+    *copy = *msg;
+    
+    if (executor_submit(key, job, copy) != 0) {
+        free(copy);
+        send_operation_reply(msg->operation_id, MSG_ERROR, "worker queue full");
+    }
+}
+
+// Send one inventory reply; ITEMS replies are assembled from the leaf list and
+// the packed items
+static void send_inventory_reply(inventory_reply_t* reply, const void* body, size_t body_length,
+                                 const uint16_t* leaves, const char* items, size_t items_length) {
+    message_t msg;
+    char payload[sizeof(msg.data)];
+    size_t length = sizeof(inventory_reply_t);
+
+    memcpy(payload, reply, sizeof(inventory_reply_t));
+    if (body_length > 0) {
+        memcpy(payload + length, body, body_length);
+        length += body_length;
+    }
+    if (leaves) {
+        memcpy(payload + length, leaves, reply->count * sizeof(uint16_t));
+        length += reply->count * sizeof(uint16_t);
+        memcpy(payload + length, items, items_length);
+        length += items_length;
+    }
+
+    create_message(&msg, MSG_INVENTORY_REPLY, node_id, "coordinator", payload, length);
+    send_to_coordinator(&msg);
+}
+
+// Answer one step of the coordinator's inventory sync: the root and branch
+// hashes, the leaf hashes of some branches, or the containers in some leaves
+static void handle_inventory_request(const message_t* msg) {
+    static int leaf_of[MAX_CONTAINERS];
+    static inventory_branch_t branches[INVENTORY_FANOUT];
+    static uint16_t leaves[INVENTORY_LEAVES];
+    static char items[sizeof(msg->data)];
+    inventory_request_t request;
+    inventory_reply_t reply;
+
+    memset(&request, 0, sizeof(request));
+    memcpy(&request, msg->data, (msg->data_length < (int)sizeof(request)) ?
+           (size_t)msg->data_length : sizeof(request));
+    if (request.count > INVENTORY_LEAVES) return;
+
+    lock_local_containers();
+
+    memset(&reply, 0, sizeof(reply));
+    reply.step = request.step;
+    reply.last = 1;
+    reply.root = local_inventory.root;
+    memcpy(reply.branches, local_inventory.branches, sizeof(reply.branches));
+
+    switch (request.step) {
+        case INVENTORY_ROOT:
+            reply.count = (uint16_t)local_inventory.count;
+            send_inventory_reply(&reply, NULL, 0, NULL, NULL, 0);
+            break;
+
+        case INVENTORY_BRANCHES: {
+            for (int i = 0; i < request.count; i++) {
+                int branch = request.indices[i];
+                if (branch >= INVENTORY_FANOUT || reply.count >= INVENTORY_FANOUT) continue;
+
+                inventory_branch_t* out = &branches[reply.count++];
+                memset(out, 0, sizeof(inventory_branch_t));
+                out->branch = (uint16_t)branch;
+                memcpy(out->leaves, &local_inventory.leaves[branch * INVENTORY_FANOUT],
+                       sizeof(out->leaves));
+            }
+            send_inventory_reply(&reply, branches, reply.count * sizeof(inventory_branch_t),
+                                 NULL, NULL, 0);
+            break;
+        }
+
+        case INVENTORY_ITEMS: {
+            // Whole leaves per reply so the coordinator can spot missing containers
+            size_t capacity = sizeof(items) - sizeof(inventory_reply_t);
+            size_t items_length = 0;
+
+            for (int i = 0; i < local_container_count; i++) {
+                leaf_of[i] = inventory_leaf_of(local_containers[i].name);
+            }
+
+            reply.last = 0;
+            for (int i = 0; i < request.count; i++) {
+                int leaf = request.indices[i];
+                if (leaf >= INVENTORY_LEAVES) continue;
+
+                size_t leaf_start = items_length;
+                uint16_t leaf_items = 0;
+                int fits = 1;
+
+                for (int j = 0; j < local_container_count && fits; j++) {
+                    if (leaf_of[j] != leaf) continue;
+                    size_t used = (reply.count + 1) * sizeof(uint16_t);
+                    fits = (inventory_append_item(items, &items_length, capacity - used,
+                                                  local_containers[j].name,
+                                                  local_containers[j].state) == 0);
+                    leaf_items += fits;
+                }
+
+                if (!fits) {
+                    // Flush what is complete and retry the leaf in a fresh reply
+                    items_length = leaf_start;
+                    if (reply.count == 0) {
+                        printf("Warning: Inventory leaf %d does not fit in one message\n", leaf);
+                        continue;
+                    }
+                    send_inventory_reply(&reply, NULL, 0, leaves, items, items_length);
+                    reply.count = 0;
+                    reply.item_count = 0;
+                    items_length = 0;
+                    i--;
+                    continue;
+                }
+
+                leaves[reply.count++] = (uint16_t)leaf;
+                reply.item_count += leaf_items;
+            }
+
+            reply.last = 1;
+            send_inventory_reply(&reply, NULL, 0, leaves, items, items_length);
+            break;
+        }
+
+        default:
+            break;
+    }
+
+    pthread_mutex_unlock(&local_containers_mutex);
+}
+
+// Forward declaration, the handler reconnects when the coordinator goes away
+static int connect_to_coordinator(void);
+
+// Gauges computed at scrape time: local containers by state, own resources,
+// heartbeat age and coordinator connection
+static void collect_worker_metrics(metrics_buffer_t* out) {
+    static const char* state_names[] = { "STOPPED", "STARTING", "RUNNING", "STOPPING", "ERROR" };
+    int states[CONTAINER_ERROR + 1] = {0};
+    resource_info_t resources;
+    
+    lock_local_containers();
+    for (int i = 0; i < local_container_count; i++) {
+        states[local_containers[i].state]++;
+    }
+    pthread_mutex_unlock(&local_containers_mutex);
+    
+    metrics_gauge_header(out, "lxc_worker_containers", "Containers on this node by state");
+    for (int state = CONTAINER_STOPPED; state <= CONTAINER_ERROR; state++) {
+        metrics_printf(out, "lxc_worker_containers{state=\"%s\"} %d\n", state_names[state], states[state]);
+    }
+    
+    if (get_system_resources(&resources) == 0) {
+        metrics_gauge_header(out, "lxc_worker_cpu_usage_percent", "CPU usage of this node");
+        metrics_printf(out, "lxc_worker_cpu_usage_percent %.2f\n", resources.cpu_usage);
+        metrics_gauge_header(out, "lxc_worker_memory_usage_percent", "Memory usage of this node");
+        metrics_printf(out, "lxc_worker_memory_usage_percent %.2f\n", resources.memory_usage);
+        metrics_gauge_header(out, "lxc_worker_disk_usage_percent", "Disk usage of this node");
+        metrics_printf(out, "lxc_worker_disk_usage_percent %.2f\n", resources.disk_usage);
+    }
+    
+    executor_status_t executor;
+    executor_status(&executor);
+    metrics_gauge_header(out, "lxc_worker_commands_queued", "Container commands waiting for an executor thread");
+    metrics_printf(out, "lxc_worker_commands_queued %d\n", executor.queued);
+    metrics_gauge_header(out, "lxc_worker_commands_running", "Container commands running on the executor");
+    metrics_printf(out, "lxc_worker_commands_running %d\n", executor.running);
+    
+    metrics_gauge_header(out, "lxc_worker_connected", "1 while connected to a coordinator");
+    metrics_printf(out, "lxc_worker_connected %d\n", coordinator_socket >= 0 ? 1 : 0);
+    
+    if (last_heartbeat_sent != 0) {
+        metrics_gauge_header(out, "lxc_worker_heartbeat_age_seconds", "Seconds since the last heartbeat was sent");
+        metrics_printf(out, "lxc_worker_heartbeat_age_seconds %ld\n", (long)(time(NULL) - last_heartbeat_sent));
+    }
+}
+
+// A container command waiting on the executor
+typedef struct {
+    message_type_t type;
+    int operation_id;
+    char name[MAX_NAME_LEN];
+    lxc_config_t config;            // Deploys only
+} container_command_t;
+
+// Run one container command and answer its operation (executor thread)
+static void run_container_command(void* arg) {
+    container_command_t* command = arg;
+    struct timespec started;
+    const char* done = "";
+    const char* failed = "";
+    int kind = COMMAND_DEPLOY;
+    int result = -1;
+    
+    clock_gettime(CLOCK_MONOTONIC, &started);
+    switch (command->type) {
+        case MSG_DEPLOY_CONTAINER:
+            kind = COMMAND_DEPLOY;
+            result = handle_deploy_container(&command->config);
+            done = "deployed";
+            failed = "deployment failed";
+            break;
+        case MSG_START_CONTAINER:
+            kind = COMMAND_START;
+            result = handle_start_container(command->name);
+            done = "started";
+            failed = "start failed";
+            break;
+        case MSG_STOP_CONTAINER:
+            kind = COMMAND_STOP;
+            result = handle_stop_container(command->name);
+            done = "stopped";
+            failed = "stop failed";
+            break;
+        case MSG_DELETE_CONTAINER:
+            kind = COMMAND_DELETE;
+            result = handle_delete_container(command->name);
+            done = "deleted";
+            failed = "delete failed";
+            break;
+        default:
+            break;
+    }
+    record_command(kind, &started, result);
+    
+    send_operation_reply(command->operation_id, result == 0 ? MSG_ACK : MSG_ERROR,
+                         result == 0 ? done : failed);
+    free(command);
+}
+
+// Hand a deploy/start/stop/delete to the executor so the socket keeps being
+// read. Commands for one container run in the order they arrived; commands
+// for different containers run at the same time.
+static void queue_container_command(const message_t* msg) {
+    if (msg->type == MSG_DEPLOY_CONTAINER && msg->data_length < (int)sizeof(lxc_config_t)) {
+        send_operation_reply(msg->operation_id, MSG_ERROR, "malformed deploy request");
+        return;
+    }
+    
+    container_command_t* command = calloc(1, sizeof(container_command_t));
+    if (!command) {
+        send_operation_reply(msg->operation_id, MSG_ERROR, "worker out of memory");
+        return;
+    }
+    command->type = msg->type;
+    command->operation_id = msg->operation_id;
+    
+    if (msg->type == MSG_DEPLOY_CONTAINER) {
+        command->config = *(const lxc_config_t*)msg->data;
+        
+        // Heap pointers from the coordinator are meaningless here
+        command->config.environment_vars = NULL;
+        command->config.mount_points = NULL;
+        command->config.network_config = NULL;
+        command->config.name[MAX_NAME_LEN - 1] = '\0';
+        strcpy(command->name, command->config.name);
+    } else {
+        int name_len = (msg->data_length < MAX_NAME_LEN) ? 
+                      msg->data_length : MAX_NAME_LEN - 1;
+        strncpy(command->name, msg->data, name_len);
+        command->name[name_len] = '\0';
+    }
+    
+    if (executor_submit(command->name, run_container_command, command) != 0) {
+        send_operation_reply(msg->operation_id, MSG_ERROR, "worker queue full");
+        free(command);
+    }
+}
+
 // Message handling loop
 void* message_handler_thread(void* arg) {
     message_t msg;
     
     while (running && coordinator_socket >= 0) {
         if (receive_message(coordinator_socket, &msg) != 0) {
-            printf("Connection to coordinator lost\n");
-            break;
+            printf("Connection to coordinator lost, reconnecting\n");
+            int old_socket = coordinator_socket;
+            coordinator_socket = -1;
+            close(old_socket);
+            
+            if (connect_to_coordinator() != 0) {
+                break;
+            }
+            continue;
         }
         
         switch (msg.type) {
-            case MSG_DEPLOY_CONTAINER: {
-                if (msg.data_length >= sizeof(lxc_config_t)) {
-                    lxc_config_t* config = (lxc_config_t*)msg.data;
-                    
-                    if (handle_deploy_container(config) == 0) {
-                        // Send acknowledgment
-                        message_t ack_msg;
-                        create_message(&ack_msg, MSG_ACK, node_id, "coordinator", 
-                                      "deployed", 8);
-                        send_message(coordinator_socket, &ack_msg);
-                    } else {
-                        // Send error
-                        message_t error_msg;
-                        create_message(&error_msg, MSG_ERROR, node_id, "coordinator", 
-                                      "deployment failed", 17);
-                        send_message(coordinator_socket, &error_msg);
-                    }
-                }
+            case MSG_DEPLOY_CONTAINER:
+            case MSG_START_CONTAINER:
+            case MSG_STOP_CONTAINER:
+            case MSG_DELETE_CONTAINER:
+                queue_container_command(&msg);
                 break;
-            }
             
-            case MSG_START_CONTAINER: {
-                char container_name[MAX_NAME_LEN];
-                int name_len = (msg.data_length < MAX_NAME_LEN) ? 
-                              msg.data_length : MAX_NAME_LEN - 1;
-                strncpy(container_name, msg.data, name_len);
-                container_name[name_len] = '\0';
-                
-                if (handle_start_container(container_name) == 0) {
-                    message_t ack_msg;
-                    create_message(&ack_msg, MSG_ACK, node_id, "coordinator", 
-                                  "started", 7);
-                    send_message(coordinator_socket, &ack_msg);
-                } else {
-                    message_t error_msg;
-                    create_message(&error_msg, MSG_ERROR, node_id, "coordinator", 
-                                  "start failed", 12);
-                    send_message(coordinator_socket, &error_msg);
-                }
+            case MSG_INVENTORY_SYNC:
+                handle_inventory_request(&msg);
                 break;
-            }
-            
-            case MSG_STOP_CONTAINER: {
-                char container_name[MAX_NAME_LEN];
-                int name_len = (msg.data_length < MAX_NAME_LEN) ? 
-                              msg.data_length : MAX_NAME_LEN - 1;
-                strncpy(container_name, msg.data, name_len);
-                container_name[name_len] = '\0';
-                
-                if (handle_stop_container(container_name) == 0) {
-                    message_t ack_msg;
-                    create_message(&ack_msg, MSG_ACK, node_id, "coordinator", 
-                                  "stopped", 7);
-                    send_message(coordinator_socket, &ack_msg);
-                } else {
-                    message_t error_msg;
-                    create_message(&error_msg, MSG_ERROR, node_id, "coordinator", 
-                                  "stop failed", 11);
-                    send_message(coordinator_socket, &error_msg);
+
+            case MSG_MIGRATE_EXPORT:
+                if (msg.data_length >= (int)sizeof(migration_export_t)) {
+                    queue_migration(&msg, ((const migration_export_t*)msg.data)->name,
+                                    run_migration_export);
                 }
                 break;
-            }
-            
-            case MSG_DELETE_CONTAINER: {
-                char container_name[MAX_NAME_LEN];
-                int name_len = (msg.data_length < MAX_NAME_LEN) ? 
-                              msg.data_length : MAX_NAME_LEN - 1;
-                strncpy(container_name, msg.data, name_len);
-                container_name[name_len] = '\0';
-                
-                if (handle_delete_container(container_name) == 0) {
-                    message_t ack_msg;
-                    create_message(&ack_msg, MSG_ACK, node_id, "coordinator", 
-                                  "deleted", 7);
-                    send_message(coordinator_socket, &ack_msg);
-                } else {
-                    message_t error_msg;
-                    create_message(&error_msg, MSG_ERROR, node_id, "coordinator", 
-                                  "delete failed", 13);
-                    send_message(coordinator_socket, &error_msg);
+
+            case MSG_MIGRATE_IMPORT:
+                if (msg.data_length >= (int)sizeof(migration_import_t)) {
+                    queue_migration(&msg, ((const migration_import_t*)msg.data)->config.name,
+                                    run_migration_import);
                 }
                 break;
-            }
-            
+
             default:
                 printf("Unknown message type received: %d\n", msg.type);
                 break;
@@ -330,7 +820,7 @@ void* message_handler_thread(void* arg) {
     return NULL;
 }
 
-// Register with coordinator
+// Register with coordinator, returns 1 when redirected to another coordinator
 int register_with_coordinator(void) {
     struct utsname system_info;
     char hostname[MAX_NAME_LEN];
@@ -354,15 +844,16 @@ int register_with_coordinator(void) {
     }
     
     // Create registration data
-    snprintf(registration_data, sizeof(registration_data), "%s %s %d", 
-             hostname, local_ip, 0); // Port 0 for worker nodes
+    snprintf(registration_data, sizeof(registration_data), "%s %s %d %s", 
+             hostname, local_ip, 0, // Port 0 for worker nodes
+             strlen(node_labels) > 0 ? node_labels : "-");
     
     // Send registration message
     message_t msg;
     create_message(&msg, MSG_REGISTER_NODE, node_id, "coordinator", 
                    registration_data, strlen(registration_data));
     
-    if (send_message(coordinator_socket, &msg) != 0) {
+    if (send_to_coordinator(&msg) != 0) {
         printf("Error: Failed to send registration message\n");
         return -1;
     }
@@ -374,6 +865,22 @@ int register_with_coordinator(void) {
         return -1;
     }
     
+    if (ack_msg.type == MSG_REDIRECT) {
+        // A standby coordinator names the leader, if it knows one
+        char leader_ip[INET_ADDRSTRLEN];
+        int leader_port;
+        ack_msg.data[sizeof(ack_msg.data) - 1] = '\0';
+        
+        if (sscanf(ack_msg.data, "%15s %d", leader_ip, &leader_port) == 2) {
+            printf("Coordinator is not the leader, following it to %s:%d\n", leader_ip, leader_port);
+            strcpy(coordinator_ip, leader_ip);
+            coordinator_port = leader_port;
+            return 1;
+        }
+        printf("Coordinator is not the leader and no leader is elected yet\n");
+        return -1;
+    }
+    
     if (ack_msg.type != MSG_ACK) {
         printf("Error: Registration failed\n");
         return -1;
@@ -383,6 +890,63 @@ int register_with_coordinator(void) {
     return 0;
 }
 
+// Add "ip:port,..." addresses to the coordinators tried in turn
+static void add_coordinators(const char* list) {
+    char buffer[MAX_COMMAND_LEN];
+    char* saveptr = NULL;
+    
+    strncpy(buffer, list, sizeof(buffer) - 1);
+    buffer[sizeof(buffer) - 1] = '\0';
+    
+    for (char* item = strtok_r(buffer, ", ", &saveptr); item && coordinator_total < MAX_COORDINATORS;
+         item = strtok_r(NULL, ", ", &saveptr)) {
+        char ip[INET_ADDRSTRLEN];
+        int port;
+        
+        if (sscanf(item, "%15[^:]:%d", ip, &port) != 2 || port <= 0 || port > 65535) {
+            printf("Warning: Ignoring coordinator address %s\n", item);
+            continue;
+        }
+        strcpy(coordinator_ips[coordinator_total], ip);
+        coordinator_ports[coordinator_total] = port;
+        coordinator_total++;
+    }
+}
+
+// Connect and register, following redirects to the cluster leader and
+// cycling through the known coordinators until one accepts
+static int connect_to_coordinator(void) {
+    int next = 0;
+    
+    while (running) {
+        int socket_fd = init_worker_node(coordinator_ip, coordinator_port);
+        if (socket_fd >= 0) {
+            coordinator_socket = socket_fd;
+            int result = register_with_coordinator();
+            if (result == 0) {
+                return 0;
+            }
+            
+            coordinator_socket = -1;
+            close(socket_fd);
+            
+            if (result == 1) {
+                usleep(100000);
+                continue;
+            }
+        }
+        
+        if (coordinator_total > 0) {
+            strcpy(coordinator_ip, coordinator_ips[next]);
+            coordinator_port = coordinator_ports[next];
+            next = (next + 1) % coordinator_total;
+        }
+        sleep(1);
+    }
+    
+    return -1;
+}
+
 // Signal handler for cleanup
 void worker_cleanup(int sig) {
     printf("\nShutting down worker node...\n");
@@ -398,16 +962,60 @@ void worker_cleanup(int sig) {
 
 // Main worker function
 int main(int argc, char* argv[]) {
-    if (argc != 3) {
-        printf("Usage: %s <coordinator_ip> <coordinator_port>\n", argv[0]);
+    const char* config_path = NULL;
+    int opt;
+    while ((opt = getopt(argc, argv, "c:l:")) != -1) {
+        switch (opt) {
+            case 'c':
+                config_path = optarg;
+                break;
+            case 'l':
+                strncpy(node_labels, optarg, MAX_NAME_LEN - 1);
+                break;
+            default:
+                printf("Usage: %s [-c config_file] [-l key=value,...] [<coordinator_ip> <coordinator_port>]\n", argv[0]);
+                return 1;
+        }
+    }
+    
+    if (argc - optind != 0 && argc - optind != 2) {
+        printf("Usage: %s [-c config_file] [-l key=value,...] [<coordinator_ip> <coordinator_port>]\n", argv[0]);
         return 1;
     }
     
-    strcpy(coordinator_ip, argv[1]);
-    coordinator_port = atoi(argv[2]);
+    // Fall back to the installed config file when present
+    if (!config_path && access(DEFAULT_WORKER_CONFIG, R_OK) == 0) {
+        config_path = DEFAULT_WORKER_CONFIG;
+    }
+    
+    // Load settings before any thread starts so SIGHUP stays blocked in all of them
+    if (init_config(config_path, NULL) != 0) {
+        return 1;
+    }
+    
+    const daemon_config_t* config = config_current();
+    
+    // Command line arguments override the config file
+    if (argc - optind == 2) {
+        strncpy(coordinator_ip, argv[optind], INET_ADDRSTRLEN - 1);
+        coordinator_port = atoi(argv[optind + 1]);
+    } else {
+        strncpy(coordinator_ip, config->coordinator_ip, INET_ADDRSTRLEN - 1);
+        coordinator_port = config->coordinator_port;
+    }
+    
+    // The primary address is tried first, then the configured alternatives
+    strcpy(coordinator_ips[0], coordinator_ip);
+    coordinator_ports[0] = coordinator_port;
+    coordinator_total = 1;
+    add_coordinators(config->coordinators);
+    
+    if (strlen(node_labels) == 0) {
+        strncpy(node_labels, config->labels, MAX_NAME_LEN - 1);
+    }
     
     if (coordinator_port <= 0 || coordinator_port > 65535) {
-        printf("Error: Invalid port number %s\n", argv[2]);
+        printf("Error: Invalid coordinator port %d\n", coordinator_port);
         return 1;
     }
     
@@ -421,16 +1029,26 @@ int main(int argc, char* argv[]) {
     signal(SIGINT, worker_cleanup);
     signal(SIGTERM, worker_cleanup);
     
-    // Connect to coordinator
-    coordinator_socket = init_worker_node(coordinator_ip, coordinator_port);
-    if (coordinator_socket < 0) {
-        printf("Error: Failed to connect to coordinator\n");
+    register_worker_metrics();
+    if (init_metrics(config->node_metrics_port, collect_worker_metrics) != 0) {
         return 1;
     }
     
-    // Register with coordinator
-    if (register_with_coordinator() != 0) {
-        close(coordinator_socket);
+    // The runtime is fixed for the life of the process
+    if (lxc_set_runtime(config->runtime) != 0) {
+        return 1;
+    }
+    if (strcmp(lxc_runtime_name(), "lxd") != 0) {
+        printf("Using the %s container runtime\n", lxc_runtime_name());
+    }
+    
+    // Container commands run here, off the socket reader
+    if (init_executor(config->executor_threads) != 0) {
+        return 1;
+    }
+    
+    // Connect to coordinator and register, retrying until one accepts
+    if (connect_to_coordinator() != 0) {
         return 1;
     }
     
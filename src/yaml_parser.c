@@ -63,14 +63,8 @@ yaml_node_t* create_yaml_node(const char* key, const char* value) {
     return node;
 }
 
-// Parse YAML file into a tree structure
-int parse_yaml_file(const char* filename, yaml_node_t** root) {
-    FILE* file = fopen(filename, "r");
-    if (!file) {
-        printf("Error: Cannot open file %s\n", filename);
-        return -1;
-    }
-    
+// Parse an open YAML stream into a tree structure; closes the stream
+static int parse_yaml_stream(FILE* file, yaml_node_t** root) {
     char line[MAX_COMMAND_LEN];
     char key[MAX_NAME_LEN];
     char value[MAX_COMMAND_LEN];
@@ -137,6 +131,31 @@ int parse_yaml_file(const char* filename, yaml_node_t** root) {
     return 0;
 }
 
+// Parse YAML file into a tree structure
+int parse_yaml_file(const char* filename, yaml_node_t** root) {
+    FILE* file = fopen(filename, "r");
+    if (!file) {
+        printf("Error: Cannot open file %s\n", filename);
+        return -1;
+    }
+    
+    return parse_yaml_stream(file, root);
+}
+
+// Parse YAML text already in memory into a tree structure
+int parse_yaml_buffer(const char* data, size_t length, yaml_node_t** root) {
+    *root = NULL;
+    if (length == 0) return 0;
+    
+    FILE* file = fmemopen((void*)data, length, "r");
+    if (!file) {
+        printf("Error: Cannot read YAML buffer: %s\n", strerror(errno));
+        return -1;
+    }
+    
+    return parse_yaml_stream(file, root);
+}
+
 // Get value for a specific key from YAML tree
 char* get_yaml_value(yaml_node_t* root, const char* key) {
     if (!root || !key) return NULL;
@@ -158,6 +177,29 @@ char* get_yaml_value(yaml_node_t* root, const char* key) {
     return NULL;
 }
 
+// Parse a priority given as a number or a class name
+static int parse_priority(const char* value, int* priority) {
+    char* end = NULL;
+    
+    if (strcmp(value, "low") == 0) {
+        *priority = PRIORITY_LOW;
+    } else if (strcmp(value, "normal") == 0) {
+        *priority = PRIORITY_NORMAL;
+    } else if (strcmp(value, "high") == 0) {
+        *priority = PRIORITY_HIGH;
+    } else if (strcmp(value, "critical") == 0) {
+        *priority = PRIORITY_CRITICAL;
+    } else {
+        long number = strtol(value, &end, 10);
+        if (end == value || *end != '\0' || number < -100000 || number > 100000) {
+            return -1;
+        }
+        *priority = (int)number;
+    }
+    
+    return 0;
+}
+
 // Extract LXC configuration from YAML tree
 int extract_lxc_config(yaml_node_t* root, lxc_config_t* config) {
     if (!root || !config) return -1;
@@ -195,6 +237,35 @@ int extract_lxc_config(yaml_node_t* root, lxc_config_t* config) {
         config->privileged = (strcmp(privileged_str, "true") == 0) ? 1 : 0;
     }
     
+    // Placement constraints
+    char* group = get_yaml_value(root, "group");
+    strncpy(config->group, group ? group : config->name, MAX_NAME_LEN - 1);
+    
+    char* affinity = get_yaml_value(root, "affinity");
+    if (affinity) {
+        strncpy(config->affinity, affinity, MAX_NAME_LEN - 1);
+    }
+    
+    char* anti_affinity = get_yaml_value(root, "anti_affinity");
+    if (anti_affinity) {
+        strncpy(config->anti_affinity, anti_affinity, MAX_NAME_LEN - 1);
+    }
+    
+    char* spread = get_yaml_value(root, "spread");
+    if (spread) {
+        strncpy(config->spread_key, spread, MAX_NAME_LEN - 1);
+    }
+    
+    char* tenant = get_yaml_value(root, "tenant");
+    strncpy(config->tenant, tenant ? tenant : DEFAULT_TENANT, MAX_NAME_LEN - 1);
+    
+    char* priority = get_yaml_value(root, "priority");
+    if (priority && parse_priority(priority, &config->priority) != 0) {
+        printf("Error: Unknown priority %s, expected a number or low, normal, high, critical\n",
+               priority);
+        return -1;
+    }
+    
     // Allocate and copy environment variables
     char* env_vars = get_yaml_value(root, "environment");
     if (env_vars) {
@@ -235,6 +306,26 @@ void free_yaml_tree(yaml_node_t* root) {
     free(root);
 }
 
+// Build a container configuration from YAML text read from source
+int parse_lxc_yaml_buffer(const char* data, size_t length, const char* source,
+                          lxc_config_t* config) {
+    yaml_node_t* root = NULL;
+    
+    if (parse_yaml_buffer(data, length, &root) != 0) {
+        printf("Error: Failed to parse YAML file %s\n", source);
+        return -1;
+    }
+    
+    if (extract_lxc_config(root, config) != 0) {
+        printf("Error: Failed to extract LXC configuration from YAML\n");
+        free_yaml_tree(root);
+        return -1;
+    }
+    
+    free_yaml_tree(root);
+    return 0;
+}
+
 // Main YAML parsing function
 int parse_lxc_yaml(const char* yaml_file, lxc_config_t* config) {
     yaml_node_t* root = NULL;
@@ -0,0 +1,286 @@
+// Placement benchmark for the scheduler. Builds scheduler.c on its own with a
+// raised node limit and compares spread placements answered by the score heap
+// against a full scan of every node, then p2c sampling against the full scan
+// when heartbeats lag behind placements. Exits non-zero when the heap ever
+// picks a node scoring below the best one or a placement finds no node.
+#include "../include/scheduler.h"
+#include "../include/lxc_manager.h"
+
+#define BENCH_MAX_CONTAINERS 64     // Slots per simulated node
+#define BENCH_VERIFY_EVERY 97       // Placements between full scan cross-checks
+#define BENCH_SAMPLE_NODES 10000
+#define BENCH_SAMPLE_PLACEMENTS 100000
+
+// Node table normally owned by the coordinator
+node_t nodes[MAX_NODES];
+int node_count = 0;
+pthread_mutex_t nodes_mutex = PTHREAD_MUTEX_INITIALIZER;
+unsigned long nodes_generation = 0;
+
+// Placements not yet reported by a heartbeat, per node
+static int unreported[MAX_NODES];
+
+// Lock the node table
+void lock_nodes(void) {
+    pthread_mutex_lock(&nodes_mutex);
+}
+
+// Image locality is not part of the benchmark
+int image_digest_contains(const unsigned char* digest, const char* image) {
+    (void)digest;
+    (void)image;
+    return 0;
+}
+
+// Seconds since a CLOCK_MONOTONIC timestamp
+static double elapsed_since(const struct timespec* start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+// Fill the node table with count connected nodes, of uneven load unless even
+// is set. The node table changes shape, so the scheduler rebuilds its index on
+// next use.
+static void reset_cluster(int count, int even) {
+    time_t now = time(NULL);
+
+    memset(nodes, 0, sizeof(node_t) * count);
+    for (int i = 0; i < count; i++) {
+        node_t* node = &nodes[i];
+        snprintf(node->id, sizeof(node->id), "node-%05d", i);
+        node->state = NODE_CONNECTED;
+        node->last_heartbeat = now;
+        node->resources.cpu_usage = even ? 20 : (i * 37) % 50;
+        node->resources.memory_usage = even ? 20 : (i * 53) % 50;
+        node->resources.disk_usage = even ? 20 : (i * 11) % 40;
+        node->resources.max_containers = BENCH_MAX_CONTAINERS;
+        node->resources.cpu_capacity = 16;
+        node->resources.memory_capacity = 65536;
+    }
+
+    node_count = count;
+    nodes_generation++;
+}
+
+// Account for one container landing on a node, as its next heartbeat would
+static void place_on(node_t* node) {
+    node->container_count++;
+    node->resources.container_count = node->container_count;
+    node->resources.cpu_usage += 0.5;
+    node->resources.memory_usage += 0.4;
+    if (node->resources.cpu_usage > 100.0) node->resources.cpu_usage = 100.0;
+    if (node->resources.memory_usage > 100.0) node->resources.memory_usage = 100.0;
+    node->last_heartbeat = time(NULL);
+}
+
+// Spread score with the default weights, computed the slow way
+static double scan_score(const node_t* node) {
+    double cpu_available = 100.0 - node->resources.cpu_usage;
+    double memory_available = 100.0 - node->resources.memory_usage;
+    double disk_available = 100.0 - node->resources.disk_usage;
+    double container_load = (double)node->container_count / node->resources.max_containers;
+
+    return cpu_available * 0.3 + memory_available * 0.3 + disk_available * 0.2 +
+           (1.0 - container_load) * 100.0 * 0.2;
+}
+
+// Best eligible node by a linear pass over the whole table
+static node_t* scan_best(double* score) {
+    node_t* best_node = NULL;
+
+    for (int i = 0; i < node_count; i++) {
+        node_t* node = &nodes[i];
+        if (node->container_count >= node->resources.max_containers) continue;
+
+        double node_score = scan_score(node);
+        if (!best_node || node_score > *score) {
+            *score = node_score;
+            best_node = node;
+        }
+    }
+    return best_node;
+}
+
+// Send stdout to /dev/null while the scheduler logs every placement
+static int silence_stdout(void) {
+    fflush(stdout);
+    int saved = dup(STDOUT_FILENO);
+    int null_fd = open("/dev/null", O_WRONLY);
+    if (null_fd >= 0) {
+        dup2(null_fd, STDOUT_FILENO);
+        close(null_fd);
+    }
+    return saved;
+}
+
+static void restore_stdout(int saved) {
+    fflush(stdout);
+    if (saved >= 0) {
+        dup2(saved, STDOUT_FILENO);
+        close(saved);
+    }
+}
+
+// Place containers through the scheduler's spread heap. Returns seconds per
+// placement and counts picks that a full scan would have beaten.
+static double run_heap(int count, int placements, lxc_config_t* config, int* mismatches) {
+    double total = 0.0;
+
+    reset_cluster(count, 0);
+    scheduler_set_policy(SCHED_SPREAD);
+
+    int saved = silence_stdout();
+    for (int p = 0; p < placements; p++) {
+        double expected = 0.0;
+        if (p % BENCH_VERIFY_EVERY == 0) {
+            scan_best(&expected);
+        }
+
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        node_t* node = find_best_node(config);
+        total += elapsed_since(&start);
+
+        if (!node || (p % BENCH_VERIFY_EVERY == 0 && scan_score(node) < expected - 1e-9)) {
+            (*mismatches)++;
+        }
+        if (!node) continue;
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        place_on(node);
+        scheduler_heartbeat(node->id);
+        total += elapsed_since(&start);
+    }
+    restore_stdout(saved);
+
+    return total / placements;
+}
+
+// Place the same containers by scanning every node each time
+static double run_scan(int count, int placements) {
+    struct timespec start;
+
+    reset_cluster(count, 0);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int p = 0; p < placements; p++) {
+        double score = 0.0;
+        node_t* node = scan_best(&score);
+        if (node) {
+            place_on(node);
+        }
+    }
+
+    return elapsed_since(&start) / placements;
+}
+
+// Place containers on evenly loaded nodes under a policy while heartbeats
+// report them only every interval placements. Returns seconds per placement
+// and the most containers that ended up on one node.
+static double run_stale(scheduler_policy_t policy, int interval, lxc_config_t* config,
+                        int* max_load, int* failures) {
+    double total = 0.0;
+
+    reset_cluster(BENCH_SAMPLE_NODES, 1);
+    memset(unreported, 0, sizeof(unreported));
+    scheduler_set_policy(policy);
+
+    int saved = silence_stdout();
+    for (int p = 0; p < BENCH_SAMPLE_PLACEMENTS; p++) {
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        node_t* node = find_best_node(config);
+        total += elapsed_since(&start);
+
+        if (!node) {
+            (*failures)++;
+            continue;
+        }
+        unreported[node - nodes]++;
+
+        if ((p + 1) % interval == 0) {
+            for (int i = 0; i < node_count; i++) {
+                if (unreported[i] == 0) continue;
+                for (; unreported[i] > 0; unreported[i]--) {
+                    place_on(&nodes[i]);
+                }
+                scheduler_heartbeat(nodes[i].id);
+            }
+        }
+    }
+    restore_stdout(saved);
+
+    *max_load = 0;
+    for (int i = 0; i < node_count; i++) {
+        int load = nodes[i].container_count + unreported[i];
+        if (load > *max_load) *max_load = load;
+    }
+    return total / BENCH_SAMPLE_PLACEMENTS;
+}
+
+// Leave only a handful of nodes with free slots so p2c draws mostly miss
+static int run_nearly_full(lxc_config_t* config) {
+    int failures = 0;
+
+    reset_cluster(BENCH_SAMPLE_NODES, 0);
+    for (int i = 0; i < node_count; i++) {
+        if (i % 2500 != 7) {
+            nodes[i].container_count = nodes[i].resources.max_containers;
+        }
+    }
+    scheduler_set_policy(SCHED_P2C);
+
+    int saved = silence_stdout();
+    for (int p = 0; p < 100; p++) {
+        if (!find_best_node(config)) failures++;
+    }
+    restore_stdout(saved);
+
+    return failures;
+}
+
+int main(void) {
+    static const int sizes[] = {1000, 2500, 10000};
+    lxc_config_t config;
+    int failed = 0;
+
+    memset(&config, 0, sizeof(config));
+    strcpy(config.name, "bench");
+    scheduler_set_locality_bonus(0.0);
+
+    printf("Spread placement, score heap against full scan (MAX_NODES %d)\n", MAX_NODES);
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        int count = sizes[i];
+        int placements = count * 10;
+        int mismatches = 0;
+
+        double heap_time = run_heap(count, placements, &config, &mismatches);
+        double scan_time = run_scan(count, placements);
+
+        printf("  %6d nodes %7d placements: heap %7.2f us, scan %8.2f us per placement, %d mismatches\n",
+               count, placements, heap_time * 1e6, scan_time * 1e6, mismatches);
+        if (mismatches > 0) failed = 1;
+    }
+
+    printf("Stale heartbeats, p2c sampling against full scan (%d nodes, %d placements, "
+           "mean %d per node)\n", BENCH_SAMPLE_NODES, BENCH_SAMPLE_PLACEMENTS,
+           BENCH_SAMPLE_PLACEMENTS / BENCH_SAMPLE_NODES);
+    static const int intervals[] = {1, 8, 32};
+    for (size_t i = 0; i < sizeof(intervals) / sizeof(intervals[0]); i++) {
+        int scan_max = 0, p2c_max = 0, failures = 0;
+
+        double scan_time = run_stale(SCHED_SPREAD, intervals[i], &config, &scan_max, &failures);
+        double p2c_time = run_stale(SCHED_P2C, intervals[i], &config, &p2c_max, &failures);
+
+        printf("  heartbeat every %2d placements: full scan max %3d (%5.2f us), p2c max %3d (%5.2f us)\n",
+               intervals[i], scan_max, scan_time * 1e6, p2c_max, p2c_time * 1e6);
+        if (failures > 0) failed = 1;
+    }
+
+    int failures = run_nearly_full(&config);
+    printf("  p2c with 4 of %d nodes free: %d of 100 placements found no node\n",
+           BENCH_SAMPLE_NODES, failures);
+    if (failures > 0) failed = 1;
+
+    return failed;
+}
@@ -0,0 +1,31 @@
+// Assertions shared by the unit tests. A failed check prints where it failed
+// and the test carries on; check_report() gives the exit status.
+#ifndef CHECK_H
+#define CHECK_H
+
+#include <stdio.h>
+
+static int check_failures = 0;
+
+#define CHECK(condition, ...) do { \
+    if (!(condition)) { \
+        printf("FAIL: %s:%d: ", __FILE__, __LINE__); \
+        printf(__VA_ARGS__); \
+        printf("\n"); \
+        check_failures++; \
+    } \
+} while (0)
+
+// Print the outcome of one named test
+static inline void check_case(const char* name, int failures_before) {
+    if (check_failures == failures_before) {
+        printf("PASS: %s\n", name);
+    }
+}
+
+// Exit status for main: 0 when every check passed
+static inline int check_report(void) {
+    return check_failures > 0 ? 1 : 0;
+}
+
+#endif // CHECK_H
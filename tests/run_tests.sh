@@ -0,0 +1,300 @@
+#!/bin/bash
+# End-to-end tests: a coordinator and two workers running the in-memory fake
+# runtime, driven over the control socket. Covers worker registration and
+# placement, batched deploys paced by admission control, operation tracking,
+# migration between workers, per-container command ordering on the worker
+# executor, snapshots, control clients that hang up mid-request, and deletes.
+# Run with "make test" or from the repository root after "make".
+
+set -u
+
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+WORK=$(mktemp -d /tmp/dlxc-test.XXXXXX)
+PORT=$((20000 + $$ % 20000))
+SOCKET=$WORK/control.sock
+PIDS=()
+FAILED=0
+
+cleanup() {
+    if [ ${#PIDS[@]} -gt 0 ]; then
+        kill "${PIDS[@]}" 2>/dev/null
+        wait 2>/dev/null
+    fi
+    if [ "$FAILED" -ne 0 ]; then
+        echo "Logs kept in $WORK"
+    else
+        rm -rf "$WORK"
+    fi
+}
+trap cleanup EXIT
+
+pass() {
+    echo "PASS: $1"
+}
+
+fail() {
+    echo "FAIL: $1"
+    shift
+    for text in "$@"; do
+        echo "$text" | sed 's/^/      /'
+    done
+    FAILED=1
+}
+
+if ! command -v python3 >/dev/null; then
+    echo "SKIP: python3 is needed to talk to the control socket"
+    exit 0
+fi
+
+# Control socket client: sends each argument as one request on a single
+# connection and prints every reply in order
+cat > "$WORK/control.py" <<'EOF'
+import socket, struct, sys
+
+def receive(sock, length):
+    data = b""
+    while len(data) < length:
+        chunk = sock.recv(length - len(data))
+        if not chunk:
+            raise SystemExit("control socket closed")
+        data += chunk
+    return data
+
+sock = socket.socket(socket.AF_UNIX)
+sock.connect(sys.argv[1])
+for request in sys.argv[2:]:
+    body = request.encode()
+    sock.sendall(struct.pack(">I", len(body)) + body)
+for request in sys.argv[2:]:
+    length = struct.unpack(">I", receive(sock, 4))[0]
+    sys.stdout.write(receive(sock, length).decode())
+EOF
+
+control() {
+    python3 "$WORK/control.py" "$SOCKET" "$@"
+}
+
+# Retry a check every 100 ms until it succeeds or the seconds run out
+wait_for() {
+    local seconds=$1
+    shift
+    for ((i = 0; i < seconds * 10; i++)); do
+        "$@" && return 0
+        sleep 0.1
+    done
+    return 1
+}
+
+cat > "$WORK/coordinator.conf" <<EOF
+[coordinator]
+port = $PORT
+state_dir = $WORK/state
+control_socket = $SOCKET
+control_port = 0
+command_threads = 4
+
+[scheduler]
+policy = spread
+
+[rebalancer]
+interval = 0
+
+# 2 deploys at once, then 4 per second
+[admission]
+rate = 4
+burst = 2
+node_rate = 0
+max_wait = 60
+EOF
+
+cat > "$WORK/worker.conf" <<EOF
+[worker]
+coordinator_ip = 127.0.0.1
+coordinator_port = $PORT
+max_containers = 50
+migration_dir = $WORK
+executor_threads = 4
+runtime = fake
+
+[fake_runtime]
+create_ms = 50
+start_ms = 20
+stop_ms = 100
+destroy_ms = 20
+jitter_percent = 0
+failure_rate = 0.0
+seed = 1
+
+[heartbeat]
+interval = 1
+EOF
+
+for i in 1 2 3 4 5 6 7 8; do
+    cat > "$WORK/web$i.yaml" <<EOF
+name: web$i
+cpu_limit: 1
+memory_limit: 256
+EOF
+done
+
+# The coordinator reads commands from stdin; keep it open on a fifo
+mkfifo "$WORK/stdin"
+exec 3<>"$WORK/stdin"
+"$ROOT/bin/coordinator" -c "$WORK/coordinator.conf" < "$WORK/stdin" > "$WORK/coordinator.log" 2>&1 &
+PIDS+=($!)
+if ! wait_for 5 test -S "$SOCKET"; then
+    fail "coordinator starts" "$(tail -5 "$WORK/coordinator.log")"
+    exit 1
+fi
+
+for w in 1 2; do
+    "$ROOT/bin/worker" -c "$WORK/worker.conf" > "$WORK/worker$w.log" 2>&1 &
+    PIDS+=($!)
+done
+
+# Both workers register and report capacity
+nodes_up() {
+    [ "$(control nodes | grep -c ' UP ')" -eq 2 ]
+}
+if wait_for 10 nodes_up; then
+    pass "workers register"
+else
+    fail "workers register" "$(control nodes)"
+    exit 1
+fi
+sleep 1.5
+
+# One batched deploy; admission lets 2 through at once and paces the rest
+started=$(date +%s%N)
+reply=$(control "deploy $(ls "$WORK"/web*.yaml | tr '\n' ' ')")
+if [ "$(echo "$reply" | head -1)" = "ok 8" ]; then
+    pass "batch deploy is accepted"
+else
+    fail "batch deploy is accepted" "$reply"
+fi
+ops=$(echo "$reply" | awk 'NR > 1 { print $3 }' | tr '\n' ' ')
+
+waited=$(control "wait all 30")
+elapsed_ms=$((($(date +%s%N) - started) / 1000000))
+if [ "$(echo "$waited" | head -1)" = "ok" ]; then
+    pass "deploy operations finish"
+else
+    fail "deploy operations finish" "$waited"
+fi
+
+states=$(control "op $ops" | awk 'NR > 1 { print $5 }' | sort | uniq -c | tr -s ' ')
+if [ "$states" = " 8 SUCCEEDED" ]; then
+    pass "every deploy operation succeeded"
+else
+    fail "every deploy operation succeeded" "$states"
+fi
+
+delayed=$(control admission | awk 'NR == 2 { print $5 }')
+if [ "$elapsed_ms" -ge 1200 ] && [ "${delayed:-0}" -gt 0 ]; then
+    pass "admission paces deploys (${elapsed_ms} ms, $delayed delayed)"
+else
+    fail "admission paces deploys" "elapsed ${elapsed_ms} ms, delayed ${delayed:-none}"
+fi
+
+# Deploys create containers; spread placement uses both nodes
+containers=$(control containers | awk 'NR > 1')
+created=$(echo "$containers" | grep -c ' STOPPED STOPPED$')
+used_nodes=$(echo "$containers" | awk '{ print $3 }' | sort -u | wc -l)
+if [ "$created" -eq 8 ] && [ "$used_nodes" -eq 2 ]; then
+    pass "containers are placed on both nodes"
+else
+    fail "containers are placed on both nodes" "$containers"
+fi
+
+ids=$(echo "$containers" | awk '{ print $1 }' | tr '\n' ' ')
+reply=$(control "start $ids")
+control "wait all 30" > /dev/null
+all_running() {
+    [ "$(control containers | grep -c ' RUNNING RUNNING$')" -eq 8 ]
+}
+if [ "$(echo "$reply" | head -1)" = "ok 8" ] && wait_for 5 all_running; then
+    pass "containers start"
+else
+    fail "containers start" "$reply" "$(control containers)"
+fi
+
+# A migration moves a running container to the other worker; the target
+# proves itself to the source with the coordinator's one-time token
+id=$(echo "$containers" | awk '$2 == "web2" { print $1 }')
+source_node=$(echo "$containers" | awk '$2 == "web2" { print $3 }')
+reply=$(control "migrate $id")
+op=$(echo "$reply" | awk '$1 == "ok" { print $2 }')
+control "wait all 30" > /dev/null
+state=$(control "op ${op:-0}" | awk 'NR > 1 { print $5 }')
+moved=$(control containers | awk '$2 == "web2" { print $3, $4, $5 }')
+if [ "$state" = "SUCCEEDED" ] && [ "${moved%% *}" != "$source_node" ] &&
+   [ "${moved#* }" = "RUNNING RUNNING" ]; then
+    pass "migration moves a running container"
+else
+    fail "migration moves a running container" "$reply" "$state" "$moved"
+fi
+containers=$(control containers | awk 'NR > 1')
+
+# A stop and a delete sent back to back run in order on the worker. Run the
+# other way round, the faster delete would remove the container while the
+# stop is still in progress and the stop would fail.
+id=$(echo "$containers" | awk '$2 == "web1" { print $1 }')
+reply=$(control "stop $id" "delete $id")
+ops=$(echo "$reply" | awk '$2 == "ok" { print $3 }' | tr '\n' ' ')
+control "wait all 30" > /dev/null
+states=$(control "op $ops" | awk 'NR > 1 { print $2, $5 }' | tr '\n' ' ')
+if [ "$states" = "STOP SUCCEEDED DELETE SUCCEEDED " ]; then
+    pass "commands on one container keep their order"
+else
+    fail "commands on one container keep their order" "$reply" "$states"
+fi
+
+# The snapshot is written on the command pool and answered when it is synced
+rm -f "$WORK/state/snapshot.dat"
+reply=$(control snapshot)
+if [ "$reply" = "ok" ] && [ -s "$WORK/state/snapshot.dat" ]; then
+    pass "snapshot writes the registry"
+else
+    fail "snapshot writes the registry" "$reply" "$(ls -l "$WORK/state")"
+fi
+
+# A client that closes while its watch is deferred is dropped rather than
+# polled in a loop; the coordinator should stay idle meanwhile
+subscriber=$(control subscribe | awk '{ print $2 }')
+cpu_ticks() {
+    awk '{ print $14 + $15 }' "/proc/${PIDS[0]}/stat"
+}
+before=$(cpu_ticks)
+python3 - "$SOCKET" "$subscriber" <<'EOF'
+import socket, struct, sys, time
+sock = socket.socket(socket.AF_UNIX)
+sock.connect(sys.argv[1])
+body = ("watch %s - 2" % sys.argv[2]).encode()
+sock.sendall(struct.pack(">I", len(body)) + body)
+sock.close()
+time.sleep(2)
+EOF
+spent=$(($(cpu_ticks) - before))
+if [ "$spent" -lt 50 ] && [ "$(control ping)" = "ok" ]; then
+    pass "closed client with a deferred request is dropped ($spent ticks)"
+else
+    fail "closed client with a deferred request is dropped" "coordinator used $spent ticks in 2s"
+fi
+control "unsubscribe $subscriber" > /dev/null
+
+ids=$(control containers | awk 'NR > 1 { print $1 }' | tr '\n' ' ')
+reply=$(control "delete $ids")
+control "wait all 30" > /dev/null
+containers_gone() {
+    [ "$(control containers | wc -l)" -eq 1 ]
+}
+if [ "$(echo "$reply" | head -1)" = "ok 7" ] && wait_for 5 containers_gone; then
+    pass "containers are deleted"
+else
+    fail "containers are deleted" "$reply" "$(control containers)"
+fi
+
+if [ "$FAILED" -ne 0 ]; then
+    exit 1
+fi
+echo "All tests passed"
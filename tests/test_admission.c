@@ -0,0 +1,206 @@
+// Admission control: the cluster and per-node token buckets pace deploys, and
+// a full node table still paces new nodes through the shared overflow queue.
+// Built with MAX_NODES 4 so the table fills quickly.
+#include "../include/admission.h"
+#include "../include/operations.h"
+#include "check.h"
+
+#define TEST_MAX_DISPATCHES 64
+
+// Deploys handed to the dispatcher, in order
+static struct {
+    int op_id;
+    char node_id[MAX_NAME_LEN];
+    double at;                      // Seconds since the test started
+} dispatches[TEST_MAX_DISPATCHES];
+static int dispatch_count = 0;
+static pthread_mutex_t dispatch_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct timespec test_started;
+
+// Seconds since the test started
+static double now_seconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - test_started.tv_sec) + (now.tv_nsec - test_started.tv_nsec) / 1e9;
+}
+
+// Record a deploy instead of sending it
+static int record_dispatch(int op_id, const char* node_id, const lxc_config_t* config) {
+    (void)config;
+    pthread_mutex_lock(&dispatch_mutex);
+    if (dispatch_count < TEST_MAX_DISPATCHES) {
+        dispatches[dispatch_count].op_id = op_id;
+        snprintf(dispatches[dispatch_count].node_id, MAX_NAME_LEN, "%s", node_id);
+        dispatches[dispatch_count].at = now_seconds();
+        dispatch_count++;
+    }
+    pthread_mutex_unlock(&dispatch_mutex);
+    return 0;
+}
+
+static int dispatched(void) {
+    pthread_mutex_lock(&dispatch_mutex);
+    int count = dispatch_count;
+    pthread_mutex_unlock(&dispatch_mutex);
+    return count;
+}
+
+// Wait up to seconds for count dispatches in total
+static int wait_dispatched(int count, double seconds) {
+    double deadline = now_seconds() + seconds;
+    while (dispatched() < count && now_seconds() < deadline) {
+        usleep(10000);
+    }
+    return dispatched() >= count;
+}
+
+// Apply admission rates as a config reload would
+static void configure(double rate, int burst, double node_rate, int node_burst) {
+    daemon_config_t config;
+    config_set_defaults(&config);
+    config.admission_rate = rate;
+    config.admission_burst = burst;
+    config.admission_node_rate = node_rate;
+    config.admission_node_burst = node_burst;
+    config.admission_max_wait = 60;
+    admission_configure(&config);
+}
+
+// Create a deploy operation and submit it for a node
+static int submit(const char* name, const char* node_id) {
+    lxc_config_t config;
+    memset(&config, 0, sizeof(config));
+    snprintf(config.name, sizeof(config.name), "%s", name);
+
+    int op_id = operation_create(OP_DEPLOY, name, node_id, 60);
+    return admission_submit(op_id, node_id, &config);
+}
+
+// Whether admission_list shows a node, and its queue length
+static int listed(const char* node_id, int* queued) {
+    admission_node_info_t infos[MAX_NODES + 1];
+    int count = admission_list(infos, MAX_NODES + 1);
+
+    for (int i = 0; i < count; i++) {
+        if (strcmp(infos[i].node_id, node_id) == 0) {
+            if (queued) *queued = infos[i].queued;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Burst 2 at 4 per second: two deploys go at once, the next two 0.25s apart
+static void test_cluster_bucket(void) {
+    int before = check_failures;
+    configure(4.0, 2, 0.0, 1);
+
+    int start = dispatched();
+    double started = now_seconds();
+    submit("c1", "node-a");
+    submit("c2", "node-b");
+    submit("c3", "node-c");
+    submit("c4", "node-a");
+    CHECK(dispatched() - start == 2, "%d deploys went at once, expected the burst of 2",
+          dispatched() - start);
+
+    CHECK(wait_dispatched(start + 4, 3.0), "queued deploys were not dispatched");
+    double last = dispatches[start + 3].at - started;
+    CHECK(last >= 0.4 && last < 1.5, "last deploy went after %.2fs, expected about 0.5s", last);
+    check_case("admission cluster bucket paces deploys", before);
+}
+
+// One token per node per second: a second deploy to the same node waits while
+// another node is served at once
+static void test_node_bucket(void) {
+    int before = check_failures;
+    configure(0.0, 1, 1.0, 1);
+
+    int start = dispatched();
+    double started = now_seconds();
+    submit("n1", "node-x");
+    submit("n2", "node-x");
+    submit("n3", "node-y");
+    CHECK(dispatched() - start == 2, "%d deploys went at once, expected 2", dispatched() - start);
+    CHECK(strcmp(dispatches[start + 1].node_id, "node-y") == 0,
+          "second dispatch went to %s, expected node-y", dispatches[start + 1].node_id);
+
+    CHECK(wait_dispatched(start + 3, 3.0), "queued deploy was not dispatched");
+    double last = dispatches[start + 2].at - started;
+    CHECK(strcmp(dispatches[start + 2].node_id, "node-x") == 0 && last >= 0.8,
+          "waiting deploy went to %s after %.2fs, expected node-x after about 1s",
+          dispatches[start + 2].node_id, last);
+    check_case("admission node bucket paces one node", before);
+}
+
+// With every slot taken by a node that is still pacing, new nodes share the
+// overflow queue: the cluster bucket and queueing still apply, and each
+// deploy still goes to its own node
+static void test_full_table(void) {
+    int before = check_failures;
+    admission_status_t status;
+
+    // An unlimited rate refills every bucket to its burst at once, which
+    // leaves the nodes of earlier tests idle
+    configure(0.0, 10, 0.0, 1);
+    admission_status(&status);
+    listed("-", NULL);
+    configure(1.0, 10, 0.1, 1);
+
+    int start = dispatched();
+    char name[MAX_NAME_LEN], node_id[MAX_NAME_LEN];
+    for (int i = 0; i < MAX_NODES + 2; i++) {
+        snprintf(name, sizeof(name), "f%d", i);
+        snprintf(node_id, sizeof(node_id), "full-%d", i);
+        submit(name, node_id);
+    }
+
+    // MAX_NODES own entries and the first overflow deploy go at once
+    CHECK(dispatched() - start == MAX_NODES + 1, "%d deploys went at once, expected %d",
+          dispatched() - start, MAX_NODES + 1);
+    snprintf(node_id, sizeof(node_id), "full-%d", MAX_NODES);
+    CHECK(strcmp(dispatches[start + MAX_NODES].node_id, node_id) == 0,
+          "overflow deploy went to %s, expected %s", dispatches[start + MAX_NODES].node_id,
+          node_id);
+
+    int queued = 0;
+    CHECK(listed("*", &queued) && queued == 1, "overflow queue holds %d, expected 1", queued);
+    CHECK(!listed(node_id, NULL), "%s got its own entry in a full table", node_id);
+    admission_status(&status);
+    CHECK(status.tokens < 10.0 - MAX_NODES, "cluster bucket has %.1f tokens, expected under %d",
+          status.tokens, 10 - MAX_NODES);
+
+    // A faster node rate releases the overflow queue to the right node
+    configure(1.0, 10, 100.0, 1);
+    CHECK(wait_dispatched(start + MAX_NODES + 2, 3.0), "overflow deploy was not dispatched");
+    snprintf(node_id, sizeof(node_id), "full-%d", MAX_NODES + 1);
+    CHECK(strcmp(dispatches[start + MAX_NODES + 1].node_id, node_id) == 0,
+          "queued overflow deploy went to %s, expected %s",
+          dispatches[start + MAX_NODES + 1].node_id, node_id);
+    check_case("admission full node table still paces", before);
+}
+
+// Nodes with nothing queued and a full bucket give up their slot
+static void test_idle_eviction(void) {
+    int before = check_failures;
+    configure(0.0, 1, 100.0, 1);
+    usleep(100000);
+
+    submit("e1", "fresh-node");
+    CHECK(listed("fresh-node", NULL), "a new node found no slot after the others went idle");
+    check_case("admission evicts idle nodes", before);
+}
+
+int main(void) {
+    clock_gettime(CLOCK_MONOTONIC, &test_started);
+    if (init_operations() != 0 || init_admission(record_dispatch) != 0) {
+        printf("FAIL: admission did not start\n");
+        return 1;
+    }
+
+    test_cluster_bucket();
+    test_node_bucket();
+    test_full_table();
+    test_idle_eviction();
+    return check_report();
+}
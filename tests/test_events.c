@@ -0,0 +1,163 @@
+// Event subscriptions: reads acknowledge through a cursor so a reader that
+// lost a reply can read the same events again, filters pick what a subscriber
+// buffers, and a full buffer drops its oldest events and reports the gap.
+#include "../include/events.h"
+#include "check.h"
+
+static int notified = 0;
+
+// Count wake-ups instead of waking control clients
+static void count_notify(void) {
+    __atomic_add_fetch(&notified, 1, __ATOMIC_SEQ_CST);
+}
+
+// Publish a container event for a container on a node
+static void publish(const char* name, const char* node_id) {
+    char id[MAX_NAME_LEN];
+    snprintf(id, sizeof(id), "%s_%s", node_id, name);
+    events_publish(EVENT_CONTAINER, "state", id, name, node_id, "RUNNING", "RUNNING");
+}
+
+// Subscribe with filter words as the control command passes them
+static int subscribe(char** words, int count, unsigned long* seq) {
+    event_filter_t filter;
+    int slots;
+    if (events_parse_filter(words, count, &filter, &slots) != 0) return -1;
+    return events_subscribe(&filter, slots, seq);
+}
+
+// Events stay buffered until a cursor acknowledges them, so reading again
+// from an old cursor returns them again
+static void test_cursor_resume(void) {
+    int before = check_failures;
+    event_t events[16];
+    unsigned long seq, lost;
+
+    int id = subscribe(NULL, 0, &seq);
+    CHECK(id > 0, "subscribe failed");
+    for (int i = 0; i < 5; i++) {
+        publish("web", "node-1");
+    }
+
+    int count = events_read(id, 0, 0, events, 16, &lost);
+    CHECK(count == 5 && events[0].seq == seq + 1 && events[4].seq == seq + 5,
+          "first read gave %d events from %lu, expected 5 from %lu", count,
+          count > 0 ? events[0].seq : 0, seq + 1);
+
+    // The reply was lost: read again from the cursor the reader still has
+    count = events_read(id, 1, seq, events, 16, &lost);
+    CHECK(count == 5 && events[0].seq == seq + 1, "reread gave %d events, expected the same 5",
+          count);
+
+    count = events_read(id, 1, seq + 3, events, 16, &lost);
+    CHECK(count == 2 && events[0].seq == seq + 4, "read from cursor %lu gave %d events from %lu",
+          seq + 3, count, count > 0 ? events[0].seq : 0);
+
+    count = events_read(id, 0, 0, events, 16, &lost);
+    CHECK(count == 0 && lost == 0, "read past the last event gave %d events, %lu lost", count,
+          lost);
+    CHECK(events_unsubscribe(id) == 0, "unsubscribe failed");
+    CHECK(events_read(id, 0, 0, events, 16, &lost) == -1, "read after unsubscribe succeeded");
+    check_case("events resume from a cursor", before);
+}
+
+// Only events matching the filter are buffered; a name matches either the
+// container name or its id
+static void test_filters(void) {
+    int before = check_failures;
+    event_t events[16];
+    unsigned long seq, lost;
+    char* by_node[] = { "node=node-2" };
+    char* by_name[] = { "container", "name=node-1_db" };
+    char* bad[] = { "colour=blue" };
+    char* too_big[] = { "slots=100000" };
+
+    int node_id = subscribe(by_node, 1, &seq);
+    int name_id = subscribe(by_name, 2, &seq);
+    CHECK(node_id > 0 && name_id > 0, "filtered subscribe failed");
+    CHECK(subscribe(bad, 1, &seq) == -1, "unknown filter word was accepted");
+    CHECK(subscribe(too_big, 1, &seq) == -1, "oversized buffer was accepted");
+
+    publish("web", "node-1");
+    publish("db", "node-1");
+    publish("db", "node-2");
+    events_publish(EVENT_NODE, "down", "node-2", NULL, "node-2", "DISC", NULL);
+
+    int count = events_read(node_id, 0, 0, events, 16, &lost);
+    CHECK(count == 2 && strcmp(events[0].name, "db") == 0 && events[1].kind == EVENT_NODE,
+          "node filter gave %d events, expected db and the node going down", count);
+
+    count = events_read(name_id, 0, 0, events, 16, &lost);
+    CHECK(count == 1 && strcmp(events[0].id, "node-1_db") == 0,
+          "name filter gave %d events, expected node-1_db only", count);
+
+    events_unsubscribe(node_id);
+    events_unsubscribe(name_id);
+    check_case("events filter by node, name and kind", before);
+}
+
+// A full buffer drops the oldest events; the loss is reported until the
+// reader acknowledges past it
+static void test_overflow(void) {
+    int before = check_failures;
+    event_t events[16];
+    unsigned long seq, lost;
+    char* small[] = { "slots=4" };
+
+    int id = subscribe(small, 1, &seq);
+    for (int i = 0; i < 6; i++) {
+        publish("web", "node-1");
+    }
+
+    int count = events_read(id, 1, seq, events, 16, &lost);
+    CHECK(count == 4 && events[0].seq == seq + 3 && lost == 2,
+          "read gave %d events from %lu with %lu lost, expected 4 from %lu with 2 lost", count,
+          count > 0 ? events[0].seq : 0, lost, seq + 3);
+
+    count = events_read(id, 1, seq, events, 16, &lost);
+    CHECK(lost == 2, "loss no longer reported to a reader behind it (%lu lost)", lost);
+
+    count = events_read(id, 1, seq + 6, events, 16, &lost);
+    CHECK(count == 0 && lost == 0, "after reading everything %d events and %lu lost remain",
+          count, lost);
+
+    event_subscriber_info_t infos[EVENT_MAX_SUBSCRIBERS];
+    int listed = events_list(infos, EVENT_MAX_SUBSCRIBERS);
+    CHECK(listed == 1 && infos[0].dropped == 2, "%d subscribers listed, %lu dropped", listed,
+          listed > 0 ? infos[0].dropped : 0);
+    events_unsubscribe(id);
+    check_case("events report drops from a full buffer", before);
+}
+
+// Readers are woken only when an event reaches some subscriber
+static void test_notify(void) {
+    int before = check_failures;
+    unsigned long seq;
+    char* by_node[] = { "node=node-9" };
+
+    int start = __atomic_load_n(&notified, __ATOMIC_SEQ_CST);
+    int id = subscribe(by_node, 1, &seq);
+    publish("web", "node-1");
+    CHECK(__atomic_load_n(&notified, __ATOMIC_SEQ_CST) == start,
+          "woken for an event nobody wanted");
+    publish("web", "node-9");
+    CHECK(__atomic_load_n(&notified, __ATOMIC_SEQ_CST) == start + 1,
+          "not woken for a matching event");
+    CHECK(events_sequence() == seq + 2, "sequence is %lu, expected %lu", events_sequence(),
+          seq + 2);
+    events_unsubscribe(id);
+    check_case("events wake readers for matching events", before);
+}
+
+int main(void) {
+    if (init_events(count_notify) != 0) {
+        printf("FAIL: events did not start\n");
+        return 1;
+    }
+
+    test_cursor_resume();
+    test_filters();
+    test_overflow();
+    test_notify();
+    return check_report();
+}
@@ -0,0 +1,173 @@
+// Keyed executor: jobs with one key run one at a time in submission order,
+// jobs with different keys run in parallel, and a key with a long backlog
+// takes turns with the others instead of holding every thread.
+#include "../include/executor.h"
+#include "check.h"
+
+#define TEST_THREADS 4
+#define TEST_MAX_RUNS 256
+
+// One job: sleeps, then records that it ran
+typedef struct {
+    int key;
+    int sequence;
+    int sleep_ms;
+} test_job_t;
+
+// Jobs run so far, in the order they finished, and jobs running per key
+static test_job_t runs[TEST_MAX_RUNS];
+static int run_count = 0;
+static int active[TEST_THREADS * 2];
+static int overlaps = 0;
+static pthread_mutex_t runs_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct timespec test_started;
+
+// Seconds since the test started
+static double now_seconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - test_started.tv_sec) + (now.tv_nsec - test_started.tv_nsec) / 1e9;
+}
+
+// Sleep as told and record the run; a second job of the same key running at
+// the same time counts as an overlap
+static void run_job(void* arg) {
+    test_job_t* job = arg;
+
+    pthread_mutex_lock(&runs_mutex);
+    if (active[job->key]++ > 0) overlaps++;
+    pthread_mutex_unlock(&runs_mutex);
+
+    usleep(job->sleep_ms * 1000);
+
+    pthread_mutex_lock(&runs_mutex);
+    active[job->key]--;
+    if (run_count < TEST_MAX_RUNS) runs[run_count++] = *job;
+    pthread_mutex_unlock(&runs_mutex);
+    free(job);
+}
+
+static int finished(void) {
+    pthread_mutex_lock(&runs_mutex);
+    int count = run_count;
+    pthread_mutex_unlock(&runs_mutex);
+    return count;
+}
+
+// Wait up to seconds for count finished jobs in total
+static int wait_finished(int count, double seconds) {
+    double deadline = now_seconds() + seconds;
+    while (finished() < count && now_seconds() < deadline) {
+        usleep(1000);
+    }
+    return finished() >= count;
+}
+
+// Queue a job under the name "key-N"
+static int submit(int key, int sequence, int sleep_ms) {
+    char name[MAX_NAME_LEN];
+    test_job_t* job = malloc(sizeof(test_job_t));
+
+    job->key = key;
+    job->sequence = sequence;
+    job->sleep_ms = sleep_ms;
+    snprintf(name, sizeof(name), "key-%d", key);
+    return executor_submit(name, run_job, job);
+}
+
+// Jobs of one key never overlap and finish in the order they were submitted,
+// including jobs that arrive while an earlier one is running
+static void test_key_order(void) {
+    int before = check_failures;
+    int start = finished();
+
+    for (int i = 0; i < 20; i++) {
+        CHECK(submit(0, i, 1 + (i * 7) % 5) == 0, "job %d was refused", i);
+        if (i % 4 == 0) usleep(1000);
+    }
+    CHECK(wait_finished(start + 20, 5.0), "jobs of one key did not finish");
+
+    for (int i = 0; i < 20 && start + i < finished(); i++) {
+        CHECK(runs[start + i].sequence == i, "job %d finished in place %d",
+              runs[start + i].sequence, i);
+    }
+    CHECK(overlaps == 0, "%d jobs ran alongside another of their key", overlaps);
+    check_case("executor runs one key in order", before);
+}
+
+// Jobs of different keys share the threads
+static void test_keys_in_parallel(void) {
+    int before = check_failures;
+    int start = finished();
+    double started = now_seconds();
+
+    for (int key = 0; key < TEST_THREADS; key++) {
+        submit(key, 0, 200);
+    }
+    CHECK(wait_finished(start + TEST_THREADS, 5.0), "jobs of different keys did not finish");
+    double elapsed = now_seconds() - started;
+    CHECK(elapsed < 0.4, "%d jobs of 200 ms took %.2fs, expected them to run together",
+          TEST_THREADS, elapsed);
+    check_case("executor runs different keys in parallel", before);
+}
+
+// Every thread is busy with a key that has a long backlog; a job for a new
+// key runs as soon as one thread is free rather than after the backlog
+static void test_busy_keys_take_turns(void) {
+    int before = check_failures;
+    int start = finished();
+
+    for (int key = 0; key < TEST_THREADS; key++) {
+        for (int i = 0; i < 10; i++) {
+            submit(key, i, 20);
+        }
+    }
+    usleep(5000);
+    double submitted = now_seconds();
+    submit(TEST_THREADS, 0, 1);
+
+    double quick = -1.0;
+    while (quick < 0 && now_seconds() - submitted < 5.0) {
+        pthread_mutex_lock(&runs_mutex);
+        for (int i = start; i < run_count; i++) {
+            if (runs[i].key == TEST_THREADS) quick = now_seconds() - submitted;
+        }
+        pthread_mutex_unlock(&runs_mutex);
+        usleep(1000);
+    }
+    CHECK(quick >= 0 && quick < 0.1, "new key's job finished after %.2fs, expected about 20 ms",
+          quick);
+
+    CHECK(wait_finished(start + TEST_THREADS * 10 + 1, 5.0), "backlog did not finish");
+    check_case("executor lets busy keys take turns", before);
+}
+
+// Idle keys are forgotten and the counters add up
+static void test_status(void) {
+    int before = check_failures;
+    executor_status_t status;
+
+    usleep(10000);
+    executor_status(&status);
+    CHECK(status.threads == TEST_THREADS, "%d threads, expected %d", status.threads, TEST_THREADS);
+    CHECK(status.queued == 0 && status.running == 0, "%d queued and %d running after the jobs",
+          status.queued, status.running);
+    CHECK(status.keys == 0, "%d keys kept with nothing pending", status.keys);
+    CHECK(status.completed == (unsigned long)finished(), "%lu completed, %d jobs ran",
+          status.completed, finished());
+    check_case("executor status counts jobs and keys", before);
+}
+
+int main(void) {
+    clock_gettime(CLOCK_MONOTONIC, &test_started);
+    if (init_executor(TEST_THREADS) != 0) {
+        printf("FAIL: executor did not start\n");
+        return 1;
+    }
+
+    test_key_order();
+    test_keys_in_parallel();
+    test_busy_keys_take_turns();
+    test_status();
+    return check_report();
+}
@@ -0,0 +1,195 @@
+// Reconciler: a container marked many times is reconciled once per change,
+// retries back off exponentially without holding up other containers, a
+// container that keeps failing is given up until its next change, and a
+// correction in flight waits for its completion to mark it again.
+// Built with RECONCILE_MAX_ATTEMPTS 2 so giving up takes seconds.
+#include "../include/reconciler.h"
+#include "check.h"
+
+#define TEST_MAX_CALLS 16
+
+// What the handler answers for one container, call by call; the last answer
+// repeats. Calls are timed from the start of the test.
+typedef struct {
+    const char* id;
+    reconcile_result_t answers[4];
+    int answer_count;
+    int calls;
+    double called_at[TEST_MAX_CALLS];
+} script_t;
+
+static script_t scripts[] = {
+    { "gate", { RECONCILE_CONVERGED }, 1, 0, { 0 } },
+    { "x", { RECONCILE_CONVERGED }, 1, 0, { 0 } },
+    { "flaky", { RECONCILE_RETRY, RECONCILE_CONVERGED }, 2, 0, { 0 } },
+    { "broken", { RECONCILE_RETRY }, 1, 0, { 0 } },
+    { "steady", { RECONCILE_CONVERGED }, 1, 0, { 0 } },
+    { "fixing", { RECONCILE_CORRECTING, RECONCILE_CONVERGED }, 2, 0, { 0 } },
+};
+#define SCRIPT_COUNT ((int)(sizeof(scripts) / sizeof(scripts[0])))
+
+static pthread_mutex_t script_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t gate_cond = PTHREAD_COND_INITIALIZER;
+static int gate_closed = 0;
+static struct timespec test_started;
+
+// Seconds since the test started
+static double now_seconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - test_started.tv_sec) + (now.tv_nsec - test_started.tv_nsec) / 1e9;
+}
+
+static script_t* find_script(const char* id) {
+    for (int i = 0; i < SCRIPT_COUNT; i++) {
+        if (strcmp(scripts[i].id, id) == 0) return &scripts[i];
+    }
+    return NULL;
+}
+
+// Answer from the container's script; "gate" holds the reconciler while the
+// gate is closed
+static reconcile_result_t scripted_handler(const char* container_id) {
+    pthread_mutex_lock(&script_mutex);
+    script_t* script = find_script(container_id);
+    if (!script) {
+        pthread_mutex_unlock(&script_mutex);
+        return RECONCILE_CONVERGED;
+    }
+
+    if (script->calls < TEST_MAX_CALLS) script->called_at[script->calls] = now_seconds();
+    int call = script->calls++;
+    reconcile_result_t answer =
+        script->answers[call < script->answer_count ? call : script->answer_count - 1];
+
+    while (strcmp(container_id, "gate") == 0 && gate_closed) {
+        pthread_cond_wait(&gate_cond, &script_mutex);
+    }
+    pthread_mutex_unlock(&script_mutex);
+    return answer;
+}
+
+// Calls so far for a container, and when the given one was made
+static int calls(const char* id, int call, double* at) {
+    pthread_mutex_lock(&script_mutex);
+    script_t* script = find_script(id);
+    int count = script->calls;
+    if (at) *at = call < count ? script->called_at[call] : -1.0;
+    pthread_mutex_unlock(&script_mutex);
+    return count;
+}
+
+// Wait up to seconds for a container to have been called count times
+static int wait_calls(const char* id, int count, double seconds) {
+    double deadline = now_seconds() + seconds;
+    while (calls(id, 0, NULL) < count && now_seconds() < deadline) {
+        usleep(10000);
+    }
+    return calls(id, 0, NULL) >= count;
+}
+
+// Marks that arrive while a container is queued or being reconciled add one
+// more pass at most
+static void test_marks_coalesce(void) {
+    int before = check_failures;
+
+    pthread_mutex_lock(&script_mutex);
+    gate_closed = 1;
+    pthread_mutex_unlock(&script_mutex);
+
+    reconciler_mark_dirty("gate");
+    CHECK(wait_calls("gate", 1, 1.0), "gate was not reconciled");
+    reconciler_mark_dirty("gate");
+    for (int i = 0; i < 3; i++) {
+        reconciler_mark_dirty("x");
+    }
+
+    pthread_mutex_lock(&script_mutex);
+    gate_closed = 0;
+    pthread_cond_broadcast(&gate_cond);
+    pthread_mutex_unlock(&script_mutex);
+
+    CHECK(wait_calls("gate", 2, 1.0), "gate marked while running was not reconciled again");
+    CHECK(wait_calls("x", 1, 1.0), "x was not reconciled");
+    usleep(200000);
+    CHECK(calls("gate", 0, NULL) == 2 && calls("x", 0, NULL) == 1,
+          "gate reconciled %d times and x %d times, expected 2 and 1", calls("gate", 0, NULL),
+          calls("x", 0, NULL));
+    check_case("reconciler coalesces repeated marks", before);
+}
+
+// A retry waits RECONCILE_BASE_BACKOFF seconds while other containers go
+// straight through; after RECONCILE_MAX_ATTEMPTS the container is dropped
+// until it is marked again
+static void test_retry_backoff(void) {
+    int before = check_failures;
+    double first, second;
+
+    reconciler_mark_dirty("flaky");
+    reconciler_mark_dirty("broken");
+    CHECK(wait_calls("flaky", 1, 1.0) && wait_calls("broken", 1, 1.0),
+          "retrying containers were not reconciled");
+
+    usleep(300000);
+    double marked = now_seconds();
+    reconciler_mark_dirty("steady");
+    CHECK(wait_calls("steady", 1, 0.5), "a container waited behind backed-off retries");
+    calls("steady", 0, &first);
+    CHECK(first - marked < 0.5, "steady waited %.2fs", first - marked);
+
+    CHECK(wait_calls("flaky", 2, 4.0), "flaky was not retried");
+    calls("flaky", 0, &first);
+    calls("flaky", 1, &second);
+    CHECK(second - first >= RECONCILE_BASE_BACKOFF - 1 &&
+          second - first < RECONCILE_BASE_BACKOFF + 1.5,
+          "flaky was retried after %.2fs, expected about %ds", second - first,
+          RECONCILE_BASE_BACKOFF);
+
+    // The next backoff is twice as long; by its end broken is given up
+    usleep((2 * RECONCILE_BASE_BACKOFF + 2) * 1000000);
+    CHECK(calls("broken", 0, NULL) == RECONCILE_MAX_ATTEMPTS,
+          "broken was tried %d times, expected %d", calls("broken", 0, NULL),
+          RECONCILE_MAX_ATTEMPTS);
+    CHECK(calls("flaky", 0, NULL) == 2, "flaky was tried %d times after converging",
+          calls("flaky", 0, NULL));
+
+    reconciler_mark_dirty("broken");
+    CHECK(wait_calls("broken", RECONCILE_MAX_ATTEMPTS + 1, 0.5),
+          "broken was not reconciled again after a new change");
+    check_case("reconciler backs off retries and gives up", before);
+}
+
+// A correction in flight is not repeated; the mark from its completion
+// brings the container back after a backoff
+static void test_correction_parks(void) {
+    int before = check_failures;
+    double second;
+
+    reconciler_mark_dirty("fixing");
+    CHECK(wait_calls("fixing", 1, 1.0), "fixing was not reconciled");
+    usleep(RECONCILE_BASE_BACKOFF * 1000000 + 200000);
+    CHECK(calls("fixing", 0, NULL) == 1, "correction was repeated before it completed");
+
+    double completed = now_seconds();
+    reconciler_mark_dirty("fixing");
+    CHECK(wait_calls("fixing", 2, RECONCILE_BASE_BACKOFF + 1.5),
+          "fixing was not checked after its correction completed");
+    calls("fixing", 1, &second);
+    CHECK(second - completed >= RECONCILE_BASE_BACKOFF - 1,
+          "checked %.2fs after the correction, expected a backoff of about %ds",
+          second - completed, RECONCILE_BASE_BACKOFF);
+    check_case("reconciler parks containers being corrected", before);
+}
+
+int main(void) {
+    clock_gettime(CLOCK_MONOTONIC, &test_started);
+    if (init_reconciler(scripted_handler) != 0) {
+        printf("FAIL: reconciler did not start\n");
+        return 1;
+    }
+
+    test_marks_coalesce();
+    test_retry_backoff();
+    test_correction_parks();
+    return check_report();
+}
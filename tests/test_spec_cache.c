@@ -0,0 +1,159 @@
+// Spec cache: an unchanged spec is served without reading the file, a touched
+// or freshly written one is reread and hashed but not parsed again, and an
+// edit is parsed even when it keeps the file's size and mtime.
+#include "../include/spec_cache.h"
+#include "check.h"
+
+static char work_dir[] = "/tmp/dlxc-spec-test.XXXXXX";
+
+// Write a spec file and set its mtime to seconds from now
+static void write_spec(const char* path, const char* text, long mtime_offset) {
+    FILE* file = fopen(path, "w");
+    fputs(text, file);
+    fclose(file);
+
+    struct timespec times[2];
+    clock_gettime(CLOCK_REALTIME, &times[0]);
+    times[0].tv_sec += mtime_offset;
+    times[1] = times[0];
+    utimensat(AT_FDCWD, path, times, 0);
+}
+
+// Set a file's mtime to an exact time
+static void set_mtime(const char* path, const struct timespec* mtime) {
+    struct timespec times[2] = { *mtime, *mtime };
+    utimensat(AT_FDCWD, path, times, 0);
+}
+
+// Counter deltas since the given status
+static void counted(const spec_cache_status_t* start, unsigned long* hits,
+                    unsigned long* revalidated, unsigned long* parsed) {
+    spec_cache_status_t status;
+    spec_cache_status(&status);
+    *hits = status.hits - start->hits;
+    *revalidated = status.revalidated - start->revalidated;
+    *parsed = status.parsed - start->parsed;
+}
+
+// A spec written a while ago is parsed once, then served from the cache
+static void test_hit(void) {
+    int before = check_failures;
+    char path[MAX_PATH_LEN];
+    lxc_config_t config;
+    spec_cache_status_t start;
+    unsigned long hits, revalidated, parsed;
+
+    snprintf(path, sizeof(path), "%s/old.yaml", work_dir);
+    write_spec(path, "name: old\ncpu_limit: 2\nmemory_limit: 512\n", -10);
+    spec_cache_status(&start);
+
+    CHECK(spec_cache_load(path, &config) == 0, "first load failed");
+    CHECK(strcmp(config.name, "old") == 0 && config.cpu_limit == 2 && config.memory_limit == 512,
+          "parsed %s with cpu %d and memory %d", config.name, config.cpu_limit,
+          config.memory_limit);
+
+    memset(&config, 0, sizeof(config));
+    CHECK(spec_cache_load(path, &config) == 0, "second load failed");
+    CHECK(strcmp(config.name, "old") == 0 && config.cpu_limit == 2, "cached spec is %s cpu %d",
+          config.name, config.cpu_limit);
+
+    counted(&start, &hits, &revalidated, &parsed);
+    CHECK(parsed == 1 && hits == 1 && revalidated == 0,
+          "%lu parsed, %lu hits, %lu revalidated, expected 1, 1, 0", parsed, hits, revalidated);
+    check_case("spec cache serves an unchanged spec", before);
+}
+
+// A touched file with the same content is hashed again but not parsed
+static void test_revalidate(void) {
+    int before = check_failures;
+    char path[MAX_PATH_LEN];
+    lxc_config_t config;
+    spec_cache_status_t start;
+    unsigned long hits, revalidated, parsed;
+
+    snprintf(path, sizeof(path), "%s/touched.yaml", work_dir);
+    write_spec(path, "name: touched\ncpu_limit: 1\n", -20);
+    spec_cache_status(&start);
+    spec_cache_load(path, &config);
+
+    write_spec(path, "name: touched\ncpu_limit: 1\n", -5);
+    CHECK(spec_cache_load(path, &config) == 0 && strcmp(config.name, "touched") == 0,
+          "touched spec did not load");
+
+    counted(&start, &hits, &revalidated, &parsed);
+    CHECK(parsed == 1 && revalidated == 1 && hits == 0,
+          "%lu parsed, %lu revalidated, %lu hits, expected 1, 1, 0", parsed, revalidated, hits);
+    check_case("spec cache revalidates a touched spec", before);
+}
+
+// A file whose mtime is not yet in the past is never trusted on identity
+// alone: an edit that keeps size and mtime is still parsed
+static void test_same_size_edit(void) {
+    int before = check_failures;
+    char path[MAX_PATH_LEN];
+    lxc_config_t config;
+    spec_cache_status_t start;
+    unsigned long hits, revalidated, parsed;
+    struct stat info;
+
+    snprintf(path, sizeof(path), "%s/edited.yaml", work_dir);
+    write_spec(path, "name: edited\ncpu_limit: 1\n", 100);
+    stat(path, &info);
+    spec_cache_status(&start);
+
+    CHECK(spec_cache_load(path, &config) == 0 && config.cpu_limit == 1, "first load failed");
+    CHECK(spec_cache_load(path, &config) == 0 && config.cpu_limit == 1, "reload failed");
+
+    write_spec(path, "name: edited\ncpu_limit: 4\n", 0);
+    set_mtime(path, &info.st_mtim);
+    CHECK(spec_cache_load(path, &config) == 0 && config.cpu_limit == 4,
+          "edited spec loaded with cpu %d, expected 4", config.cpu_limit);
+
+    counted(&start, &hits, &revalidated, &parsed);
+    CHECK(parsed == 2 && revalidated == 1 && hits == 0,
+          "%lu parsed, %lu revalidated, %lu hits, expected 2, 1, 0", parsed, revalidated, hits);
+    check_case("spec cache parses a same-size edit", before);
+}
+
+// Broken or missing specs fail and leave nothing cached
+static void test_errors(void) {
+    int before = check_failures;
+    char path[MAX_PATH_LEN];
+    lxc_config_t config;
+    spec_cache_status_t start, status;
+
+    snprintf(path, sizeof(path), "%s/broken.yaml", work_dir);
+    write_spec(path, "name: broken\npriority: whenever\n", -10);
+    spec_cache_status(&start);
+
+    CHECK(spec_cache_load(path, &config) == -1, "a broken spec loaded");
+    CHECK(spec_cache_load(path, &config) == -1, "a broken spec loaded from the cache");
+    snprintf(path, sizeof(path), "%s/missing.yaml", work_dir);
+    CHECK(spec_cache_load(path, &config) == -1, "a missing spec loaded");
+
+    spec_cache_status(&status);
+    CHECK(status.entries == start.entries && status.parsed == start.parsed,
+          "failed loads left %d entries, expected %d", status.entries, start.entries);
+
+    spec_cache_clear();
+    spec_cache_status(&status);
+    CHECK(status.entries == 0, "%d entries after clearing", status.entries);
+    check_case("spec cache refuses broken specs", before);
+}
+
+int main(void) {
+    if (!mkdtemp(work_dir) || init_spec_cache() != 0) {
+        printf("FAIL: spec cache test could not start\n");
+        return 1;
+    }
+
+    test_hit();
+    test_revalidate();
+    test_same_size_edit();
+    test_errors();
+
+    char command[MAX_PATH_LEN + 16];
+    snprintf(command, sizeof(command), "rm -rf %s", work_dir);
+    if (system(command) != 0) printf("Warning: could not remove %s\n", work_dir);
+    return check_report();
+}
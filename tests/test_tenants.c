@@ -0,0 +1,194 @@
+// Tenant queue: pending deployments go in dominant-resource-share order,
+// requests that can never be placed fail instead of waiting, and a request
+// that finds no room does not hold up the smaller ones behind it.
+#include "../include/tenants.h"
+#include "../include/raft.h"
+#include "check.h"
+
+#define TEST_MAX_PLACEMENTS 64
+
+// Node table normally owned by the coordinator: one node with 100 CPUs,
+// 100 GB of memory and 100 container slots
+node_t nodes[MAX_NODES];
+int node_count = 0;
+pthread_mutex_t nodes_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Lock the node table
+void lock_nodes(void) {
+    pthread_mutex_lock(&nodes_mutex);
+}
+
+// The test coordinator runs standalone
+int raft_enabled(void) {
+    return 0;
+}
+
+int raft_is_leader(void) {
+    return 1;
+}
+
+// How the placer answers: no room for anything, or by request size
+typedef enum {
+    PLACE_NO_ROOM,
+    PLACE_BY_SIZE                   // Room below 50 CPUs, "bad-" names never fit
+} place_mode_t;
+
+static place_mode_t place_mode = PLACE_NO_ROOM;
+static char placed[TEST_MAX_PLACEMENTS][MAX_NAME_LEN];
+static int placed_count = 0;
+static int next_op_id = 1;
+static pthread_mutex_t placed_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Place by the current mode; a placed container is charged to its tenant as
+// the registry would
+static int test_placer(const lxc_config_t* config, container_state_t desired_state) {
+    (void)desired_state;
+
+    pthread_mutex_lock(&placed_mutex);
+    place_mode_t mode = place_mode;
+    pthread_mutex_unlock(&placed_mutex);
+
+    if (strncmp(config->name, "bad-", 4) == 0) return -1;
+    if (mode == PLACE_NO_ROOM || config->cpu_limit >= 50) return TENANT_NO_ROOM;
+
+    tenant_charge(config);
+    pthread_mutex_lock(&placed_mutex);
+    if (placed_count < TEST_MAX_PLACEMENTS) {
+        snprintf(placed[placed_count++], MAX_NAME_LEN, "%s", config->name);
+    }
+    int op_id = next_op_id++;
+    pthread_mutex_unlock(&placed_mutex);
+    return op_id;
+}
+
+static void set_mode(place_mode_t mode) {
+    pthread_mutex_lock(&placed_mutex);
+    place_mode = mode;
+    pthread_mutex_unlock(&placed_mutex);
+}
+
+static int placements(void) {
+    pthread_mutex_lock(&placed_mutex);
+    int count = placed_count;
+    pthread_mutex_unlock(&placed_mutex);
+    return count;
+}
+
+// Wait up to seconds for count placements in total
+static int wait_placements(int count, int seconds) {
+    for (int i = 0; i < seconds * 100 && placements() < count; i++) {
+        usleep(10000);
+    }
+    return placements() >= count;
+}
+
+static int submit(const char* tenant, const char* name, int cpu) {
+    lxc_config_t config;
+    memset(&config, 0, sizeof(config));
+    snprintf(config.name, sizeof(config.name), "%s", name);
+    snprintf(config.tenant, sizeof(config.tenant), "%s", tenant);
+    config.cpu_limit = cpu;
+    config.memory_limit = 256;
+    return tenant_submit(&config, CONTAINER_STOPPED);
+}
+
+// Deployments a tenant has waiting
+static int pending(const char* tenant) {
+    tenant_info_t infos[MAX_TENANTS];
+    int count = tenants_list(infos, MAX_TENANTS);
+
+    for (int i = 0; i < count; i++) {
+        if (strcmp(infos[i].name, tenant) == 0) return infos[i].pending;
+    }
+    return 0;
+}
+
+// Nudge the dispatcher as a config reload does
+static void wake_dispatcher(void) {
+    tenants_configure(config_current());
+}
+
+// A request no node can ever take fails at once instead of waiting
+static void test_unplaceable(void) {
+    int before = check_failures;
+    set_mode(PLACE_BY_SIZE);
+
+    CHECK(submit("alpha", "bad-1", 1) < 0, "an unplaceable request was accepted");
+    CHECK(pending("alpha") == 0, "an unplaceable request was queued");
+    check_case("tenants refuse requests that can never be placed", before);
+}
+
+// Queued while nothing has room, then placed lowest dominant share first:
+// beta holds no resources, so both of its requests go before gamma's
+static void test_dominant_share_order(void) {
+    int before = check_failures;
+    lxc_config_t held;
+
+    memset(&held, 0, sizeof(held));
+    snprintf(held.tenant, sizeof(held.tenant), "gamma");
+    held.cpu_limit = 30;
+    held.memory_limit = 256;
+    tenant_charge(&held);
+
+    set_mode(PLACE_NO_ROOM);
+    CHECK(submit("gamma", "g1", 10) == 0, "g1 was not queued");
+    CHECK(submit("gamma", "g2", 10) == 0, "g2 was not queued");
+    CHECK(submit("beta", "b1", 10) == 0, "b1 was not queued");
+    CHECK(submit("beta", "b2", 10) == 0, "b2 was not queued");
+
+    // Let the dispatcher finish the rounds the queueing started
+    usleep(200000);
+    int start = placements();
+    set_mode(PLACE_BY_SIZE);
+    wake_dispatcher();
+
+    CHECK(wait_placements(start + 4, 5), "queued requests were not placed");
+    static const char* expected[] = { "b1", "b2", "g1", "g2" };
+    for (int i = 0; i < 4 && start + i < placements(); i++) {
+        CHECK(strcmp(placed[start + i], expected[i]) == 0, "placement %d was %s, expected %s",
+              i + 1, placed[start + i], expected[i]);
+    }
+    check_case("tenants are served in dominant share order", before);
+}
+
+// A request that finds no room is passed over, so a small one behind it is
+// placed; one found unplaceable later is dropped from the queue
+static void test_stuck_head(void) {
+    int before = check_failures;
+
+    set_mode(PLACE_NO_ROOM);
+    CHECK(submit("delta", "d-big", 60) == 0, "d-big was not queued");
+    CHECK(submit("delta", "d-small", 5) == 0, "d-small was not queued");
+    CHECK(submit("delta", "bad-2", 5) == 0, "bad-2 was not queued");
+    usleep(200000);
+
+    int start = placements();
+    set_mode(PLACE_BY_SIZE);
+    wake_dispatcher();
+
+    CHECK(wait_placements(start + 1, 2), "the small request waited behind the big one");
+    CHECK(placements() == start + 1 && strcmp(placed[start], "d-small") == 0,
+          "placed %s, expected only d-small", placements() > start ? placed[start] : "nothing");
+    usleep(200000);
+    CHECK(pending("delta") == 1, "delta has %d pending, expected only d-big", pending("delta"));
+    check_case("tenants place past a request with no room", before);
+}
+
+int main(void) {
+    node_t* node = &nodes[node_count++];
+    snprintf(node->id, sizeof(node->id), "node-1");
+    node->state = NODE_CONNECTED;
+    node->resources.cpu_capacity = 100;
+    node->resources.memory_capacity = 102400;
+    node->resources.max_containers = 100;
+
+    if (init_tenants(test_placer) != 0) {
+        printf("FAIL: tenants did not start\n");
+        return 1;
+    }
+
+    test_unplaceable();
+    test_dominant_share_order();
+    test_stuck_head();
+    return check_report();
+}